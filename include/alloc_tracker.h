@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+
+// Counts heap allocations made by the calling thread. Only active in builds
+// with EFZ_ALLOC_TRACKING (Debug, or the CMake option), which replaces the
+// global operator new; otherwise the count stays at zero and IsEnabled()
+// returns false.
+class AllocTracker {
+public:
+    static bool IsEnabled();
+    static size_t GetThreadAllocations();
+};
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Fast non-cryptographic 64-bit fingerprint for memory snapshots. Only used
+// to tell whether a block changed since the previous tick, never persisted.
+// The SSE2 and scalar paths produce identical values.
+class BlockHash {
+public:
+    static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0);
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Half-open pixel rectangle [x0, x1) x [y0, y1)
+struct CanvasRect {
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+    static CanvasRect Make(int x, int y, int width, int height) { return {x, y, x + width, y + height}; }
+    bool Empty() const { return x1 <= x0 || y1 <= y0; }
+    int Area() const { return Empty() ? 0 : (x1 - x0) * (y1 - y0); }
+    CanvasRect Intersect(const CanvasRect& other) const;
+    CanvasRect Union(const CanvasRect& other) const;    // Bounding box; an empty side is ignored
+    bool operator==(const CanvasRect& other) const {
+        return x0 == other.x0 && y0 == other.y0 && x1 == other.x1 && y1 == other.y1;
+    }
+};
+
+// 32-bit premultiplied BGRA image (B in the lowest byte, so a pixel reads
+// 0xAARRGGBB as a little-endian uint32). Compositing is the "over" operator
+// on premultiplied colour with exact /255 rounding; the SSE2 paths blend
+// four pixels at a time and produce the same bytes as the scalar ones.
+//
+// No Windows dependencies.
+class Canvas {
+public:
+    Canvas() = default;
+    Canvas(int width, int height) { Resize(width, height); }
+    void Resize(int width, int height);     // Contents become transparent
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    CanvasRect GetBounds() const { return {0, 0, width, height}; }
+    uint32_t* Row(int y) { return pixels.data() + (size_t)y * width; }
+    const uint32_t* Row(int y) const { return pixels.data() + (size_t)y * width; }
+
+    // Straight 0xAARRGGBB to premultiplied
+    static uint32_t Premultiply(uint32_t argb);
+
+    // Every operation is clipped to the canvas
+    void Fill(const CanvasRect& area, uint32_t color);          // Replace
+    void FillBlend(const CanvasRect& area, uint32_t color);     // Color over the pixels
+    // Color scaled by 8-bit coverage (a glyph) at x, y; only pixels inside clip change
+    void BlendMask(int x, int y, const uint8_t* mask, int maskStride, int maskWidth, int maskHeight, uint32_t color,
+                   const CanvasRect& clip);
+    // source over the pixels at x, y
+    void BlendCanvas(int x, int y, const Canvas& source, const CanvasRect& clip);
+    // Bilinear resample of source to this canvas's size
+    void ScaleFrom(const Canvas& source);
+
+    static const char* GetSimdLevel();
+    static void ForceScalar(bool scalar) { forceScalar = scalar; }  // Self-test and benchmark
+
+    // SIMD and scalar blends against each other and against the exact
+    // formula, clipping at every edge. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+
+private:
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> pixels;
+    static bool forceScalar;
+};
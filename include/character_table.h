@@ -0,0 +1,159 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "constants.h"
+
+// Size of the character name field at CHARACTER_NAME_OFFSET
+#define CHARACTER_NAME_FIELD_SIZE 12
+
+struct CharacterInfo {
+    int id;
+    const char* rawName;      // As stored in game memory (matched case-insensitively)
+    const char* displayName;  // Shown on the overlay
+    const char* portrait;     // File in overlay_assets/portraits
+};
+
+// Single source for character IDs, names and portraits, indexed by ID
+constexpr CharacterInfo CHARACTER_TABLE[] = {
+    { CHAR_ID_AKANE,    "AKANE",    "Akane",          "akane.png" },
+    { CHAR_ID_AKIKO,    "AKIKO",    "Akiko",          "akiko.png" },
+    { CHAR_ID_IKUMI,    "IKUMI",    "Ikumi",          "ikumi.png" },
+    { CHAR_ID_MISAKI,   "MISAKI",   "Misaki",         "misaki.png" },
+    { CHAR_ID_SAYURI,   "SAYURI",   "Sayuri",         "sayuri.png" },
+    { CHAR_ID_KANNA,    "KANNA",    "Kanna",          "kanna.png" },
+    { CHAR_ID_KAORI,    "KAORI",    "Kaori",          "kaori.png" },
+    { CHAR_ID_MAKOTO,   "MAKOTO",   "Makoto",         "makoto.png" },
+    { CHAR_ID_MINAGI,   "MINAGI",   "Minagi",         "minagi.png" },
+    { CHAR_ID_MIO,      "MIO",      "Mio",            "mio.png" },
+    { CHAR_ID_MISHIO,   "MISHIO",   "Mishio",         "mishio.png" },
+    { CHAR_ID_MISUZU,   "MISUZU",   "Misuzu",         "misuzu.png" },
+    { CHAR_ID_MIZUKA,   "MIZUKA",   "UNKNOWN",        "mizukab.png" },  // Both forms share the portrait
+    { CHAR_ID_NAGAMORI, "NAGAMORI", "Mizuka",         "nagamori.png" },
+    { CHAR_ID_NANASE,   "NANASE",   "Rumi",           "nanase.png" },
+    { CHAR_ID_EXNANASE, "EXNANASE", "Doppel Nanase",  "exnanase.png" },
+    { CHAR_ID_NAYUKI,   "NAYUKI",   "Nayuki(Asleep)", "nayuki.png" },
+    { CHAR_ID_NAYUKIB,  "NAYUKIB",  "Nayuki(Awake)",  "nayukib.png" },
+    { CHAR_ID_SHIORI,   "SHIORI",   "Shiori",         "shiori.png" },
+    { CHAR_ID_AYU,      "AYU",      "Ayu",            "ayu.png" },
+    { CHAR_ID_MAI,      "MAI",      "Mai",            "mai.png" },
+    { CHAR_ID_MAYU,     "MAYU",     "Mayu",           "mayu.png" },
+    { CHAR_ID_MIZUKAB,  "MIZUKAB",  "UNKNOWN",        "mizukab.png" },
+    { CHAR_ID_KANO,     "KANO",     "Kano",           "kano.png" },
+};
+
+constexpr int CHARACTER_COUNT = (int)(sizeof(CHARACTER_TABLE) / sizeof(CHARACTER_TABLE[0]));
+static_assert(CHARACTER_COUNT == MAX_CHARACTER_ID + 1, "character table out of sync with MAX_CHARACTER_ID");
+
+// Resolves the raw name field to an ID through a perfect hash built at
+// compile time: the first 8 bytes of the field (every raw name fits) are
+// packed into a 64-bit key, and a multiplier is searched so that the top
+// CHARACTER_HASH_BITS bits of key * multiplier differ for every character.
+#define CHARACTER_HASH_BITS 6
+#define CHARACTER_HASH_SLOTS (1 << CHARACTER_HASH_BITS)
+
+struct CharacterHash {
+    uint64_t multiplier;
+    uint64_t keys[CHARACTER_HASH_SLOTS];  // 0 = empty
+    int8_t ids[CHARACTER_HASH_SLOTS];
+};
+
+constexpr uint64_t PackCharacterKey(const char* name) {
+    uint64_t key = 0;
+    for (int i = 0; i < 8 && name[i] != '\0'; i++) {
+        key |= (uint64_t)(uint8_t)name[i] << (8 * i);
+    }
+    return key;
+}
+
+constexpr uint32_t CharacterHashSlot(uint64_t key, uint64_t multiplier) {
+    return (uint32_t)((key * multiplier) >> (64 - CHARACTER_HASH_BITS));
+}
+
+constexpr bool IsCharacterTableValid() {
+    for (int id = 0; id < CHARACTER_COUNT; id++) {
+        const char* name = CHARACTER_TABLE[id].rawName;
+        int length = 0;
+        while (name[length] != '\0') {
+            if (name[length] < 'A' || name[length] > 'Z') return false;
+            length++;
+        }
+        if (CHARACTER_TABLE[id].id != id || length < 3 || length > 8) return false;
+    }
+    return true;
+}
+
+static_assert(IsCharacterTableValid(), "CHARACTER_TABLE must be ordered by ID with uppercase raw names of 3-8 letters");
+
+constexpr CharacterHash BuildCharacterHash() {
+    uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    for (;;) {
+        uint64_t used = 0;
+        bool collision = false;
+        for (int id = 0; id < CHARACTER_COUNT && !collision; id++) {
+            uint64_t bit = 1ull << CharacterHashSlot(PackCharacterKey(CHARACTER_TABLE[id].rawName), multiplier);
+            collision = (used & bit) != 0;
+            used |= bit;
+        }
+        if (!collision) break;
+        multiplier = (multiplier * 6364136223846793005ull + 1442695040888963407ull) | 1;
+    }
+
+    CharacterHash hash = {};
+    hash.multiplier = multiplier;
+    for (int slot = 0; slot < CHARACTER_HASH_SLOTS; slot++) {
+        hash.ids[slot] = -1;
+    }
+    for (int id = 0; id < CHARACTER_COUNT; id++) {
+        uint64_t key = PackCharacterKey(CHARACTER_TABLE[id].rawName);
+        uint32_t slot = CharacterHashSlot(key, multiplier);
+        hash.keys[slot] = key;
+        hash.ids[slot] = (int8_t)id;
+    }
+    return hash;
+}
+
+class CharacterTable {
+public:
+    static constexpr CharacterHash HASH = BuildCharacterHash();
+
+    // field points at CHARACTER_NAME_FIELD_SIZE bytes. Case-insensitive exact
+    // match, else the longest known name the field starts with. No allocation.
+    static int ResolveRawName(const char* field) {
+        uint64_t key;
+        memcpy(&key, field, sizeof(key));
+
+        // Keep only the bytes before the first NUL, then fold ASCII case
+        uint64_t zeroBytes = (key - 0x0101010101010101ull) & ~key & 0x8080808080808080ull;
+        uint64_t firstZero = zeroBytes & (0 - zeroBytes);
+        key &= (firstZero >> 7) - 1;
+        key &= 0xDFDFDFDFDFDFDFDFull;
+
+        int id = Lookup(key);
+        if (id >= 0) return id;
+
+        // Rare: trailing bytes after the name
+        for (int length = 7; length >= 3; length--) {
+            uint64_t prefix = key & ((1ull << (8 * length)) - 1);
+            if (prefix != key) {
+                id = Lookup(prefix);
+                if (id >= 0) return id;
+            }
+        }
+        return -1;
+    }
+
+    static const char* GetDisplayName(int id) {
+        return (id >= 0 && id < CHARACTER_COUNT) ? CHARACTER_TABLE[id].displayName : "Unknown";
+    }
+
+    static const char* GetPortrait(int id) {
+        return (id >= 0 && id < CHARACTER_COUNT) ? CHARACTER_TABLE[id].portrait : "unknown.png";
+    }
+
+private:
+    static int Lookup(uint64_t key) {
+        uint32_t slot = CharacterHashSlot(key, HASH.multiplier);
+        return (key != 0 && HASH.keys[slot] == key) ? HASH.ids[slot] : -1;
+    }
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// One frame of the fields the tracker reads; -1 where the schema does not
+// describe a field or it could not be read
+struct ComboSample {
+    uint32_t frame;
+    uint64_t timestampUs;
+    int32_t hp[2];
+    int32_t hitstun[2];         // > 0 while the player is in hitstun
+};
+
+// What one player has done as the attacker
+struct ComboSide {
+    uint32_t hits;              // Combo in progress, 0 when none
+    int32_t damage;
+    uint32_t startFrame;        // Of the combo in progress
+    uint32_t lastHits;          // Last finished combo
+    int32_t lastDamage;
+    uint32_t lastStartFrame;
+    uint32_t lastEndFrame;      // First frame the defender was out of hitstun
+    uint64_t lastStartUs;
+    uint64_t lastEndUs;
+    uint32_t maxHits;           // Best this match (hits and damage tracked separately)
+    int32_t maxDamage;
+    int32_t roundDamage;        // Dealt this round, combos and chip
+};
+
+struct ComboStats {
+    bool available;             // Both HP fields were read on the last frame
+    uint32_t round;             // Rounds started this match, 0 before the first
+    ComboSide side[2];          // side[0]: player 1 attacking
+
+    bool operator==(const ComboStats& other) const;
+    bool operator!=(const ComboStats& other) const { return !(*this == other); }
+};
+
+// Incremental combo and damage analysis. Each frame compares both players'
+// HP and hitstun with the previous frame: HP lost while (or on becoming) in
+// hitstun is a hit and starts or extends a combo on that defender, the
+// combo ends on the first frame out of hitstun. Without a hitstun field a
+// combo ends after COMBO_TIMEOUT_FRAMES without damage. HP lost outside
+// hitstun (chip) only counts towards round damage. A player's HP rising by
+// ROUND_REFILL_HP in one frame starts a new round.
+//
+// Constant work per frame and no allocation. No Windows dependencies.
+class ComboTracker {
+public:
+    static const int32_t ROUND_REFILL_HP = 1000;
+    static const uint32_t COMBO_TIMEOUT_FRAMES = 30;
+
+    ComboTracker();
+    void Reset();
+
+    // Frames in order; returns true when GetStats() changed
+    bool Record(const ComboSample& sample);
+    // A game was decided or the characters changed: the maxima and round
+    // count are kept on display until the next round starts
+    void EndMatch() { matchEnded = true; }
+
+    const ComboStats& GetStats() const { return stats; }
+
+    // Scripted exchanges: combos, chip, refreshes, round and match resets,
+    // missing fields. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+
+private:
+    struct Defender {
+        int32_t lastHp;
+        int32_t lastHitstun;
+        uint32_t lastHitFrame;
+        uint64_t startUs;
+    };
+
+    void Finish(int attacker, const ComboSample& sample);
+    void StartRound();
+
+    ComboStats stats;
+    Defender defenders[2];
+    bool started;
+    bool matchEnded;
+};
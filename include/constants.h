@@ -1,6 +1,7 @@
 #pragma once
 
-// Memory offsets for EFZ Revival
+// Memory offsets for EFZ Revival. These are the built-in defaults; at runtime
+// the layout comes from overlay_assets/offsets.json (see OffsetSchema).
 #define EFZ_BASE_OFFSET_P1 0x390104
 #define EFZ_BASE_OFFSET_P2 0x390108
 #define EFZ_BASE_OFFSET_GAME_STATE 0x39010C
@@ -21,6 +22,12 @@
 #define P1_NICKNAME_OFFSET_SPECTATOR 0x9A
 #define P2_NICKNAME_OFFSET_SPECTATOR 0x11A
 
+// Span of the Revival block read in one call per tick (spectator fields
+// through the player win counts)
+#define REVIVAL_BLOCK_START P1_WIN_COUNT_OFFSET_SPECTATOR
+#define REVIVAL_BLOCK_END (P2_WIN_COUNT_OFFSET + 4)
+#define REVIVAL_BLOCK_SIZE (REVIVAL_BLOCK_END - REVIVAL_BLOCK_START)
+
 // Character IDs - corrected to match internal game IDs
 #define CHAR_ID_AKANE     0
 #define CHAR_ID_AKIKO     1
@@ -47,24 +54,10 @@
 #define CHAR_ID_MIZUKAB   22
 #define CHAR_ID_KANO      23
 
-// Character names array
-static const char* CHARACTER_NAMES[] = {
-    "Akane", "Akiko", "Ikumi", "Misaki", "Sayuri", "Kanna",
-    "Kaori", "Makoto", "Minagi", "Mio", "Mishio", "Misuzu",
-    "Mizuka", "Nagamori", "Nanase", "ExNanase", "Nayuki", "NayukiB",
-    "Shiori", "Ayu", "Mai", "Mayu", "MizukaB", "Kano"
-};
-
-// Add this array for portrait filenames
-static const char* CHARACTER_PORTRAITS[] = {
-    "akane.png", "akiko.png", "ikumi.png", "misaki.png", "sayuri.png", "kanna.png",
-    "kaori.png", "makoto.png", "minagi.png", "mio.png", "mishio.png", "misuzu.png",
-    "mizuka.png", "nagamori.png", "nanase.png", "exnanase.png", "nayuki.png", "nayukib.png",
-    "shiori.png", "ayu.png", "mai.png", "mayu.png", "mizukab.png", "kano.png"
-};
-
+// Names and portraits for these IDs live in character_table.h
 #define MAX_CHARACTER_ID 23
 #define MAX_NICKNAME_LENGTH 20
+#define MAX_SANITIZED_NICKNAME_LENGTH 16
 
 // HTTP server settings
 #define HTTP_SERVER_PORT 8080
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "canvas.h"
+
+struct ImDrawData;
+struct ImDrawVert;
+
+// CPU backend for Dear ImGui: rasterizes draw lists (coloured and textured
+// triangles, each command with its clip rect) into a premultiplied BGRA
+// canvas, blended as ImGui's GPU backends do (source alpha over).
+//
+// Triangles are set up once (1/16 pixel fixed point, exact integer edge
+// functions with a top-left fill rule, so neighbouring triangles never
+// blend a pixel twice or leave a gap), then binned into TILE_SIZE tiles
+// by their clipped bounds. Each tile is drawn in a small buffer that stays
+// in L1, four pixels per step with SSE2, and copied to the target only
+// where it differs from the previous frame, so Render() also returns what
+// changed.
+//
+// Colours are interpolated premultiplied; textures are sampled nearest
+// (ImGui's font atlas is pixel aligned). A triangle whose colour and UVs
+// are uniform (every ImGui fill) skips interpolation and sampling, and the
+// axis-aligned quads ImGui emits for fills and glyphs are drawn as one
+// rectangle without edge tests.
+//
+// Textures: an ImTextureID holds a const Canvas* (TextureId()); 0 is an
+// opaque white texture. No Windows dependencies.
+class DrawListRasterizer {
+public:
+    static const int TILE_SIZE = 32;
+
+    struct Stats {
+        uint64_t frames;
+        uint64_t triangles;         // Set up and drawn; a rectangle counts once
+        uint64_t culled;            // Degenerate, clipped away or out of range
+        uint64_t binEntries;        // Triangle-tile pairs
+        uint64_t tilesChanged;
+    };
+
+    static uint64_t TextureId(const Canvas* texture) { return (uint64_t)(uintptr_t)texture; }
+
+    // target is resized to the draw data's display size (keeping its pixels
+    // when the size is unchanged); returns the changed area
+    CanvasRect Render(const ImDrawData* data, Canvas& target);
+
+    void SetBinning(bool enabled) { binning = enabled; }   // Benchmark: whole triangles into one frame buffer
+    Stats GetStats() const { return stats; }
+
+    static const char* GetSimdLevel();
+    static void ForceScalar(bool scalar) { forceScalar = scalar; }  // Self-test and benchmark
+
+    // Shared edges, clipping, exact textured copies, smooth colours, the
+    // changed area, and SIMD against scalar and binned against unbinned on
+    // random triangles. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+
+    // Set-up form of one triangle, shared with the span functions
+    enum TriangleFlags {
+        SMOOTH_COLOR = 1,
+        SAMPLED = 2,
+        SHADED = SMOOTH_COLOR | SAMPLED,    // Needs the planes per pixel
+        RECTANGLE = 4                       // Every pixel of bounds; no edge functions
+    };
+
+    struct Triangle {
+        CanvasRect bounds;          // Covered pixels, clipped
+        int64_t edge[3];            // Edge functions at pixel (0, 0), fill-rule bias included; inside >= 0
+        int32_t stepX[3];           // Per pixel
+        int32_t stepY[3];
+        uint32_t flags;
+        uint32_t color;             // Premultiplied; already times the texel when the UVs are uniform
+        float planes[6][3];         // b, g, r, a (premultiplied), u * width, v * height: value at 0, per x, per y
+        const Canvas* texture;      // SAMPLED only
+    };
+
+private:
+    void Setup(const ImDrawData* data, int width, int height);
+    static bool SetupTriangle(const ImDrawVert* vertices[3], const CanvasRect& clip, const Canvas* texture,
+                              Triangle& triangle);
+    static bool SetupRectangle(const ImDrawVert* corners[4], const CanvasRect& clip, const Canvas* texture,
+                               Triangle& triangle);
+    static bool SetupShading(const ImDrawVert* const* vertices, int count, const int32_t* fx, const int32_t* fy,
+                             const Canvas* texture, Triangle& triangle);
+    static void DrawRegion(const Triangle& triangle, const CanvasRect& region, uint32_t* buffer, int stride,
+                           int originX, int originY);
+    CanvasRect Resolve(const uint32_t* buffer, int stride, const CanvasRect& tile, int originX, int originY,
+                       Canvas& target);
+
+    std::vector<Triangle> triangles;
+    std::vector<uint32_t> binCounts;        // Per tile, then start offsets
+    std::vector<uint32_t> binTriangles;     // Triangle indices, tile by tile, in draw order
+    std::vector<uint32_t> scratch;          // Whole frame when not binning
+    bool binning = true;
+    Stats stats = {};
+    static bool forceScalar;
+};
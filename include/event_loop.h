@@ -0,0 +1,118 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+
+typedef void (*LoopCallback)(void* context);
+
+// Completion handler for handles associated with the loop's port (sockets,
+// overlapped files). error is 0 on success.
+typedef void (*LoopIoCallback)(void* context, OVERLAPPED* overlapped, DWORD bytes, DWORD error);
+
+// Caller-owned timer; the loop links it into the wheel without allocating.
+// Only touch it through EventLoop while it is armed.
+struct LoopTimer {
+    LoopCallback callback = nullptr;
+    void* context = nullptr;
+    uint32_t intervalMs = 0;    // 0 = one-shot
+    uint64_t expiry = 0;        // Loop tick (ms) the timer is due
+    LoopTimer* next = nullptr;
+    LoopTimer* prev = nullptr;
+    LoopTimer** slot = nullptr; // Wheel slot it is linked into, nullptr when not armed
+    bool background = false;    // Non-critical: runs in background mode when enabled
+};
+
+// Caller-owned registration for a waitable handle (console input, events)
+struct LoopWaitable {
+    HANDLE handle = nullptr;
+    LoopCallback callback = nullptr;
+    void* context = nullptr;
+    HANDLE wait = nullptr;      // Thread pool wait, re-armed after each callback
+    bool active = false;
+};
+
+// Caller-owned association of an overlapped handle with the loop's port
+struct LoopIoHandler {
+    LoopIoCallback callback = nullptr;
+    void* context = nullptr;
+};
+
+// Single-threaded reactor. Every periodic job in the mod (sampling, module
+// polling, overlay refresh, console input) runs as a task on the one thread
+// that calls Run(), so they share state without locks.
+//
+// Timers live in a hierarchical wheel (4 levels of 64 slots, 1 ms ticks).
+// The thread blocks in GetQueuedCompletionStatus until the next due timer,
+// an I/O completion, a ready waitable or a Post() from another thread.
+class EventLoop {
+public:
+    struct Stats {
+        uint64_t wakeups;
+        uint64_t timersFired;
+        uint64_t posts;
+        uint64_t ioCompletions;
+        uint64_t waitableSignals;
+        double averageLatenessMs;   // How late timers fired relative to their expiry
+        double maxLatenessMs;
+        double busyMs;              // Time spent running tasks
+        double elapsedMs;           // Since the last reset
+    };
+
+    // Called on the thread that will run the loop
+    static bool Initialize();
+    static void Run();
+    static void Shutdown();
+
+    // Any thread
+    static void Stop();
+    static bool Post(LoopCallback callback, void* context);
+    static bool IsLoopThread() { return GetCurrentThreadId() == loopThreadId; }
+
+    // Loop thread only. Re-adding an armed timer reschedules it, including
+    // from its own callback.
+    static void AddTimer(LoopTimer* timer, uint32_t delayMs, uint32_t intervalMs);
+    static void CancelTimer(LoopTimer* timer);
+    static bool AddWaitable(LoopWaitable* waitable);
+    static void RemoveWaitable(LoopWaitable* waitable);
+    static bool AssociateHandle(HANDLE handle, LoopIoHandler* handler);
+
+    // Background mode lowers CPU and I/O priority while a background timer runs
+    static void EnableBackgroundTasks(bool enable) { backgroundTasks = enable; }
+    // Called on the loop thread after every wakeup (scheduling counters)
+    static void SetWakeupHook(LoopCallback hook, void* context);
+
+    static uint64_t GetTickMs();
+    static Stats GetStats();
+    static void ResetStats();
+
+private:
+    static const int WHEEL_LEVELS = 4;
+    static const int WHEEL_BITS = 6;
+    static const int WHEEL_SLOTS = 1 << WHEEL_BITS;
+
+    static void InsertTimer(LoopTimer* timer);
+    static void UnlinkTimer(LoopTimer* timer);
+    static void Cascade(int level);
+    static void AdvanceTo(uint64_t target);
+    static DWORD NextTimeout();
+    static void Dispatch(DWORD bytes, ULONG_PTR key, OVERLAPPED* overlapped, DWORD error);
+    static void ArmWaitable(LoopWaitable* waitable);
+    static VOID CALLBACK OnWaitableSignaled(PVOID context, BOOLEAN timedOut);
+
+    static HANDLE port;
+    static DWORD loopThreadId;
+    static std::atomic<bool> running;
+    static LARGE_INTEGER startCounter;
+    static LARGE_INTEGER frequency;
+    static uint64_t currentTick;
+    static LoopTimer* wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+    static uint32_t armedTimers;
+    static bool backgroundTasks;
+    static LoopCallback wakeupHook;
+    static void* wakeupHookContext;
+
+    static Stats stats;
+    static uint64_t statsResetTick;
+    static uint64_t latenessSamples;
+    static double latenessTotalMs;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include "event_loop.h"
+
+// Orderly shutdown before the process terminates. Detours hooks
+// ExitProcess; the exiting thread posts the shutdown task to the event loop
+// and waits for it (up to a timeout) before the real ExitProcess kills the
+// other threads. The task runs while every thread is still alive, so it
+// may take locks, finish the set in progress and flush files.
+//
+// Without the hook (TerminateProcess, or the wait timed out) only
+// DLL_PROCESS_DETACH runs, when the other threads are already gone.
+class ExitHook {
+public:
+    // Loop thread. shutdown runs on the loop thread at most once.
+    static bool Install(LoopCallback shutdown, void* context, DWORD timeoutMs);
+
+private:
+    static VOID WINAPI HookedExitProcess(UINT exitCode);
+    static void OnExitTask(void* context);
+
+    static LoopCallback shutdownTask;
+    static void* shutdownContext;
+    static DWORD timeout;
+    static HANDLE doneEvent;
+    static std::atomic<bool> exiting;
+};
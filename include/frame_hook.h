@@ -0,0 +1,31 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include "frame_sampler.h"
+
+// Frame-synchronous sampling. Detours hooks PeekMessageA/W; when the game
+// thread finds its message queue empty it is between frames, and the hook
+// runs FrameSampler::OnFrame() there before returning to the game. The
+// snapshots reach GameDataManager through the sampler's queue.
+//
+// Enabled with [Sampling] Mode=frame in scheduling.ini. Without it, or if
+// the hook cannot be installed, sampling stays on the event loop timer.
+class FrameHook {
+public:
+    // Loop thread; needs SchedulingPolicy to have found the game thread
+    static bool Install(uint32_t budgetUs, uint32_t minFrameIntervalUs);
+    static void Remove();
+
+    // nullptr unless the hook is installed
+    static FrameSampler* GetSampler() { return activeSampler.load(std::memory_order_acquire); }
+
+private:
+    static bool Transaction(bool attach);
+    static void OnMessagePump();
+    static BOOL WINAPI HookedPeekMessageA(LPMSG msg, HWND hwnd, UINT filterMin, UINT filterMax, UINT removeMsg);
+    static BOOL WINAPI HookedPeekMessageW(LPMSG msg, HWND hwnd, UINT filterMin, UINT filterMax, UINT removeMsg);
+
+    static std::atomic<FrameSampler*> activeSampler;
+    static FrameSampler* sampler;   // Never freed: a hook call may still be running after Remove()
+    static DWORD gameThreadId;
+};
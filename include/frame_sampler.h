@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "memory_snapshot.h"
+#include "spsc_queue.h"
+
+// Where frame samples come from. The live source reads game memory; tests
+// substitute a synthetic one.
+class FrameStateSource {
+public:
+    virtual ~FrameStateSource() {}
+    // Fills snapshot; false when nothing could be read this frame
+    virtual bool Capture(MemorySnapshot& snapshot) = 0;
+};
+
+// Monotonic microsecond clock. Live: QueryPerformanceCounter; tests: a
+// simulated clock advanced by hand.
+class FrameClock {
+public:
+    virtual ~FrameClock() {}
+    virtual uint64_t NowMicros() = 0;
+};
+
+struct FrameSnapshot {
+    uint64_t frame;         // Frame counter at capture
+    uint64_t timestampUs;   // FrameClock time the capture started
+    MemorySnapshot blocks;
+};
+
+// Samples game state once per frame on the thread that calls OnFrame() (the
+// game thread in frame mode) and hands the snapshots to one consumer through
+// a lock-free queue. Has no Windows dependencies, so a simulated clock and
+// source can drive it anywhere.
+//
+// A capture that runs over budget makes the sampler skip the following
+// frames in proportion, so a slow read never costs the game more than about
+// one budget per frame on average. Snapshots are dropped, not waited for,
+// when the consumer falls a full queue behind.
+class FrameSampler {
+public:
+    static const size_t QUEUE_SIZE = 64;
+    static const uint32_t MAX_SKIP_FRAMES = 8;
+
+    struct Stats {
+        uint64_t frames;            // Frame boundaries seen
+        uint64_t sampled;           // Snapshots queued
+        uint64_t skipped;           // Frames skipped to stay within budget
+        uint64_t overBudget;        // Captures that took longer than the budget
+        uint64_t dropped;           // Queue was full
+        uint64_t failed;            // Source had nothing to read
+        uint64_t maxCaptureUs;
+        double averageCaptureUs;
+    };
+
+    // minFrameIntervalUs: calls closer together than this are treated as the
+    // same frame (message pumps that spin between frames)
+    FrameSampler(FrameStateSource* source, FrameClock* clock, uint32_t budgetUs, uint32_t minFrameIntervalUs);
+
+    // Producer thread only
+    void OnFrame();
+
+    // Consumer thread only
+    const FrameSnapshot* Front() { return queue.Front(); }
+    void Pop() { queue.Pop(); }
+
+    // Any thread
+    Stats GetStats() const;
+    void ResetStats();
+    uint32_t GetBudgetUs() const { return budgetUs; }
+
+    // Drives a sampler with a simulated clock and source: spinning pumps,
+    // over-budget captures, a stalled consumer. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+
+private:
+    FrameStateSource* source;
+    FrameClock* clock;
+    uint32_t budgetUs;
+    uint32_t minFrameIntervalUs;
+
+    // Producer state
+    uint64_t frameCounter = 0;
+    uint64_t lastFrameUs = 0;
+    bool seenFrame = false;
+    uint32_t skipFrames = 0;
+
+    SpscQueue<FrameSnapshot, QUEUE_SIZE> queue;
+
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> sampled{0};
+    std::atomic<uint64_t> skipped{0};
+    std::atomic<uint64_t> overBudget{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> failed{0};
+    std::atomic<uint64_t> maxCaptureUs{0};
+    std::atomic<uint64_t> totalCaptureUs{0};
+};
@@ -0,0 +1,136 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "canvas.h"
+
+#define FRAME_SHARE_MAGIC 0x465A4645u   // "EFZF"
+#define FRAME_SHARE_VERSION 1
+#define FRAME_SHARE_BUFFERS 3
+#define FRAME_SHARE_NONE 0xFFFFFFFFu    // latest before the first frame
+#define FRAME_SHARE_MIN_CAPACITY (1u << 20)     // Bytes per buffer; room for a larger template after a reload
+
+#define FRAME_FORMAT_BGRA_PREMULTIPLIED 1       // 0xAARRGGBB little-endian, colour multiplied by alpha
+
+#define FRAME_SHARE_SCOREBOARD_NAME "Local\\EfzStreamingScoreboard"
+#define FRAME_SHARE_WIDGETS_NAME "Local\\EfzStreamingWidgets"
+
+// One buffer's description; the pixels are at offset bytes from the start
+// of the mapping, stride bytes per row, top row first
+struct FrameShareSlot {
+    std::atomic<uint32_t> sequence;     // Odd while the writer is in this slot
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint64_t frame;                     // Counts from 1
+    int32_t dirtyX0, dirtyY0;           // Changed since frame - 1 (whole image on a size change)
+    int32_t dirtyX1, dirtyY1;
+    uint32_t checksum;                  // FrameShare::Checksum of the pixels
+    uint32_t offset;
+    uint32_t reserved[4];
+};
+
+// Fixed layout of a frame output mapping. One writer, any number of
+// readers, triple buffered:
+//
+//   1. read latest; FRAME_SHARE_NONE means nothing was published yet
+//   2. read that slot's sequence; odd means the writer is in it, start over
+//   3. copy (or upload) the pixels, then read the sequence again
+//   4. unchanged: the copy is one whole frame. Changed: the writer lapped
+//      this reader (two newer frames went out meanwhile), start over.
+//
+// The writer fills the slot after latest and never waits for anyone.
+// A reader that last took frame - 1 can upload only the dirty rectangle.
+struct FrameShareHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;                // sizeof(FrameShareHeader); pixels follow
+    uint32_t bufferCount;
+    uint32_t capacity;                  // Bytes per buffer
+    uint32_t format;                    // FRAME_FORMAT_*
+    std::atomic<uint32_t> latest;       // Slot of the newest complete frame
+    std::atomic<uint32_t> closed;       // Nonzero once the writer has shut down
+    uint32_t reserved[8];
+    FrameShareSlot slots[FRAME_SHARE_BUFFERS];
+};
+
+// Publishes canvases into a FrameShareHeader mapping. Only the rows and
+// columns changed since the target buffer was last written are copied.
+// No Windows dependencies.
+class FrameShareWriter {
+public:
+    struct Stats {
+        uint64_t published;
+        uint64_t tooLarge;          // Frames that did not fit a buffer (skipped)
+        uint64_t bytesCopied;
+    };
+
+    // memory: MappingSize(capacity) bytes, caller-owned; formatted here
+    FrameShareWriter(void* memory, uint32_t capacity);
+
+    // dirty: what changed since the last Publish (clipped to the image)
+    bool Publish(const Canvas& image, const CanvasRect& dirty);
+    void Close();
+    Stats GetStats() const { return stats; }
+
+private:
+    FrameShareHeader* header;
+    uint8_t* base;
+    uint64_t frame;
+    uint64_t slotFrame[FRAME_SHARE_BUFFERS];    // Frame each buffer holds, 0 = nothing usable
+    CanvasRect history[FRAME_SHARE_BUFFERS];    // Dirty rect of frame n at n % FRAME_SHARE_BUFFERS
+    int width;
+    int height;
+    Stats stats;
+};
+
+class FrameShare {
+public:
+    enum ReadStatus {
+        READ_FRAME,         // A new frame was copied
+        READ_UNCHANGED,     // latest is still lastFrame
+        READ_NO_FRAME,      // Nothing published yet
+        READ_LAPPED,        // Writer kept overtaking the copy; try again later
+        READ_INVALID        // Not a frame mapping, or a field out of range
+    };
+
+    struct FrameInfo {
+        uint32_t width;
+        uint32_t height;
+        uint64_t frame;
+        CanvasRect dirty;
+        uint32_t checksum;
+        uint32_t retries;   // Attempts the writer spoiled
+    };
+
+    static size_t MappingSize(uint32_t capacity);
+
+    // Any process. Copies the newest frame if it is not lastFrame.
+    static ReadStatus Read(const void* memory, size_t size, uint64_t lastFrame, FrameInfo& info,
+                           std::vector<uint32_t>& pixels);
+    static bool IsClosed(const void* memory);
+    static const char* GetStatusName(ReadStatus status);
+
+    // Four interleaved FNV-1a streams over the pixels, so it runs at
+    // memory speed
+    static uint32_t Checksum(const uint32_t* pixels, size_t count);
+
+    // Single thread: formatting, partial copies across the buffers, size
+    // changes, lap detection. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+
+    struct StressResult {
+        uint64_t published;
+        uint64_t reads;         // Frames copied and verified
+        uint64_t unchanged;
+        uint64_t lapped;
+        uint64_t torn;          // Copies whose pixels did not match their checksum
+        uint64_t outOfOrder;    // A reader saw the frame number go backwards
+        double seconds;
+    };
+    // A writer thread publishing random partial updates as fast as it can
+    // against reader threads that verify every copy
+    static StressResult RunStressTest(uint32_t frames, int readers);
+};
@@ -8,46 +8,168 @@
 #endif
 
 #include <string>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "event_loop.h"
 #include <windows.h>
+#include "inline_string.h"
+#include "player_stats.h"
+#include "rating_service.h"
+#include "memory_snapshot.h"
+#include "offset_schema.h"
+#include "netplay_telemetry.h"
+#include "combo_tracker.h"
 
 struct PlayerData {
-    std::string nickname;
-    std::string character;
+    NicknameString nickname;
+    uint32_t nicknameId;           // NicknamePool ID, stable for a given raw name
+    CharacterNameString character;
     int characterId;
     int winCount;
+    PlayerSummary stats; // Refreshed when the players, characters or score change
+    RatingSnapshot rating;
 };
 
 struct GameData {
     PlayerData player1;
     PlayerData player2;
     bool gameActive;
+    CharacterNameString layout;     // Revival layout being read: "player", "spectator", "detecting", "offline"
+    float layoutConfidence;         // 0..1, see LayoutClassifier
+    NetplayStats netplay;           // Rolling connection health, refreshed once a second
+    ComboStats combo;               // Combos and damage per attacker, updated per hit
     
     std::string ToJSON() const;
 };
 
+// One bit per field group that consumers react to
+enum GameField : uint32_t {
+    FIELD_P1_NICKNAME  = 1u << 0,
+    FIELD_P1_CHARACTER = 1u << 1,   // characterId and display name
+    FIELD_P1_WINS      = 1u << 2,
+    FIELD_P1_STATS     = 1u << 3,   // summary and rating
+    FIELD_P2_NICKNAME  = 1u << 4,
+    FIELD_P2_CHARACTER = 1u << 5,
+    FIELD_P2_WINS      = 1u << 6,
+    FIELD_P2_STATS     = 1u << 7,
+    FIELD_GAME_ACTIVE  = 1u << 8,
+    FIELD_LAYOUT       = 1u << 9,   // layout and its confidence
+    FIELD_NETPLAY      = 1u << 10,
+    FIELD_COMBO        = 1u << 11,
+    FIELD_ALL          = (1u << 12) - 1
+};
+
+// Change between two published versions of GameData: the changed fields
+// plus the old and new values. Each version's fields are computed once
+// when it is published and shared by every consumer. A delta over several
+// versions ORs their fields and re-checks only those, so fields that
+// changed back are not flagged; that result is cached for the next
+// consumer at the same version. Both snapshots are shared, not copied.
+struct GameDelta {
+    uint64_t fromVersion;
+    uint64_t toVersion;
+    uint32_t changedFields;
+    bool resync;            // fromVersion is no longer retained: treat every field as changed
+    std::shared_ptr<const GameData> oldData;    // State at fromVersion; null when resync is set
+    std::shared_ptr<const GameData> newData;    // State at toVersion
+    
+    bool Has(uint32_t fields) const { return (changedFields & fields) != 0; }
+    
+    // Only the changed fields, for push-style consumers
+    std::string ToJSON() const;
+    
+    // Compares only the candidate field groups
+    static uint32_t Diff(const GameData& oldData, const GameData& newData, uint32_t candidates = FIELD_ALL);
+};
+
 class GameDataManager {
 public:
     static bool Initialize();
     static bool Update(); // Change return type to bool
+    // Same as Update() for a capture taken elsewhere (frame mode), on game
+    // frame `frame` at its QueryPerformanceCounter time in microseconds;
+    // loop thread only
+    static bool UpdateFromSnapshot(const MemorySnapshot& snapshot, uint32_t frame, uint64_t timestampUs);
     static const GameData& GetCurrentData();
     static std::string GetJSONData();
     static void Shutdown();
     
+    // Ticks sampled and ticks short-circuited because no memory block changed
+    static void GetChangeDetectionStats(uint64_t& ticks, uint64_t& skipped);
+    
+    // Published versions start at 0 (initial state) and increase by one per change
+    static uint64_t GetVersion();
+    
+    // Delta from `version` to the latest version. Returns false when nothing
+    // was published since then.
+    static bool GetDeltaSince(uint64_t version, GameDelta& delta);
+    
+    // Every applied capture as a netplay sample, with rolling histograms; loop thread
+    static const NetplayTelemetry& GetNetplayTelemetry() { return netplayTelemetry; }
+    
 private:
     static GameData currentData;
     static bool initialized;
-    static bool running;
-    static HANDLE updateThread;
-    static DWORD WINAPI UpdateThreadProc(LPVOID lpParam);
+    
+    // Event loop tasks (see EventLoop): sampling, cache refresh, overlay rewrite
+    static const uint32_t SAMPLE_INTERVAL_MS = 100;
+    static const uint32_t SAMPLE_BACKOFF_MS = 600;
+    static const uint32_t CACHE_REFRESH_INTERVAL_MS = 1500;
+    static const uint32_t OVERLAY_REFRESH_INTERVAL_MS = 5000;
+    static LoopTimer sampleTimer;
+    static LoopTimer cacheRefreshTimer;
+    static LoopTimer overlayRefreshTimer;
+    static int consecutiveFailures;
+    static void OnSampleTimer(void* context);
+    static void OnCacheRefreshTimer(void* context);
+    static void OnOverlayRefreshTimer(void* context);
+    // changedSources: SCHEMA_FIELD_BIT()s whose memory changed
+    // sampledChanged: a per-frame analyzer moved its GameData field
+    static bool Decode(uint64_t changedSources, bool sampledChanged);
+    
+    // Every applied capture goes through the per-frame analyzers once:
+    // netplay telemetry, combo tracker, input display
+    static uint64_t sampledAppliedCount;
+    static bool SampleFrame(uint32_t frame, uint64_t timestampUs);
+    
+    // The netplay summary in GameData is refreshed at most this often
+    static const uint32_t NETPLAY_PUBLISH_MS = 1000;
+    static NetplayTelemetry netplayTelemetry;
+    static uint64_t lastNetplayPublishMs;
+    static bool SampleNetplay(uint64_t timestampUs);
+    
+    static ComboTracker comboTracker;
+    
+    // Frame mode falls back to timer sampling when no frame arrived for this long
+    static const uint32_t FRAME_STALL_MS = 1000;
+    static uint64_t lastFrameTick;
 
-    // Add these members for change detection
+    // Last published state and the versions kept for GetDeltaSince
     static GameData previousData;
-    static bool HasDataChanged();
-    static void LogChanges();
-
-    // Add these members for caching and throttling
-    static DWORD lastWinCountCheck;
-    static const int WIN_COUNT_CHECK_INTERVAL_MS = 500; // Only check win counts twice per second
-    static DWORD cachedP1WinCount;
-    static DWORD cachedP2WinCount;
+    static const uint32_t VERSION_HISTORY_SIZE = 64;
+    static std::shared_ptr<const GameData> versionHistory[VERSION_HISTORY_SIZE]; // Version v in slot v % size
+    static uint32_t versionFields[VERSION_HISTORY_SIZE];    // Changed from version v - 1 to v
+    static uint64_t publishedVersion;
+    static std::mutex versionMutex;
+    // Last squashed delta, for consumers several versions behind
+    static uint64_t squashedFrom;
+    static uint64_t squashedTo;
+    static uint32_t squashedFields;
+    static void PublishVersion(uint32_t changedFields);
+    static void LogDelta(const GameDelta& delta);
+
+    // Block-hash change detection: ticks where no block changed skip decoding
+    static std::atomic<uint64_t> sampledTicks;
+    static std::atomic<uint64_t> skippedTicks;
+
+    // Set tracking for the match history
+    static bool TrackSetProgress(uint32_t changedFields);
+    static bool FinalizeSet();
+    static void RefreshPlayerSummaries();
+    static bool setInProgress;
+    static bool setDecided;             // Recorded at first-to; closed until the counters reset
+    static PlayerData setP1;
+    static PlayerData setP2;
+    static DWORD setStartTick;
 };
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "canvas.h"
+
+// Text rendering for generated overlay images with the vendored
+// stb_truetype. Glyphs are rasterized once per (code point, pixel size) into
+// an 8-bit coverage atlas packed in shelves and blended from there; a full
+// atlas is cleared and refilled on demand. Fonts after the first are
+// fallbacks for code points the earlier ones lack (CJK nicknames).
+//
+// No Windows dependencies. Not thread-safe.
+class GlyphCache {
+public:
+    static const int ATLAS_SIZE = 512;
+    static const int MAX_PIXEL_SIZE = 255;
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;        // Glyphs rasterized
+        uint64_t flushes;       // Atlas cleared because it was full
+        size_t glyphs;          // In the atlas now
+        int atlasRowsUsed;
+    };
+
+    GlyphCache();
+    ~GlyphCache();
+
+    // Font file contents (TTF, or the first face of a TTC); false with an
+    // error if stb_truetype cannot read it
+    bool AddFont(std::vector<uint8_t> data, std::string& error);
+    size_t GetFontCount() const { return fonts.size(); }
+
+    // Ascent above and descent below the baseline, from the first font
+    void GetLineMetrics(int pixelSize, int& ascent, int& descent);
+    // Advance width of UTF-8 text in pixels
+    int MeasureText(const std::string& utf8, int pixelSize);
+    // Draws with the baseline at y; returns the advance width
+    int DrawText(Canvas& canvas, int x, int y, const std::string& utf8, int pixelSize, uint32_t color,
+                 const CanvasRect& clip);
+
+    Stats GetStats() const;
+    void ResetStats();
+
+private:
+    struct FontFace;
+
+    struct Glyph {
+        int16_t atlasX, atlasY;
+        int16_t width, height;
+        int16_t offsetX, offsetY;   // Bitmap corner relative to the pen on the baseline
+        float advance;
+        int font;
+        int index;                  // Glyph index within the font, for kerning
+    };
+
+    const Glyph* Lookup(uint32_t codepoint, int pixelSize);
+    bool Pack(int width, int height, int& x, int& y);
+    void ClearAtlas();
+    int Layout(Canvas* canvas, int x, int y, const std::string& utf8, int pixelSize, uint32_t color,
+               const CanvasRect& clip);
+
+    std::vector<std::unique_ptr<FontFace>> fonts;
+    std::vector<uint8_t> atlas;
+    std::unordered_map<uint64_t, Glyph> glyphs;    // codepoint << 8 | pixel size
+    int shelfX, shelfY, shelfHeight;
+    Stats stats;
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "combo_tracker.h"
+
+enum HighlightType {
+    HIGHLIGHT_LONG_COMBO,
+    HIGHLIGHT_PERFECT,
+    HIGHLIGHT_COMEBACK,
+    HIGHLIGHT_MATCH_POINT,
+    HIGHLIGHT_SET_WIN,
+    HIGHLIGHT_TYPE_COUNT
+};
+
+struct HighlightEvent {
+    HighlightType type;
+    int player;                 // 0 or 1; -1 for both (deciding game)
+    uint32_t frame;
+    uint64_t timestampUs;       // Sampler clock; a long combo is marked where it started
+    int score;                  // 0-100, how much an editor should care
+    int32_t value;              // Combo hits, HP or game deficit, winner's games
+    int32_t detail;             // Combo damage, 1 for a set comeback, loser's games
+};
+
+struct HighlightConfig {
+    uint32_t longComboHits = 15;
+    int32_t bigComboDamage = 4000;      // A shorter combo doing this much also counts
+    int32_t comebackHp = 4000;          // Round won after trailing by this much HP
+    int32_t comebackGames = 2;          // Set won after trailing by this many games
+    int32_t firstTo = 3;                // Games to win a set; 0 = unknown (no match points)
+};
+
+// Finds moments worth a VOD marker in the sampler's output: long combos,
+// perfect rounds, comebacks (rounds and sets), match points and set wins.
+// OnFrame follows the ComboTracker frame by frame, OnScore the published win
+// counters; both only compare against the previous call, so each costs a
+// handful of comparisons and events are queued without formatting or I/O.
+//
+// Round results are inferred from HP: the round ends when ComboTracker
+// starts the next one (a refill) or the players disappear with one of them
+// at 0, and whoever had more HP on the last frame won it.
+//
+// No Windows dependencies.
+class HighlightDetector {
+public:
+    static const size_t QUEUE_SIZE = 64;
+
+    HighlightDetector();
+    void Configure(const HighlightConfig& settings) { config = settings; }
+    const HighlightConfig& GetConfig() const { return config; }
+    void Reset();
+
+    // Every sampled frame, with the tracker's stats after recording it
+    void OnFrame(const ComboSample& sample, const ComboStats& combo);
+    // Win counters changed; the first call only sets the baseline
+    void OnScore(int p1Wins, int p2Wins);
+    // A set was recorded; marks its winner unless OnScore already did
+    void OnSetEnd(int p1Wins, int p2Wins);
+
+    bool Pop(HighlightEvent& event);    // Oldest queued event
+    size_t GetPending() const { return queueCount; }
+    uint64_t GetDropped() const { return dropped; }
+
+    static const char* GetTypeName(HighlightType type);
+    // "P1 17-hit combo (4200 damage)", with the names given for P1 and P2
+    static std::string Describe(const HighlightEvent& event, const std::string& p1Name = "P1",
+                                const std::string& p2Name = "P2");
+
+    // Scripted rounds and sets through the detector. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+
+private:
+    HighlightEvent* Emit(HighlightType type, int player, int score, int32_t value, int32_t detail);
+    void EndRound(bool refilled);
+    void StartSet();
+
+    HighlightConfig config;
+    HighlightEvent queue[QUEUE_SIZE];
+    size_t queueHead;
+    size_t queueCount;
+    uint64_t dropped;
+
+    uint32_t lastFrame;
+    uint64_t lastUs;
+
+    // Round in progress
+    bool roundOpen;
+    bool roundClean;            // Seen from its first frame with both bars equal
+    uint32_t round;
+    int32_t roundStartHp[2];
+    int32_t lastHp[2];
+    int32_t maxDeficit[2];      // Largest HP lead the opponent had
+    uint32_t seenComboEnd[2];   // lastEndFrame already looked at, per attacker
+
+    // Set in progress
+    bool scoreKnown;
+    bool setWon;
+    int wins[2];
+    int maxGameDeficit[2];
+};
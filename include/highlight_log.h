@@ -0,0 +1,97 @@
+#pragma once
+#include <windows.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "event_loop.h"
+#include "highlight_detector.h"
+
+// Timestamped markers for VOD editing. Every HighlightDetector event is
+// appended to three files in the overlay directory:
+//
+//   highlights.csv           timecode, seconds, wall clock, type, player, score, description
+//   highlights.edl           CMX 3600 marker list (DaVinci Resolve, Premiere)
+//   highlights_chapters.txt  "H:MM:SS description" lines for video chapters
+//
+// Times are relative to the stream start. Settings come from highlights.ini,
+// which is written with defaults on first run:
+//
+//   [Highlights]
+//   Enabled=1
+//   StreamStart=         ; local "YYYY-MM-DD HH:MM:SS" or "HH:MM:SS" (today); empty = when the mod started
+//   FrameRate=60         ; EDL timecode rate
+//   ChapterMinScore=60   ; quieter events stay out of the chapter list
+//   FirstTo=3            ; games to win a set; 0 = unknown (set wins marked when the set is recorded)
+//   LongComboHits=15
+//   BigComboDamage=4000
+//   ComebackHp=4000
+//   ComebackGames=2
+//
+// The detector runs inline with the sampler and only queues events. A
+// background timer formats them every FLUSH_INTERVAL_MS and appends each
+// file's batch with one overlapped WriteFile that completes through the
+// event loop's port, so no tick waits on the disk. Loop thread only.
+class HighlightLog {
+public:
+    struct Stats {
+        uint64_t markers;       // Events formatted
+        uint64_t writes;        // Appends completed
+        uint64_t bytes;
+        uint64_t failedWrites;  // Batches kept for the next flush
+        uint64_t dropped;       // Lost to a full detector queue
+        size_t pendingBytes;    // Formatted, not yet written
+        double streamSeconds;   // Now, relative to the stream start
+    };
+
+    static bool Initialize(const std::string& directory);
+    static void Shutdown();
+
+    // From GameDataManager as the sampler produces data
+    static void OnFrame(const ComboSample& sample, const ComboStats& combo);
+    static void OnScore(int p1Wins, int p2Wins);
+    static void OnSetEnd(int p1Wins, int p2Wins, uint32_t p1NicknameId, uint32_t p2NicknameId);
+
+    static void MarkStreamStart();      // The stream starts now
+    static void Flush();                // Format queued events and start the writes
+    static Stats GetStats();
+    static const HighlightConfig& GetConfig() { return detector.GetConfig(); }
+
+private:
+    // An event with the nicknames present when it happened
+    struct Marker {
+        HighlightEvent event;
+        uint32_t p1NicknameId;
+        uint32_t p2NicknameId;
+    };
+
+    enum { LOG_CSV, LOG_EDL, LOG_CHAPTERS, LOG_FILE_COUNT };
+
+    struct LogFile {
+        HANDLE handle = INVALID_HANDLE_VALUE;
+        LoopIoHandler handler;
+        OVERLAPPED overlapped = {};
+        std::string pending;    // Formatted, waiting for the write in flight
+        std::string writing;    // Owned by the write in flight
+        bool busy = false;
+    };
+
+    static void LoadConfig(const std::string& path);
+    static bool Open(LogFile& file, const std::string& path, const char* header);
+    static void Collect(uint32_t p1NicknameId, uint32_t p2NicknameId);
+    static void Format(const Marker& marker);
+    static void StartWrite(LogFile& file);
+    static void OnWriteComplete(void* context, OVERLAPPED* overlapped, DWORD bytes, DWORD error);
+    static void OnFlushTimer(void* context);
+
+    static bool enabled;
+    static HighlightDetector detector;
+    static std::vector<Marker> markers;
+    static LogFile files[LOG_FILE_COUNT];
+    static LoopTimer flushTimer;
+    static int64_t streamStartUs;       // Sampler clock
+    static uint32_t frameRate;
+    static int chapterMinScore;
+    static uint32_t edlEvents;          // Numbered on from the existing file
+    static Stats stats;
+    static const uint32_t FLUSH_INTERVAL_MS = 2000;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Fixed-capacity, NUL-terminated string stored inline. Assigning and comparing
+// never touch the heap, which keeps per-tick updates of PlayerData free of
+// allocations. Input longer than the capacity is truncated on a UTF-8
+// character boundary.
+template<size_t Capacity>
+class InlineString {
+public:
+    static_assert(Capacity > 1 && Capacity <= 256, "length is stored in one byte");
+
+    InlineString() { clear(); }
+    InlineString(const char* text) { assign(text); }
+    InlineString(const std::string& text) { assign(text.data(), text.size()); }
+
+    InlineString& operator=(const char* text) { assign(text); return *this; }
+    InlineString& operator=(const std::string& text) { assign(text.data(), text.size()); return *this; }
+
+    void assign(const char* text) { assign(text, text ? strlen(text) : 0); }
+
+    void assign(const char* text, size_t length) {
+        if (length > Capacity - 1) {
+            length = Capacity - 1;
+            while (length > 0 && (static_cast<unsigned char>(text[length]) & 0xC0) == 0x80) {
+                length--;
+            }
+        }
+        if (length > 0) {
+            memcpy(data, text, length);
+        }
+        data[length] = '\0';
+        size_ = static_cast<uint8_t>(length);
+    }
+
+    void clear() {
+        data[0] = '\0';
+        size_ = 0;
+    }
+
+    const char* c_str() const { return data; }
+    size_t size() const { return size_; }
+    size_t length() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    static constexpr size_t capacity() { return Capacity - 1; }
+
+    // Only for consumers that need an owning copy (logging, file output)
+    std::string str() const { return std::string(data, size_); }
+
+    bool operator==(const InlineString& other) const {
+        return size_ == other.size_ && memcmp(data, other.data, size_) == 0;
+    }
+    bool operator!=(const InlineString& other) const { return !(*this == other); }
+    bool operator==(const char* text) const { return strcmp(data, text) == 0; }
+    bool operator!=(const char* text) const { return !(*this == text); }
+
+private:
+    char data[Capacity];
+    uint8_t size_;
+};
+
+// Sanitized nicknames are at most 16 UTF-16 units, i.e. 48 bytes of UTF-8
+typedef InlineString<64> NicknameString;
+typedef InlineString<32> CharacterNameString;
@@ -0,0 +1,51 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include "event_loop.h"
+#include "input_recorder.h"
+
+// Both players' inputs for an input display overlay. Every applied capture
+// is recorded into an InputRing in the named mapping INPUT_RING_MAPPING_NAME,
+// which other processes can open read-only, and input_display.json (the
+// newest JSON_RUNS runs per player) is rewritten when it changed, at most
+// every JSON_INTERVAL_MS.
+//
+// Needs p1.input and p2.input in offsets.json; until they are described
+// nothing is recorded. Loop thread only.
+class InputDisplay {
+public:
+    struct Stats {
+        InputRecorder::Stats recorder;
+        uint64_t captures;          // OnCapture calls that recorded a frame
+        double averageCaptureNs;    // Decode and record, per frame
+        double maxCaptureNs;
+        bool shared;                // Published through the mapping (else process-local)
+    };
+
+    static bool Initialize(const std::string& directory);
+    static void Shutdown();
+
+    // After a capture was applied; frame = game frame it was taken on
+    static void OnCapture(uint32_t frame);
+
+    static Stats GetStats();
+    static void ResetStats();
+    static const InputRing* GetRing() { return ring; }
+
+private:
+    static void OnJsonTimer(void* context);
+    static bool WriteJson();
+
+    static HANDLE mapping;
+    static InputRing* ring;
+    static InputRecorder* recorder;
+    static uint64_t recordedApplied;    // MemoryReader applied count last recorded
+    static uint32_t jsonSequence;       // Ring sequence the file reflects
+    static std::string jsonPath;
+    static LoopTimer jsonTimer;
+    static uint64_t captures;
+    static uint64_t captureTicks;       // QueryPerformanceCounter ticks spent in OnCapture
+    static uint64_t maxCaptureTicks;
+    static const uint32_t JSON_INTERVAL_MS = 100;
+    static const uint32_t JSON_RUNS = 16;
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// What a player holds on one frame; p1.input/p2.input in the schema are read
+// with these bits
+enum InputBits : uint8_t {
+    INPUT_UP    = 1 << 0,
+    INPUT_DOWN  = 1 << 1,
+    INPUT_LEFT  = 1 << 2,
+    INPUT_RIGHT = 1 << 3,
+    INPUT_A     = 1 << 4,
+    INPUT_B     = 1 << 5,
+    INPUT_C     = 1 << 6,
+    INPUT_D     = 1 << 7
+};
+
+// One input held for a number of consecutive frames
+struct InputRun {
+    uint32_t frame;             // First frame
+    uint16_t held;              // Frames, at least 1
+    uint8_t input;              // InputBits
+    uint8_t flags;              // INPUT_RUN_*
+};
+
+#define INPUT_RUN_FILLED 0x01   // Includes frames that were not captured (assumed unchanged)
+
+#define INPUT_RING_MAGIC 0x495A4645u    // "EFZI"
+#define INPUT_RING_VERSION 1
+#define INPUT_RING_CAPACITY 256         // Runs per player; power of two
+
+// Fixed layout shared with other processes through the named mapping
+// INPUT_RING_MAPPING_NAME. One writer; readers copy under the sequence
+// number (odd while an update is in progress) and retry if it moved.
+// Run i of a player is in runs[player][i % INPUT_RING_CAPACITY]; the newest
+// is written[player] - 1.
+struct InputRing {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t size;                      // sizeof(InputRing)
+    std::atomic<uint32_t> sequence;
+    uint32_t lastFrame;                 // Newest frame recorded
+    uint32_t written[2];                // Runs ever written per player since the last reset
+    InputRun runs[2][INPUT_RING_CAPACITY];
+};
+
+#define INPUT_RING_MAPPING_NAME "Local\\EfzStreamingInputs"
+
+// Run-length encodes both players' inputs frame by frame into an InputRing.
+// Record() is the whole per-frame cost: a compare per player and either a
+// counter increment or one new run. It never allocates and never waits for
+// readers. No Windows dependencies.
+class InputRecorder {
+public:
+    struct Stats {
+        uint64_t frames;        // Frames recorded, including gaps filled
+        uint64_t gaps;          // Frames that were not captured
+        uint64_t duplicates;    // Same frame recorded twice (ignored)
+        uint64_t restarts;      // Frame number went backwards
+    };
+
+    struct BenchmarkResult {
+        uint32_t frames;
+        uint64_t runs;
+        double nsPerFrame;      // Best average over several rounds
+        double p999FrameNs;     // Single frames timed one by one, clock overhead included
+        double maxFrameNs;      // Includes preemption by the OS
+        double framesPerRun;
+        bool verified;          // Ring expanded back to the replay's tail
+    };
+
+    // ring: caller-owned storage, e.g. a mapped view; initialized here
+    explicit InputRecorder(InputRing* ring);
+    void Reset();
+
+    // Writer only. frame counts game frames (60 per second); skipped
+    // numbers are filled with the previous input. A smaller number, or a
+    // gap longer than a run can hold, starts a new recording.
+    void Record(uint32_t frame, uint8_t p1, uint8_t p2);
+
+    Stats GetStats() const { return stats; }
+    const InputRing& GetRing() const { return *ring; }
+
+    // Any thread or process. Newest `count` runs of a player, oldest first;
+    // returns how many were copied (0 if the writer kept interfering).
+    static uint32_t ReadLatest(const InputRing& ring, int player, InputRun* out, uint32_t count);
+    // Newest `count` runs per player as JSON, newest last
+    static std::string ToJSON(const InputRing& ring, uint32_t count);
+    // "6A", "2B+C", "5": numpad direction and buttons
+    static std::string FormatInput(uint8_t input);
+
+    // Encoding, gap filling, restarts, run splitting and torn-read
+    // detection. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+    // Records a synthetic replay (holds, mashing, dropped frames) and checks
+    // the ring against it
+    static BenchmarkResult RunBenchmark(uint32_t frames);
+
+private:
+    void Append(int player, uint32_t frame, uint32_t held, uint8_t input, uint8_t flags);
+    void Extend(int player, uint32_t frames, uint8_t input, uint8_t flags, uint32_t frame);
+
+    InputRing* ring;
+    bool started;
+    Stats stats;
+};
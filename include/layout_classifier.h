@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "memory_snapshot.h"
+#include "offset_schema.h"
+
+// Decides which ReadPlan variant (player or spectator layout) the Revival
+// block is in, so accessors read one precompiled location per field
+// instead of probing every location on every call.
+//
+// A session is identified by the plan, module generation and the base
+// addresses of the variant blocks; a new session starts undecided. Each
+// changed capture counts, per variant, the variant-dependent fields that
+// validate there (ReadPlan::Validates). After DECIDE_SAMPLES captures the
+// variant with the most evidence is locked, unless it is tied. A locked
+// variant is only given up after SWITCH_SAMPLES captures in a row in which
+// another variant validates more fields. Loop thread only.
+class LayoutClassifier {
+public:
+    enum State {
+        STATE_OFFLINE = 0,      // Variant blocks unreadable (not in netplay)
+        STATE_DETECTING,        // Collecting evidence; decoders try every location
+        STATE_LOCKED,
+        STATE_FIXED             // The plan has a single variant
+    };
+
+    struct Status {
+        State state;
+        int variant;            // SCHEMA_ANY_VARIANT unless locked or fixed
+        float confidence;       // Share of the locked variant's fields that validated while deciding
+        uint32_t sessions;      // Session changes seen
+        uint32_t decisions;     // Times a variant was locked
+        uint32_t switches;      // Locked variant abandoned through hysteresis
+    };
+
+    static const uint32_t DECIDE_SAMPLES = 5;
+    static const uint32_t SWITCH_SAMPLES = 10;
+
+    LayoutClassifier();
+    void Reset();
+
+    // Once per applied capture; changed = the capture differs from the last one
+    void Observe(const ReadPlan& plan, const MemorySnapshot& snapshot, bool changed);
+
+    int GetVariant() const { return variant; }
+    Status GetStatus() const;
+    static const char* GetStateName(State state);
+
+    // Player and spectator sessions, ties, and noisy captures against the
+    // built-in schema. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+
+private:
+    void StartSession(State initial);
+    void Decide(const ReadPlan& plan);
+
+    uint64_t sessionKey;
+    State state;
+    int variant;
+    float confidence;
+    uint32_t samples;                           // Captures scored this session
+    uint32_t evidence[SCHEMA_MAX_LOCATIONS];    // Fields that validated, per variant
+    uint32_t checked;                           // Fields scored, per variant
+    uint32_t contrary;                          // Consecutive captures favouring another variant
+    uint32_t sessions;
+    uint32_t decisions;
+    uint32_t switches;
+};
@@ -0,0 +1,116 @@
+#pragma once
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef _WINSOCKAPI_
+#define _WINSOCKAPI_
+#endif
+
+#include <windows.h>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define MATCH_NICKNAME_BYTES 64 // UTF-8, NUL-terminated (sanitized nicknames are at most 16 chars)
+
+// One finished set as stored on disk. Fixed layout so the log can be read
+// straight out of the mapped view without parsing.
+#pragma pack(push, 1)
+struct MatchRecord {
+    int64_t timestamp;                    // Unix time (seconds) when the set ended
+    char p1Nickname[MATCH_NICKNAME_BYTES];
+    char p2Nickname[MATCH_NICKNAME_BYTES];
+    int8_t p1CharacterId;                 // -1 if unknown
+    int8_t p2CharacterId;
+    uint8_t p1Score;                      // Games won in the set
+    uint8_t p2Score;
+    uint32_t durationMs;
+};
+
+struct MatchLogHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t recordCount;                 // Committed records; written after the record itself
+    uint8_t reserved[52];
+};
+#pragma pack(pop)
+
+struct HeadToHeadRecord {
+    uint32_t sets = 0;
+    uint32_t firstWins = 0;               // Sets won by the first player of the query
+    uint32_t secondWins = 0;
+    uint32_t draws = 0;
+};
+
+// Append-only, memory-mapped log of finished sets stored in overlay_assets.
+// Secondary indexes live in memory and are brought up to date incrementally
+// from the committed record count, so nothing but record indices is kept on
+// the heap.
+class MatchHistory {
+public:
+    struct BenchmarkResult {
+        double appendMs;                // Appending and indexing every set
+        double reopenMs;                // Mapping and re-indexing the whole log
+        double headToHeadUs;            // Per lifetime A vs B query
+        double recentMatchesUs;         // Per last-10-sets query
+    };
+
+    static bool Initialize(const std::string& directory);
+    static void Shutdown();
+
+    static bool AppendMatch(const MatchRecord& record);
+
+    // Queries
+    static size_t GetMatchCount();
+    static HeadToHeadRecord GetHeadToHead(const std::string& first, const std::string& second);
+    static std::vector<MatchRecord> GetRecentMatches(const std::string& player, size_t count);
+    static std::vector<MatchRecord> GetRecentMatchups(int characterA, int characterB, size_t count);
+    static void ForEachMatch(const std::function<void(const MatchRecord&, uint32_t p1Id, uint32_t p2Id)>& visitor);
+
+    // Interned player IDs, shared with anything that keys data by nickname
+    static int FindPlayerId(const std::string& nickname);
+
+    static void FillNickname(char (&dest)[MATCH_NICKNAME_BYTES], const std::string& nickname);
+
+    // Loop thread. Both run on a temporary log: synthetic sets are
+    // appended, the log is reopened and the indexes are checked against
+    // the generated sets. The open history is set aside meanwhile.
+    static bool RunSelfTest(std::string& failure);
+    static bool RunBenchmark(uint32_t sets, BenchmarkResult& result, std::string& failure);
+
+private:
+    struct State;
+    static void SwapState(State& other);
+    static bool RunOnTemporaryLog(uint32_t sets, BenchmarkResult& result, std::string& failure);
+
+    static bool MapFile(uint32_t capacity);
+    static void UnmapFile();
+    static bool Grow();
+    static void IndexNewRecords();
+    static uint32_t InternPlayer(const char* nickname);
+    static const MatchRecord* RecordAt(uint32_t index);
+    static uint64_t PairKey(uint32_t a, uint32_t b);
+    static int CharacterPairSlot(int a, int b);
+
+    static std::mutex mutex;
+    static bool initialized;
+    static HANDLE fileHandle;
+    static HANDLE mappingHandle;
+    static BYTE* view;
+    static uint32_t capacity;              // Records that fit in the current mapping
+    static uint32_t indexedCount;
+
+    // Secondary indexes (record indices only, the records stay in the mapping)
+    static std::unordered_map<std::string, uint32_t> playerIds;
+    static std::vector<std::vector<uint32_t>> playerMatches;
+    static std::vector<std::vector<uint32_t>> characterPairMatches;
+    static std::unordered_map<uint64_t, HeadToHeadRecord> headToHead;
+
+    static const uint32_t MATCH_LOG_MAGIC = 0x48465A45; // "EZFH"
+    static const uint16_t MATCH_LOG_VERSION = 1;
+    static const uint32_t INITIAL_CAPACITY = 4096;
+};
@@ -3,36 +3,60 @@
 #include <string>
 #include <atomic>
 #include <unordered_map>
+#include <memory>
+#include "constants.h"
+#include "character_table.h"
+#include "memory_snapshot.h"
+#include "offset_schema.h"
+#include "layout_classifier.h"
+#include "netplay_telemetry.h"
+#include "combo_tracker.h"
 
 class MemoryReader {
 public:
     static bool Initialize();
     static void Shutdown();
     
-    // Dynamic module detection
-    static bool TryLoadEfzRevivalModule();
-    static void StartModuleWatcher();
-    static void StopModuleWatcher();
-    
     // Memory read functions
     static bool ReadMemory(DWORD address, void* buffer, size_t size);
     static DWORD ReadDWORD(DWORD address);
     static int ReadByte(DWORD address);
     static std::string ReadString(DWORD address, size_t maxLength);  // Add this
-    static std::wstring ReadWideString(DWORD address, size_t maxLength);
+    static std::u16string ReadWideString(DWORD address, size_t maxLength);
+    static size_t ReadWideStringInto(DWORD address, char16_t* buffer, size_t maxLength); // No allocation
+    
+    // Reads and hashes every block of the active read plan (see SchemaLoader);
+    // returns SCHEMA_FIELD_BIT()s of the fields whose blocks changed. The
+    // accessors below decode from the last refresh.
+    static uint64_t RefreshBlocks();
+    
+    // RefreshBlocks in two halves. CaptureBlocks only reads memory and may run
+    // on any thread (the game thread in frame mode); ApplyBlocks hashes and
+    // publishes a capture and belongs to the event loop thread.
+    static bool CaptureBlocks(MemorySnapshot& snapshot);
+    static uint64_t ApplyBlocks(const MemorySnapshot& snapshot);
+    static uint64_t GetAppliedCount() { return appliedCount; }  // Captures applied so far
+    
+    // Which Revival layout the accessors read (player, spectator, ...); loop thread
+    static LayoutClassifier::Status GetLayoutStatus() { return layoutClassifier.GetStatus(); }
+    static std::string GetLayoutName();     // Variant name when decided, else the classifier state
     
     // Game data accessors
     static int GetP1CharacterID();
     static int GetP2CharacterID();
     static DWORD GetP1WinCount();
     static DWORD GetP2WinCount();
-    static std::wstring GetP1Nickname();
-    static std::wstring GetP2Nickname();
+    static uint32_t GetP1NicknameId(); // NicknamePool IDs
+    static uint32_t GetP2NicknameId();
+    static void GetNetplaySample(NetplaySample& sample);  // From the last applied capture; timestamp left as is
+    static bool GetInputs(uint8_t& p1, uint8_t& p2);       // InputBits; false unless both sides were read
+    static void GetComboSample(ComboSample& sample);       // HP and hitstun; frame and timestamp left as is
     static std::string GetP1CharacterName();
     static std::string GetP2CharacterName();
     static std::string GetP1CharacterNameRaw();  // Add this
     static std::string GetP2CharacterNameRaw();  // Add this
     static HMODULE GetEFZModuleAddress() { return efzModule; } // Add this accessor for the debug command
+    static std::u16string SanitizeNickname(const std::u16string& nickname); // Empty if nothing valid remains
     
     // Add this new method
     static void ForceRefreshCharacterData() {
@@ -49,22 +73,14 @@ public:
 
 private:
     static bool FindEFZProcess();
-    static HMODULE GetModuleHandle(const std::string& moduleName);
-    static HMODULE GetModuleHandleDynamic(const char* moduleName);
-    static DWORD WINAPI ModuleWatcherThreadProc(LPVOID lpParam);
-    static int MapRawCharacterNameToID(const std::string& rawName);
-    static std::string GetCharacterNameFromID(int id);  // Add this line
-    static bool IsValidNicknameChar(wchar_t c);
-    static std::wstring SanitizeNickname(const std::wstring& nickname);
-    static DWORD SanitizeWinCount(DWORD count);
+    static void InvalidateModuleState();
+    static uint32_t ReadNicknameId(int player);
+    static bool ReadCharacterNameField(int player, char (&field)[CHARACTER_NAME_FIELD_SIZE]);
     
     static HANDLE hProcess;
     static DWORD processId;
     static HMODULE efzModule;
-    static HMODULE efzRevivalModule;
-    static HANDLE moduleWatcherThread;
-    static std::atomic<bool> watcherRunning;
-    static const int MODULE_CHECK_INTERVAL_MS = 1000;
+    static uint32_t seenModuleGeneration;  // ModuleMonitor generation the caches were built against
 
     // Add cache for memory reads to reduce repeated logs
     static std::unordered_map<DWORD, std::string> stringCache;
@@ -76,4 +92,27 @@ private:
     static void ClearCache();
     static const int CACHE_CLEAR_INTERVAL_MS = 5000; // Clear cache every 5 seconds
     static DWORD lastCacheClearTime;
+    
+    // Last raw nickname per side, so an unchanged name costs one compare
+    struct NicknameSlot {
+        char16_t raw[MAX_NICKNAME_LENGTH];
+        size_t length;
+        uint32_t id;
+    };
+    static NicknameSlot nicknameSlots[2];
+    
+    // Fingerprint of each plan block as of the last refresh
+    struct MemoryBlock {
+        DWORD base;         // Address the block was read from, 0 if unavailable
+        uint64_t hash;
+        bool valid;
+    };
+    static MemoryBlock blocks[SNAPSHOT_MAX_BLOCKS];
+    static MemorySnapshot applied;                      // Last applied capture
+    static std::shared_ptr<const ReadPlan> appliedPlan; // Plan it was laid out by
+    static LayoutClassifier layoutClassifier;
+    static uint64_t appliedCount;
+    
+    static bool UpdateBlock(uint32_t index, DWORD base, const void* data, size_t size);
+    static void TrackBlockBase(uint32_t index, const PlanBlock& block, DWORD base);
 };
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+
+// Limits of one capture; a schema that needs more is rejected when compiled
+#define SNAPSHOT_MAX_BLOCKS 8
+#define SNAPSHOT_DATA_SIZE 4096
+
+// Raw copy of every memory block in the active read plan, taken in one pass.
+// Captured on whichever thread samples (the game thread in frame mode) and
+// applied on the event loop thread, so it holds plain 32-bit addresses.
+struct MemorySnapshot {
+    uint32_t moduleGeneration;                  // ModuleMonitor generation at capture
+    uint32_t planId;                            // ReadPlan the blocks were laid out by
+    uint32_t blockBase[SNAPSHOT_MAX_BLOCKS];    // Resolved address per block, 0 when unreadable
+    uint8_t data[SNAPSHOT_DATA_SIZE];           // Blocks back to back at their plan offsets
+};
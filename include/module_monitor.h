@@ -0,0 +1,53 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "event_loop.h"
+
+// Modules whose base address the reader depends on
+enum WatchedModule {
+    WATCHED_EFZ_REVIVAL = 0,
+    WATCHED_MODULE_COUNT
+};
+
+enum ModuleEventType {
+    MODULE_EVENT_LOADED = 0,
+    MODULE_EVENT_UNLOADED
+};
+
+// Tracks load and unload of the watched modules. On Windows the events come
+// from the loader (LdrRegisterDllNotification); where that is unavailable a
+// polling thread checks GetModuleHandle instead. Either source feeds Notify(),
+// which tests and the console can also call to simulate a netplay restart.
+//
+// Resolved bases are published through atomics, so readers on any thread get
+// them without locks or module enumeration. Every load or unload bumps the
+// generation; consumers compare it to drop state derived from the old base.
+class ModuleMonitor {
+public:
+    static bool Start();
+    static void Stop();
+
+    // nullptr while the module is not loaded
+    static HMODULE GetBase(WatchedModule module) {
+        return bases[module].load(std::memory_order_acquire);
+    }
+    static uint32_t GetGeneration() { return generation.load(std::memory_order_acquire); }
+    static bool IsEventDriven() { return cookie != nullptr; }
+    static const char* GetModuleName(WatchedModule module);
+
+    // Single entry point for every notification source. May run under the
+    // loader lock: it only compares names and stores atomics.
+    static void Notify(ModuleEventType type, const wchar_t* baseName, size_t length, HMODULE base);
+
+private:
+    static void Publish(WatchedModule module, HMODULE base);
+    static void OnPollTimer(void* context);
+
+    static std::atomic<HMODULE> bases[WATCHED_MODULE_COUNT];
+    static std::atomic<uint32_t> generation;
+    static void* cookie;                    // Loader registration, nullptr when polling
+    static LoopTimer pollTimer;
+    static const int POLL_INTERVAL_MS = 1000;
+};
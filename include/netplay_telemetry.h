@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// One reading of the Revival netplay fields; -1 where a field is not
+// described by the schema or could not be read
+struct NetplaySample {
+    uint64_t timestampUs;
+    int32_t pingMs;
+    int32_t delayFrames;
+    int32_t rollbacks;          // Cumulative counters as the game keeps them
+    int32_t resyncs;
+    int32_t spectators;
+};
+
+// Rolling summary over the last NetplayTelemetry::WINDOW_US
+struct NetplayStats {
+    bool available;             // Any netplay field was read in the window
+    int pingMs;                 // Latest, -1 if unknown
+    int pingP50Ms;              // Percentiles at histogram resolution
+    int pingP95Ms;
+    int pingMaxMs;
+    int delayFrames;
+    float rollbacksPerSecond;   // -1 if the counter is not read
+    uint32_t rollbacks;         // Since the session started; counter resets are bridged
+    uint32_t resyncs;
+    int spectators;
+
+    bool operator==(const NetplayStats& other) const;
+    bool operator!=(const NetplayStats& other) const { return !(*this == other); }
+};
+
+// Keeps every sample in a ring and maintains ping and rollback histograms
+// over a sliding time window incrementally: a sample is counted when it is
+// recorded and uncounted when it leaves the window or is overwritten, so a
+// stats query never walks the ring. No Windows dependencies.
+class NetplayTelemetry {
+public:
+    static const size_t RING_SIZE = 4096;               // ~68 s of frames at 60 fps
+    static const uint64_t WINDOW_US = 10000000;         // Histograms and rates cover 10 s
+    static const uint32_t PING_BUCKET_MS = 5;
+    static const uint32_t PING_BUCKETS = 64;            // Last bucket holds everything from 315 ms up
+    static const uint32_t ROLLBACK_BUCKETS = 16;        // Rollbacks per second, last bucket 15+
+
+    struct Histogram {
+        uint32_t counts[PING_BUCKETS];
+        uint32_t bucketCount;
+        uint32_t bucketWidth;
+        uint32_t total;
+    };
+
+    NetplayTelemetry();
+    void Reset();
+
+    // Samples must arrive in timestamp order
+    void Record(const NetplaySample& sample);
+
+    NetplayStats GetStats() const;
+    // Ping samples by PING_BUCKET_MS; seconds of the window by rollback count
+    void GetPingHistogram(Histogram& histogram) const;
+    void GetRollbackHistogram(Histogram& histogram) const;
+
+    size_t GetSampleCount() const { return count; }
+    const NetplaySample& GetSample(size_t age) const;    // 0 = newest
+
+    std::string HistogramsToJSON() const;
+
+    // Synthetic sessions: percentiles, rates, counter resets, window expiry
+    // and ring overwrite. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+
+private:
+    struct Entry {
+        NetplaySample sample;
+        uint32_t rollbackDelta;     // Rollbacks since the previous sample
+        bool readable;
+    };
+
+    void Expire(uint64_t nowUs);
+    void Uncount(Entry& entry);
+    void CloseSecond();
+
+    Entry ring[RING_SIZE];
+    size_t head;                    // Next slot to write
+    size_t count;
+    size_t windowTail;              // Oldest entry still counted
+    size_t windowCount;
+
+    uint32_t pingCounts[PING_BUCKETS];
+    uint32_t pingSamples;
+    uint32_t windowRollbacks;
+    uint32_t windowRollbackReadings;
+    uint32_t windowReadable;        // Entries with at least one field read
+
+    // Rollbacks per whole second, for the rollback histogram
+    static const uint32_t WINDOW_SECONDS = (uint32_t)(WINDOW_US / 1000000);
+    uint32_t secondTotals[WINDOW_SECONDS];
+    uint32_t secondsFilled;
+    uint32_t secondCursor;
+    uint64_t currentSecond;
+    uint32_t currentSecondRollbacks;
+    bool secondStarted;
+
+    int32_t lastRollbackCounter;
+    int32_t lastResyncCounter;
+    uint32_t totalRollbacks;
+    uint32_t totalResyncs;
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include "inline_string.h"
+#include "constants.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Interns nicknames by their raw UTF-16 units as read from game memory.
+// Sanitizing and UTF-8 conversion happen once per distinct raw name; after
+// that a name is identified by a stable ID that is cheap to compare.
+//
+// The pool holds at most CAPACITY names. Garbage read while the game loads
+// or the layout flips would otherwise accumulate for the whole session, so
+// a new name replaces the least recently used one. An ID carries its
+// entry's generation, so a dropped ID never aliases the name that replaced
+// it: Get() returns an empty string for it.
+class NicknamePool {
+public:
+    static const uint32_t INVALID_ID = 0xFFFFFFFF;
+    static const uint32_t CAPACITY = 256;
+
+    // fallback must be a string literal; it is used when nothing valid remains
+    static uint32_t Intern(const char16_t* raw, size_t length, const char* fallback);
+    // A cached ID is still on screen: keep it over older names
+    static void Touch(uint32_t id);
+    static NicknameString Get(uint32_t id);
+    static size_t Size();
+
+    // Interning, eviction under a flood of distinct names, stale IDs, and
+    // no heap allocation for names already pooled (when AllocTracker is
+    // compiled in). Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+
+private:
+    static const uint32_t INDEX_BITS = 16;
+    static const uint32_t BUCKET_COUNT = CAPACITY * 2;  // Power of two, at most half full
+
+    struct Entry {
+        uint32_t id;                // Generation << INDEX_BITS | index
+        uint32_t hash;
+        uint32_t lastUse;           // useClock when last interned, touched or read
+        uint8_t length;
+        char16_t raw[MAX_NICKNAME_LENGTH];
+        const char* fallback;
+        NicknameString utf8;
+    };
+
+    static uint32_t Hash(const char16_t* raw, size_t length, const char* fallback);
+    static void Rehash();
+    static Entry* Find(uint32_t id);
+    static bool CheckPool(std::string& failure);
+
+    static std::mutex mutex;
+    static std::vector<Entry> entries;      // Reserved to CAPACITY once; slots are reused
+    static std::vector<uint32_t> buckets;   // Open addressing over entry indices, INVALID_ID = empty
+    static uint32_t useClock;
+};
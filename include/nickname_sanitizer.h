@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "constants.h"
+
+// Classifies nickname characters through a two-level property table (one
+// byte per code unit, identical 256-unit blocks shared) and rewrites raw
+// names into something safe to display and stable to key stats by.
+//   allowed     - kept as is (Latin incl. accents, Greek, Cyrillic, kana, CJK, Hangul)
+//   confusable  - folded to ASCII (fullwidth forms, typographic spaces, dashes, quotes)
+//   control     - dropped silently (C0/C1 controls, zero-width and bidi marks)
+//   combining   - kept after a base character, at most two in a row
+//   disallowed  - replaced by a single '_' per run
+class NicknameSanitizer {
+public:
+    enum CharClass : uint8_t {
+        CHAR_DISALLOWED = 0,
+        CHAR_ALLOWED,
+        CHAR_CONFUSABLE,
+        CHAR_CONTROL,
+        CHAR_COMBINING
+    };
+
+    static CharClass Classify(char16_t c);
+
+    // ASCII replacement for a confusable character (c itself otherwise)
+    static char16_t Fold(char16_t c);
+
+    // Writes at most MAX_SANITIZED_NICKNAME_LENGTH units, returns the count
+    static size_t Sanitize(const char16_t* input, size_t length, char16_t* output);
+    static std::u16string Sanitize(const std::u16string& input);
+
+    // Checks a set of known names, returns false with a description on mismatch
+    static bool RunSelfTest(std::string& failure);
+
+    // Sanitizes synthetic names, returns nanoseconds per name
+    static double RunBenchmark(size_t names);
+
+private:
+    static const size_t MAX_BLOCKS = 64;
+
+    struct Tables {
+        uint8_t blockIndex[256];
+        uint8_t blocks[MAX_BLOCKS][256];
+        size_t blockCount;
+    };
+
+    static const Tables& GetTables();
+    static void BuildTables(Tables& tables);
+};
@@ -0,0 +1,198 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "memory_snapshot.h"
+#include "signature_scanner.h"
+
+// Modules a schema can anchor pointer chains to; the JSON names them by file
+enum SchemaModule {
+    SCHEMA_MODULE_EFZ = 0,      // "efz.exe"
+    SCHEMA_MODULE_REVIVAL,      // "EfzRevival.dll"
+    SCHEMA_MODULE_COUNT
+};
+
+// Fields the mod decodes; the JSON names are in OffsetSchema::GetFieldName()
+enum SchemaField {
+    SCHEMA_P1_WIN_COUNT = 0,    // "p1.winCount"
+    SCHEMA_P2_WIN_COUNT,
+    SCHEMA_P1_NICKNAME,         // "p1.nickname"
+    SCHEMA_P2_NICKNAME,
+    SCHEMA_P1_CHARACTER_NAME,   // "p1.characterName"
+    SCHEMA_P2_CHARACTER_NAME,
+    // Optional from here on: the built-in offsets do not locate these
+    SCHEMA_P1_INPUT,            // "p1.input" (InputBits: directions and buttons held this frame)
+    SCHEMA_P2_INPUT,
+    SCHEMA_P1_HP,               // "p1.hp"
+    SCHEMA_P2_HP,
+    SCHEMA_P1_HITSTUN,          // "p1.hitstun" (> 0 while in hitstun)
+    SCHEMA_P2_HITSTUN,
+    // Netplay telemetry
+    SCHEMA_NETPLAY_PING,        // "netplay.ping" (ms)
+    SCHEMA_NETPLAY_DELAY,       // "netplay.delay" (frames)
+    SCHEMA_NETPLAY_ROLLBACKS,   // "netplay.rollbacks" (cumulative)
+    SCHEMA_NETPLAY_RESYNCS,     // "netplay.resyncs" (cumulative)
+    SCHEMA_NETPLAY_SPECTATORS,  // "netplay.spectators"
+    SCHEMA_FIELD_COUNT,
+    SCHEMA_FIRST_OPTIONAL_FIELD = SCHEMA_P1_INPUT
+};
+
+#define SCHEMA_FIELD_BIT(field) (1ull << (field))
+
+enum SchemaFieldType {
+    FIELD_TYPE_U8 = 0,
+    FIELD_TYPE_U16,
+    FIELD_TYPE_U32,
+    FIELD_TYPE_I32,
+    FIELD_TYPE_UTF16,           // length = characters
+    FIELD_TYPE_ASCII            // length = bytes
+};
+
+// Identity of a loaded module image, matched against a layout's "match"
+struct ModuleFingerprint {
+    bool loaded;
+    uint32_t timestamp;         // PE header TimeDateStamp
+    uint32_t checksum;          // PE optional header CheckSum
+    uint32_t imageSize;
+};
+
+#define SCHEMA_MAX_POINTER_CHAIN 4
+#define SCHEMA_MAX_LOCATIONS 4
+#define SCHEMA_ANY_VARIANT (-1)     // Decode by trying every location in order
+
+struct PlanBlock {
+    std::string name;
+    SchemaModule module;
+    uint32_t chainLength;
+    uint32_t chain[SCHEMA_MAX_POINTER_CHAIN];  // chain[0] from the module base, later offsets from the pointer read before
+    bool scanned;                               // chain[0] came from a signature rather than its fallback
+    uint32_t start;                             // First byte read, relative to the resolved pointer
+    uint32_t size;
+    uint32_t dataOffset;                        // Where the block lands in MemorySnapshot::data
+};
+
+struct PlanLocation {
+    uint32_t block;
+    uint32_t offset;                            // Relative to the resolved pointer, as written in the schema
+    uint32_t dataOffset;                        // Same byte in MemorySnapshot::data
+};
+
+struct PlanField {
+    bool present;
+    SchemaFieldType type;
+    uint32_t length;
+    uint32_t locationCount;
+    PlanLocation locations[SCHEMA_MAX_LOCATIONS];  // Tried in order (player, then spectator, ...)
+    bool hasRange;
+    int64_t minValue;
+    int64_t maxValue;
+    int64_t defaultValue;                       // Integers when no location passes validation
+    std::vector<std::u16string> reject;         // Strings that mean "try the next location"
+    uint32_t blockMask;                         // Blocks any location reads from
+};
+
+// Where every field is in one kind of session (player, spectator, ...).
+// Variant v reads each field from its location v, or from its only
+// location when the field does not move between sessions.
+struct PlanVariant {
+    std::string name;
+    PlanLocation locations[SCHEMA_FIELD_COUNT];
+};
+
+// A schema layout compiled against the loaded modules. Capture only touches
+// the block table; decoding reads fields out of a snapshot taken with it.
+// Immutable once published.
+struct ReadPlan {
+    uint32_t id;
+    std::string layout;
+    uint32_t blockCount;
+    PlanBlock blocks[SNAPSHOT_MAX_BLOCKS];
+    uint32_t dataSize;
+    PlanField fields[SCHEMA_FIELD_COUNT];
+    uint32_t variantCount;                      // 1 when the layout names no "variants"
+    PlanVariant variants[SCHEMA_MAX_LOCATIONS];
+    uint64_t variantFields;                     // SCHEMA_FIELD_BIT()s whose location differs between variants
+    uint32_t variantBlockMask;                  // Blocks those locations are in
+    std::vector<std::string> warnings;          // Unknown names and other non-fatal findings
+
+    // SCHEMA_FIELD_BIT()s of fields that read from any of the blocks
+    uint64_t FieldsInBlocks(uint32_t blockMask) const;
+
+    // Whether the value at a location looks like real data: block read,
+    // integer in range, string non-empty, printable and not rejected
+    bool Validates(SchemaField field, const PlanLocation& location, const MemorySnapshot& snapshot) const;
+
+    // The decoders read the variant's location only, or with
+    // SCHEMA_ANY_VARIANT try the field's locations in order.
+    //
+    // First location whose block was read and whose value is in range.
+    // False (value = default) when none qualifies or the field is absent.
+    bool DecodeInteger(SchemaField field, const MemorySnapshot& snapshot, int64_t& value,
+                       int variant = SCHEMA_ANY_VARIANT) const;
+    // First readable location not in the reject list, else the first
+    // readable one. Returns the length; out is NUL-terminated.
+    size_t DecodeString16(SchemaField field, const MemorySnapshot& snapshot, char16_t* out, size_t capacity,
+                          int variant = SCHEMA_ANY_VARIANT) const;
+    // Raw bytes of the first readable location, zero-padded to capacity.
+    // False when no location could be read.
+    bool DecodeBytes(SchemaField field, const MemorySnapshot& snapshot, char* out, size_t capacity,
+                     int variant = SCHEMA_ANY_VARIANT) const;
+
+private:
+    uint32_t GetLocations(SchemaField field, int variant, const PlanLocation*& locations) const;
+};
+
+// Looks signatures up in a loaded module image (SchemaLoader scans the
+// process and caches results on disk; tests substitute their own)
+class SignatureResolver {
+public:
+    virtual ~SignatureResolver() {}
+    virtual bool Resolve(SchemaModule module, const SignatureSpec& spec, uint32_t& rva, std::string& error) = 0;
+};
+
+// Versioned JSON description of where every field lives:
+//
+//   { "schemaVersion": 1,
+//     "layouts": [
+//       { "name": "...",
+//         "match": { "EfzRevival.dll": { "timestamp": "0x...", "checksum": "0x..." } },
+//         "variants": [ "player", "spectator" ],
+//         "blocks": { "revival": { "module": "EfzRevival.dll", "pointer": ["0xA02CC"],
+//                                  "start": "0x80", "size": 1104 } },
+//         "fields": { "p1.winCount": { "type": "u32", "range": [0, 99], "default": 0,
+//                                      "locations": [ { "block": "revival", "offset": "0x4C8" },
+//                                                     { "block": "revival", "offset": "0x80" } ] } } } ] }
+//
+// Numbers may be JSON numbers or "0x" strings. The first layout whose
+// "match" fits the loaded modules is compiled; a layout without "match"
+// fits anything. Strings take "length" and optional "reject". "variants"
+// names the location positions (see PlanVariant and LayoutClassifier).
+//
+// The first pointer offset may instead be a signature of code that uses
+// the global, so the schema survives module rebuilds:
+//
+//   "pointer": [ { "signature": "8B 0D ?? ?? ?? ?? 8B 81 C8 04 00 00", "operand": 2,
+//                  "kind": "absolute", "fallback": "0xA02CC" } ]
+//
+// The fallback is used when no resolver is given, the module is not
+// loaded or the scan fails (with a warning); without one, failure is fatal.
+class OffsetSchema {
+public:
+    static constexpr int SCHEMA_VERSION = 1;
+
+    static const char* GetFieldName(SchemaField field);
+    static const char* GetModuleName(SchemaModule module);
+    static const char* GetTypeName(SchemaFieldType type);
+
+    // Parses, selects a layout and compiles it. On failure plan is untouched.
+    static bool Compile(const std::string& text, const ModuleFingerprint fingerprints[SCHEMA_MODULE_COUNT],
+                        ReadPlan& plan, std::string& error, SignatureResolver* resolver = nullptr);
+
+    // The offsets in constants.h as a schema document
+    static std::string BuiltInSchema();
+
+    // Compiles the built-in schema and hand-written variants against
+    // synthetic snapshots. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+};
@@ -1,12 +1,17 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include <filesystem>
 
+struct PlayerData;
+struct NetplayStats;
+struct ComboStats;
+
 class OverlayData {
 public:
     static bool Initialize();
-    static void UpdateFiles();
+    static void UpdateFiles(bool forceAll = false);
     static void Shutdown();
     static void ResetData(); 
     static std::string GetOutputDirectory() { return outputDirectory; } // Add this line
@@ -14,7 +19,12 @@ public:
 private:
     static std::string outputDirectory;
     static bool initialized;
+    static uint64_t writtenVersion;    // Last GameData version reflected in the files
     
     // Update the WriteToFile signature to accept std::filesystem::path
     static bool WriteToFile(const std::filesystem::path& filePath, const std::string& content);
+    static void WritePlayerStatsFiles(const std::filesystem::path& dir, const std::string& prefix, const PlayerData& player);
+    static void WriteNetplayFiles(const std::filesystem::path& dir, const NetplayStats& netplay);
+    static void WriteComboFiles(const std::filesystem::path& dir, const std::string& prefix, const ComboStats& combo,
+                                int side);
 };
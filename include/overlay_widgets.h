@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "canvas.h"
+#include "draw_list_rasterizer.h"
+#include "inline_string.h"
+
+struct ImGuiContext;
+struct ImFont;
+
+// Everything the widgets show, copied by value from the loop thread
+struct WidgetState {
+    NicknameString nickname[2];
+    int wins[2];
+    int rating[2];              // -1 unknown
+    int32_t hp[2];              // -1 when the schema has no HP field
+    uint32_t comboHits[2];      // By attacker; combo in progress
+    int32_t comboDamage[2];
+    uint32_t bestHits[2];       // This match
+    int32_t roundDamage[2];
+    uint32_t round;             // 0 before the first
+    int pingMs;                 // -1 offline or unknown
+    double clockSeconds;        // Stream clock
+    InlineString<256> ticker;   // Scrolls along the bottom; empty hides the strip
+};
+
+// Overlay widgets (health bars with a damage trail, win pips, combo
+// counters, the stream clock, a ping meter and a scrolling ticker) laid out
+// with Dear ImGui's draw lists and rasterized on the CPU by
+// DrawListRasterizer, so no GPU or window is involved. Each instance owns
+// an ImGui context; ImGui keeps the current context in one global, so
+// building a frame holds a lock shared by all instances. The rasterizer
+// runs outside it. No Windows dependencies.
+class OverlayWidgets {
+public:
+    struct Config {
+        int width = 640;
+        int height = 150;
+        float fontSize = 18.0f;
+        float tickerSpeed = 60.0f;      // Pixels per second
+        int32_t maxHp = 10000;          // A full bar; a higher reading raises it
+        std::vector<uint8_t> font;      // TTF/OTF file; empty = ImGui's built-in font
+    };
+
+    struct Stats {
+        uint64_t frames;
+        uint64_t changedFrames;
+        double lastBuildUs;             // ImGui NewFrame to Render
+        double lastRasterUs;
+        int vertices;                   // Last frame
+        int indices;
+        DrawListRasterizer::Stats raster;
+    };
+
+    OverlayWidgets();
+    ~OverlayWidgets();
+    OverlayWidgets(const OverlayWidgets&) = delete;
+    OverlayWidgets& operator=(const OverlayWidgets&) = delete;
+
+    bool Initialize(const Config& config, std::string& error);
+
+    // time: seconds on any steady clock, for the ticker and the damage
+    // trail. Returns the changed area of GetCanvas().
+    CanvasRect Render(const WidgetState& state, double time);
+    const Canvas& GetCanvas() const { return canvas; }
+    Stats GetStats() const;
+
+    // A set in progress, mid-combo, with a ticker: the representative
+    // layout for the self-test and benchmark
+    static WidgetState SampleState();
+
+    // Renders the sample and checks that frames change only where they
+    // should. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+
+    struct BenchmarkResult {
+        int vertices;
+        int triangles;
+        uint64_t binEntries;            // Triangle-tile pairs per frame
+        double buildUs;                 // Best of the rounds
+        double rasterUs;                // Binned, SIMD, unchanged target (the steady state)
+        double scalarUs;                // Binned, scalar
+        double unbinnedUs;              // Whole frame buffer, SIMD
+        double firstFrameUs;            // Binned, SIMD, into an empty target
+        const char* level;
+    };
+    static BenchmarkResult RunBenchmark(const Config& config, int rounds);
+
+private:
+    void Build(const WidgetState& state, double time);
+
+    Config config;
+    ImGuiContext* context = nullptr;
+    ImFont* font = nullptr;
+    ImFont* largeFont = nullptr;
+    Canvas atlas;
+    Canvas canvas;
+    DrawListRasterizer rasterizer;
+    float trail[2] = {-1.0f, -1.0f};    // HP the damage trail shows
+    int32_t maxHp = 0;
+    double lastTime = 0.0;
+    Stats stats = {};
+    static std::mutex contextLock;
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include "match_history.h"
+#include "constants.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define STATS_CHARACTER_COUNT (MAX_CHARACTER_ID + 1)
+
+// Aggregates for one interned player (MatchHistory player ID)
+struct PlayerStatsRow {
+    uint32_t sets;
+    uint32_t wins;
+    uint32_t losses;
+    int32_t streak;                                  // >0 win streak, <0 loss streak
+    uint32_t games;                                  // Games played across all sets
+    uint64_t durationMs;                             // Total set time
+    uint32_t characterSets[STATS_CHARACTER_COUNT];   // Sets played with each character
+    uint32_t matchupSets[STATS_CHARACTER_COUNT];     // Sets against each opponent character
+    uint32_t matchupWins[STATS_CHARACTER_COUNT];
+    int32_t mostPlayedCharacterId;                   // -1 until a character is known
+};
+
+// Aggregates for one character across all players
+struct CharacterStatsRow {
+    uint32_t sets;
+    uint32_t wins;
+    uint32_t matchupSets[STATS_CHARACTER_COUNT];
+    uint32_t matchupWins[STATS_CHARACTER_COUNT];
+};
+
+// Values published to the overlay for one side
+struct PlayerSummary {
+    int sets = 0;
+    int wins = 0;
+    int losses = 0;
+    int winRate = -1;                 // Percent, -1 when there is no data
+    int streak = 0;
+    int mostPlayedCharacterId = -1;
+    DWORD setTimePerGameMs = 0;       // Total set time / games; the history times whole sets only
+    int matchupWinRate = -1;          // This player vs the opponent's current character
+    int characterMatchupWinRate = -1; // This character vs that character, all players
+};
+
+// Per-player and per-character statistics maintained incrementally from
+// finished sets. Tables are fixed-layout rows indexed by interned player ID
+// and character ID, so recording a set is O(1).
+class PlayerStats {
+public:
+    static void Initialize();
+    static void Shutdown();
+
+    static void RecordSet(const MatchRecord& record);
+    static PlayerSummary GetSummary(const std::string& nickname, int characterId, int opponentCharacterId);
+
+    static std::string FormatWinRate(int winRate);
+    static std::string FormatStreak(int streak);
+    static std::string FormatDuration(DWORD ms);
+
+private:
+    static void Accumulate(const MatchRecord& record, int p1Id, int p2Id);
+    static void AccumulateSide(int playerId, int characterId, int opponentCharacterId,
+                               int result, const MatchRecord& record);
+    static int Percent(uint32_t wins, uint32_t total);
+
+    static std::mutex mutex;
+    static std::vector<PlayerStatsRow> players;
+    static CharacterStatsRow characters[STATS_CHARACTER_COUNT];
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "canvas.h"
+
+// PNG encoder for overlay images that are rewritten on every change. Each
+// row gets the Sub or Up filter, whichever leaves the smaller residuals,
+// and the zlib stream uses fixed Huffman codes with one of:
+//
+//   STORED  no compression; the largest file, no matching at all
+//   RLE     runs of one byte only (distance 1); flat panels and the zero
+//           rows the filters leave behind
+//   FAST    greedy matching through a one-entry-per-hash table
+//
+// Scratch buffers belong to the writer and are reused, so encoding the
+// same size again allocates nothing. Output is 8-bit straight RGBA.
+//
+// No Windows dependencies.
+class PngWriter {
+public:
+    enum Mode { STORED, RLE, FAST, MODE_COUNT };
+
+    // Premultiplied canvas in, PNG file bytes out; valid until the next call
+    const std::vector<uint8_t>& Encode(const Canvas& image, Mode mode);
+
+    static const char* GetModeName(Mode mode);
+    static bool ParseMode(const std::string& name, Mode& mode);
+    static const char* GetSimdLevel();
+    static void ForceScalar(bool scalar) { forceScalar = scalar; }  // Self-test and benchmark
+
+    // Encodes synthetic images in every mode and decodes them again with a
+    // minimal inflater: chunk CRCs, Adler-32, filters and the exact pixels,
+    // SIMD against scalar. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+
+    struct BenchmarkResult {
+        double rawUs;                   // Copying the BGRA pixels as they are
+        size_t rawBytes;
+        double encodeUs[MODE_COUNT];    // Best of the rounds
+        size_t encodeBytes[MODE_COUNT];
+        double scalarUs;                // FAST without SIMD
+        const char* level;
+    };
+    static BenchmarkResult RunBenchmark(const Canvas& image, int rounds);
+
+private:
+    void Filter(const Canvas& image);
+    size_t Deflate(const uint8_t* data, size_t size, Mode mode, uint8_t* out);
+
+    std::vector<uint8_t> filtered;      // Filter byte and RGBA per row
+    std::vector<uint8_t> rows[3];       // Previous and current straight row, Sub candidate
+    std::vector<int32_t> hashTable;
+    std::vector<uint8_t> output;
+    static bool forceScalar;
+};
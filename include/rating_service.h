@@ -0,0 +1,88 @@
+#pragma once
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef _WINSOCKAPI_
+#define _WINSOCKAPI_
+#endif
+
+#include <windows.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "match_history.h"
+
+enum RatingMode {
+    RATING_MODE_GLICKO2 = 0,
+    RATING_MODE_ELO = 1
+};
+
+struct RatingState {
+    double rating;
+    double deviation;   // RD (Glicko-2 only)
+    double volatility;  // sigma (Glicko-2 only)
+    uint32_t sets;
+};
+
+// One set outcome with players already resolved to table indices
+struct RatingResult {
+    uint32_t p1;
+    uint32_t p2;
+    float p1Score;      // 1 = P1 won, 0 = P2 won, 0.5 = draw
+};
+
+// Values published to the overlay for one side
+struct RatingSnapshot {
+    int rating = -1;    // -1 when the player has no rated sets
+    int deviation = -1;
+};
+
+// Live ratings keyed by sanitized nickname. Each update is appended to
+// overlay_assets/ratings.bin as a checksummed journal entry; a torn entry
+// at the end of the file (crash mid-write) is dropped on load.
+class RatingService {
+public:
+    static bool Initialize(const std::string& directory);
+    static void Shutdown();
+
+    static void RecordSet(const MatchRecord& record);
+    static RatingSnapshot GetRating(const std::string& nickname);
+
+    static RatingMode GetMode() { return mode; }
+    static bool SetMode(RatingMode newMode);
+
+    // Rebuild every rating from the match history and rewrite the journal
+    static bool RecomputeFromHistory();
+
+    // Pure batch update used by backfills and the benchmark
+    static void ApplyResults(const std::vector<RatingResult>& results, std::vector<RatingState>& table, RatingMode mode);
+    static RatingState InitialState();
+
+    // Recompute over a synthetic history, returns elapsed milliseconds
+    static double RunBenchmark(size_t matches, size_t playerCount);
+
+private:
+    static void UpdateGlicko2(RatingState& a, RatingState& b, double scoreA);
+    static void UpdateElo(RatingState& a, RatingState& b, double scoreA);
+    static double Glicko2Volatility(double phi, double sigma, double delta, double v);
+
+    static uint32_t InternPlayer(const std::string& nickname, bool journal);
+    static bool LoadJournal();
+    static bool WriteSnapshot();
+    static bool AppendEntry(uint8_t type, const void* payload, uint8_t length);
+    static bool AppendRating(uint32_t id);
+    static uint32_t Checksum(const uint8_t* data, size_t length);
+
+    static std::mutex mutex;
+    static bool initialized;
+    static RatingMode mode;
+    static std::string journalPath;
+    static HANDLE journalFile;
+    static uint32_t journalEntries;
+
+    static std::unordered_map<std::string, uint32_t> playerIds;
+    static std::vector<std::string> playerNames;
+    static std::vector<RatingState> ratings;
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "event_loop.h"
+
+// How the mod's threads share the CPU with the game. Loaded from
+// overlay_assets/scheduling.ini, which is written with defaults on first run:
+//
+//   [Scheduling]
+//   Enabled=1            ; 0 leaves every thread at OS defaults
+//   PinThreads=1         ; keep mod threads off the game thread's core
+//   GameCore=-1          ; -1 = detect from the game thread's ideal processor
+//   Priority=below_normal ; normal | below_normal | lowest | idle
+//   BackgroundTasks=1    ; run non-critical tasks in background mode (low CPU and I/O priority)
+//
+//   [Sampling]
+//   Mode=timer           ; timer | frame (sample once per game frame on the game thread)
+//   FrameBudgetUs=200    ; capture time per frame before later frames are skipped
+//   MinFrameIntervalUs=12000 ; pump calls closer than this are one frame (EFZ runs at 60 fps)
+struct SchedulingConfig {
+    bool enabled = true;
+    bool pinThreads = true;
+    int gameCore = -1;
+    int priority = THREAD_PRIORITY_BELOW_NORMAL;
+    bool backgroundTasks = true;
+    bool frameSampling = false;
+    uint32_t frameBudgetUs = 200;
+    uint32_t minFrameIntervalUs = 12000;
+};
+
+class SchedulingPolicy {
+public:
+    struct Counters {
+        uint64_t wakeups;               // Event loop wakeups observed
+        uint64_t wakeupsOnGameCore;     // ...that ran on the game thread's core (could preempt it)
+        uint64_t migrations;            // Loop thread moved to another core between wakeups
+        uint64_t gameCoreChanges;       // Game thread's ideal processor changed
+        double gameThreadCpuPercent;    // Game thread CPU time (user + kernel) over wall time
+        double elapsedMs;
+    };
+
+    // Loads the config and applies it to the calling thread (the event loop)
+    static void Initialize(const std::string& directory);
+    static void Shutdown();
+
+    // Any thread; threads other than the loop re-apply when GetGameCore() changes
+    static void ApplyToCurrentThread();
+    static int GetGameCore() { return gameCore.load(std::memory_order_relaxed); }
+    static DWORD GetGameThreadId() { return gameThreadId; }
+    static const SchedulingConfig& GetConfig() { return config; }
+
+    // Loop thread only
+    static Counters GetCounters();
+    static void ResetCounters();
+
+private:
+    static void LoadConfig(const std::string& path);
+    static DWORD FindGameThread();
+    static int DetectGameCore();
+    static DWORD_PTR ModThreadMask();
+    static void OnWakeup(void* context);
+    static void OnRecheckTimer(void* context);
+
+    static SchedulingConfig config;
+    static DWORD gameThreadId;
+    static HANDLE gameThread;
+    static std::atomic<int> gameCore;   // Written on the loop thread, read by other mod threads
+    static LoopTimer recheckTimer;
+    static const uint32_t RECHECK_INTERVAL_MS = 5000;
+
+    static Counters counters;
+    static DWORD lastProcessor;
+    static uint64_t resetTick;
+    static uint64_t gameCpuAtReset;     // 100 ns units
+    static uint64_t GetGameThreadCpuTime();
+};
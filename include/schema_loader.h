@@ -0,0 +1,59 @@
+#pragma once
+#include <windows.h>
+#include <map>
+#include <memory>
+#include <string>
+#include "event_loop.h"
+#include "offset_schema.h"
+
+// Owns the active ReadPlan. Loads overlay_assets/offsets.json (written from
+// the built-in offsets on first run), compiles the layout matching the
+// loaded modules and swaps the plan in atomically. Edits to the file are
+// picked up through a directory change notification on the event loop;
+// a file that fails to compile leaves the current plan in place.
+//
+// Captures in flight when a plan is replaced still decode: the previous
+// plan stays reachable by ID until the next swap.
+//
+// Signature pointers are resolved by scanning the module mapped in this
+// process. Results (including misses) go to signature_cache.json keyed by
+// the module fingerprint and the signature, so a known build never rescans.
+class SchemaLoader {
+public:
+    // Loop thread
+    static bool Initialize(const std::string& directory);
+    static void Shutdown();
+    static bool Reload();           // Re-reads the file
+    static void Reselect();         // Recompiles for the modules loaded now (after a module change)
+
+    // Any thread; nullptr before Initialize
+    static std::shared_ptr<const ReadPlan> GetPlan();
+    // Current or previous plan with this ID, else nullptr
+    static std::shared_ptr<const ReadPlan> GetPlan(uint32_t id);
+
+    static const std::string& GetPath() { return path; }
+    static bool IsUsingFile() { return usingFile; }
+
+private:
+    class ModuleResolver;
+
+    static void LoadSignatureCache();
+    static void SaveSignatureCache();
+    static void ReadFingerprints(ModuleFingerprint fingerprints[SCHEMA_MODULE_COUNT]);
+    static bool CompileAndPublish(const std::string& text, const char* origin);
+    static void OnDirectoryChanged(void* context);
+    static void OnReloadTimer(void* context);
+
+    static std::string path;
+    static std::string text;                // Last document that compiled
+    static bool usingFile;
+    static FILETIME lastWriteTime;
+    static std::shared_ptr<const ReadPlan> current;
+    static std::shared_ptr<const ReadPlan> previous;
+    static LoopWaitable directoryWatch;
+    static LoopTimer reloadTimer;
+    static std::string cachePath;
+    static std::map<std::string, int64_t> signatureCache;   // Key -> RVA, -1 when the scan failed
+    static bool cacheDirty;
+    static const uint32_t RELOAD_DELAY_MS = 250;   // Editors save in several writes
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <windows.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "canvas.h"
+#include "frame_share.h"
+#include "png_writer.h"
+#include "scoreboard_renderer.h"
+
+struct GameData;
+struct IWICImagingFactory;
+
+// One scoreboard.png in the overlay directory instead of a text source per
+// field, so OBS never shows half of an update. Laid out by
+// overlay_assets/scoreboard.json (written from the default on first run, see
+// ScoreboardRenderer), with fields p1./p2. nickname, character, wins,
+// rating, record, winrate, streak, plus h2h, and the p1./p2.portrait
+// images from the portraits folder (decoded once per character).
+//
+// Each published change re-renders only the dirty rects and, if any pixel
+// changed, encodes with PngWriter ("encoding" in the template) and replaces
+// the file in one step ("none" skips the file). The same frames also go
+// to the FRAME_SHARE_SCOREBOARD_NAME mapping as raw BGRA for a custom OBS
+// source, without encoding (see frame_share.h and tools/frame_reader.cpp).
+// WIC decodes the portraits. Loop thread only.
+class ScoreboardImage {
+public:
+    struct Stats {
+        ScoreboardRenderer::Stats renderer;
+        GlyphCache::Stats glyphs;
+        uint64_t images;            // Files written
+        double lastRenderUs;
+        double lastEncodeUs;
+        double lastWriteUs;         // Write and replace
+        size_t lastBytes;
+        const char* encoding;
+        FrameShareWriter::Stats frames;     // Shared memory output
+        bool shared;
+        CanvasRect lastDirty;
+        size_t portraits;           // Decoded and cached
+        bool ready;
+    };
+
+    static bool Initialize(const std::string& directory);
+    static void Shutdown();
+    // Process termination without Shutdown(): closes the shared frames only
+    static void Abandon();
+    static bool Reload();           // Re-reads scoreboard.json and its fonts, redraws
+
+    // After a published change; fields are the GameDelta bits that changed
+    static void Update(const GameData& data, uint32_t fields);
+
+    static Stats GetStats();
+    static const Canvas* GetCanvas();   // Last render, for benchmarks; nullptr when unavailable
+
+private:
+    static bool LoadTemplate();
+    static void OpenFrameShare();
+    static const Canvas* GetPortrait(int characterId);
+    static bool DecodeImage(const std::string& path, Canvas& image);
+    static bool WriteImage(const std::vector<uint8_t>& png);
+    static void Publish();
+
+    static IWICImagingFactory* factory;
+    static ScoreboardRenderer* renderer;
+    static std::string directory;
+    static std::string templatePath;
+    static std::string imagePath;
+    static std::unordered_map<int, Canvas> portraits;   // By character ID; empty canvas = no file
+    static PngWriter writer;
+    static PngWriter::Mode mode;
+    static bool writeFile;              // False for "encoding": "none"
+    static HANDLE frameMapping;
+    static void* frameView;
+    static FrameShareWriter* frameWriter;
+    static Stats stats;
+};
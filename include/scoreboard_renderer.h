@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "canvas.h"
+#include "glyph_cache.h"
+
+// One drawable of a scoreboard template, in drawing order
+struct ScoreboardElement {
+    enum Type { RECT, TEXT, IMAGE };
+    enum Align { ALIGN_LEFT, ALIGN_CENTER, ALIGN_RIGHT };
+
+    Type type;
+    CanvasRect rect;
+    uint32_t color;             // Premultiplied
+    std::string text;           // TEXT: literal text with {field} placeholders
+    std::string source;         // IMAGE: image slot name
+    int size;                   // TEXT: pixel height; shrunk to fit the width
+    Align align;
+
+    // What was drawn last; a different key makes the rect dirty
+    std::string key;
+    bool drawn;
+    int fittedSize;
+    int textWidth;
+    Canvas scaled;              // IMAGE: source fitted into the rect
+    CanvasRect imageRect;
+};
+
+// Composites a scoreboard image from a JSON template:
+//
+//   { "width": 400, "height": 120, "background": "#00000000", "encoding": "fast",
+//     "fonts": ["C:/Windows/Fonts/arialbd.ttf", "C:/Windows/Fonts/msgothic.ttc"],
+//     "elements": [
+//       { "type": "rect",  "x": 0, "y": 0, "w": 400, "h": 120, "color": "#C0101820" },
+//       { "type": "image", "source": "p1.portrait", "x": 4, "y": 4, "w": 80, "h": 112 },
+//       { "type": "text",  "text": "{p1.nickname}", "x": 90, "y": 8, "w": 120, "h": 30,
+//         "size": 24, "color": "#FFFFFFFF", "align": "left" } ] }
+//
+// Colours are #RRGGBB or #AARRGGBB. Text and image elements are keyed by
+// what they show; Render() redraws only the rects whose key changed (plus
+// whatever overlaps them, in template order) and reports the area it
+// touched. The fonts list is read by the owner and loaded into GetGlyphs();
+// "encoding" (default "fast") is passed through for whoever writes the image.
+//
+// No Windows dependencies.
+class ScoreboardRenderer {
+public:
+    struct Stats {
+        uint64_t renders;           // Render() calls that drew something
+        uint64_t skipped;           // ...that found nothing changed
+        uint64_t pixelsDrawn;       // Dirty area summed over renders
+        uint64_t fullRedraws;
+    };
+
+    ScoreboardRenderer();
+
+    bool LoadTemplate(const std::string& text, std::string& error);
+    const std::vector<std::string>& GetFontPaths() const { return fontPaths; }
+    GlyphCache& GetGlyphs() { return glyphs; }
+    const std::string& GetEncoding() const { return encoding; }
+
+    // Value for {name} placeholders
+    void SetField(const std::string& name, const std::string& value);
+    // Image for a slot; id must change whenever the pixels do (0 = no image).
+    // The caller keeps the canvas alive while it is set.
+    void SetImage(const std::string& name, const Canvas* image, uint64_t id);
+
+    // Redraws what changed; returns the area drawn (empty when nothing did)
+    CanvasRect Render();
+    void Invalidate() { fullRedraw = true; }
+    const Canvas& GetCanvas() const { return canvas; }
+    Stats GetStats() const { return stats; }
+
+    static std::string DefaultTemplate();
+
+    // Template parsing, dirty tracking and incremental against full
+    // redraws, without fonts. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+
+private:
+    struct ImageSlot {
+        const Canvas* image;
+        uint64_t id;
+    };
+
+    std::string Substitute(const std::string& text) const;
+    std::string KeyOf(const ScoreboardElement& element) const;
+    void Prepare(ScoreboardElement& element);
+    void Draw(ScoreboardElement& element, const CanvasRect& clip);
+    static void AddDirty(std::vector<CanvasRect>& dirty, CanvasRect rect);
+
+    Canvas canvas;
+    uint32_t background;
+    std::vector<ScoreboardElement> elements;
+    std::vector<std::string> fontPaths;
+    std::string encoding;
+    std::unordered_map<std::string, std::string> fields;
+    std::unordered_map<std::string, ImageSlot> images;
+    std::vector<CanvasRect> dirty;
+    GlyphCache glyphs;
+    bool fullRedraw;
+    Stats stats;
+};
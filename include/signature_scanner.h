@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Byte pattern with wildcards, written "8B 0D ?? ?? ?? ?? 8B 81 C8 04 00 00"
+struct BytePattern {
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> mask;      // 0xFF where the byte must match, 0x00 for ??
+    size_t first;                   // First and last fixed bytes: the SIMD filter
+    size_t last;
+
+    static bool Parse(const std::string& text, BytePattern& pattern, std::string& error);
+};
+
+enum OperandKind {
+    OPERAND_ABSOLUTE = 0,           // 32-bit address (mov ecx, [global])
+    OPERAND_RELATIVE                // rel32 from the end of the operand (call/jmp)
+};
+
+// An instruction signature and which 32-bit operand in it refers to the global
+struct SignatureSpec {
+    std::string pattern;
+    uint32_t operand;               // Byte offset of the operand within the match
+    OperandKind kind;
+};
+
+struct ImageRange {
+    uint32_t offset;
+    uint32_t size;
+};
+
+// Finds instruction signatures in PE images mapped in memory. Candidates are
+// filtered 32 (AVX2) or 16 (SSE2) positions at a time on the pattern's first
+// and last fixed bytes; only those are compared in full against the mask.
+class SignatureScanner {
+public:
+    static const size_t NOT_FOUND = (size_t)-1;
+
+    // Offset of the first match at or after start, NOT_FOUND if none
+    static size_t Find(const uint8_t* data, size_t size, const BytePattern& pattern, size_t start = 0);
+    // Byte-at-a-time reference, used to cross-check the SIMD paths
+    static size_t FindScalar(const uint8_t* data, size_t size, const BytePattern& pattern, size_t start = 0);
+
+    // Sections of a mapped PE image by kind, bounded by size
+    static bool GetSections(const uint8_t* image, size_t size, bool code, std::vector<ImageRange>& sections);
+
+    // Scans the code sections and returns the RVA the operand refers to.
+    // Fails when the pattern is missing, matches with different operands,
+    // or (absolute) the target is not inside a data section of the image.
+    static bool Resolve(const uint8_t* image, size_t imageSize, uint32_t imageBase, const SignatureSpec& spec,
+                        uint32_t& rva, std::string& error);
+
+    static const char* GetSimdLevel();  // "AVX2", "SSE2" or "scalar"
+
+    // Synthetic images with planted signatures, decoys and a minimal PE
+    // header. Empty failure on success.
+    static bool RunSelfTest(std::string& failure);
+
+    struct BenchmarkResult {
+        double megabytes;
+        double fastMs;                  // Full scan for a missing pattern
+        double scalarMs;
+        const char* level;
+    };
+    static BenchmarkResult RunBenchmark(size_t imageSize);
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-size single-producer/single-consumer ring. The producer fills a slot
+// in place and publishes it with Commit(); the consumer reads Front() and
+// releases it with Pop(). Neither side blocks or allocates. N must be a
+// power of two.
+template<typename T, size_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+    // Producer: slot to fill, or nullptr when the consumer has fallen N behind
+    T* ProducerSlot() {
+        uint32_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - headIndex.load(std::memory_order_acquire) >= N) {
+            return nullptr;
+        }
+        return &slots[tail & (N - 1)];
+    }
+    void Commit() {
+        tailIndex.store(tailIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer: oldest committed slot, or nullptr when empty
+    const T* Front() {
+        uint32_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailIndex.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &slots[head & (N - 1)];
+    }
+    void Pop() {
+        headIndex.store(headIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Approximate from either side
+    size_t Size() const {
+        return tailIndex.load(std::memory_order_acquire) - headIndex.load(std::memory_order_acquire);
+    }
+
+private:
+    T slots[N];
+    // Separate cache lines so producer and consumer do not contend
+    alignas(64) std::atomic<uint32_t> headIndex{0};
+    alignas(64) std::atomic<uint32_t> tailIndex{0};
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// UTF-16 -> UTF-8 conversion over a fixed-width char16_t view, so the result
+// does not depend on the platform's wchar_t. Runs of ASCII are converted 16
+// units at a time with SSE2. Unpaired surrogates become U+FFFD instead of
+// throwing.
+class Utf16Transcoder {
+public:
+    // Worst case output per input unit (a BMP unit or lone surrogate; pairs need 4 bytes for 2 units)
+    static const size_t MAX_UTF8_PER_UNIT = 3;
+
+    // Writes at most capacity bytes, stopping before a code point that would not
+    // fit. Returns the number of bytes written; output is not NUL-terminated.
+    static size_t ToUtf8(const char16_t* input, size_t length, char* output, size_t capacity);
+    static std::string ToUtf8(const char16_t* input, size_t length);
+    static std::string ToUtf8(const std::u16string& input);
+
+    // Unit-at-a-time reference implementation, used to cross-check the fast path
+    static size_t ToUtf8Scalar(const char16_t* input, size_t length, char* output, size_t capacity);
+
+    // Randomized comparison of the fast path against the scalar path and, on
+    // Windows, the OS converter. Returns false and describes the first
+    // mismatch in failure.
+    static bool RunFuzzTest(size_t iterations, std::string& failure);
+
+    // Converts a synthetic buffer repeatedly, returns input throughput in MB/s
+    struct BenchmarkResult {
+        double fastMBps;
+        double scalarMBps;
+        double systemMBps;          // 0 without an OS converter (not Windows)
+    };
+    static BenchmarkResult RunBenchmark(size_t units, bool asciiOnly);
+
+private:
+    static size_t EncodeOne(const char16_t* input, size_t length, size_t& index, char* output, size_t remaining);
+};
@@ -0,0 +1,85 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "frame_share.h"
+#include "overlay_widgets.h"
+#include "png_writer.h"
+
+struct GameData;
+struct ComboSample;
+
+// Animated overlay widgets (see OverlayWidgets) published like the
+// scoreboard: raw BGRA to the FRAME_SHARE_WIDGETS_NAME mapping and, if an
+// encoding is set, widgets.png in the overlay directory. Configured by
+// widgets.ini (written with defaults on first run): size, font, frame rate,
+// full HP, ticker speed and the PNG encoding. The default "none" skips the
+// file, since the scrolling ticker changes a pixel on every frame.
+//
+// A render thread at FrameRate, under the SchedulingPolicy, does the layout, rasterizing, encoding and
+// file replace, and publishes only frames where a pixel changed. The loop
+// thread only copies values into the shared WidgetState under a lock, so
+// a slow frame never delays sampling.
+class WidgetImage {
+public:
+    struct Stats {
+        OverlayWidgets::Stats widgets;
+        FrameShareWriter::Stats frames;     // Shared memory output
+        uint64_t images;            // Files written
+        double lastEncodeUs;
+        double lastWriteUs;         // Write and replace
+        size_t lastBytes;
+        CanvasRect lastDirty;
+        const char* encoding;
+        int frameRate;
+        bool shared;
+        bool ready;
+    };
+
+    static bool Initialize(const std::string& directory);
+    // Loop thread, before the process exits: stops the render thread
+    static void Shutdown();
+    // Process termination without Shutdown(): closes the shared frames only
+    static void Abandon();
+
+    // Loop thread. After a published change; fields are the GameDelta bits
+    // that changed
+    static void Update(const GameData& data, uint32_t fields);
+    // Every sampled frame, for the health bars
+    static void OnFrame(const ComboSample& sample);
+
+    static Stats GetStats();
+    // The configured layout, rendered by a private instance
+    static OverlayWidgets::BenchmarkResult RunBenchmark(int rounds);
+
+private:
+    static void LoadConfig(const std::string& path);
+    static void OpenFrameShare();
+    static DWORD WINAPI RenderThreadProc(LPVOID parameter);
+    static void RenderFrame(PngWriter& writer);
+    static bool WriteImage(const std::vector<uint8_t>& png);
+
+    static OverlayWidgets::Config config;
+    static OverlayWidgets* widgets;     // Render thread only once it runs
+    static bool enabled;
+    static int frameRate;
+    static PngWriter::Mode mode;
+    static bool writeFile;              // False for Encoding=none
+    static std::string imagePath;
+    static std::string headToHead;      // Ticker part, refreshed with the players
+    static HANDLE frameMapping;
+    static void* frameView;
+    static FrameShareWriter* frameWriter;
+    static HANDLE wakeEvent;
+    static HANDLE renderThread;
+    static std::atomic<bool> stopping;
+
+    // Shared with the render thread
+    static std::mutex lock;
+    static WidgetState state;
+    static int64_t stateUs;             // When state.clockSeconds was read
+    static Stats stats;
+};
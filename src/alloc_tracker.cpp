@@ -0,0 +1,44 @@
+#include "../include/alloc_tracker.h"
+#include <cstdlib>
+#include <new>
+
+#ifdef EFZ_ALLOC_TRACKING
+
+static thread_local size_t threadAllocations = 0;
+
+void* operator new(size_t size) {
+    threadAllocations++;
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+bool AllocTracker::IsEnabled() {
+    return true;
+}
+
+size_t AllocTracker::GetThreadAllocations() {
+    return threadAllocations;
+}
+
+#else
+
+bool AllocTracker::IsEnabled() {
+    return false;
+}
+
+size_t AllocTracker::GetThreadAllocations() {
+    return 0;
+}
+
+#endif
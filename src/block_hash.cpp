@@ -0,0 +1,69 @@
+#include "../include/block_hash.h"
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define EFZ_BLOCK_HASH_SSE2 1
+#endif
+
+// Two 64-bit lanes per 16-byte stripe, xxh3-style accumulation:
+//   acc[i] += data[i ^ 1] + lo32(data[i] ^ key[i]) * hi32(data[i] ^ key[i])
+// The key advances per stripe so reordered stripes hash differently.
+static const uint64_t KEY_LO = 0xBE4BA423396CFEB8ull;
+static const uint64_t KEY_HI = 0x1CAD21F72C81017Cull;
+static const uint64_t KEY_STEP = 0x9E3779B97F4A7C15ull;
+
+static inline uint64_t Mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline void AccumulateScalar(uint64_t acc[2], const uint8_t* stripe, uint64_t step) {
+    uint64_t data[2];
+    memcpy(data, stripe, sizeof(data));
+    uint64_t key0 = data[0] ^ (KEY_LO + step);
+    uint64_t key1 = data[1] ^ (KEY_HI + step);
+    acc[0] += data[1] + (key0 & 0xFFFFFFFFull) * (key0 >> 32);
+    acc[1] += data[0] + (key1 & 0xFFFFFFFFull) * (key1 >> 32);
+}
+
+uint64_t BlockHash::Hash(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t stripes = size / 16;
+    uint64_t acc[2] = { seed ^ 0x27D4EB2F165667C5ull, ~seed };
+    size_t i = 0;
+
+#ifdef EFZ_BLOCK_HASH_SSE2
+    __m128i accVec = _mm_set_epi32((int)(acc[1] >> 32), (int)acc[1], (int)(acc[0] >> 32), (int)acc[0]);
+    __m128i keyVec = _mm_set_epi32((int)(KEY_HI >> 32), (int)KEY_HI, (int)(KEY_LO >> 32), (int)KEY_LO);
+    const __m128i stepVec = _mm_set_epi32((int)(KEY_STEP >> 32), (int)KEY_STEP, (int)(KEY_STEP >> 32), (int)KEY_STEP);
+    for (; i < stripes; i++) {
+        __m128i dataVec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i * 16));
+        __m128i dataKey = _mm_xor_si128(dataVec, keyVec);
+        __m128i dataKeyHi = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128i product = _mm_mul_epu32(dataKey, dataKeyHi);
+        __m128i swapped = _mm_shuffle_epi32(dataVec, _MM_SHUFFLE(1, 0, 3, 2));
+        accVec = _mm_add_epi64(accVec, _mm_add_epi64(swapped, product));
+        keyVec = _mm_add_epi64(keyVec, stepVec);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(acc), accVec);
+#else
+    for (; i < stripes; i++) {
+        AccumulateScalar(acc, bytes + i * 16, KEY_STEP * i);
+    }
+#endif
+
+    // Zero-padded tail; the length is mixed in below so padding cannot collide
+    size_t tail = size - stripes * 16;
+    if (tail > 0) {
+        uint8_t last[16] = {};
+        memcpy(last, bytes + stripes * 16, tail);
+        AccumulateScalar(acc, last, KEY_STEP * stripes);
+    }
+
+    return Mix64(acc[0] ^ Mix64(acc[1] + size));
+}
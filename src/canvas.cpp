@@ -0,0 +1,334 @@
+#include "../include/canvas.h"
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define EFZ_CANVAS_SSE2 1
+#endif
+
+bool Canvas::forceScalar = false;
+
+CanvasRect CanvasRect::Intersect(const CanvasRect& other) const {
+    CanvasRect result = {std::max(x0, other.x0), std::max(y0, other.y0), std::min(x1, other.x1),
+                         std::min(y1, other.y1)};
+    return result.Empty() ? CanvasRect() : result;
+}
+
+CanvasRect CanvasRect::Union(const CanvasRect& other) const {
+    if (Empty()) {
+        return other;
+    }
+    if (other.Empty()) {
+        return *this;
+    }
+    return {std::min(x0, other.x0), std::min(y0, other.y0), std::max(x1, other.x1), std::max(y1, other.y1)};
+}
+
+void Canvas::Resize(int newWidth, int newHeight) {
+    width = newWidth > 0 ? newWidth : 0;
+    height = newHeight > 0 ? newHeight : 0;
+    pixels.assign((size_t)width * height, 0);
+}
+
+// round(x / 255) for x <= 255 * 255
+static inline uint32_t Div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+uint32_t Canvas::Premultiply(uint32_t argb) {
+    uint32_t alpha = argb >> 24;
+    uint32_t r = Div255(((argb >> 16) & 0xFF) * alpha);
+    uint32_t g = Div255(((argb >> 8) & 0xFF) * alpha);
+    uint32_t b = Div255((argb & 0xFF) * alpha);
+    return (alpha << 24) | (r << 16) | (g << 8) | b;
+}
+
+static inline uint32_t OverPixel(uint32_t src, uint32_t dst) {
+    uint32_t inverse = 255 - (src >> 24);
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t channel = ((src >> shift) & 0xFF) + Div255(((dst >> shift) & 0xFF) * inverse);
+        result |= channel << shift;
+    }
+    return result;
+}
+
+static inline uint32_t ScalePixel(uint32_t color, uint32_t coverage) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        result |= Div255(((color >> shift) & 0xFF) * coverage) << shift;
+    }
+    return result;
+}
+
+#ifdef EFZ_CANVAS_SSE2
+static inline __m128i Div255x8(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Two premultiplied pixels widened to 16 bits per channel
+static inline __m128i OverWide(__m128i src, __m128i dst) {
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+    return _mm_add_epi16(src, Div255x8(_mm_mullo_epi16(dst, inverse)));
+}
+
+static inline __m128i Over4(__m128i src, __m128i dst) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i low = OverWide(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(dst, zero));
+    __m128i high = OverWide(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(dst, zero));
+    return _mm_packus_epi16(low, high);
+}
+#endif
+
+static void OverRow(uint32_t* dst, const uint32_t* src, int count, bool simd) {
+    int x = 0;
+#ifdef EFZ_CANVAS_SSE2
+    if (simd) {
+        for (; x + 4 <= count; x += 4) {
+            __m128i s = _mm_loadu_si128((const __m128i*)(src + x));
+            __m128i d = _mm_loadu_si128((const __m128i*)(dst + x));
+            _mm_storeu_si128((__m128i*)(dst + x), Over4(s, d));
+        }
+    }
+#endif
+    for (; x < count; x++) {
+        dst[x] = OverPixel(src[x], dst[x]);
+    }
+}
+
+static void OverRowConstant(uint32_t* dst, uint32_t color, int count, bool simd) {
+    int x = 0;
+#ifdef EFZ_CANVAS_SSE2
+    if (simd) {
+        __m128i s = _mm_set1_epi32((int)color);
+        for (; x + 4 <= count; x += 4) {
+            __m128i d = _mm_loadu_si128((const __m128i*)(dst + x));
+            _mm_storeu_si128((__m128i*)(dst + x), Over4(s, d));
+        }
+    }
+#endif
+    for (; x < count; x++) {
+        dst[x] = OverPixel(color, dst[x]);
+    }
+}
+
+static void MaskRow(uint32_t* dst, const uint8_t* mask, uint32_t color, int count, bool simd) {
+    int x = 0;
+#ifdef EFZ_CANVAS_SSE2
+    if (simd) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i wideColor = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero);
+        for (; x + 4 <= count; x += 4) {
+            uint32_t coverage = (uint32_t)mask[x] | (uint32_t)mask[x + 1] << 8 | (uint32_t)mask[x + 2] << 16 |
+                                (uint32_t)mask[x + 3] << 24;
+            if (coverage == 0) {
+                continue;
+            }
+            // m0 m1 m2 m3 -> each coverage byte repeated over its pixel's four channels
+            __m128i m = _mm_cvtsi32_si128((int)coverage);
+            m = _mm_unpacklo_epi8(m, m);
+            m = _mm_unpacklo_epi16(m, m);
+            __m128i srcLow = Div255x8(_mm_mullo_epi16(wideColor, _mm_unpacklo_epi8(m, zero)));
+            __m128i srcHigh = Div255x8(_mm_mullo_epi16(wideColor, _mm_unpackhi_epi8(m, zero)));
+            __m128i d = _mm_loadu_si128((const __m128i*)(dst + x));
+            __m128i low = OverWide(srcLow, _mm_unpacklo_epi8(d, zero));
+            __m128i high = OverWide(srcHigh, _mm_unpackhi_epi8(d, zero));
+            _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(low, high));
+        }
+    }
+#endif
+    for (; x < count; x++) {
+        if (mask[x]) {
+            dst[x] = OverPixel(ScalePixel(color, mask[x]), dst[x]);
+        }
+    }
+}
+
+const char* Canvas::GetSimdLevel() {
+#ifdef EFZ_CANVAS_SSE2
+    return forceScalar ? "scalar" : "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+void Canvas::Fill(const CanvasRect& area, uint32_t color) {
+    CanvasRect clipped = area.Intersect(GetBounds());
+    for (int y = clipped.y0; y < clipped.y1; y++) {
+        std::fill(Row(y) + clipped.x0, Row(y) + clipped.x1, color);
+    }
+}
+
+void Canvas::FillBlend(const CanvasRect& area, uint32_t color) {
+    if ((color >> 24) == 255) {
+        Fill(area, color);
+        return;
+    }
+    CanvasRect clipped = area.Intersect(GetBounds());
+    for (int y = clipped.y0; y < clipped.y1; y++) {
+        OverRowConstant(Row(y) + clipped.x0, color, clipped.x1 - clipped.x0, !forceScalar);
+    }
+}
+
+void Canvas::BlendMask(int x, int y, const uint8_t* mask, int maskStride, int maskWidth, int maskHeight,
+                       uint32_t color, const CanvasRect& clip) {
+    CanvasRect area = CanvasRect::Make(x, y, maskWidth, maskHeight).Intersect(clip).Intersect(GetBounds());
+    for (int row = area.y0; row < area.y1; row++) {
+        const uint8_t* coverage = mask + (size_t)(row - y) * maskStride + (area.x0 - x);
+        MaskRow(Row(row) + area.x0, coverage, color, area.x1 - area.x0, !forceScalar);
+    }
+}
+
+void Canvas::BlendCanvas(int x, int y, const Canvas& source, const CanvasRect& clip) {
+    CanvasRect area =
+        CanvasRect::Make(x, y, source.width, source.height).Intersect(clip).Intersect(GetBounds());
+    for (int row = area.y0; row < area.y1; row++) {
+        OverRow(Row(row) + area.x0, source.Row(row - y) + (area.x0 - x), area.x1 - area.x0, !forceScalar);
+    }
+}
+
+// 16.16 fixed point, sampling pixel centres; the horizontal taps are the
+// same for every row and worked out once
+void Canvas::ScaleFrom(const Canvas& source) {
+    if (source.width == 0 || source.height == 0) {
+        std::fill(pixels.begin(), pixels.end(), 0);
+        return;
+    }
+    struct Tap {
+        int x0, x1;
+        uint32_t fraction;
+    };
+    std::vector<Tap> taps(width);
+    int64_t stepX = ((int64_t)source.width << 16) / std::max(width, 1);
+    for (int x = 0; x < width; x++) {
+        int64_t sx = std::max<int64_t>(0, x * stepX + stepX / 2 - 32768);
+        taps[x].x0 = std::min((int)(sx >> 16), source.width - 1);
+        taps[x].x1 = std::min(taps[x].x0 + 1, source.width - 1);
+        taps[x].fraction = (uint32_t)(sx >> 8) & 0xFF;
+    }
+
+    int64_t stepY = ((int64_t)source.height << 16) / std::max(height, 1);
+    for (int y = 0; y < height; y++) {
+        int64_t sy = std::max<int64_t>(0, y * stepY + stepY / 2 - 32768);
+        int y0 = std::min((int)(sy >> 16), source.height - 1);
+        const uint32_t* top = source.Row(y0);
+        const uint32_t* bottom = source.Row(std::min(y0 + 1, source.height - 1));
+        uint32_t fy = (uint32_t)(sy >> 8) & 0xFF;
+        uint32_t* out = Row(y);
+        for (int x = 0; x < width; x++) {
+            const Tap& tap = taps[x];
+            uint32_t fx = tap.fraction;
+            uint32_t a = top[tap.x0], b = top[tap.x1], c = bottom[tap.x0], d = bottom[tap.x1];
+            uint32_t result = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                uint32_t upper = ((a >> shift) & 0xFF) * (256 - fx) + ((b >> shift) & 0xFF) * fx;
+                uint32_t lower = ((c >> shift) & 0xFF) * (256 - fx) + ((d >> shift) & 0xFF) * fx;
+                result |= ((upper * (256 - fy) + lower * fy + 32768) >> 16) << shift;
+            }
+            out[x] = result;
+        }
+    }
+}
+
+// Deterministic pseudo-random pixels for the self-test
+static uint32_t NextRandom(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state;
+}
+
+static Canvas RandomCanvas(int width, int height, uint32_t& state) {
+    Canvas canvas(width, height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            canvas.Row(y)[x] = Canvas::Premultiply(NextRandom(state));
+        }
+    }
+    return canvas;
+}
+
+static bool SamePixels(const Canvas& a, const Canvas& b) {
+    for (int y = 0; y < a.GetHeight(); y++) {
+        if (!std::equal(a.Row(y), a.Row(y) + a.GetWidth(), b.Row(y))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Canvas::RunSelfTest(std::string& failure) {
+    failure.clear();
+    bool wasScalar = forceScalar;
+
+    // The exact operator on a few known values
+    if (OverPixel(0x80400000, 0xFF0000FF) != 0xFF40007F || Premultiply(0x80FF8000) != 0x80804000 ||
+        OverPixel(0x00000000, 0x12345678) != 0x12345678 || OverPixel(0xFF102030, 0x12345678) != 0xFF102030) {
+        failure = "scalar over operator";
+        return false;
+    }
+
+    // Odd sizes so every SIMD loop has a tail, and clips cutting through each edge
+    uint32_t state = 12345;
+    Canvas base = RandomCanvas(37, 23, state);
+    Canvas source = RandomCanvas(13, 9, state);
+    std::vector<uint8_t> mask(11 * 7);
+    for (uint8_t& coverage : mask) {
+        uint32_t value = NextRandom(state) >> 24;
+        coverage = (uint8_t)(value < 64 ? 0 : value > 200 ? 255 : value);
+    }
+    const CanvasRect clips[] = {{0, 0, 37, 23}, {3, 2, 30, 20}, {-5, -5, 8, 6}, {30, 18, 60, 60}, {10, 10, 10, 20}};
+    const int positions[][2] = {{0, 0}, {-4, -3}, {30, 18}, {5, 7}, {36, 22}};
+
+    for (const CanvasRect& clip : clips) {
+        for (const auto& position : positions) {
+            Canvas results[2];
+            for (int pass = 0; pass < 2; pass++) {
+                forceScalar = pass == 1;
+                Canvas canvas = base;
+                canvas.FillBlend(CanvasRect::Make(position[0], position[1], 9, 5).Intersect(clip), 0x80402010);
+                canvas.BlendCanvas(position[0], position[1], source, clip);
+                canvas.BlendMask(position[0] + 1, position[1] + 2, mask.data(), 11, 11, 7, 0xC0C08040, clip);
+                results[pass] = canvas;
+            }
+            forceScalar = wasScalar;
+            if (!SamePixels(results[0], results[1])) {
+                failure = "SIMD and scalar blends differ at " + std::to_string(position[0]) + "," +
+                          std::to_string(position[1]) + " clip " + std::to_string(clip.x0) + "," +
+                          std::to_string(clip.y0) + "-" + std::to_string(clip.x1) + "," + std::to_string(clip.y1);
+                return false;
+            }
+            // Nothing outside the clip changes
+            for (int y = 0; y < base.GetHeight(); y++) {
+                for (int x = 0; x < base.GetWidth(); x++) {
+                    bool inside = x >= clip.x0 && x < clip.x1 && y >= clip.y0 && y < clip.y1;
+                    if (!inside && results[0].Row(y)[x] != base.Row(y)[x]) {
+                        failure = "blend wrote outside the clip at " + std::to_string(x) + "," + std::to_string(y);
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    // Opaque scaling of a flat image stays flat; a 2x2 checker averages out
+    Canvas flat(5, 3);
+    flat.Fill(flat.GetBounds(), 0xFF336699);
+    Canvas scaled(17, 11);
+    scaled.ScaleFrom(flat);
+    if (scaled.Row(5)[8] != 0xFF336699 || scaled.Row(0)[0] != 0xFF336699 || scaled.Row(10)[16] != 0xFF336699) {
+        failure = "scaling a flat image changed its colour";
+        return false;
+    }
+    Canvas checker(2, 2);
+    checker.Row(0)[0] = checker.Row(1)[1] = 0xFFFFFFFF;
+    checker.Row(0)[1] = checker.Row(1)[0] = 0xFF000000;
+    Canvas single(1, 1);
+    single.ScaleFrom(checker);
+    if (single.Row(0)[0] != 0xFF808080) {
+        failure = "2x2 checker scaled to " + std::to_string(single.Row(0)[0]);
+        return false;
+    }
+    return true;
+}
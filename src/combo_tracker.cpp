@@ -0,0 +1,232 @@
+#include "../include/combo_tracker.h"
+#include <cstring>
+
+static bool SameSide(const ComboSide& a, const ComboSide& b) {
+    return a.hits == b.hits && a.damage == b.damage && a.startFrame == b.startFrame && a.lastHits == b.lastHits &&
+           a.lastDamage == b.lastDamage && a.lastStartFrame == b.lastStartFrame && a.lastEndFrame == b.lastEndFrame &&
+           a.lastStartUs == b.lastStartUs && a.lastEndUs == b.lastEndUs && a.maxHits == b.maxHits &&
+           a.maxDamage == b.maxDamage && a.roundDamage == b.roundDamage;
+}
+
+bool ComboStats::operator==(const ComboStats& other) const {
+    return available == other.available && round == other.round && SameSide(side[0], other.side[0]) &&
+           SameSide(side[1], other.side[1]);
+}
+
+ComboTracker::ComboTracker() {
+    Reset();
+}
+
+void ComboTracker::Reset() {
+    memset(&stats, 0, sizeof(stats));
+    memset(defenders, 0, sizeof(defenders));
+    started = false;
+    matchEnded = false;
+}
+
+void ComboTracker::Finish(int attacker, const ComboSample& sample) {
+    ComboSide& side = stats.side[attacker];
+    side.lastHits = side.hits;
+    side.lastDamage = side.damage;
+    side.lastStartFrame = side.startFrame;
+    side.lastEndFrame = sample.frame;
+    side.lastStartUs = defenders[1 - attacker].startUs;
+    side.lastEndUs = sample.timestampUs;
+    side.maxHits = side.hits > side.maxHits ? side.hits : side.maxHits;
+    side.maxDamage = side.damage > side.maxDamage ? side.damage : side.maxDamage;
+    side.hits = 0;
+    side.damage = 0;
+    side.startFrame = 0;
+}
+
+void ComboTracker::StartRound() {
+    if (matchEnded) {
+        matchEnded = false;
+        stats.round = 0;
+        for (ComboSide& side : stats.side) {
+            side.maxHits = 0;
+            side.maxDamage = 0;
+        }
+    }
+    stats.round++;
+    for (ComboSide& side : stats.side) {
+        side.roundDamage = 0;
+    }
+}
+
+bool ComboTracker::Record(const ComboSample& sample) {
+    ComboStats before = stats;
+    stats.available = sample.hp[0] >= 0 && sample.hp[1] >= 0;
+
+    // Players gone (menus, loading): a combo in progress cannot be finished
+    if (!stats.available) {
+        for (ComboSide& side : stats.side) {
+            side.hits = 0;
+            side.damage = 0;
+            side.startFrame = 0;
+        }
+        started = false;
+        return stats != before;
+    }
+
+    // First frame with players, or a bar refilled: a round starts
+    bool refilled = started && (sample.hp[0] >= defenders[0].lastHp + ROUND_REFILL_HP ||
+                                sample.hp[1] >= defenders[1].lastHp + ROUND_REFILL_HP);
+    if (!started || refilled) {
+        for (int attacker = 0; attacker < 2; attacker++) {
+            if (stats.side[attacker].hits > 0) {
+                Finish(attacker, sample);
+            }
+        }
+        StartRound();
+        for (int player = 0; player < 2; player++) {
+            defenders[player].lastHp = sample.hp[player];
+            defenders[player].lastHitstun = sample.hitstun[player];
+        }
+        started = true;
+        return stats != before;
+    }
+
+    for (int defender = 0; defender < 2; defender++) {
+        Defender& state = defenders[defender];
+        ComboSide& side = stats.side[1 - defender];
+        int32_t lost = state.lastHp - sample.hp[defender];
+        lost = lost > 0 ? lost : 0;
+        bool hitstunKnown = sample.hitstun[defender] >= 0;
+        bool inHitstun = sample.hitstun[defender] > 0;
+
+        side.roundDamage += lost;
+        if (lost > 0 && (inHitstun || !hitstunKnown)) {
+            if (side.hits == 0) {
+                side.startFrame = sample.frame;
+                state.startUs = sample.timestampUs;
+            }
+            side.hits++;
+            side.damage += lost;
+            state.lastHitFrame = sample.frame;
+        } else if (side.hits > 0) {
+            bool over = hitstunKnown ? !inHitstun : sample.frame - state.lastHitFrame > COMBO_TIMEOUT_FRAMES;
+            if (over) {
+                Finish(1 - defender, sample);
+            }
+        }
+        state.lastHp = sample.hp[defender];
+        state.lastHitstun = sample.hitstun[defender];
+    }
+    return stats != before;
+}
+
+// Scripted frames for the self-test: HP and hitstun per player
+static ComboSample Frame(uint32_t frame, int32_t hp1, int32_t hitstun1, int32_t hp2, int32_t hitstun2) {
+    ComboSample sample;
+    sample.frame = frame;
+    sample.timestampUs = (uint64_t)frame * 16667;
+    sample.hp[0] = hp1;
+    sample.hp[1] = hp2;
+    sample.hitstun[0] = hitstun1;
+    sample.hitstun[1] = hitstun2;
+    return sample;
+}
+
+bool ComboTracker::RunSelfTest(std::string& failure) {
+    failure.clear();
+    ComboTracker tracker;
+    const ComboStats& stats = tracker.GetStats();
+    const ComboSide& p1 = stats.side[0];
+    const ComboSide& p2 = stats.side[1];
+
+    tracker.Record(Frame(0, 10000, 0, 10000, 0));
+    if (!stats.available || stats.round != 1 || tracker.Record(Frame(1, 10000, 0, 10000, 0))) {
+        failure = "first frame did not start round 1, or an idle frame reported a change";
+        return false;
+    }
+
+    // Player 1 lands two hits, the second refreshing hitstun; the combo ends when it runs out
+    uint32_t frame = 10;
+    tracker.Record(Frame(frame++, 10000, 0, 9500, 20));
+    for (int32_t left = 19; left > 15; left--) {
+        tracker.Record(Frame(frame++, 10000, 0, 9500, left));
+    }
+    tracker.Record(Frame(frame++, 10000, 0, 9200, 20));
+    if (p1.hits != 2 || p1.damage != 800 || p1.startFrame != 10) {
+        failure = "combo in progress: " + std::to_string(p1.hits) + " hits, " + std::to_string(p1.damage) + " damage";
+        return false;
+    }
+    for (int32_t left = 19; left >= 0; left--) {
+        tracker.Record(Frame(frame++, 10000, 0, 9200, left));
+    }
+    if (p1.hits != 0 || p1.lastHits != 2 || p1.lastDamage != 800 || p1.lastStartFrame != 10 ||
+        p1.lastEndFrame != frame - 1 || p1.lastStartUs != 10 * 16667 || p1.lastEndUs != (uint64_t)(frame - 1) * 16667 ||
+        p1.maxHits != 2 || p1.maxDamage != 800 || p1.roundDamage != 800) {
+        failure = "finished combo: " + std::to_string(p1.lastHits) + " hits, " + std::to_string(p1.lastDamage) +
+                  " damage, frames " + std::to_string(p1.lastStartFrame) + "-" + std::to_string(p1.lastEndFrame);
+        return false;
+    }
+
+    // Chip damage counts for the round only
+    tracker.Record(Frame(frame++, 9950, 0, 9200, 0));
+    if (p2.hits != 0 || p2.lastHits != 0 || p2.roundDamage != 50) {
+        failure = "chip damage started a combo";
+        return false;
+    }
+
+    // A longer but weaker combo raises the hit maximum only
+    int32_t hp = 9950;
+    for (int hit = 0; hit < 5; hit++) {
+        hp -= 100;
+        tracker.Record(Frame(frame++, hp, 10, 9200, 0));
+    }
+    tracker.Record(Frame(frame++, hp, 0, 9200, 0));
+    if (p2.lastHits != 5 || p2.lastDamage != 500 || p2.maxHits != 5 || p2.maxDamage != 500 || p1.maxDamage != 800) {
+        failure = "second combo: " + std::to_string(p2.lastHits) + " hits, max " + std::to_string(p2.maxHits);
+        return false;
+    }
+
+    // A combo cut short by the round ending is finished; the refill starts round 2
+    tracker.Record(Frame(frame++, hp, 0, 200, 30));
+    tracker.Record(Frame(frame++, 10000, 0, 10000, 0));
+    if (stats.round != 2 || p1.roundDamage != 0 || p1.lastHits != 1 || p1.lastDamage != 9000 ||
+        p1.maxDamage != 9000 || p2.maxHits != 5) {
+        failure = "round reset: round " + std::to_string(stats.round) + ", last " + std::to_string(p1.lastDamage);
+        return false;
+    }
+
+    // Maxima stay up after the game is decided until the next round begins;
+    // a combo the refill cuts short belongs to the old match
+    tracker.EndMatch();
+    tracker.Record(Frame(frame++, 10000, 0, 9000, 5));
+    if (p1.maxDamage != 9000 || stats.round != 2) {
+        failure = "match end cleared the maxima early";
+        return false;
+    }
+    tracker.Record(Frame(frame++, 10000, 0, 10000, 0));
+    if (stats.round != 1 || p1.lastDamage != 1000 || p1.maxHits != 0 || p1.maxDamage != 0 || p2.maxHits != 0) {
+        failure = "new match: round " + std::to_string(stats.round) + ", max " + std::to_string(p1.maxDamage);
+        return false;
+    }
+
+    // Without a hitstun field a combo ends after a run of frames without damage
+    tracker.Record(Frame(frame++, 10000, -1, 9700, -1));
+    tracker.Record(Frame(frame++, 10000, -1, 9400, -1));
+    for (uint32_t i = 0; i < COMBO_TIMEOUT_FRAMES; i++) {
+        tracker.Record(Frame(frame++, 10000, -1, 9400, -1));
+    }
+    if (p1.hits != 2) {
+        failure = "timeout combo ended early";
+        return false;
+    }
+    tracker.Record(Frame(frame++, 10000, -1, 9400, -1));
+    if (p1.hits != 0 || p1.lastHits != 2 || p1.lastDamage != 600) {
+        failure = "timeout combo did not end";
+        return false;
+    }
+
+    // Players unreadable: unavailable, and a combo in progress is dropped
+    tracker.Record(Frame(frame++, 10000, 0, 9000, 10));
+    tracker.Record(Frame(frame++, -1, -1, -1, -1));
+    if (stats.available || p1.hits != 0 || p1.lastDamage != 600) {
+        failure = "unreadable frame kept a combo going";
+        return false;
+    }
+    return true;
+}
@@ -2,9 +2,29 @@
 #include "../include/memory_reader.h"
 #include "../include/game_data.h"
 #include "../include/overlay_data.h"
+#include "../include/match_history.h"
+#include "../include/player_stats.h"
+#include "../include/rating_service.h"
+#include "../include/nickname_pool.h"
+#include "../include/alloc_tracker.h"
+#include "../include/utf_transcoder.h"
+#include "../include/nickname_sanitizer.h"
+#include "../include/module_monitor.h"
+#include "../include/event_loop.h"
+#include "../include/scheduling_policy.h"
+#include "../include/frame_hook.h"
+#include "../include/exit_hook.h"
+#include "../include/schema_loader.h"
+#include "../include/signature_scanner.h"
+#include "../include/input_display.h"
+#include "../include/highlight_log.h"
+#include "../include/scoreboard_image.h"
+#include "../include/widget_image.h"
 #include "../include/logger.h"
 #include "../include/constants.h"
 #include <thread>
+#include <atomic>
+#include <cstdio>
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -13,16 +33,54 @@
 // Extern declaration to get the DLL's base address
 EXTERN_C IMAGE_DOS_HEADER __ImageBase;
 
-// Forward declaration for ConsoleCommandThread
-DWORD WINAPI ConsoleCommandThread(LPVOID lpParam);
+// Global flag for DLL initialization status (set by the startup thread)
+std::atomic<bool> g_dllInitialized(false);
 
-// Global flag for DLL initialization status
-bool g_dllInitialized = false;
-bool g_consoleCommandThreadRunning = false;
-HANDLE g_consoleCommandThread = nullptr;
+// Set once ShutdownComponents has run; detach then has nothing left to do
+static std::atomic<bool> g_componentsShutDown(false);
+
+// How long the exiting thread waits for the shutdown on the loop thread
+static const DWORD SHUTDOWN_TIMEOUT_MS = 3000;
+static void ShutdownComponents(void* context);
+
+// Console input, read on the event loop
+static LoopWaitable g_consoleInput;
+static void StartConsoleInput();
+
+// QueryPerformanceCounter value taken on entry to DLL_PROCESS_ATTACH
+static LARGE_INTEGER g_attachTime = {};
+
+static double ElapsedMs(const LARGE_INTEGER& from, const LARGE_INTEGER& to) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (double)(to.QuadPart - from.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+}
+
+// Collects per-stage durations and logs them as one line at the end
+class StartupTimeline {
+public:
+    StartupTimeline() { QueryPerformanceCounter(&stageStart); }
+    
+    void Mark(const char* stage) {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        char entry[64];
+        snprintf(entry, sizeof(entry), "%s%s %.2f ms", breakdown.empty() ? "" : ", ", stage, ElapsedMs(stageStart, now));
+        breakdown += entry;
+        stageStart = now;
+    }
+    
+    const std::string& GetBreakdown() const { return breakdown; }
+    
+private:
+    LARGE_INTEGER stageStart;
+    std::string breakdown;
+};
 
 // Function to initialize all components
 bool InitializeComponents() {
+    StartupTimeline timeline;
+    
     // Initialize logging first, conditionally enabling the console
 #ifdef EFZ_ENABLE_CONSOLE
     Logger::Initialize("efz_streaming.log", Logger::LOG_DEBUG, true);
@@ -34,14 +92,12 @@ bool InitializeComponents() {
     
     // Enable filtering by default to reduce spam
     Logger::EnableMemoryOperationFiltering(true);
+    timeline.Mark("logger");
     
-    // Start console command thread
-    if (Logger::HasConsole()) {
-        g_consoleCommandThreadRunning = true;
-        g_consoleCommandThread = CreateThread(nullptr, 0, ConsoleCommandThread, nullptr, 0, nullptr);
-        if (!g_consoleCommandThread) {
-            Logger::Warning("Failed to start console command thread");
-        }
+    // Every periodic task registers with the loop, which runs on this thread
+    if (!EventLoop::Initialize()) {
+        Logger::Error("Failed to initialize event loop - aborting");
+        return false;
     }
     
     // Initialize components with error handling
@@ -49,15 +105,17 @@ bool InitializeComponents() {
         Logger::Error("Failed to initialize memory reader - aborting");
         return false;
     }
+    timeline.Mark("memory reader");
     
     // Continue with initialization even if EfzRevival.dll isn't available yet
-    // It will be detected later by the background thread
+    // It will be detected later by the module monitor
     
     if (!GameDataManager::Initialize()) {
         Logger::Error("Failed to initialize game data manager - aborting");
         MemoryReader::Shutdown(); // Cleanup already initialized components
         return false;
     }
+    timeline.Mark("game data");
     
     if (!OverlayData::Initialize()) {
         Logger::Error("Failed to initialize overlay data - aborting");
@@ -65,163 +123,820 @@ bool InitializeComponents() {
         MemoryReader::Shutdown();
         return false;
     }
+    timeline.Mark("overlay files");
+    
+    // Offsets come from overlay_assets/offsets.json; nothing is sampled before the plan exists
+    SchemaLoader::Initialize(OverlayData::GetOutputDirectory());
+    timeline.Mark("offset schema");
+    
+    // Works without the shared mapping; only other processes lose the ring
+    InputDisplay::Initialize(OverlayData::GetOutputDirectory());
+    timeline.Mark("input display");
+    
+    // VOD markers; the files are only appended to, never rewritten
+    HighlightLog::Initialize(OverlayData::GetOutputDirectory());
+    timeline.Mark("highlights");
+    
+    // Composited scoreboard; the text files keep working without it
+    ScoreboardImage::Initialize(OverlayData::GetOutputDirectory());
+    timeline.Mark("scoreboard");
+    
+    // Match history is optional - the overlay still works without it
+    if (MatchHistory::Initialize(OverlayData::GetOutputDirectory())) {
+        PlayerStats::Initialize();
+        if (!RatingService::Initialize(OverlayData::GetOutputDirectory())) {
+            Logger::Warning("Rating service unavailable - ratings will not be updated");
+        }
+    } else {
+        Logger::Warning("Match history unavailable - sets will not be recorded");
+    }
+    timeline.Mark("history/ratings");
+    
+    // Priority and affinity of this thread, which goes on to run the event loop
+    SchedulingPolicy::Initialize(OverlayData::GetOutputDirectory());
+    timeline.Mark("scheduling");
+    
+    // Animated widgets on their own render thread, which takes the policy above
+    WidgetImage::Initialize(OverlayData::GetOutputDirectory());
+    timeline.Mark("widgets");
+    
+    // Optional: sample on the game thread once per frame instead of on a timer
+    const SchedulingConfig& sampling = SchedulingPolicy::GetConfig();
+    if (sampling.frameSampling) {
+        FrameHook::Install(sampling.frameBudgetUs, sampling.minFrameIntervalUs);
+        timeline.Mark("frame hook");
+    }
+    
+    if (Logger::HasConsole()) {
+        StartConsoleInput();
+    }
+    
+    // Shut down on the loop thread while the game's threads are still alive
+    ExitHook::Install(ShutdownComponents, nullptr, SHUTDOWN_TIMEOUT_MS);
+    timeline.Mark("exit hook");
     
     Logger::Info("All components initialized successfully");
+    Logger::Info("Startup timing: " + timeline.GetBreakdown());
     return true;
 }
 
-// Function to clean up all components in reverse order
-void CleanupComponents() {
-    Logger::Info("======== EFZ Streaming Overlay DLL Unloading ========");
+// Runs the real initialization once DllMain has returned. A new thread has
+// to take the loader lock before it reaches its start routine, so this
+// cannot start until the game's loader has released it.
+DWORD WINAPI StartupThreadProc(LPVOID lpParam) {
+    LARGE_INTEGER workerStart;
+    QueryPerformanceCounter(&workerStart);
     
-    // Stop command thread
-    if (g_consoleCommandThread != nullptr) {
-        g_consoleCommandThreadRunning = false;
-        
-        // Give the thread time to exit
-        WaitForSingleObject(g_consoleCommandThread, 1000);
-        CloseHandle(g_consoleCommandThread);
-        g_consoleCommandThread = nullptr;
+    // Keep the DLL mapped until the process exits. Detach then only ever
+    // happens at process termination, when our threads are already gone and
+    // never have to be joined under the loader lock.
+    HMODULE self = nullptr;
+    GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_PIN,
+                       (LPCSTR)&__ImageBase, &self);
+    
+    // Stay out of the way of the game's own boot
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+    
+    bool initialized = InitializeComponents();
+    g_dllInitialized = initialized;
+    
+    LARGE_INTEGER done;
+    QueryPerformanceCounter(&done);
+    Logger::Info("Startup " + std::string(initialized ? "finished" : "failed") + ": worker started " +
+                 std::to_string(ElapsedMs(g_attachTime, workerStart)) + " ms after attach, initialization took " +
+                 std::to_string(ElapsedMs(workerStart, done)) + " ms");
+    
+    // This thread now becomes the event loop and runs every task until the
+    // exit hook stops it
+    if (initialized) {
+        EventLoop::Run();
+        EventLoop::Shutdown();
     }
+    return 0;
+}
+
+// Cleans up all components in reverse order. Runs as the last task on the
+// event loop thread, posted by the exit hook while the game's threads are
+// still alive, so it may take locks and wait for the render thread.
+static void ShutdownComponents(void* context) {
+    Logger::Info("======== EFZ Streaming Overlay DLL Unloading ========");
+    
+    EventLoop::RemoveWaitable(&g_consoleInput);
     
     // Clean up in reverse order of initialization
+    FrameHook::Remove();
+    SchedulingPolicy::Shutdown();
+    InputDisplay::Shutdown();
+    SchemaLoader::Shutdown();
+    WidgetImage::Shutdown();
+    ScoreboardImage::Shutdown();
     OverlayData::Shutdown();
-    GameDataManager::Shutdown();
-    MemoryReader::Shutdown(); // This will also stop the module watcher thread
+    GameDataManager::Shutdown(); // Records the set in progress
+    HighlightLog::Shutdown();    // After the last set is marked
+    RatingService::Shutdown();
+    PlayerStats::Shutdown();
+    MatchHistory::Shutdown();
+    MemoryReader::Shutdown(); // This will also stop the module monitor
     
     // Shutdown logger last
     Logger::Info("All components shut down successfully");
     Logger::Shutdown();
+    
+    g_componentsShutDown = true;
+    EventLoop::Stop();
 }
 
-DWORD WINAPI ConsoleCommandThread(LPVOID lpParam) {
-    Logger::Info("Console command interface started - type 'help' for available commands");
+// Process termination without the orderly shutdown (the exit hook is
+// missing or timed out). Every other thread is gone and may have died
+// holding any lock, the heap's included, so this only tells frame readers
+// the source closed and releases kernel objects.
+static void ReleaseOnTermination() {
+    WidgetImage::Abandon();
+    ScoreboardImage::Abandon();
+    EventLoop::Shutdown();
+}
+
+// Runs one console command on the event loop thread
+static void ExecuteConsoleCommand(const std::string& input) {
+    // Convert to lowercase for case-insensitive commands
+    std::string cmd = input;
+    std::transform(cmd.begin(), cmd.end(), cmd.begin(), 
+           [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
     
-    while (g_consoleCommandThreadRunning) {
-        // Check if console exists
-        if (!Logger::HasConsole()) {
-            Sleep(1000);
-            continue;
-        }
-        
-        std::string input;
-        std::cout << "\n> ";
-        std::getline(std::cin, input);
-        
-        // Convert to lowercase for case-insensitive commands
-        std::string cmd = input;
-        std::transform(cmd.begin(), cmd.end(), cmd.begin(), 
-               [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
-        
-        if (cmd == "help") {
-            std::cout << "Available commands:\n";
-            std::cout << "  help          - Show this help\n";
-            std::cout << "  filter on     - Enable memory operation filtering (reduce spam)\n";
-            std::cout << "  filter off    - Disable memory operation filtering (show all reads)\n";
-            std::cout << "  debug chars   - Debug character detection\n";
-            std::cout << "  quit          - Exit the command interface\n";
-            std::cout << "  clear         - Clear the console\n";
-        } 
-        else if (cmd == "filter on") {
-            Logger::EnableMemoryOperationFiltering(true);
-        }
-        else if (cmd == "filter off") {
-            Logger::EnableMemoryOperationFiltering(false);
-        }
-        else if (cmd == "debug chars") {
-            // Debug character detection
-            std::cout << "---- Character Detection Debug ----\n";
+    if (cmd == "help") {
+        std::cout << "Available commands:\n";
+        std::cout << "  help          - Show this help\n";
+        std::cout << "  filter on     - Enable memory operation filtering (reduce spam)\n";
+        std::cout << "  filter off    - Disable memory operation filtering (show all reads)\n";
+        std::cout << "  debug chars   - Debug character detection\n";
+        std::cout << "  debug alloc   - Count heap allocations on the nickname read path\n";
+        std::cout << "  test nicknames - Check the nickname pool: stable IDs, bounded size, no allocation for pooled names\n";
+        std::cout << "  debug blocks  - Show how many ticks skipped decoding (no memory block changed)\n";
+        std::cout << "  delta [version] - Print the field delta since a version (default: previous)\n";
+        std::cout << "  schema        - Show the active offset layout, its blocks and fields\n";
+        std::cout << "  schema reload - Re-read offsets.json now\n";
+        std::cout << "  test schema   - Compile and decode built-in and sample schemas\n";
+        std::cout << "  debug layout  - Show the detected player/spectator layout and its confidence\n";
+        std::cout << "  test layout   - Classify simulated player, spectator and ambiguous sessions\n";
+        std::cout << "  debug netplay - Show ping, delay, rollback and spectator telemetry with histograms\n";
+        std::cout << "  test netplay  - Feed synthetic netplay sessions through the telemetry\n";
+        std::cout << "  debug combo   - Show combos, maxima and round damage per player\n";
+        std::cout << "  test combo    - Run scripted exchanges through the combo tracker\n";
+        std::cout << "  highlights start - Count highlight marker times from now (the stream just started)\n";
+        std::cout << "  debug highlights - Flush markers and show counts, pending bytes and the stream clock\n";
+        std::cout << "  test highlights  - Run scripted rounds and sets through the highlight detector\n";
+        std::cout << "  debug scoreboard  - Show scoreboard render and encode times, dirty area, glyph cache and shared frames\n";
+        std::cout << "  scoreboard reload - Re-read scoreboard.json and its fonts and redraw\n";
+        std::cout << "  test scoreboard   - Check blending, incremental redraws and PNG encoding (SIMD vs scalar), shared frames\n";
+        std::cout << "  bench scoreboard  - Time each PNG encoding of the current scoreboard against raw BGRA\n";
+        std::cout << "  debug widgets     - Show widget layout, raster and encode times, changed area and shared frames\n";
+        std::cout << "  test widgets      - Check the CPU rasterizer (fill rule, SIMD vs scalar, binning) and widget redraws\n";
+        std::cout << "  bench widgets     - Time layout and rasterizing of the widgets (SIMD/scalar, binned/unbinned)\n";
+        std::cout << "  debug inputs  - Show input capture counts, cost and the newest inputs (resets timings)\n";
+        std::cout << "  test inputs   - Encode, wrap and read back synthetic inputs\n";
+        std::cout << "  bench inputs  - Record a one hour replay and time the per-frame cost\n";
+        std::cout << "  test scanner  - Find planted signatures in synthetic images (SIMD vs scalar)\n";
+        std::cout << "  bench scanner - Time a full signature scan of an 8 MB image\n";
+        std::cout << "  debug loop    - Show event loop wakeups, timer lateness and busy time (resets counters)\n";
+        std::cout << "  debug sched   - Show game core, mod thread placement and preemption counters (resets counters)\n";
+        std::cout << "  debug frames  - Show frame sampling counts, skips and capture times (resets counters)\n";
+        std::cout << "  test frames   - Drive the frame sampler with a simulated clock\n";
+        std::cout << "  debug modules - Show watched module bases and how changes are detected\n";
+        std::cout << "  debug module reload - Simulate an EfzRevival.dll unload and reload\n";
+        std::cout << "  history       - Show head-to-head and recent sets for the current players\n";
+        std::cout << "  rating mode glicko|elo - Switch rating system (recomputes from history)\n";
+        std::cout << "  rating recompute - Rebuild all ratings from the match history\n";
+        std::cout << "  bench ratings - Time a rating recompute over 1M synthetic sets\n";
+        std::cout << "  test history  - Append, reopen and check the indexes of a temporary match log\n";
+        std::cout << "  bench history - Time head-to-head and recent-set queries over 100k synthetic sets\n";
+        std::cout << "  test utf      - Fuzz the UTF-16 to UTF-8 transcoder against the system converter\n";
+        std::cout << "  bench utf     - Measure transcoder throughput (ASCII and mixed text)\n";
+        std::cout << "  test sanitizer - Check nickname sanitizing against known names\n";
+        std::cout << "  bench sanitizer - Time nickname sanitizing over 1M names\n";
+        std::cout << "  quit          - Exit the command interface\n";
+        std::cout << "  clear         - Clear the console\n";
+    } 
+    else if (cmd == "filter on") {
+        Logger::EnableMemoryOperationFiltering(true);
+    }
+    else if (cmd == "filter off") {
+        Logger::EnableMemoryOperationFiltering(false);
+    }
+    else if (cmd == "debug chars") {
+        // Debug character detection
+        std::cout << "---- Character Detection Debug ----\n";
+        
+        // Show the memory addresses and pointers
+        DWORD baseAddr1 = (DWORD)MemoryReader::GetEFZModuleAddress() + EFZ_BASE_OFFSET_P1;
+        DWORD p1Addr = MemoryReader::ReadDWORD(baseAddr1);
+        
+        std::cout << "P1 Base: 0x" << std::hex << baseAddr1 
+                  << " -> P1 Pointer: 0x" << p1Addr << "\n";
+        
+        if (p1Addr == 0) {
+            std::cout << "P1 CHARACTER NOT SELECTED (null pointer)\n";
+        } else {
+            DWORD charNameAddr1 = p1Addr + CHARACTER_NAME_OFFSET;
+            std::cout << "P1 Char Name Addr: 0x" << charNameAddr1 << "\n";
             
-            // Show the memory addresses and pointers
-            DWORD baseAddr1 = (DWORD)MemoryReader::GetEFZModuleAddress() + EFZ_BASE_OFFSET_P1;
-            DWORD p1Addr = MemoryReader::ReadDWORD(baseAddr1);
+            // Force a cache-less read
+            bool originalCache = MemoryReader::IsCacheEnabled();
+            MemoryReader::EnableCache(false);
+            std::string rawName = MemoryReader::ReadString(charNameAddr1, 12);
+            MemoryReader::EnableCache(originalCache);
             
-            std::cout << "P1 Base: 0x" << std::hex << baseAddr1 
-                      << " -> P1 Pointer: 0x" << p1Addr << "\n";
+            std::cout << "P1 Direct memory read: '" << rawName << "'\n";
+            std::string p1Raw = MemoryReader::GetP1CharacterNameRaw();
+            std::cout << "P1 Raw Name: '" << p1Raw << "'\n";
             
-            if (p1Addr == 0) {
-                std::cout << "P1 CHARACTER NOT SELECTED (null pointer)\n";
-            } else {
-                DWORD charNameAddr1 = p1Addr + CHARACTER_NAME_OFFSET;
-                std::cout << "P1 Char Name Addr: 0x" << charNameAddr1 << "\n";
-                
-                // Force a cache-less read
-                bool originalCache = MemoryReader::IsCacheEnabled();
-                MemoryReader::EnableCache(false);
-                std::string rawName = MemoryReader::ReadString(charNameAddr1, 12);
-                MemoryReader::EnableCache(originalCache);
-                
-                std::cout << "P1 Direct memory read: '" << rawName << "'\n";
-                std::string p1Raw = MemoryReader::GetP1CharacterNameRaw();
-                std::cout << "P1 Raw Name: '" << p1Raw << "'\n";
-                
-                int p1Id = MemoryReader::GetP1CharacterID();
-                std::string p1Name = MemoryReader::GetP1CharacterName();
-                
-                std::cout << "P1 Character ID: " << std::dec << p1Id << "\n";
-                std::cout << "P1 Character Name: " << p1Name << "\n\n";
-            }
+            int p1Id = MemoryReader::GetP1CharacterID();
+            std::string p1Name = MemoryReader::GetP1CharacterName();
             
-            // Same for P2
-            DWORD baseAddr2 = (DWORD)MemoryReader::GetEFZModuleAddress() + EFZ_BASE_OFFSET_P2;
-            DWORD p2Addr = MemoryReader::ReadDWORD(baseAddr2);
+            std::cout << "P1 Character ID: " << std::dec << p1Id << "\n";
+            std::cout << "P1 Character Name: " << p1Name << "\n\n";
+        }
+        
+        // Same for P2
+        DWORD baseAddr2 = (DWORD)MemoryReader::GetEFZModuleAddress() + EFZ_BASE_OFFSET_P2;
+        DWORD p2Addr = MemoryReader::ReadDWORD(baseAddr2);
+        
+        std::cout << "P2 Base: 0x" << std::hex << baseAddr2 
+                  << " -> P2 Pointer: 0x" << p2Addr << "\n";
+        
+        if (p2Addr == 0) {
+            std::cout << "P2 CHARACTER NOT SELECTED (null pointer)\n";
+        } else {
+            DWORD charNameAddr2 = p2Addr + CHARACTER_NAME_OFFSET;
+            std::cout << "P2 Char Name Addr: 0x" << charNameAddr2 << "\n";
             
-            std::cout << "P2 Base: 0x" << std::hex << baseAddr2 
-                      << " -> P2 Pointer: 0x" << p2Addr << "\n";
+            // Force a cache-less read
+            bool originalCache = MemoryReader::IsCacheEnabled();
+            MemoryReader::EnableCache(false);
+            std::string rawName = MemoryReader::ReadString(charNameAddr2, 12);
+            MemoryReader::EnableCache(originalCache);
             
-            if (p2Addr == 0) {
-                std::cout << "P2 CHARACTER NOT SELECTED (null pointer)\n";
-            } else {
-                DWORD charNameAddr2 = p2Addr + CHARACTER_NAME_OFFSET;
-                std::cout << "P2 Char Name Addr: 0x" << charNameAddr2 << "\n";
-                
-                // Force a cache-less read
-                bool originalCache = MemoryReader::IsCacheEnabled();
-                MemoryReader::EnableCache(false);
-                std::string rawName = MemoryReader::ReadString(charNameAddr2, 12);
-                MemoryReader::EnableCache(originalCache);
-                
-                std::cout << "P2 Direct memory read: '" << rawName << "'\n";
-                std::string p2Raw = MemoryReader::GetP2CharacterNameRaw();
-                std::cout << "P2 Raw Name: '" << p2Raw << "'\n";
-                
-                int p2Id = MemoryReader::GetP2CharacterID();
-                std::string p2Name = MemoryReader::GetP2CharacterName();
-                
-                std::cout << "P2 Character ID: " << std::dec << p2Id << "\n";
-                std::cout << "P2 Character Name: " << p2Name << "\n";
-            }
+            std::cout << "P2 Direct memory read: '" << rawName << "'\n";
+            std::string p2Raw = MemoryReader::GetP2CharacterNameRaw();
+            std::cout << "P2 Raw Name: '" << p2Raw << "'\n";
             
-            std::cout << "--------------------------------\n";
+            int p2Id = MemoryReader::GetP2CharacterID();
+            std::string p2Name = MemoryReader::GetP2CharacterName();
+            
+            std::cout << "P2 Character ID: " << std::dec << p2Id << "\n";
+            std::cout << "P2 Character Name: " << p2Name << "\n";
+        }
+        
+        std::cout << "--------------------------------\n";
+    }
+    else if (cmd == "debug alloc") {
+        if (!AllocTracker::IsEnabled()) {
+            std::cout << "Allocation tracking is not compiled in (use a Debug build or configure with -DEFZ_ALLOC_TRACKING=ON)\n";
+            return;
+        }
+        
+        // Warm up: the first read may intern a new name
+        MemoryReader::GetP1NicknameId();
+        MemoryReader::GetP2NicknameId();
+        
+        const int iterations = 1000;
+        size_t before = AllocTracker::GetThreadAllocations();
+        for (int i = 0; i < iterations; i++) {
+            MemoryReader::GetP1NicknameId();
+            MemoryReader::GetP2NicknameId();
+        }
+        size_t allocations = AllocTracker::GetThreadAllocations() - before;
+        
+        std::cout << "Nickname reads: " << allocations << " allocations over " << iterations
+                  << " ticks (" << NicknamePool::Size() << " pooled names)\n";
+    }
+    else if (cmd == "test nicknames") {
+        std::string failure;
+        if (!AllocTracker::IsEnabled()) {
+            std::cout << "Allocation tracking is not compiled in; checking the pool without it\n";
+        }
+        if (NicknamePool::RunSelfTest(failure)) {
+            std::cout << "Nickname pool self-test passed (" << NicknamePool::Size() << "/" << NicknamePool::CAPACITY
+                      << " names pooled)\n";
+        } else {
+            std::cout << "Nickname pool self-test FAILED: " << failure << "\n";
+        }
+    }
+    else if (cmd == "debug blocks") {
+        uint64_t ticks = 0, skipped = 0;
+        GameDataManager::GetChangeDetectionStats(ticks, skipped);
+        double percent = ticks ? (double)skipped * 100.0 / (double)ticks : 0.0;
+        std::cout << "Sampled " << ticks << " ticks, " << skipped << " short-circuited (" << percent << "%)\n";
+    }
+    else if (cmd == "schema") {
+        std::shared_ptr<const ReadPlan> plan = SchemaLoader::GetPlan();
+        if (!plan) {
+            std::cout << "No offset schema loaded\n";
+        } else {
+            std::cout << "Layout '" << plan->layout << "' (plan " << plan->id << ") from "
+                      << (SchemaLoader::IsUsingFile() ? SchemaLoader::GetPath() : std::string("built-in offsets")) << "\n";
+            for (uint32_t i = 0; i < plan->blockCount; i++) {
+                const PlanBlock& block = plan->blocks[i];
+                std::cout << "  block " << block.name << ": " << OffsetSchema::GetModuleName(block.module);
+                for (uint32_t c = 0; c < block.chainLength; c++) {
+                    std::cout << (c == 0 ? "+" : " -> +") << Logger::FormatHex(block.chain[c]);
+                    if (c == 0 && block.scanned) {
+                        std::cout << " (signature)";
+                    }
+                }
+                std::cout << ", " << block.size << " bytes from +" << Logger::FormatHex(block.start) << "\n";
+            }
+            for (int f = 0; f < SCHEMA_FIELD_COUNT; f++) {
+                const PlanField& field = plan->fields[f];
+                std::cout << "  " << OffsetSchema::GetFieldName((SchemaField)f) << ": ";
+                if (!field.present) {
+                    std::cout << "not described\n";
+                    continue;
+                }
+                std::cout << OffsetSchema::GetTypeName(field.type);
+                for (uint32_t l = 0; l < field.locationCount; l++) {
+                    std::cout << (l == 0 ? " at " : ", else ") << plan->blocks[field.locations[l].block].name
+                              << "+" << Logger::FormatHex(field.locations[l].offset);
+                }
+                std::cout << "\n";
+            }
         }
-        else if (cmd == "clear") {
-            system("cls");
+    }
+    else if (cmd == "schema reload") {
+        std::cout << (SchemaLoader::Reload() ? "Offset schema reloaded\n" : "Reload failed - see the log; current plan kept\n");
+    }
+    else if (cmd == "test schema") {
+        std::string failure;
+        if (OffsetSchema::RunSelfTest(failure)) {
+            std::cout << "Offset schema self-test passed\n";
+        } else {
+            std::cout << "Offset schema self-test FAILED: " << failure << "\n";
+        }
+    }
+    else if (cmd == "debug layout") {
+        LayoutClassifier::Status status = MemoryReader::GetLayoutStatus();
+        std::cout << "Layout " << MemoryReader::GetLayoutName() << " ("
+                  << LayoutClassifier::GetStateName(status.state) << "), confidence "
+                  << (int)(status.confidence * 100.0f + 0.5f) << "%\n";
+        std::cout << status.sessions << " sessions, " << status.decisions << " decisions, " << status.switches
+                  << " switched through hysteresis\n";
+    }
+    else if (cmd == "test layout") {
+        std::string failure;
+        if (LayoutClassifier::RunSelfTest(failure)) {
+            std::cout << "Layout classifier self-test passed\n";
+        } else {
+            std::cout << "Layout classifier self-test FAILED: " << failure << "\n";
         }
-        else if (cmd == "quit") {
-            g_consoleCommandThreadRunning = false;
+    }
+    else if (cmd == "debug netplay") {
+        const NetplayTelemetry& telemetry = GameDataManager::GetNetplayTelemetry();
+        NetplayStats stats = telemetry.GetStats();
+        if (!stats.available) {
+            std::cout << "No netplay fields read in the last " << NetplayTelemetry::WINDOW_US / 1000000
+                      << " s (describe netplay.* in offsets.json)\n";
         }
-        else if (!cmd.empty()) {
-            std::cout << "Unknown command. Type 'help' for available commands.\n";
+        std::cout << "Ping " << stats.pingMs << " ms (p50 " << stats.pingP50Ms << ", p95 " << stats.pingP95Ms
+                  << ", max " << stats.pingMaxMs << "), delay " << stats.delayFrames << " frames, spectators "
+                  << stats.spectators << "\n";
+        std::cout << "Rollbacks " << stats.rollbacks << " total, " << stats.rollbacksPerSecond << "/s; resyncs "
+                  << stats.resyncs << "; " << telemetry.GetSampleCount() << " samples held\n";
+        std::cout << telemetry.HistogramsToJSON();
+    }
+    else if (cmd == "test netplay") {
+        std::string failure;
+        if (NetplayTelemetry::RunSelfTest(failure)) {
+            std::cout << "Netplay telemetry self-test passed\n";
+        } else {
+            std::cout << "Netplay telemetry self-test FAILED: " << failure << "\n";
         }
     }
+    else if (cmd == "debug combo") {
+        const ComboStats& combo = GameDataManager::GetCurrentData().combo;
+        if (!combo.available) {
+            std::cout << "HP not read - describe p1.hp and p2.hp (and p1.hitstun, p2.hitstun) in offsets.json\n";
+        }
+        std::cout << "Round " << combo.round << "\n";
+        for (int side = 0; side < 2; side++) {
+            const ComboSide& attacker = combo.side[side];
+            std::cout << "P" << side + 1 << ": " << attacker.hits << " hits / " << attacker.damage
+                      << " in progress; last " << attacker.lastHits << " hits / " << attacker.lastDamage << " (frames "
+                      << attacker.lastStartFrame << "-" << attacker.lastEndFrame << "); max " << attacker.maxHits
+                      << " hits, " << attacker.maxDamage << " damage; round damage " << attacker.roundDamage << "\n";
+        }
+    }
+    else if (cmd == "test combo") {
+        std::string failure;
+        if (ComboTracker::RunSelfTest(failure)) {
+            std::cout << "Combo tracker self-test passed\n";
+        } else {
+            std::cout << "Combo tracker self-test FAILED: " << failure << "\n";
+        }
+    }
+    else if (cmd == "highlights start") {
+        HighlightLog::MarkStreamStart();
+        std::cout << "Highlight markers now count from 0:00:00\n";
+    }
+    else if (cmd == "debug highlights") {
+        HighlightLog::Flush();
+        HighlightLog::Stats stats = HighlightLog::GetStats();
+        const HighlightConfig& config = HighlightLog::GetConfig();
+        std::cout << "Stream clock " << stats.streamSeconds << " s; " << stats.markers << " markers, "
+                  << stats.writes << " appends (" << stats.bytes << " bytes), " << stats.failedWrites << " failed, "
+                  << stats.pendingBytes << " bytes pending, " << stats.dropped << " dropped\n";
+        std::cout << "Long combo " << config.longComboHits << " hits or " << config.bigComboDamage
+                  << " damage; comeback " << config.comebackHp << " HP or " << config.comebackGames
+                  << " games; first to " << config.firstTo << "\n";
+    }
+    else if (cmd == "test highlights") {
+        std::string failure;
+        if (HighlightDetector::RunSelfTest(failure)) {
+            std::cout << "Highlight detector self-test passed\n";
+        } else {
+            std::cout << "Highlight detector self-test FAILED: " << failure << "\n";
+        }
+    }
+    else if (cmd == "debug scoreboard") {
+        ScoreboardImage::Stats stats = ScoreboardImage::GetStats();
+        if (!stats.ready) {
+            std::cout << "Scoreboard image not available - see the log\n";
+        }
+        std::cout << stats.images << " images written; last render " << stats.lastRenderUs << " us, "
+                  << (stats.encoding ? stats.encoding : "-") << " encode " << stats.lastEncodeUs << " us ("
+                  << stats.lastBytes << " bytes), write " << stats.lastWriteUs << " us, dirty "
+                  << stats.lastDirty.x1 - stats.lastDirty.x0 << "x" << stats.lastDirty.y1 - stats.lastDirty.y0
+                  << " at " << stats.lastDirty.x0 << "," << stats.lastDirty.y0 << "\n";
+        std::cout << "Renders " << stats.renderer.renders << " (" << stats.renderer.fullRedraws << " full), "
+                  << stats.renderer.skipped << " unchanged, " << stats.renderer.pixelsDrawn << " pixels drawn; "
+                  << stats.portraits << " portraits cached; blending " << Canvas::GetSimdLevel() << "\n";
+        std::cout << "Glyphs " << stats.glyphs.glyphs << " cached, " << stats.glyphs.hits << " hits, "
+                  << stats.glyphs.misses << " misses, " << stats.glyphs.flushes << " atlas flushes, "
+                  << stats.glyphs.atlasRowsUsed << "/" << GlyphCache::ATLAS_SIZE << " atlas rows\n";
+        std::cout << "Shared frames: " << (stats.shared ? FRAME_SHARE_SCOREBOARD_NAME : "not shared") << ", "
+                  << stats.frames.published << " published, " << stats.frames.bytesCopied << " bytes copied, "
+                  << stats.frames.tooLarge << " too large\n";
+    }
+    else if (cmd == "scoreboard reload") {
+        std::cout << (ScoreboardImage::Reload() ? "Scoreboard template reloaded\n"
+                                                : "Scoreboard template rejected or unavailable - see the log\n");
+    }
+    else if (cmd == "test scoreboard") {
+        std::string failure;
+        if (Canvas::RunSelfTest(failure) && ScoreboardRenderer::RunSelfTest(failure) &&
+            PngWriter::RunSelfTest(failure) && FrameShare::RunSelfTest(failure)) {
+            std::cout << "Scoreboard self-test passed\n";
+        } else {
+            std::cout << "Scoreboard self-test FAILED: " << failure << "\n";
+        }
+    }
+    else if (cmd == "bench scoreboard") {
+        const Canvas* canvas = ScoreboardImage::GetCanvas();
+        if (!canvas) {
+            std::cout << "Scoreboard image not available - see the log\n";
+        } else {
+            PngWriter::BenchmarkResult result = PngWriter::RunBenchmark(*canvas, 20);
+            std::cout << canvas->GetWidth() << "x" << canvas->GetHeight() << " scoreboard, best of 20 (" << result.level
+                      << "):\n";
+            std::cout << "  raw BGRA " << result.rawUs << " us, " << result.rawBytes << " bytes\n";
+            for (int mode = 0; mode < PngWriter::MODE_COUNT; mode++) {
+                std::cout << "  png " << PngWriter::GetModeName((PngWriter::Mode)mode) << " " << result.encodeUs[mode]
+                          << " us, " << result.encodeBytes[mode] << " bytes\n";
+            }
+            std::cout << "  png fast, scalar " << result.scalarUs << " us\n";
+        }
+    }
+    else if (cmd == "debug widgets") {
+        WidgetImage::Stats stats = WidgetImage::GetStats();
+        if (!stats.ready) {
+            std::cout << "Overlay widgets not available - see the log\n";
+        }
+        std::cout << stats.widgets.frames << " frames at " << stats.frameRate << " fps, "
+                  << stats.widgets.changedFrames << " changed; last layout " << stats.widgets.lastBuildUs
+                  << " us, raster " << stats.widgets.lastRasterUs << " us (" << DrawListRasterizer::GetSimdLevel()
+                  << "), " << stats.widgets.vertices << " vertices, " << stats.widgets.indices / 3 << " triangles\n";
+        std::cout << "Rasterizer: " << stats.widgets.raster.triangles << " drawn, " << stats.widgets.raster.culled
+                  << " culled, " << stats.widgets.raster.binEntries << " bin entries, "
+                  << stats.widgets.raster.tilesChanged << " tiles changed\n";
+        std::cout << stats.images << " images written; " << (stats.encoding ? stats.encoding : "-") << " encode "
+                  << stats.lastEncodeUs << " us (" << stats.lastBytes << " bytes), write " << stats.lastWriteUs
+                  << " us, dirty " << stats.lastDirty.x1 - stats.lastDirty.x0 << "x"
+                  << stats.lastDirty.y1 - stats.lastDirty.y0 << " at " << stats.lastDirty.x0 << ","
+                  << stats.lastDirty.y0 << "\n";
+        std::cout << "Shared frames: " << (stats.shared ? FRAME_SHARE_WIDGETS_NAME : "not shared") << ", "
+                  << stats.frames.published << " published, " << stats.frames.bytesCopied << " bytes copied, "
+                  << stats.frames.tooLarge << " too large\n";
+    }
+    else if (cmd == "test widgets") {
+        std::string failure;
+        if (OverlayWidgets::RunSelfTest(failure)) {
+            std::cout << "Widget self-test passed\n";
+        } else {
+            std::cout << "Widget self-test FAILED: " << failure << "\n";
+        }
+    }
+    else if (cmd == "bench widgets") {
+        OverlayWidgets::BenchmarkResult result = WidgetImage::RunBenchmark(50);
+        std::cout << "Widgets, best of 50 (" << result.level << "): " << result.vertices << " vertices, "
+                  << result.triangles << " triangles, " << result.binEntries << " bin entries\n";
+        std::cout << "  layout " << result.buildUs << " us\n";
+        std::cout << "  raster " << result.rasterUs << " us, scalar " << result.scalarUs << " us, unbinned "
+                  << result.unbinnedUs << " us, first frame " << result.firstFrameUs << " us\n";
+    }
+    else if (cmd == "debug inputs") {
+        InputDisplay::Stats stats = InputDisplay::GetStats();
+        std::cout << "Input capture: " << stats.recorder.frames << " frames (" << stats.recorder.gaps << " filled, "
+                  << stats.recorder.duplicates << " duplicate, " << stats.recorder.restarts << " restarts), "
+                  << (stats.shared ? INPUT_RING_MAPPING_NAME : "not shared") << "\n";
+        std::cout << "Per frame: avg " << stats.averageCaptureNs << " ns, max " << stats.maxCaptureNs << " ns over "
+                  << stats.captures << " captures\n";
+        if (stats.captures == 0) {
+            std::cout << "Nothing recorded - describe p1.input and p2.input in offsets.json\n";
+        } else if (InputDisplay::GetRing()) {
+            std::cout << InputRecorder::ToJSON(*InputDisplay::GetRing(), 8);
+        }
+        InputDisplay::ResetStats();
+    }
+    else if (cmd == "test inputs") {
+        std::string failure;
+        if (InputRecorder::RunSelfTest(failure)) {
+            std::cout << "Input recorder self-test passed\n";
+        } else {
+            std::cout << "Input recorder self-test FAILED: " << failure << "\n";
+        }
+    }
+    else if (cmd == "bench inputs") {
+        InputRecorder::BenchmarkResult result = InputRecorder::RunBenchmark(60 * 60 * 60);
+        std::cout << "Recorded " << result.frames << " frames into " << result.runs << " runs ("
+                  << result.framesPerRun << " frames per run): avg " << result.nsPerFrame << " ns, p99.9 "
+                  << result.p999FrameNs << " ns, max " << result.maxFrameNs << " ns per frame; replay "
+                  << (result.verified ? "matches" : "DOES NOT match") << "\n";
+    }
+    else if (cmd == "test scanner") {
+        std::string failure;
+        if (SignatureScanner::RunSelfTest(failure)) {
+            std::cout << "Signature scanner self-test passed (" << SignatureScanner::GetSimdLevel() << ")\n";
+        } else {
+            std::cout << "Signature scanner self-test FAILED: " << failure << "\n";
+        }
+    }
+    else if (cmd == "bench scanner") {
+        SignatureScanner::BenchmarkResult result = SignatureScanner::RunBenchmark(8 << 20);
+        std::cout << "Scanned " << result.megabytes << " MB in " << result.fastMs << " ms with " << result.level
+                  << " (scalar " << result.scalarMs << " ms)\n";
+    }
+    else if (cmd == "delta" || cmd.rfind("delta ", 0) == 0) {
+        uint64_t current = GameDataManager::GetVersion();
+        uint64_t since = current ? current - 1 : 0;
+        if (cmd.size() > 6) {
+            since = strtoull(cmd.c_str() + 6, nullptr, 10);
+        }
+        GameDelta delta;
+        if (GameDataManager::GetDeltaSince(since, delta)) {
+            std::cout << delta.ToJSON() << "\n";
+        } else {
+            std::cout << "No changes since version " << since << " (current " << current << ")\n";
+        }
+    }
+    else if (cmd == "debug loop") {
+        EventLoop::Stats stats = EventLoop::GetStats();
+        double seconds = stats.elapsedMs / 1000.0;
+        std::cout << "Over " << seconds << " s: " << stats.wakeups << " wakeups (" 
+                  << (seconds > 0 ? stats.wakeups / seconds : 0.0) << "/s), " << stats.timersFired << " timers, "
+                  << stats.posts << " posts, " << stats.ioCompletions << " I/O completions, "
+                  << stats.waitableSignals << " waitable signals\n";
+        std::cout << "Timer lateness: avg " << stats.averageLatenessMs << " ms, max " << stats.maxLatenessMs
+                  << " ms; busy " << stats.busyMs << " ms ("
+                  << (stats.elapsedMs > 0 ? stats.busyMs * 100.0 / stats.elapsedMs : 0.0) << "%)\n";
+        EventLoop::ResetStats();
+    }
+    else if (cmd == "debug sched") {
+        const SchedulingConfig& config = SchedulingPolicy::GetConfig();
+        SchedulingPolicy::Counters counters = SchedulingPolicy::GetCounters();
+        std::cout << "Policy " << (config.enabled ? "enabled" : "disabled") << ", game thread "
+                  << SchedulingPolicy::GetGameThreadId() << " on core " << SchedulingPolicy::GetGameCore()
+                  << ", loop thread now on core " << GetCurrentProcessorNumber() << "\n";
+        std::cout << "Over " << counters.elapsedMs / 1000.0 << " s: " << counters.wakeups << " wakeups, "
+                  << counters.wakeupsOnGameCore << " on the game core, " << counters.migrations << " migrations, "
+                  << counters.gameCoreChanges << " game core changes; game thread CPU "
+                  << counters.gameThreadCpuPercent << "%\n";
+        EventLoop::Stats stats = EventLoop::GetStats();
+        std::cout << "Timer jitter: avg " << stats.averageLatenessMs << " ms, max " << stats.maxLatenessMs << " ms\n";
+        SchedulingPolicy::ResetCounters();
+    }
+    else if (cmd == "debug frames") {
+        FrameSampler* sampler = FrameHook::GetSampler();
+        if (!sampler) {
+            std::cout << "Frame sampling is off (set [Sampling] Mode=frame in scheduling.ini); sampling on the "
+                      << "event loop timer\n";
+        } else {
+            FrameSampler::Stats stats = sampler->GetStats();
+            std::cout << stats.frames << " frames: " << stats.sampled << " sampled, " << stats.skipped
+                      << " skipped for budget, " << stats.dropped << " dropped (queue full), " << stats.failed
+                      << " failed\n";
+            std::cout << "Capture: avg " << stats.averageCaptureUs << " us, max " << stats.maxCaptureUs
+                      << " us, " << stats.overBudget << " over the " << sampler->GetBudgetUs() << " us budget\n";
+            sampler->ResetStats();
+        }
+    }
+    else if (cmd == "test frames") {
+        std::string failure;
+        if (FrameSampler::RunSelfTest(failure)) {
+            std::cout << "Frame sampler self-test passed\n";
+        } else {
+            std::cout << "Frame sampler self-test FAILED: " << failure << "\n";
+        }
+    }
+    else if (cmd == "debug modules") {
+        std::cout << "Module changes detected by " << (ModuleMonitor::IsEventDriven() ? "loader notifications" : "polling")
+                  << ", generation " << ModuleMonitor::GetGeneration() << "\n";
+        for (int i = 0; i < WATCHED_MODULE_COUNT; i++) {
+            HMODULE base = ModuleMonitor::GetBase((WatchedModule)i);
+            std::cout << "  " << ModuleMonitor::GetModuleName((WatchedModule)i) << ": "
+                      << (base ? Logger::FormatHex((DWORD)base) : std::string("not loaded")) << "\n";
+        }
+    }
+    else if (cmd == "debug module reload") {
+        // Same path a netplay restart takes; the next tick drops cached pointers
+        HMODULE base = ModuleMonitor::GetBase(WATCHED_EFZ_REVIVAL);
+        const wchar_t* name = L"EfzRevival.dll";
+        if (base) {
+            ModuleMonitor::Notify(MODULE_EVENT_UNLOADED, name, wcslen(name), base);
+            ModuleMonitor::Notify(MODULE_EVENT_LOADED, name, wcslen(name), base);
+            std::cout << "Reload simulated, generation " << ModuleMonitor::GetGeneration() << "\n";
+        } else {
+            std::cout << "EfzRevival.dll is not loaded\n";
+        }
+    }
+    else if (cmd == "history") {
+        const GameData& data = GameDataManager::GetCurrentData();
+        std::string p1Nickname = data.player1.nickname.str();
+        std::string p2Nickname = data.player2.nickname.str();
+        HeadToHeadRecord h2h = MatchHistory::GetHeadToHead(p1Nickname, p2Nickname);
+        
+        std::cout << "---- Match History (" << MatchHistory::GetMatchCount() << " sets) ----\n";
+        std::cout << p1Nickname << " vs " << p2Nickname << ": "
+                  << h2h.firstWins << " - " << h2h.secondWins << " (" << h2h.sets << " sets)\n";
+        
+        for (const std::string& nickname : { p1Nickname, p2Nickname }) {
+            std::cout << "Last 10 sets for " << nickname << ":\n";
+            for (const MatchRecord& record : MatchHistory::GetRecentMatches(nickname, 10)) {
+                std::cout << "  " << record.p1Nickname << " " << (int)record.p1Score << " - "
+                          << (int)record.p2Score << " " << record.p2Nickname << "\n";
+            }
+        }
+        std::cout << "--------------------------------\n";
+    }
+    else if (cmd == "rating mode glicko" || cmd == "rating mode elo") {
+        RatingMode mode = (cmd == "rating mode elo") ? RATING_MODE_ELO : RATING_MODE_GLICKO2;
+        std::cout << (RatingService::SetMode(mode) ? "Rating mode changed\n" : "Failed to change rating mode\n");
+    }
+    else if (cmd == "rating recompute") {
+        std::cout << (RatingService::RecomputeFromHistory() ? "Ratings recomputed\n" : "Rating recompute failed\n");
+    }
+    else if (cmd == "bench ratings") {
+        const size_t sets = 1000000;
+        double elapsedMs = RatingService::RunBenchmark(sets, 2000);
+        std::cout << "Recomputed " << sets << " synthetic sets over 2000 players in " << elapsedMs << " ms ("
+                  << (elapsedMs * 1000000.0 / sets) << " ns/set)\n";
+    }
+    else if (cmd == "test history") {
+        std::string failure;
+        if (MatchHistory::RunSelfTest(failure)) {
+            std::cout << "Match history self-test passed\n";
+        } else {
+            std::cout << "Match history self-test FAILED: " << failure << "\n";
+        }
+    }
+    else if (cmd == "bench history") {
+        const uint32_t sets = 100000;
+        MatchHistory::BenchmarkResult result;
+        std::string failure;
+        if (MatchHistory::RunBenchmark(sets, result, failure)) {
+            std::cout << "Appended " << sets << " sets in " << result.appendMs << " ms, reopened and indexed in "
+                      << result.reopenMs << " ms\n";
+            std::cout << "Head-to-head " << result.headToHeadUs << " us/query, last 10 sets "
+                      << result.recentMatchesUs << " us/query\n";
+        } else {
+            std::cout << "Match history benchmark FAILED: " << failure << "\n";
+        }
+    }
+    else if (cmd == "test utf") {
+        const size_t iterations = 100000;
+        std::string failure;
+        if (Utf16Transcoder::RunFuzzTest(iterations, failure)) {
+            std::cout << "Transcoder passed " << iterations << " fuzz iterations\n";
+        } else {
+            std::cout << "Transcoder FAILED: " << failure << "\n";
+        }
+    }
+    else if (cmd == "bench utf") {
+        const size_t units = 1 << 20;
+        for (int asciiOnly = 1; asciiOnly >= 0; asciiOnly--) {
+            Utf16Transcoder::BenchmarkResult result = Utf16Transcoder::RunBenchmark(units, asciiOnly != 0);
+            std::cout << (asciiOnly ? "ASCII: " : "Mixed: ") << result.fastMBps << " MB/s (scalar "
+                      << result.scalarMBps << " MB/s, WideCharToMultiByte " << result.systemMBps << " MB/s)\n";
+        }
+    }
+    else if (cmd == "test sanitizer") {
+        std::string failure;
+        if (NicknameSanitizer::RunSelfTest(failure)) {
+            std::cout << "Sanitizer self-test passed\n";
+        } else {
+            std::cout << "Sanitizer self-test FAILED: " << failure << "\n";
+        }
+    }
+    else if (cmd == "bench sanitizer") {
+        std::cout << "Sanitized 1M names at " << NicknameSanitizer::RunBenchmark(1000000) << " ns/name\n";
+    }
+    else if (cmd == "clear") {
+        system("cls");
+    }
+    else if (cmd == "quit") {
+        EventLoop::RemoveWaitable(&g_consoleInput);
+        Logger::Info("Console command interface stopped");
+    }
+    else if (!cmd.empty()) {
+        std::cout << "Unknown command. Type 'help' for available commands.\n";
+    }
+}
+
+// Line editing on raw key events, so reading the console never blocks the
+// event loop: characters are echoed as typed and Enter runs the command
+static void OnConsoleInput(void* context) {
+    static std::string line;
+    HANDLE input = g_consoleInput.handle;
     
-    Logger::Info("Console command interface stopped");
-    return 0;
+    DWORD pending = 0;
+    while (g_consoleInput.active && GetNumberOfConsoleInputEvents(input, &pending) && pending > 0) {
+        INPUT_RECORD records[32];
+        DWORD count = 0;
+        if (!ReadConsoleInputA(input, records, 32, &count)) {
+            break;
+        }
+        
+        for (DWORD i = 0; i < count && g_consoleInput.active; i++) {
+            const INPUT_RECORD& record = records[i];
+            if (record.EventType != KEY_EVENT || !record.Event.KeyEvent.bKeyDown) {
+                continue;
+            }
+            char c = record.Event.KeyEvent.uChar.AsciiChar;
+            for (WORD repeat = 0; repeat < record.Event.KeyEvent.wRepeatCount; repeat++) {
+                if (c == '\r') {
+                    std::cout << "\n";
+                    std::string command;
+                    command.swap(line);
+                    ExecuteConsoleCommand(command);
+                    if (g_consoleInput.active) {
+                        std::cout << "\n> " << std::flush;
+                    }
+                    break;
+                } else if (c == '\b') {
+                    if (!line.empty()) {
+                        line.pop_back();
+                        std::cout << "\b \b" << std::flush;
+                    }
+                } else if (c >= 32 && c < 127) {
+                    line += c;
+                    std::cout << c << std::flush;
+                }
+            }
+        }
+    }
 }
 
+static void StartConsoleInput() {
+    g_consoleInput.handle = GetStdHandle(STD_INPUT_HANDLE);
+    g_consoleInput.callback = OnConsoleInput;
+    if (g_consoleInput.handle == nullptr || g_consoleInput.handle == INVALID_HANDLE_VALUE ||
+        !EventLoop::AddWaitable(&g_consoleInput)) {
+        Logger::Warning("Console input unavailable - commands disabled");
+        return;
+    }
+    Logger::Info("Console command interface started - type 'help' for available commands");
+    std::cout << "\n> " << std::flush;
+}
+
+// DllMain runs under the loader lock, so it only hands off to the startup
+// thread; everything else (console, file I/O, thread creation) happens there.
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserved) {
     switch (ul_reason_for_call) {
-    case DLL_PROCESS_ATTACH:
+    case DLL_PROCESS_ATTACH: {
+        QueryPerformanceCounter(&g_attachTime);
         DisableThreadLibraryCalls(hModule); // Optimize DLL performance
         
-        // Initialize components
-        g_dllInitialized = InitializeComponents();
-        return g_dllInitialized; // Return FALSE if initialization failed
+        HANDLE startupThread = CreateThread(nullptr, 0, StartupThreadProc, nullptr, 0, nullptr);
+        if (!startupThread) {
+            return FALSE;
+        }
+        CloseHandle(startupThread);
+        break;
+    }
         
     case DLL_PROCESS_DETACH:
-        if (g_dllInitialized) {
-            // Only clean up if we successfully initialized
-            CleanupComponents();
+        // lpReserved is non-null at process termination, the only time a
+        // pinned module is detached. If startup never finished there is
+        // nothing consistent to clean up.
+        if (g_dllInitialized && lpReserved != nullptr && !g_componentsShutDown) {
+            ReleaseOnTermination();
         }
         break;
         
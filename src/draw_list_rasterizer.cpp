@@ -0,0 +1,793 @@
+#include "../include/draw_list_rasterizer.h"
+#include "imgui/imgui.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define EFZ_RASTER_SSE2 1
+#endif
+
+bool DrawListRasterizer::forceScalar = false;
+
+static const int SUBPIXEL_BITS = 4;
+static const int SUBPIXEL = 1 << SUBPIXEL_BITS;
+// Vertices further out are not drawn, which keeps a span's edge steps in
+// 32 bits: |step| <= 2 * LIMIT * SUBPIXEL * SUBPIXEL, 2^23
+static const float COORD_LIMIT = 16384.0f;
+// Edge values are clamped to this at the start of each span of at most
+// TILE_SIZE pixels; the span can move them by less than 2^28, so the sign
+// of every value in it stays right
+static const int64_t EDGE_CLAMP = (int64_t)1 << 30;
+// Tile and frame buffers are this much wider than their rows, so a group
+// of four starting at the last pixel stays inside its row
+static const int ROW_PADDING = 4;
+
+const char* DrawListRasterizer::GetSimdLevel() {
+#ifdef EFZ_RASTER_SSE2
+    return forceScalar ? "scalar" : "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+// round(x / 255) for x <= 255 * 255
+static inline uint32_t Div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline uint32_t OverPixel(uint32_t src, uint32_t dst) {
+    uint32_t inverse = 255 - (src >> 24);
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t channel = ((src >> shift) & 0xFF) + Div255(((dst >> shift) & 0xFF) * inverse);
+        result |= (channel > 255 ? 255 : channel) << shift;
+    }
+    return result;
+}
+
+// Channel by channel product of two premultiplied colours
+static inline uint32_t Modulate(uint32_t a, uint32_t b) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        result |= Div255(((a >> shift) & 0xFF) * ((b >> shift) & 0xFF)) << shift;
+    }
+    return result;
+}
+
+// ImGui's IM_COL32 (R in the lowest byte, straight alpha) to premultiplied BGRA
+static inline uint32_t ConvertColor(uint32_t rgba) {
+    return Canvas::Premultiply((rgba & 0xFF00FF00u) | (rgba & 0xFF) << 16 | (rgba >> 16 & 0xFF));
+}
+
+static inline int32_t ClampEdge(int64_t value) {
+    return (int32_t)(value > EDGE_CLAMP ? EDGE_CLAMP : value < -EDGE_CLAMP ? -EDGE_CLAMP : value);
+}
+
+static inline float Clamp(float value, float low, float high) {
+    return std::min(std::max(value, low), high);
+}
+
+// Nearest texel at scaled coordinates (u * width, v * height)
+static inline uint32_t Sample(const Canvas& texture, float u, float v) {
+    int x = (int)Clamp(u, 0.0f, (float)(texture.GetWidth() - 1));
+    int y = (int)Clamp(v, 0.0f, (float)(texture.GetHeight() - 1));
+    return texture.Row(y)[x];
+}
+
+// Vertex colour, then texel, at pixel x of a row whose plane terms for
+// its y are in rowTerm
+static inline uint32_t ShadePixel(const DrawListRasterizer::Triangle& triangle, int x, const float* rowTerm) {
+    float px = (float)x + 0.5f;
+    uint32_t color = triangle.color;
+    if (triangle.flags & DrawListRasterizer::SMOOTH_COLOR) {
+        uint32_t channels[4];
+        for (int i = 0; i < 4; i++) {
+            channels[i] = (uint32_t)(Clamp(rowTerm[i] + triangle.planes[i][1] * px, 0.0f, 255.0f) + 0.5f);
+        }
+        for (int i = 0; i < 3; i++) {
+            channels[i] = std::min(channels[i], channels[3]);
+        }
+        color = channels[0] | channels[1] << 8 | channels[2] << 16 | channels[3] << 24;
+    }
+    if (triangle.flags & DrawListRasterizer::SAMPLED) {
+        uint32_t texel = Sample(*triangle.texture, rowTerm[4] + triangle.planes[4][1] * px,
+                                rowTerm[5] + triangle.planes[5][1] * px);
+        color = Modulate(color, texel);
+    }
+    return color;
+}
+
+#ifdef EFZ_RASTER_SSE2
+static inline __m128i Div255x8(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Two premultiplied pixels widened to 16 bits per channel
+static inline __m128i OverWide(__m128i src, __m128i dst) {
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+    return _mm_add_epi16(src, Div255x8(_mm_mullo_epi16(dst, inverse)));
+}
+
+static inline __m128i Over4(__m128i src, __m128i dst) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i low = OverWide(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(dst, zero));
+    __m128i high = OverWide(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(dst, zero));
+    return _mm_packus_epi16(low, high);
+}
+
+static inline __m128i Modulate4(__m128i a, __m128i b) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i low = Div255x8(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)));
+    __m128i high = Div255x8(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)));
+    return _mm_packus_epi16(low, high);
+}
+
+static inline __m128 Plane4(const float* plane, float rowTerm, __m128 px) {
+    return _mm_add_ps(_mm_set1_ps(rowTerm), _mm_mul_ps(_mm_set1_ps(plane[1]), px));
+}
+
+// Float channel values 0-255 to integers rounded as ShadePixel does
+static inline __m128i Round4(__m128 value) {
+    value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+    return _mm_cvttps_epi32(_mm_add_ps(value, _mm_set1_ps(0.5f)));
+}
+
+// ShadePixel for pixels x .. x + 3
+static inline __m128i Shade4(const DrawListRasterizer::Triangle& triangle, int x, const float* rowTerm) {
+    __m128i color = _mm_set1_epi32((int)triangle.color);
+    if (!(triangle.flags & DrawListRasterizer::SHADED)) {
+        return color;
+    }
+    __m128 px = _mm_add_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x), _mm_setr_epi32(0, 1, 2, 3))),
+                           _mm_set1_ps(0.5f));
+    if (triangle.flags & DrawListRasterizer::SMOOTH_COLOR) {
+        __m128i alpha = Round4(Plane4(triangle.planes[3], rowTerm[3], px));
+        // Values fit 16 bits, so the 16-bit minimum works on the 32-bit lanes
+        __m128i b = _mm_min_epi16(Round4(Plane4(triangle.planes[0], rowTerm[0], px)), alpha);
+        __m128i g = _mm_min_epi16(Round4(Plane4(triangle.planes[1], rowTerm[1], px)), alpha);
+        __m128i r = _mm_min_epi16(Round4(Plane4(triangle.planes[2], rowTerm[2], px)), alpha);
+        color = _mm_or_si128(_mm_or_si128(b, _mm_slli_epi32(g, 8)),
+                             _mm_or_si128(_mm_slli_epi32(r, 16), _mm_slli_epi32(alpha, 24)));
+    }
+    if (triangle.flags & DrawListRasterizer::SAMPLED) {
+        const Canvas& texture = *triangle.texture;
+        __m128 u = _mm_min_ps(_mm_max_ps(Plane4(triangle.planes[4], rowTerm[4], px), _mm_setzero_ps()),
+                              _mm_set1_ps((float)(texture.GetWidth() - 1)));
+        __m128 v = _mm_min_ps(_mm_max_ps(Plane4(triangle.planes[5], rowTerm[5], px), _mm_setzero_ps()),
+                              _mm_set1_ps((float)(texture.GetHeight() - 1)));
+        // Texture sizes are below 2^15, so one 16-bit multiply-add forms y * width + x
+        __m128i index = _mm_add_epi32(_mm_madd_epi16(_mm_cvttps_epi32(v), _mm_set1_epi32(texture.GetWidth())),
+                                      _mm_cvttps_epi32(u));
+        alignas(16) int32_t offsets[4];
+        _mm_store_si128((__m128i*)offsets, index);
+        const uint32_t* texels = texture.Row(0);
+        __m128i sampled = _mm_setr_epi32((int)texels[offsets[0]], (int)texels[offsets[1]], (int)texels[offsets[2]],
+                                         (int)texels[offsets[3]]);
+        color = Modulate4(color, sampled);
+    }
+    return color;
+}
+#endif
+
+// Pixels of region (absolute coordinates) covered by the triangle, blended
+// into buffer, whose first pixel is (originX, originY)
+void DrawListRasterizer::DrawRegion(const Triangle& triangle, const CanvasRect& region, uint32_t* buffer, int stride,
+                                    int originX, int originY) {
+    bool rectangle = (triangle.flags & RECTANGLE) != 0;
+    if (rectangle && !(triangle.flags & SHADED) && (triangle.color >> 24) == 0xFF) {
+        // Opaque fill: a plain copy
+        for (int y = region.y0; y < region.y1; y++) {
+            uint32_t* row = buffer + (size_t)(y - originY) * stride + (region.x0 - originX);
+            std::fill(row, row + (region.x1 - region.x0), triangle.color);
+        }
+        return;
+    }
+    float rowTerm[6] = {};
+    for (int y = region.y0; y < region.y1; y++) {
+        uint32_t* row = buffer + (size_t)(y - originY) * stride;
+        if (triangle.flags & SHADED) {
+            float py = (float)y + 0.5f;
+            for (int i = 0; i < 6; i++) {
+                rowTerm[i] = triangle.planes[i][0] + triangle.planes[i][2] * py;
+            }
+        }
+
+        for (int spanStart = region.x0; spanStart < region.x1; spanStart += TILE_SIZE) {
+            int spanEnd = std::min(spanStart + TILE_SIZE, region.x1);
+            int32_t edge[3] = {};
+            if (!rectangle) {
+                for (int i = 0; i < 3; i++) {
+                    edge[i] = ClampEdge(triangle.edge[i] + (int64_t)triangle.stepY[i] * y +
+                                        (int64_t)triangle.stepX[i] * spanStart);
+                }
+            }
+            int x = spanStart;
+#ifdef EFZ_RASTER_SSE2
+            if (!forceScalar) {
+                __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+                __m128i w[3], step[3];
+                for (int i = 0; i < 3; i++) {
+                    // lanes * step without a 32-bit multiply: 0, step, 2 step, 3 step
+                    __m128i offsets = _mm_setr_epi32(0, triangle.stepX[i], triangle.stepX[i] * 2,
+                                                     triangle.stepX[i] * 3);
+                    w[i] = _mm_add_epi32(_mm_set1_epi32(edge[i]), offsets);
+                    step[i] = _mm_set1_epi32(triangle.stepX[i] * 4);
+                }
+                for (; x < spanEnd; x += 4) {
+                    __m128i covered = _mm_cmplt_epi32(lanes, _mm_set1_epi32(spanEnd - x));
+                    if (!rectangle) {
+                        // Any negative edge value sets the sign bit: outside
+                        __m128i outside = _mm_srai_epi32(_mm_or_si128(w[0], _mm_or_si128(w[1], w[2])), 31);
+                        covered = _mm_andnot_si128(outside, covered);
+                        for (int i = 0; i < 3; i++) {
+                            w[i] = _mm_add_epi32(w[i], step[i]);
+                        }
+                        if (_mm_movemask_epi8(covered) == 0) {
+                            continue;
+                        }
+                    }
+                    __m128i* pixels = (__m128i*)(row + (x - originX));
+                    __m128i dst = _mm_loadu_si128(pixels);
+                    __m128i blended = Over4(Shade4(triangle, x, rowTerm), dst);
+                    _mm_storeu_si128(pixels, _mm_or_si128(_mm_and_si128(covered, blended),
+                                                          _mm_andnot_si128(covered, dst)));
+                }
+                continue;
+            }
+#endif
+            for (; x < spanEnd; x++) {
+                if ((edge[0] | edge[1] | edge[2]) >= 0) {
+                    uint32_t& pixel = row[x - originX];
+                    pixel = OverPixel(ShadePixel(triangle, x, rowTerm), pixel);
+                }
+                for (int i = 0; i < 3; i++) {
+                    edge[i] += triangle.stepX[i];
+                }
+            }
+        }
+    }
+}
+
+// Attribute plane through three vertices (pixel units): value at 0, per x, per y
+static void SetPlane(float* plane, const double* x, const double* y, const double* value) {
+    double det = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    double dx = ((value[1] - value[0]) * (y[2] - y[0]) - (value[2] - value[0]) * (y[1] - y[0])) / det;
+    double dy = ((value[2] - value[0]) * (x[1] - x[0]) - (value[1] - value[0]) * (x[2] - x[0])) / det;
+    plane[0] = (float)(value[0] - dx * x[0] - dy * y[0]);
+    plane[1] = (float)dx;
+    plane[2] = (float)dy;
+}
+
+static bool ToFixed(const ImDrawVert& vertex, int32_t& fx, int32_t& fy) {
+    if (!(std::fabs(vertex.pos.x) < COORD_LIMIT && std::fabs(vertex.pos.y) < COORD_LIMIT)) {
+        return false;
+    }
+    fx = (int32_t)std::floor(vertex.pos.x * SUBPIXEL + 0.5f);
+    fy = (int32_t)std::floor(vertex.pos.y * SUBPIXEL + 0.5f);
+    return true;
+}
+
+// ImGui's PrimRect and PrimRectUV: corners a, b, c, d in order, drawn as
+// (a, b, c) and (a, c, d), axis aligned, with colours and UVs that one
+// plane describes
+static bool IsRectangle(const ImDrawVert* base, const ImDrawIdx* indices) {
+    if (indices[3] != indices[0] || indices[4] != indices[2]) {
+        return false;
+    }
+    const ImDrawVert& a = base[indices[0]];
+    const ImDrawVert& b = base[indices[1]];
+    const ImDrawVert& c = base[indices[2]];
+    const ImDrawVert& d = base[indices[5]];
+    if (!(a.pos.y == b.pos.y && b.pos.x == c.pos.x && c.pos.y == d.pos.y && d.pos.x == a.pos.x) &&
+        !(a.pos.x == b.pos.x && b.pos.y == c.pos.y && c.pos.x == d.pos.x && d.pos.y == a.pos.y)) {
+        return false;
+    }
+    if (std::fabs(a.uv.x + c.uv.x - b.uv.x - d.uv.x) > 1e-6f || std::fabs(a.uv.y + c.uv.y - b.uv.y - d.uv.y) > 1e-6f) {
+        return false;
+    }
+    if (a.col == b.col && a.col == c.col && a.col == d.col) {
+        return true;
+    }
+    uint32_t ca = ConvertColor(a.col), cb = ConvertColor(b.col), cc = ConvertColor(c.col), cd = ConvertColor(d.col);
+    for (int shift = 0; shift < 32; shift += 8) {
+        if ((ca >> shift & 0xFF) + (cc >> shift & 0xFF) != (cb >> shift & 0xFF) + (cd >> shift & 0xFF)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Colours, texture and planes from count vertices, interpolated through
+// the first three; false when nothing would show
+bool DrawListRasterizer::SetupShading(const ImDrawVert* const* vertices, int count, const int32_t* fx,
+                                      const int32_t* fy, const Canvas* texture, Triangle& triangle) {
+    uint32_t colors[4];
+    bool uniformUv = true;
+    for (int i = 0; i < count; i++) {
+        colors[i] = ConvertColor(vertices[i]->col);
+        uniformUv = uniformUv && vertices[i]->uv.x == vertices[0]->uv.x && vertices[i]->uv.y == vertices[0]->uv.y;
+    }
+    triangle.texture = nullptr;
+    if (texture && uniformUv) {
+        // Every ImGui fill points at the atlas's white pixel
+        uint32_t texel = Sample(*texture, vertices[0]->uv.x * texture->GetWidth(),
+                                vertices[0]->uv.y * texture->GetHeight());
+        for (int i = 0; i < count; i++) {
+            colors[i] = Modulate(colors[i], texel);
+        }
+    } else if (texture) {
+        triangle.flags |= SAMPLED;
+        triangle.texture = texture;
+    }
+    bool visible = false, smooth = false;
+    for (int i = 0; i < count; i++) {
+        visible = visible || colors[i] != 0;
+        smooth = smooth || colors[i] != colors[0];
+    }
+    if (!visible) {
+        return false;
+    }
+    if (smooth) {
+        triangle.flags |= SMOOTH_COLOR;
+    }
+    triangle.color = colors[0];
+
+    if (!(triangle.flags & SHADED)) {
+        return true;
+    }
+    double x[3], y[3];
+    for (int i = 0; i < 3; i++) {
+        x[i] = (double)fx[i] / SUBPIXEL;
+        y[i] = (double)fy[i] / SUBPIXEL;
+    }
+    memset(triangle.planes, 0, sizeof(triangle.planes));
+    if (triangle.flags & SMOOTH_COLOR) {
+        for (int channel = 0; channel < 4; channel++) {
+            double values[3];
+            for (int i = 0; i < 3; i++) {
+                values[i] = (double)(colors[i] >> (channel * 8) & 0xFF);
+            }
+            SetPlane(triangle.planes[channel], x, y, values);
+        }
+    }
+    if (triangle.flags & SAMPLED) {
+        double u[3], v[3];
+        for (int i = 0; i < 3; i++) {
+            u[i] = (double)vertices[i]->uv.x * texture->GetWidth();
+            v[i] = (double)vertices[i]->uv.y * texture->GetHeight();
+        }
+        SetPlane(triangle.planes[4], x, y, u);
+        SetPlane(triangle.planes[5], x, y, v);
+    }
+    return true;
+}
+
+// False when the triangle cannot change a pixel
+bool DrawListRasterizer::SetupTriangle(const ImDrawVert* vertices[3], const CanvasRect& clip, const Canvas* texture,
+                                       Triangle& triangle) {
+    int32_t fx[3], fy[3];
+    for (int i = 0; i < 3; i++) {
+        if (!ToFixed(*vertices[i], fx[i], fy[i])) {
+            return false;
+        }
+    }
+    int64_t area = (int64_t)(fx[1] - fx[0]) * (fy[2] - fy[0]) - (int64_t)(fy[1] - fy[0]) * (fx[2] - fx[0]);
+    if (area == 0) {
+        return false;
+    }
+    // ImGui winds both ways; inside is positive for a positive area
+    if (area < 0) {
+        std::swap(fx[1], fx[2]);
+        std::swap(fy[1], fy[2]);
+        std::swap(vertices[1], vertices[2]);
+    }
+
+    // Pixels whose centre (x + 0.5, y + 0.5) is inside the bounding box
+    const int half = SUBPIXEL / 2;
+    int minX = std::min({fx[0], fx[1], fx[2]}) - half, maxX = std::max({fx[0], fx[1], fx[2]}) - half;
+    int minY = std::min({fy[0], fy[1], fy[2]}) - half, maxY = std::max({fy[0], fy[1], fy[2]}) - half;
+    CanvasRect box = {-((-minX) >> SUBPIXEL_BITS), -((-minY) >> SUBPIXEL_BITS), (maxX >> SUBPIXEL_BITS) + 1,
+                      (maxY >> SUBPIXEL_BITS) + 1};
+    triangle.bounds = box.Intersect(clip);
+    if (triangle.bounds.Empty()) {
+        return false;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        int a = i, b = (i + 1) % 3;
+        int32_t stepA = fy[a] - fy[b];     // Per subpixel in x
+        int32_t stepB = fx[b] - fx[a];     // Per subpixel in y
+        // The top-left rule: an edge shared by two triangles belongs to
+        // exactly one, whose A (or, when horizontal, B) is positive
+        bool owner = stepA > 0 || (stepA == 0 && stepB > 0);
+        triangle.edge[i] = (int64_t)stepA * (half - fx[a]) + (int64_t)stepB * (half - fy[a]) - (owner ? 0 : 1);
+        triangle.stepX[i] = stepA * SUBPIXEL;
+        triangle.stepY[i] = stepB * SUBPIXEL;
+    }
+    triangle.flags = 0;
+    return SetupShading(vertices, 3, fx, fy, texture, triangle);
+}
+
+// The pixels its two triangles would cover under the fill rule: centres
+// on the left and top edges are in, on the right and bottom edges out
+bool DrawListRasterizer::SetupRectangle(const ImDrawVert* corners[4], const CanvasRect& clip, const Canvas* texture,
+                                        Triangle& triangle) {
+    int32_t fx[4], fy[4];
+    for (int i = 0; i < 4; i++) {
+        if (!ToFixed(*corners[i], fx[i], fy[i])) {
+            return false;
+        }
+    }
+    const int half = SUBPIXEL / 2;
+    int minX = std::min({fx[0], fx[1], fx[2]}) - half, maxX = std::max({fx[0], fx[1], fx[2]}) - half;
+    int minY = std::min({fy[0], fy[1], fy[2]}) - half, maxY = std::max({fy[0], fy[1], fy[2]}) - half;
+    CanvasRect box = {-((-minX) >> SUBPIXEL_BITS), -((-minY) >> SUBPIXEL_BITS), ((maxX - 1) >> SUBPIXEL_BITS) + 1,
+                      ((maxY - 1) >> SUBPIXEL_BITS) + 1};
+    triangle.bounds = box.Intersect(clip);
+    if (triangle.bounds.Empty()) {
+        return false;
+    }
+    memset(triangle.edge, 0, sizeof(triangle.edge));
+    memset(triangle.stepX, 0, sizeof(triangle.stepX));
+    memset(triangle.stepY, 0, sizeof(triangle.stepY));
+    triangle.flags = RECTANGLE;
+    return SetupShading(corners, 4, fx, fy, texture, triangle);
+}
+
+void DrawListRasterizer::Setup(const ImDrawData* data, int width, int height) {
+    triangles.clear();
+    CanvasRect screen = {0, 0, width, height};
+    ImVec2 origin = data->DisplayPos;
+    ImVec2 scale = data->FramebufferScale;
+    Triangle triangle;
+    for (int list = 0; list < data->CmdListsCount; list++) {
+        const ImDrawList* drawList = data->CmdLists[list];
+        const ImDrawVert* vertexBuffer = drawList->VtxBuffer.Data;
+        const ImDrawIdx* indexBuffer = drawList->IdxBuffer.Data;
+        for (const ImDrawCmd& command : drawList->CmdBuffer) {
+            // Callbacks set GPU state; there is none here
+            if (command.UserCallback) {
+                continue;
+            }
+            // Truncated like a backend's scissor rect
+            CanvasRect clip = {(int)((command.ClipRect.x - origin.x) * scale.x),
+                               (int)((command.ClipRect.y - origin.y) * scale.y),
+                               (int)((command.ClipRect.z - origin.x) * scale.x),
+                               (int)((command.ClipRect.w - origin.y) * scale.y)};
+            clip = clip.Intersect(screen);
+            if (clip.Empty()) {
+                stats.culled += command.ElemCount / 3;
+                continue;
+            }
+            const Canvas* texture = (const Canvas*)(uintptr_t)command.GetTexID();
+            const ImDrawVert* base = vertexBuffer + command.VtxOffset;
+            const ImDrawIdx* indices = indexBuffer + command.IdxOffset;
+            for (unsigned int i = 0; i + 2 < command.ElemCount;) {
+                // Rectangles (fills, glyphs) skip the edge functions
+                bool rectangle = i + 5 < command.ElemCount && IsRectangle(base, indices + i);
+                int count = rectangle ? 4 : 3;
+                ImDrawVert transformed[4];
+                const ImDrawVert* vertices[4];
+                for (int k = 0; k < count; k++) {
+                    transformed[k] = base[indices[i + (k == 3 ? 5 : k)]];
+                    transformed[k].pos.x = (transformed[k].pos.x - origin.x) * scale.x;
+                    transformed[k].pos.y = (transformed[k].pos.y - origin.y) * scale.y;
+                    vertices[k] = &transformed[k];
+                }
+                bool drawn = rectangle ? SetupRectangle(vertices, clip, texture, triangle)
+                                       : SetupTriangle(vertices, clip, texture, triangle);
+                if (drawn) {
+                    triangles.push_back(triangle);
+                } else {
+                    stats.culled++;
+                }
+                i += rectangle ? 6 : 3;
+            }
+        }
+    }
+}
+
+// Copies the rows of tile that differ from target; returns the rows copied
+CanvasRect DrawListRasterizer::Resolve(const uint32_t* buffer, int stride, const CanvasRect& tile, int originX,
+                                       int originY, Canvas& target) {
+    CanvasRect changed;
+    size_t bytes = (size_t)(tile.x1 - tile.x0) * sizeof(uint32_t);
+    for (int y = tile.y0; y < tile.y1; y++) {
+        const uint32_t* source = buffer + (size_t)(y - originY) * stride + (tile.x0 - originX);
+        uint32_t* destination = target.Row(y) + tile.x0;
+        if (memcmp(source, destination, bytes) != 0) {
+            memcpy(destination, source, bytes);
+            changed = changed.Union({tile.x0, y, tile.x1, y + 1});
+        }
+    }
+    if (!changed.Empty()) {
+        stats.tilesChanged++;
+    }
+    return changed;
+}
+
+CanvasRect DrawListRasterizer::Render(const ImDrawData* data, Canvas& target) {
+    int width = (int)(data->DisplaySize.x * data->FramebufferScale.x);
+    int height = (int)(data->DisplaySize.y * data->FramebufferScale.y);
+    bool resized = target.GetWidth() != width || target.GetHeight() != height;
+    if (resized) {
+        target.Resize(width, height);
+    }
+    Setup(data, width, height);
+    stats.frames++;
+    stats.triangles += triangles.size();
+
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    CanvasRect changed;
+    if (binning) {
+        // Counts at [tile + 1], so the prefix sums leave each tile's start
+        // at [tile]; filling advances that to its end
+        binCounts.assign((size_t)tilesX * tilesY + 1, 0);
+        for (const Triangle& triangle : triangles) {
+            for (int ty = triangle.bounds.y0 / TILE_SIZE; ty <= (triangle.bounds.y1 - 1) / TILE_SIZE; ty++) {
+                for (int tx = triangle.bounds.x0 / TILE_SIZE; tx <= (triangle.bounds.x1 - 1) / TILE_SIZE; tx++) {
+                    binCounts[(size_t)ty * tilesX + tx + 1]++;
+                }
+            }
+        }
+        for (size_t tile = 1; tile < binCounts.size(); tile++) {
+            binCounts[tile] += binCounts[tile - 1];
+        }
+        binTriangles.resize(binCounts.back());
+        stats.binEntries += binTriangles.size();
+        for (uint32_t index = 0; index < (uint32_t)triangles.size(); index++) {
+            const CanvasRect& bounds = triangles[index].bounds;
+            for (int ty = bounds.y0 / TILE_SIZE; ty <= (bounds.y1 - 1) / TILE_SIZE; ty++) {
+                for (int tx = bounds.x0 / TILE_SIZE; tx <= (bounds.x1 - 1) / TILE_SIZE; tx++) {
+                    binTriangles[binCounts[(size_t)ty * tilesX + tx]++] = index;
+                }
+            }
+        }
+
+        const int stride = TILE_SIZE + ROW_PADDING;
+        alignas(16) uint32_t buffer[TILE_SIZE * stride];
+        for (int ty = 0; ty < tilesY; ty++) {
+            for (int tx = 0; tx < tilesX; tx++) {
+                size_t tileIndex = (size_t)ty * tilesX + tx;
+                CanvasRect tile = CanvasRect::Make(tx * TILE_SIZE, ty * TILE_SIZE, TILE_SIZE, TILE_SIZE)
+                                      .Intersect(target.GetBounds());
+                memset(buffer, 0, sizeof(buffer));
+                for (uint32_t entry = tileIndex ? binCounts[tileIndex - 1] : 0; entry < binCounts[tileIndex];
+                     entry++) {
+                    const Triangle& triangle = triangles[binTriangles[entry]];
+                    DrawRegion(triangle, triangle.bounds.Intersect(tile), buffer, stride, tile.x0, tile.y0);
+                }
+                changed = changed.Union(Resolve(buffer, stride, tile, tile.x0, tile.y0, target));
+            }
+        }
+    } else {
+        const int stride = width + ROW_PADDING;
+        scratch.assign((size_t)stride * height, 0);
+        for (const Triangle& triangle : triangles) {
+            DrawRegion(triangle, triangle.bounds, scratch.data(), stride, 0, 0);
+        }
+        for (int ty = 0; ty < tilesY; ty++) {
+            for (int tx = 0; tx < tilesX; tx++) {
+                CanvasRect tile = CanvasRect::Make(tx * TILE_SIZE, ty * TILE_SIZE, TILE_SIZE, TILE_SIZE)
+                                      .Intersect(target.GetBounds());
+                changed = changed.Union(Resolve(scratch.data(), stride, tile, 0, 0, target));
+            }
+        }
+    }
+    return resized ? target.GetBounds() : changed;
+}
+
+static uint32_t NextRandom(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state;
+}
+
+// One command of triangles (three vertices each) appended to list
+static void AddTriangles(ImDrawList& list, const ImDrawVert* vertices, int count, const ImVec4& clip,
+                         const Canvas* texture) {
+    ImDrawCmd command;
+    command.ClipRect = clip;
+    command.TextureId = (ImTextureID)DrawListRasterizer::TextureId(texture);
+    command.VtxOffset = (unsigned int)list.VtxBuffer.Size;
+    command.IdxOffset = (unsigned int)list.IdxBuffer.Size;
+    command.ElemCount = (unsigned int)count;
+    for (int i = 0; i < count; i++) {
+        list.VtxBuffer.push_back(vertices[i]);
+        list.IdxBuffer.push_back((ImDrawIdx)i);
+    }
+    list.CmdBuffer.push_back(command);
+}
+
+static ImDrawVert Vertex(float x, float y, uint32_t color, float u = 0.0f, float v = 0.0f) {
+    ImDrawVert vertex;
+    vertex.pos = ImVec2(x, y);
+    vertex.uv = ImVec2(u, v);
+    vertex.col = color;
+    return vertex;
+}
+
+static void SetDisplay(ImDrawData& data, ImDrawList& list, int width, int height) {
+    data.Clear();
+    data.Valid = true;
+    data.CmdLists.push_back(&list);
+    data.CmdListsCount = 1;
+    data.DisplayPos = ImVec2(0.0f, 0.0f);
+    data.DisplaySize = ImVec2((float)width, (float)height);
+    data.FramebufferScale = ImVec2(1.0f, 1.0f);
+}
+
+bool DrawListRasterizer::RunSelfTest(std::string& failure) {
+    failure.clear();
+    bool wasScalar = forceScalar;
+    const ImVec4 noClip(0.0f, 0.0f, 4096.0f, 4096.0f);
+    const uint32_t translucent = IM_COL32(255, 128, 0, 128);
+    const uint32_t expected = ConvertColor(translucent);
+
+    for (int pass = 0; pass < 2 && failure.empty(); pass++) {
+        forceScalar = pass == 1;
+        DrawListRasterizer rasterizer;
+        Canvas target;
+        ImDrawData data;
+
+        // A quad split on its diagonal plus an octagon fan around (40.3, 20.7):
+        // every covered pixel blended exactly once, no holes
+        ImDrawList shapes(nullptr);
+        ImDrawVert quad[6] = {Vertex(2, 3, translucent),  Vertex(20, 3, translucent),  Vertex(20, 15, translucent),
+                              Vertex(2, 3, translucent),  Vertex(20, 15, translucent), Vertex(2, 15, translucent)};
+        AddTriangles(shapes, quad, 6, noClip, nullptr);
+        ImDrawVert fan[24];
+        for (int i = 0; i < 8; i++) {
+            float a0 = (float)i * 0.785398f, a1 = (float)(i + 1) * 0.785398f;
+            fan[i * 3] = Vertex(40.3f, 20.7f, translucent);
+            fan[i * 3 + 1] = Vertex(40.3f + 12.0f * std::cos(a0), 20.7f + 12.0f * std::sin(a0), translucent);
+            fan[i * 3 + 2] = Vertex(40.3f + 12.0f * std::cos(a1), 20.7f + 12.0f * std::sin(a1), translucent);
+        }
+        AddTriangles(shapes, fan, 24, noClip, nullptr);
+        SetDisplay(data, shapes, 61, 37);
+        rasterizer.Render(&data, target);
+        for (int y = 0; y < 37 && failure.empty(); y++) {
+            for (int x = 0; x < 61; x++) {
+                uint32_t pixel = target.Row(y)[x];
+                bool inQuad = x >= 2 && x < 20 && y >= 3 && y < 15;
+                float dx = (float)x + 0.5f - 40.3f, dy = (float)y + 0.5f - 20.7f;
+                bool inFan = dx * dx + dy * dy < 10.5f * 10.5f;
+                if ((inQuad || inFan) ? pixel != expected : x < 24 && pixel != 0) {
+                    failure = "shared edges: pixel " + std::to_string(x) + "," + std::to_string(y) +
+                              " blended twice, missed or drawn outside";
+                    break;
+                }
+                if (pixel != 0 && pixel != expected) {
+                    failure = "fan: pixel " + std::to_string(x) + "," + std::to_string(y) + " blended twice";
+                    break;
+                }
+            }
+        }
+        if (!failure.empty()) {
+            break;
+        }
+        if (!rasterizer.Render(&data, target).Empty()) {
+            failure = "an identical frame reported a change";
+            break;
+        }
+
+        // The same quad clipped, then a texture mapped 1:1 onto a quad at
+        // (5, 4): an exact copy
+        ImDrawList clipped(nullptr);
+        AddTriangles(clipped, quad, 6, ImVec4(5.0f, 5.0f, 10.0f, 8.0f), nullptr);
+        Canvas texture(13, 9);
+        uint32_t state = 777;
+        for (int y = 0; y < 9; y++) {
+            for (int x = 0; x < 13; x++) {
+                texture.Row(y)[x] = Canvas::Premultiply(NextRandom(state));
+            }
+        }
+        const uint32_t white = IM_COL32(255, 255, 255, 255);
+        ImDrawVert image[6] = {Vertex(30, 4, white, 0, 0),  Vertex(43, 4, white, 1, 0),
+                               Vertex(43, 13, white, 1, 1), Vertex(30, 4, white, 0, 0),
+                               Vertex(43, 13, white, 1, 1), Vertex(30, 13, white, 0, 1)};
+        AddTriangles(clipped, image, 6, noClip, &texture);
+        SetDisplay(data, clipped, 61, 37);
+        Canvas previous = target;
+        CanvasRect changed = rasterizer.Render(&data, target);
+        // Whole tiles across, exact rows
+        CanvasRect differing;
+        for (int y = 0; y < 37; y++) {
+            for (int x = 0; x < 61; x++) {
+                if (target.Row(y)[x] != previous.Row(y)[x]) {
+                    differing = differing.Union({x, y, x + 1, y + 1});
+                }
+            }
+        }
+        CanvasRect expectedChange = {differing.x0 / TILE_SIZE * TILE_SIZE, differing.y0,
+                                     std::min((differing.x1 + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE, 61),
+                                     differing.y1};
+        for (int y = 0; y < 37 && failure.empty(); y++) {
+            for (int x = 0; x < 61; x++) {
+                uint32_t want = x >= 5 && x < 10 && y >= 5 && y < 8       ? expected
+                                : x >= 30 && x < 43 && y >= 4 && y < 13 ? texture.Row(y - 4)[x - 30]
+                                                                         : 0;
+                if (target.Row(y)[x] != want) {
+                    failure = "clip or texture copy: pixel " + std::to_string(x) + "," + std::to_string(y);
+                    break;
+                }
+            }
+        }
+        if (failure.empty() && (differing.Empty() || !(changed == expectedChange))) {
+            failure = "changed area of the second frame";
+        }
+        if (!failure.empty()) {
+            break;
+        }
+
+        // Alpha 0 to 255 across 256 pixels: each column one step
+        ImDrawList gradient(nullptr);
+        const uint32_t clear = IM_COL32(255, 255, 255, 0);
+        ImDrawVert ramp[6] = {Vertex(0, 0, clear), Vertex(256, 0, white), Vertex(256, 2, white),
+                              Vertex(0, 0, clear), Vertex(256, 2, white), Vertex(0, 2, clear)};
+        AddTriangles(gradient, ramp, 6, noClip, nullptr);
+        SetDisplay(data, gradient, 256, 2);
+        rasterizer.Render(&data, target);
+        for (int x = 0; x < 256; x++) {
+            uint32_t alpha = (uint32_t)((x + 0.5) * 255.0 / 256.0 + 0.5);
+            if (target.Row(1)[x] != (alpha * 0x01010101u)) {
+                failure = "smooth colour: column " + std::to_string(x);
+                break;
+            }
+        }
+    }
+
+    // Random triangles, colours, UVs and clips over several tiles: SIMD
+    // and scalar, binned and not, produce the same bytes
+    if (failure.empty()) {
+        Canvas texture(17, 11);
+        uint32_t state = 4242;
+        for (int y = 0; y < 11; y++) {
+            for (int x = 0; x < 17; x++) {
+                texture.Row(y)[x] = Canvas::Premultiply(NextRandom(state));
+            }
+        }
+        ImDrawList random(nullptr);
+        for (int command = 0; command < 40; command++) {
+            float x0 = (float)((NextRandom(state) >> 24) % 90) - 10.0f;
+            float y0 = (float)((NextRandom(state) >> 24) % 70) - 10.0f;
+            ImVec4 clip(x0, y0, x0 + (float)(NextRandom(state) >> 26) + 4.0f,
+                        y0 + (float)(NextRandom(state) >> 26) + 4.0f);
+            if (command % 5 == 0) {
+                clip = noClip;
+            }
+            ImDrawVert vertices[30];
+            bool flat = NextRandom(state) & 1;
+            uint32_t color = NextRandom(state);
+            for (ImDrawVert& vertex : vertices) {
+                vertex = Vertex((float)(NextRandom(state) % 1000) / 10.0f - 10.0f,
+                                (float)(NextRandom(state) % 700) / 10.0f - 10.0f, flat ? color : NextRandom(state),
+                                (float)(NextRandom(state) % 100) / 80.0f - 0.1f,
+                                (float)(NextRandom(state) % 100) / 80.0f - 0.1f);
+            }
+            AddTriangles(random, vertices, 30, clip, command % 3 == 0 ? nullptr : &texture);
+        }
+        ImDrawData data;
+        SetDisplay(data, random, 77, 53);
+        Canvas results[4];
+        for (int mode = 0; mode < 4; mode++) {
+            forceScalar = (mode & 1) != 0;
+            DrawListRasterizer rasterizer;
+            rasterizer.SetBinning(mode < 2);
+            rasterizer.Render(&data, results[mode]);
+            if (mode > 0 && memcmp(results[mode].Row(0), results[0].Row(0), 77 * 53 * sizeof(uint32_t)) != 0) {
+                failure = mode == 1 ? "random triangles: scalar differs from SIMD"
+                                    : "random triangles: unbinned differs from binned";
+                break;
+            }
+        }
+    }
+
+    forceScalar = wasScalar;
+    return failure.empty();
+}
@@ -0,0 +1,366 @@
+#include "../include/event_loop.h"
+#include "../include/logger.h"
+#include <cstring>
+
+HANDLE EventLoop::port = nullptr;
+DWORD EventLoop::loopThreadId = 0;
+std::atomic<bool> EventLoop::running(false);
+LARGE_INTEGER EventLoop::startCounter = {};
+LARGE_INTEGER EventLoop::frequency = {};
+uint64_t EventLoop::currentTick = 0;
+LoopTimer* EventLoop::wheel[EventLoop::WHEEL_LEVELS][EventLoop::WHEEL_SLOTS] = {};
+uint32_t EventLoop::armedTimers = 0;
+bool EventLoop::backgroundTasks = false;
+LoopCallback EventLoop::wakeupHook = nullptr;
+void* EventLoop::wakeupHookContext = nullptr;
+EventLoop::Stats EventLoop::stats = {};
+uint64_t EventLoop::statsResetTick = 0;
+uint64_t EventLoop::latenessSamples = 0;
+double EventLoop::latenessTotalMs = 0.0;
+
+// Completion keys of internal packets; handler keys are pointers and never this small
+enum LoopPacketKey : ULONG_PTR {
+    LOOP_KEY_STOP = 1,
+    LOOP_KEY_POST = 2,
+    LOOP_KEY_WAITABLE = 3
+};
+
+struct PostedTask {
+    LoopCallback callback;
+    void* context;
+};
+
+bool EventLoop::Initialize() {
+    port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+    if (!port) {
+        LOG_WIN32_ERROR("Failed to create event loop completion port");
+        return false;
+    }
+
+    loopThreadId = GetCurrentThreadId();
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&startCounter);
+    currentTick = 0;
+    memset(wheel, 0, sizeof(wheel));
+    armedTimers = 0;
+    ResetStats();
+
+    Logger::Info("Event loop initialized on thread " + std::to_string(loopThreadId));
+    return true;
+}
+
+uint64_t EventLoop::GetTickMs() {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((now.QuadPart - startCounter.QuadPart) * 1000 / frequency.QuadPart);
+}
+
+// The level is chosen by distance to expiry, the slot by the expiry bits of
+// that level, so a timer cascades down exactly when its slot comes around
+void EventLoop::InsertTimer(LoopTimer* timer) {
+    const uint64_t maxDelta = (1ull << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    if (timer->expiry < currentTick) {
+        timer->expiry = currentTick;
+    } else if (timer->expiry - currentTick > maxDelta) {
+        timer->expiry = currentTick + maxDelta;
+    }
+
+    uint64_t delta = timer->expiry - currentTick;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1ull << (WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    LoopTimer** slot = &wheel[level][(timer->expiry >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+
+    timer->prev = nullptr;
+    timer->next = *slot;
+    if (*slot) {
+        (*slot)->prev = timer;
+    }
+    *slot = timer;
+    timer->slot = slot;
+}
+
+void EventLoop::UnlinkTimer(LoopTimer* timer) {
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        *timer->slot = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    timer->next = nullptr;
+    timer->prev = nullptr;
+    timer->slot = nullptr;
+}
+
+void EventLoop::AddTimer(LoopTimer* timer, uint32_t delayMs, uint32_t intervalMs) {
+    if (timer->slot) {
+        UnlinkTimer(timer);
+    } else {
+        armedTimers++;
+    }
+    timer->intervalMs = intervalMs;
+    timer->expiry = currentTick + (delayMs ? delayMs : 1);
+    InsertTimer(timer);
+}
+
+void EventLoop::CancelTimer(LoopTimer* timer) {
+    if (timer->slot) {
+        UnlinkTimer(timer);
+        armedTimers--;
+    }
+}
+
+// Moves every timer of the slot that just came due one level down
+void EventLoop::Cascade(int level) {
+    LoopTimer** slot = &wheel[level][(currentTick >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+    LoopTimer* timer = *slot;
+    *slot = nullptr;
+    while (timer) {
+        LoopTimer* next = timer->next;
+        InsertTimer(timer);
+        timer = next;
+    }
+}
+
+void EventLoop::AdvanceTo(uint64_t target) {
+    while (currentTick < target && armedTimers > 0) {
+        currentTick++;
+        int topLevel = 0;
+        while (topLevel + 1 < WHEEL_LEVELS && (currentTick & ((1ull << (WHEEL_BITS * (topLevel + 1))) - 1)) == 0) {
+            topLevel++;
+        }
+        for (int level = topLevel; level >= 1; level--) {
+            Cascade(level);
+        }
+
+        // Pop one at a time: a callback may cancel or re-add any timer
+        LoopTimer** slot = &wheel[0][currentTick & (WHEEL_SLOTS - 1)];
+        while (*slot) {
+            LoopTimer* timer = *slot;
+            UnlinkTimer(timer);
+
+            double lateness = (double)(target - timer->expiry);
+            latenessSamples++;
+            latenessTotalMs += lateness;
+            if (lateness > stats.maxLatenessMs) {
+                stats.maxLatenessMs = lateness;
+            }
+            stats.timersFired++;
+
+            if (timer->intervalMs) {
+                // After a stall, skip the missed periods instead of firing them back to back
+                uint64_t next = timer->expiry + timer->intervalMs;
+                timer->expiry = (next > target) ? next : target + timer->intervalMs;
+                InsertTimer(timer);
+            } else {
+                armedTimers--;
+            }
+
+            bool background = timer->background && backgroundTasks;
+            if (background) {
+                SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+            }
+            timer->callback(timer->context);
+            if (background) {
+                SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+            }
+        }
+    }
+
+    // Nothing armed: keep the wheel position current for the next AddTimer
+    if (currentTick < target) {
+        currentTick = target;
+    }
+}
+
+// Ticks until the earliest populated slot comes due: directly for level 0,
+// at its cascade for the higher levels
+DWORD EventLoop::NextTimeout() {
+    if (armedTimers == 0) {
+        return INFINITE;
+    }
+    uint64_t nearest = ~0ull;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        int shift = WHEEL_BITS * level;
+        for (uint64_t i = 1; i <= WHEEL_SLOTS; i++) {
+            if (wheel[level][((currentTick >> shift) + i) & (WHEEL_SLOTS - 1)]) {
+                uint64_t due = ((currentTick >> shift) + i) << shift;
+                if (due < nearest) {
+                    nearest = due;
+                }
+                break;
+            }
+        }
+    }
+    return (DWORD)(nearest - currentTick);
+}
+
+void EventLoop::SetWakeupHook(LoopCallback hook, void* context) {
+    wakeupHook = hook;
+    wakeupHookContext = context;
+}
+
+bool EventLoop::Post(LoopCallback callback, void* context) {
+    if (!port) {
+        return false;
+    }
+    PostedTask* task = new PostedTask{ callback, context };
+    if (!PostQueuedCompletionStatus(port, 0, LOOP_KEY_POST, reinterpret_cast<OVERLAPPED*>(task))) {
+        delete task;
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::Stop() {
+    running = false;
+    if (port) {
+        PostQueuedCompletionStatus(port, 0, LOOP_KEY_STOP, nullptr);
+    }
+}
+
+// Thread pool callback: forward readiness to the loop thread
+VOID CALLBACK EventLoop::OnWaitableSignaled(PVOID context, BOOLEAN timedOut) {
+    PostQueuedCompletionStatus(port, 0, LOOP_KEY_WAITABLE, static_cast<OVERLAPPED*>(context));
+}
+
+void EventLoop::ArmWaitable(LoopWaitable* waitable) {
+    if (!RegisterWaitForSingleObject(&waitable->wait, waitable->handle, OnWaitableSignaled, waitable,
+                                     INFINITE, WT_EXECUTEONLYONCE | WT_EXECUTEINWAITTHREAD)) {
+        waitable->wait = nullptr;
+        waitable->active = false;
+        LOG_WIN32_ERROR("Failed to register waitable handle with the event loop");
+    }
+}
+
+bool EventLoop::AddWaitable(LoopWaitable* waitable) {
+    waitable->active = true;
+    ArmWaitable(waitable);
+    return waitable->active;
+}
+
+void EventLoop::RemoveWaitable(LoopWaitable* waitable) {
+    waitable->active = false;
+    if (waitable->wait) {
+        UnregisterWait(waitable->wait);
+        waitable->wait = nullptr;
+    }
+}
+
+bool EventLoop::AssociateHandle(HANDLE handle, LoopIoHandler* handler) {
+    if (!CreateIoCompletionPort(handle, port, reinterpret_cast<ULONG_PTR>(handler), 0)) {
+        LOG_WIN32_ERROR("Failed to associate handle with the event loop");
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::Dispatch(DWORD bytes, ULONG_PTR key, OVERLAPPED* overlapped, DWORD error) {
+    switch (key) {
+    case LOOP_KEY_STOP:
+        break;
+
+    case LOOP_KEY_POST: {
+        PostedTask* task = reinterpret_cast<PostedTask*>(overlapped);
+        stats.posts++;
+        task->callback(task->context);
+        delete task;
+        break;
+    }
+
+    case LOOP_KEY_WAITABLE: {
+        LoopWaitable* waitable = reinterpret_cast<LoopWaitable*>(overlapped);
+        // One-shot wait already fired; release it before re-arming
+        if (waitable->wait) {
+            UnregisterWait(waitable->wait);
+            waitable->wait = nullptr;
+        }
+        if (waitable->active) {
+            stats.waitableSignals++;
+            waitable->callback(waitable->context);
+        }
+        if (waitable->active) {
+            ArmWaitable(waitable);
+        }
+        break;
+    }
+
+    default: {
+        LoopIoHandler* handler = reinterpret_cast<LoopIoHandler*>(key);
+        stats.ioCompletions++;
+        handler->callback(handler->context, overlapped, bytes, error);
+        break;
+    }
+    }
+}
+
+void EventLoop::Run() {
+    Logger::Info("Event loop running");
+    running = true;
+
+    LARGE_INTEGER busyStart, busyEnd;
+
+    while (running) {
+        QueryPerformanceCounter(&busyStart);
+        AdvanceTo(GetTickMs());
+        DWORD timeout = NextTimeout();
+        QueryPerformanceCounter(&busyEnd);
+        stats.busyMs += (double)(busyEnd.QuadPart - busyStart.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+
+        if (!running) {
+            break;
+        }
+
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED* overlapped = nullptr;
+        BOOL ok = GetQueuedCompletionStatus(port, &bytes, &key, &overlapped, timeout);
+        DWORD error = ok ? 0 : GetLastError();
+        stats.wakeups++;
+        if (wakeupHook) {
+            wakeupHook(wakeupHookContext);
+        }
+
+        if (!ok && overlapped == nullptr) {
+            if (error == WAIT_TIMEOUT) {
+                continue;
+            }
+            LOG_WIN32_ERROR("Event loop wait failed");
+            break;
+        }
+
+        QueryPerformanceCounter(&busyStart);
+        Dispatch(bytes, key, overlapped, error);
+        QueryPerformanceCounter(&busyEnd);
+        stats.busyMs += (double)(busyEnd.QuadPart - busyStart.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+    }
+
+    running = false;
+    Logger::Info("Event loop stopped");
+}
+
+void EventLoop::Shutdown() {
+    // After Run() returned, or at process termination; pending tasks are abandoned
+    running = false;
+    if (port) {
+        CloseHandle(port);
+        port = nullptr;
+    }
+}
+
+EventLoop::Stats EventLoop::GetStats() {
+    Stats result = stats;
+    result.averageLatenessMs = latenessSamples ? latenessTotalMs / (double)latenessSamples : 0.0;
+    result.elapsedMs = (double)(GetTickMs() - statsResetTick);
+    return result;
+}
+
+void EventLoop::ResetStats() {
+    stats = Stats();
+    statsResetTick = GetTickMs();
+    latenessSamples = 0;
+    latenessTotalMs = 0.0;
+}
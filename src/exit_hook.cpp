@@ -0,0 +1,57 @@
+#include "../include/exit_hook.h"
+#include "../include/logger.h"
+#include <detours.h>
+
+LoopCallback ExitHook::shutdownTask = nullptr;
+void* ExitHook::shutdownContext = nullptr;
+DWORD ExitHook::timeout = 0;
+HANDLE ExitHook::doneEvent = nullptr;
+std::atomic<bool> ExitHook::exiting(false);
+
+static VOID (WINAPI* TrueExitProcess)(UINT) = ExitProcess;
+
+void ExitHook::OnExitTask(void* context) {
+    shutdownTask(shutdownContext);
+    SetEvent(doneEvent);
+}
+
+VOID WINAPI ExitHook::HookedExitProcess(UINT exitCode) {
+    // Only the first caller shuts down; the hook stays in place until the end
+    if (!exiting.exchange(true)) {
+        if (EventLoop::IsLoopThread()) {
+            shutdownTask(shutdownContext);
+        } else if (EventLoop::Post(OnExitTask, nullptr)) {
+            WaitForSingleObject(doneEvent, timeout);
+        }
+    }
+    TrueExitProcess(exitCode);
+}
+
+bool ExitHook::Install(LoopCallback shutdown, void* context, DWORD timeoutMs) {
+    if (shutdownTask) {
+        return true;
+    }
+    // Created up front so the exit path has nothing left to fail on
+    doneEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    if (!doneEvent) {
+        LOG_WIN32_ERROR("Exit hook unavailable");
+        return false;
+    }
+    shutdownTask = shutdown;
+    shutdownContext = context;
+    timeout = timeoutMs;
+
+    DetourTransactionBegin();
+    DetourAttach(&(PVOID&)TrueExitProcess, (PVOID)HookedExitProcess);
+    LONG error = DetourTransactionCommit();
+    if (error != NO_ERROR) {
+        Logger::Error("Exit hook not installed, error " + std::to_string(error) +
+                      " - shutdown is left to the process teardown");
+        shutdownTask = nullptr;
+        CloseHandle(doneEvent);
+        doneEvent = nullptr;
+        return false;
+    }
+    Logger::Info("Exit hook installed");
+    return true;
+}
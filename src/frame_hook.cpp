@@ -0,0 +1,128 @@
+#include "../include/frame_hook.h"
+#include "../include/memory_reader.h"
+#include "../include/scheduling_policy.h"
+#include "../include/logger.h"
+#include <detours.h>
+
+std::atomic<FrameSampler*> FrameHook::activeSampler(nullptr);
+FrameSampler* FrameHook::sampler = nullptr;
+DWORD FrameHook::gameThreadId = 0;
+
+static BOOL (WINAPI* TruePeekMessageA)(LPMSG, HWND, UINT, UINT, UINT) = PeekMessageA;
+static BOOL (WINAPI* TruePeekMessageW)(LPMSG, HWND, UINT, UINT, UINT) = PeekMessageW;
+
+class LiveFrameSource : public FrameStateSource {
+public:
+    bool Capture(MemorySnapshot& snapshot) override {
+        return MemoryReader::CaptureBlocks(snapshot);
+    }
+};
+
+class QpcFrameClock : public FrameClock {
+public:
+    QpcFrameClock() {
+        QueryPerformanceFrequency(&frequency);
+    }
+    uint64_t NowMicros() override {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        return (uint64_t)(now.QuadPart / frequency.QuadPart * 1000000 +
+                          now.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+    }
+
+private:
+    LARGE_INTEGER frequency;
+};
+
+static LiveFrameSource liveSource;
+static QpcFrameClock qpcClock;
+
+// Only the game thread's pump marks frames; other threads may pump too
+void FrameHook::OnMessagePump() {
+    if (GetCurrentThreadId() != gameThreadId) {
+        return;
+    }
+    FrameSampler* current = activeSampler.load(std::memory_order_acquire);
+    if (current) {
+        current->OnFrame();
+    }
+}
+
+BOOL WINAPI FrameHook::HookedPeekMessageA(LPMSG msg, HWND hwnd, UINT filterMin, UINT filterMax, UINT removeMsg) {
+    BOOL result = TruePeekMessageA(msg, hwnd, filterMin, filterMax, removeMsg);
+    if (!result) {
+        OnMessagePump();
+    }
+    return result;
+}
+
+BOOL WINAPI FrameHook::HookedPeekMessageW(LPMSG msg, HWND hwnd, UINT filterMin, UINT filterMax, UINT removeMsg) {
+    BOOL result = TruePeekMessageW(msg, hwnd, filterMin, filterMax, removeMsg);
+    if (!result) {
+        OnMessagePump();
+    }
+    return result;
+}
+
+// Patches or restores both functions with the game thread suspended, so it
+// cannot be executing the bytes being rewritten
+bool FrameHook::Transaction(bool attach) {
+    HANDLE thread = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_SET_CONTEXT, FALSE, gameThreadId);
+    if (!thread) {
+        LOG_WIN32_ERROR("Failed to open the game thread for hooking");
+        return false;
+    }
+    
+    DetourTransactionBegin();
+    DetourUpdateThread(thread);
+    if (attach) {
+        DetourAttach(&(PVOID&)TruePeekMessageA, (PVOID)HookedPeekMessageA);
+        DetourAttach(&(PVOID&)TruePeekMessageW, (PVOID)HookedPeekMessageW);
+    } else {
+        DetourDetach(&(PVOID&)TruePeekMessageA, (PVOID)HookedPeekMessageA);
+        DetourDetach(&(PVOID&)TruePeekMessageW, (PVOID)HookedPeekMessageW);
+    }
+    LONG error = DetourTransactionCommit();
+    CloseHandle(thread);
+    
+    if (error != NO_ERROR) {
+        Logger::Error(std::string("Detours transaction failed (") + (attach ? "attach" : "detach") +
+                      "), error " + std::to_string(error));
+        return false;
+    }
+    return true;
+}
+
+bool FrameHook::Install(uint32_t budgetUs, uint32_t minFrameIntervalUs) {
+    if (activeSampler.load()) {
+        return true;
+    }
+    gameThreadId = SchedulingPolicy::GetGameThreadId();
+    if (gameThreadId == 0) {
+        Logger::Warning("Frame sampling unavailable: game thread not found - using timer sampling");
+        return false;
+    }
+    
+    if (!sampler) {
+        sampler = new FrameSampler(&liveSource, &qpcClock, budgetUs, minFrameIntervalUs);
+    }
+    activeSampler.store(sampler, std::memory_order_release);
+    if (!Transaction(true)) {
+        activeSampler.store(nullptr, std::memory_order_release);
+        Logger::Warning("Frame sampling hook not installed - using timer sampling");
+        return false;
+    }
+    
+    Logger::Info("Frame sampling enabled on game thread " + std::to_string(gameThreadId) +
+                 ", budget " + std::to_string(budgetUs) + " us per frame");
+    return true;
+}
+
+void FrameHook::Remove() {
+    if (!activeSampler.load()) {
+        return;
+    }
+    activeSampler.store(nullptr, std::memory_order_release);
+    Transaction(false);
+    Logger::Info("Frame sampling hook removed");
+}
@@ -0,0 +1,209 @@
+#include "../include/frame_sampler.h"
+
+FrameSampler::FrameSampler(FrameStateSource* source, FrameClock* clock, uint32_t budgetUs, uint32_t minFrameIntervalUs)
+    : source(source), clock(clock), budgetUs(budgetUs ? budgetUs : 1), minFrameIntervalUs(minFrameIntervalUs) {
+}
+
+void FrameSampler::OnFrame() {
+    uint64_t start = clock->NowMicros();
+    if (seenFrame && start - lastFrameUs < minFrameIntervalUs) {
+        return;
+    }
+    seenFrame = true;
+    lastFrameUs = start;
+    frameCounter++;
+    frames.fetch_add(1, std::memory_order_relaxed);
+
+    if (skipFrames > 0) {
+        skipFrames--;
+        skipped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    FrameSnapshot* slot = queue.ProducerSlot();
+    if (!slot) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    bool captured = source->Capture(slot->blocks);
+    uint64_t elapsed = clock->NowMicros() - start;
+
+    totalCaptureUs.fetch_add(elapsed, std::memory_order_relaxed);
+    if (elapsed > maxCaptureUs.load(std::memory_order_relaxed)) {
+        maxCaptureUs.store(elapsed, std::memory_order_relaxed);
+    }
+    if (elapsed > budgetUs) {
+        // Pay the overrun back out of the next frames
+        overBudget.fetch_add(1, std::memory_order_relaxed);
+        uint64_t skip = elapsed / budgetUs;
+        skipFrames = (uint32_t)(skip < MAX_SKIP_FRAMES ? skip : MAX_SKIP_FRAMES);
+    }
+
+    if (!captured) {
+        failed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    slot->frame = frameCounter;
+    slot->timestampUs = start;
+    queue.Commit();
+    sampled.fetch_add(1, std::memory_order_relaxed);
+}
+
+FrameSampler::Stats FrameSampler::GetStats() const {
+    Stats stats;
+    stats.frames = frames.load(std::memory_order_relaxed);
+    stats.sampled = sampled.load(std::memory_order_relaxed);
+    stats.skipped = skipped.load(std::memory_order_relaxed);
+    stats.overBudget = overBudget.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.failed = failed.load(std::memory_order_relaxed);
+    stats.maxCaptureUs = maxCaptureUs.load(std::memory_order_relaxed);
+    uint64_t captures = stats.sampled + stats.failed;
+    stats.averageCaptureUs = captures ? (double)totalCaptureUs.load(std::memory_order_relaxed) / captures : 0.0;
+    return stats;
+}
+
+// Counters only; the producer's frame state is left alone
+void FrameSampler::ResetStats() {
+    frames = 0;
+    sampled = 0;
+    skipped = 0;
+    overBudget = 0;
+    dropped = 0;
+    failed = 0;
+    maxCaptureUs = 0;
+    totalCaptureUs = 0;
+}
+
+namespace {
+
+class SimulatedClock : public FrameClock {
+public:
+    uint64_t now = 0;
+    uint64_t NowMicros() override { return now; }
+};
+
+// Each capture advances the clock by its cost and stamps the capture number
+class SimulatedSource : public FrameStateSource {
+public:
+    SimulatedClock* clock = nullptr;
+    uint32_t costUs = 50;
+    uint32_t captures = 0;
+
+    bool Capture(MemorySnapshot& snapshot) override {
+        clock->now += costUs;
+        captures++;
+        snapshot.moduleGeneration = 0;
+        snapshot.blockBase[0] = captures;
+        return true;
+    }
+};
+
+const uint64_t FRAME_US = 16667;
+
+}
+
+bool FrameSampler::RunSelfTest(std::string& failure) {
+    failure.clear();
+    
+    // Steady 60 fps with the pump polled every millisecond between frames:
+    // one sample per frame, delivered in order
+    {
+        SimulatedClock clock;
+        SimulatedSource source;
+        source.clock = &clock;
+        FrameSampler sampler(&source, &clock, 200, 12000);
+        uint64_t expected = 1;
+        for (int frame = 0; frame < 600; frame++) {
+            uint64_t frameStart = clock.now;
+            for (int poll = 0; poll < 10; poll++) {
+                sampler.OnFrame();
+                clock.now += 1000;
+            }
+            clock.now = frameStart + FRAME_US;
+            if (frame % 6 == 5) {
+                for (const FrameSnapshot* snapshot = sampler.Front(); snapshot; snapshot = sampler.Front()) {
+                    if (snapshot->frame != expected || snapshot->blocks.blockBase[0] != expected) {
+                        failure = "steady: frame " + std::to_string(snapshot->frame) + " out of order, expected " +
+                                  std::to_string(expected);
+                        return false;
+                    }
+                    expected++;
+                    sampler.Pop();
+                }
+            }
+        }
+        Stats stats = sampler.GetStats();
+        if (stats.frames != 600 || stats.sampled != 600 || stats.skipped != 0 || stats.dropped != 0) {
+            failure = "steady: " + std::to_string(stats.frames) + " frames, " + std::to_string(stats.sampled) +
+                      " sampled, " + std::to_string(stats.skipped) + " skipped, " + std::to_string(stats.dropped) + " dropped";
+            return false;
+        }
+    }
+    
+    // One slow capture is paid back by skipping the next frames
+    {
+        SimulatedClock clock;
+        SimulatedSource source;
+        source.clock = &clock;
+        FrameSampler sampler(&source, &clock, 200, 12000);
+        for (int frame = 0; frame < 10; frame++) {
+            source.costUs = (frame == 2) ? 700 : 50;
+            uint64_t frameStart = clock.now;
+            sampler.OnFrame();
+            clock.now = frameStart + FRAME_US;
+        }
+        Stats stats = sampler.GetStats();
+        if (stats.overBudget != 1 || stats.skipped != 3 || stats.sampled != 7 || stats.maxCaptureUs != 700) {
+            failure = "over budget: " + std::to_string(stats.overBudget) + " over, " + std::to_string(stats.skipped) +
+                      " skipped, " + std::to_string(stats.sampled) + " sampled";
+            return false;
+        }
+    }
+    
+    // Always-slow captures still average within the budget per frame
+    {
+        SimulatedClock clock;
+        SimulatedSource source;
+        source.clock = &clock;
+        source.costUs = 1000;
+        FrameSampler sampler(&source, &clock, 200, 12000);
+        for (int frame = 0; frame < 600; frame++) {
+            uint64_t frameStart = clock.now;
+            sampler.OnFrame();
+            clock.now = frameStart + FRAME_US;
+            while (sampler.Front()) {
+                sampler.Pop();
+            }
+        }
+        Stats stats = sampler.GetStats();
+        double perFrameUs = (double)(stats.sampled * source.costUs) / stats.frames;
+        if (perFrameUs > 200.0) {
+            failure = "slow source: " + std::to_string(perFrameUs) + " us of capture per frame";
+            return false;
+        }
+    }
+    
+    // A stalled consumer loses the newest frames, never blocks the producer
+    {
+        SimulatedClock clock;
+        SimulatedSource source;
+        source.clock = &clock;
+        FrameSampler sampler(&source, &clock, 200, 12000);
+        for (int frame = 0; frame < 100; frame++) {
+            uint64_t frameStart = clock.now;
+            sampler.OnFrame();
+            clock.now = frameStart + FRAME_US;
+        }
+        Stats stats = sampler.GetStats();
+        const FrameSnapshot* oldest = sampler.Front();
+        if (stats.sampled != QUEUE_SIZE || stats.dropped != 100 - QUEUE_SIZE || !oldest || oldest->frame != 1) {
+            failure = "stalled consumer: " + std::to_string(stats.sampled) + " sampled, " +
+                      std::to_string(stats.dropped) + " dropped";
+            return false;
+        }
+    }
+    
+    return true;
+}
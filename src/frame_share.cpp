@@ -0,0 +1,329 @@
+#include "../include/frame_share.h"
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+static_assert(sizeof(FrameShareSlot) == 64, "FrameShareSlot layout is shared with other processes");
+static_assert(sizeof(FrameShareHeader) == 64 + 64 * FRAME_SHARE_BUFFERS, "FrameShareHeader layout is shared");
+
+static const int READ_ATTEMPTS = 4;
+
+size_t FrameShare::MappingSize(uint32_t capacity) {
+    return sizeof(FrameShareHeader) + (size_t)capacity * FRAME_SHARE_BUFFERS;
+}
+
+uint32_t FrameShare::Checksum(const uint32_t* pixels, size_t count) {
+    const uint32_t prime = 16777619u;
+    uint32_t lanes[4] = {2166136261u, 2166136261u ^ 1, 2166136261u ^ 2, 2166136261u ^ 3};
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        lanes[0] = (lanes[0] ^ pixels[i]) * prime;
+        lanes[1] = (lanes[1] ^ pixels[i + 1]) * prime;
+        lanes[2] = (lanes[2] ^ pixels[i + 2]) * prime;
+        lanes[3] = (lanes[3] ^ pixels[i + 3]) * prime;
+    }
+    for (; i < count; i++) {
+        lanes[i & 3] = (lanes[i & 3] ^ pixels[i]) * prime;
+    }
+    uint32_t hash = 2166136261u;
+    for (uint32_t lane : lanes) {
+        hash = (hash ^ lane) * prime;
+    }
+    return hash;
+}
+
+FrameShareWriter::FrameShareWriter(void* memory, uint32_t capacity)
+    : base((uint8_t*)memory), frame(0), width(0), height(0), stats() {
+    header = new (memory) FrameShareHeader();
+    header->magic = FRAME_SHARE_MAGIC;
+    header->version = FRAME_SHARE_VERSION;
+    header->headerSize = sizeof(FrameShareHeader);
+    header->bufferCount = FRAME_SHARE_BUFFERS;
+    header->capacity = capacity;
+    header->format = FRAME_FORMAT_BGRA_PREMULTIPLIED;
+    for (uint32_t i = 0; i < FRAME_SHARE_BUFFERS; i++) {
+        header->slots[i].sequence.store(0, std::memory_order_relaxed);
+        header->slots[i].offset = (uint32_t)(sizeof(FrameShareHeader) + (size_t)capacity * i);
+        slotFrame[i] = 0;
+    }
+    header->closed.store(0, std::memory_order_relaxed);
+    header->latest.store(FRAME_SHARE_NONE, std::memory_order_release);
+}
+
+bool FrameShareWriter::Publish(const Canvas& image, const CanvasRect& dirty) {
+    size_t bytes = (size_t)image.GetWidth() * image.GetHeight() * 4;
+    if (bytes == 0 || bytes > header->capacity) {
+        stats.tooLarge++;
+        return false;
+    }
+    frame++;
+    CanvasRect changed = dirty.Intersect(image.GetBounds());
+    if (image.GetWidth() != width || image.GetHeight() != height) {
+        // Every buffer holds the old size now
+        width = image.GetWidth();
+        height = image.GetHeight();
+        changed = image.GetBounds();
+        for (uint64_t& held : slotFrame) {
+            held = 0;
+        }
+    }
+    history[frame % FRAME_SHARE_BUFFERS] = changed;
+
+    // Round robin: the target held frame - BUFFERS, so it misses exactly the
+    // changes of the frames since, all of which are in history
+    uint32_t index = (uint32_t)(frame % FRAME_SHARE_BUFFERS);
+    CanvasRect copy = image.GetBounds();
+    if (slotFrame[index] != 0 && slotFrame[index] + FRAME_SHARE_BUFFERS == frame) {
+        copy = CanvasRect();
+        for (const CanvasRect& rect : history) {
+            copy = copy.Union(rect);
+        }
+    }
+
+    FrameShareSlot& slot = header->slots[index];
+    uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.width = (uint32_t)width;
+    slot.height = (uint32_t)height;
+    slot.stride = (uint32_t)width * 4;
+    slot.frame = frame;
+    slot.dirtyX0 = changed.x0;
+    slot.dirtyY0 = changed.y0;
+    slot.dirtyX1 = changed.x1;
+    slot.dirtyY1 = changed.y1;
+    slot.checksum = FrameShare::Checksum(image.Row(0), (size_t)width * height);
+    if (!copy.Empty()) {
+        uint8_t* pixels = base + slot.offset;
+        size_t rowBytes = (size_t)(copy.x1 - copy.x0) * 4;
+        for (int y = copy.y0; y < copy.y1; y++) {
+            memcpy(pixels + (size_t)y * slot.stride + (size_t)copy.x0 * 4, image.Row(y) + copy.x0, rowBytes);
+        }
+        stats.bytesCopied += rowBytes * (size_t)(copy.y1 - copy.y0);
+    }
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    header->latest.store(index, std::memory_order_release);
+    slotFrame[index] = frame;
+    stats.published++;
+    return true;
+}
+
+void FrameShareWriter::Close() {
+    header->closed.store(1, std::memory_order_release);
+}
+
+FrameShare::ReadStatus FrameShare::Read(const void* memory, size_t size, uint64_t lastFrame, FrameInfo& info,
+                                        std::vector<uint32_t>& pixels) {
+    info = FrameInfo();
+    const FrameShareHeader* header = (const FrameShareHeader*)memory;
+    if (size < sizeof(FrameShareHeader) || header->magic != FRAME_SHARE_MAGIC ||
+        header->version != FRAME_SHARE_VERSION || header->bufferCount != FRAME_SHARE_BUFFERS ||
+        header->headerSize != sizeof(FrameShareHeader) || MappingSize(header->capacity) > size) {
+        return READ_INVALID;
+    }
+
+    for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+        uint32_t index = header->latest.load(std::memory_order_acquire);
+        if (index == FRAME_SHARE_NONE) {
+            return READ_NO_FRAME;
+        }
+        if (index >= FRAME_SHARE_BUFFERS) {
+            return READ_INVALID;
+        }
+        const FrameShareSlot& slot = header->slots[index];
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            info.retries++;
+            continue;
+        }
+        FrameInfo copy = info;
+        copy.width = slot.width;
+        copy.height = slot.height;
+        copy.frame = slot.frame;
+        copy.dirty = {slot.dirtyX0, slot.dirtyY0, slot.dirtyX1, slot.dirtyY1};
+        copy.checksum = slot.checksum;
+        uint32_t stride = slot.stride;
+        uint32_t offset = slot.offset;
+
+        bool unchanged = copy.frame == lastFrame;
+        bool valid = copy.width > 0 && copy.height > 0 && stride == copy.width * 4 &&
+                     (uint64_t)stride * copy.height <= header->capacity &&
+                     offset == sizeof(FrameShareHeader) + (size_t)header->capacity * index;
+        if (valid && !unchanged) {
+            pixels.resize((size_t)copy.width * copy.height);
+            memcpy(pixels.data(), (const uint8_t*)memory + offset, pixels.size() * 4);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            info.retries++;
+            continue;
+        }
+        info = copy;
+        return !valid ? READ_INVALID : unchanged ? READ_UNCHANGED : READ_FRAME;
+    }
+    return READ_LAPPED;
+}
+
+bool FrameShare::IsClosed(const void* memory) {
+    return ((const FrameShareHeader*)memory)->closed.load(std::memory_order_acquire) != 0;
+}
+
+const char* FrameShare::GetStatusName(ReadStatus status) {
+    switch (status) {
+        case READ_FRAME: return "frame";
+        case READ_UNCHANGED: return "unchanged";
+        case READ_NO_FRAME: return "no frame";
+        case READ_LAPPED: return "lapped";
+        default: return "invalid";
+    }
+}
+
+static uint32_t NextRandom(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state;
+}
+
+// A random rectangle of the canvas set to a colour derived from the frame
+static CanvasRect Scribble(Canvas& canvas, uint32_t& state, uint64_t frame) {
+    int width = canvas.GetWidth(), height = canvas.GetHeight();
+    int x0 = (int)(NextRandom(state) >> 8) % width, y0 = (int)(NextRandom(state) >> 8) % height;
+    int x1 = x0 + 1 + (int)(NextRandom(state) >> 8) % (width - x0);
+    int y1 = y0 + 1 + (int)(NextRandom(state) >> 8) % (height - y0);
+    CanvasRect rect = {x0, y0, x1, y1};
+    canvas.Fill(rect, (uint32_t)(frame * 2654435761u) | 0xFF000000u);
+    return rect;
+}
+
+bool FrameShare::RunSelfTest(std::string& failure) {
+    failure.clear();
+    const uint32_t capacity = 64 * 48 * 4;
+    std::vector<uint8_t> memory(MappingSize(capacity), 0xCD);
+    FrameShareWriter writer(memory.data(), capacity);
+    FrameInfo info;
+    std::vector<uint32_t> pixels;
+
+    if (Read(memory.data(), memory.size(), 0, info, pixels) != READ_NO_FRAME ||
+        Read(memory.data(), sizeof(FrameShareHeader) - 1, 0, info, pixels) != READ_INVALID) {
+        failure = "empty or truncated mapping";
+        return false;
+    }
+
+    // Partial updates across more frames than buffers, with a size change
+    // in the middle; every read must equal the writer's canvas
+    uint32_t state = 99;
+    Canvas canvas(37, 21);
+    for (uint64_t frame = 1; frame <= 40; frame++) {
+        if (frame == 17) {
+            canvas.Resize(64, 48);
+        }
+        CanvasRect dirty = Scribble(canvas, state, frame);
+        if (frame == 1 || frame == 17) {
+            dirty = canvas.GetBounds();     // New size: everything changed
+        }
+        writer.Publish(canvas, dirty);
+        ReadStatus status = Read(memory.data(), memory.size(), frame - 1, info, pixels);
+        if (status != READ_FRAME || info.frame != frame || info.width != (uint32_t)canvas.GetWidth() ||
+            memcmp(pixels.data(), canvas.Row(0), pixels.size() * 4) != 0 ||
+            Checksum(pixels.data(), pixels.size()) != info.checksum) {
+            failure = "frame " + std::to_string(frame) + ": " + GetStatusName(status) + " or pixels differ";
+            return false;
+        }
+        if (!(info.dirty == dirty.Intersect(canvas.GetBounds()))) {
+            failure = "frame " + std::to_string(frame) + ": dirty rectangle";
+            return false;
+        }
+    }
+    if (Read(memory.data(), memory.size(), 40, info, pixels) != READ_UNCHANGED) {
+        failure = "reading the same frame again";
+        return false;
+    }
+
+    // Too large for a buffer: skipped, the last frame stays readable
+    Canvas large(65, 48);
+    if (writer.Publish(large, large.GetBounds()) || writer.GetStats().tooLarge != 1 ||
+        Read(memory.data(), memory.size(), 0, info, pixels) != READ_FRAME || info.frame != 40) {
+        failure = "oversized frame";
+        return false;
+    }
+
+    // A slot that is being written (odd sequence) never reads as a frame
+    FrameShareHeader* header = (FrameShareHeader*)memory.data();
+    uint32_t latest = header->latest.load();
+    header->slots[latest].sequence.fetch_add(1);
+    if (Read(memory.data(), memory.size(), 0, info, pixels) != READ_LAPPED || info.retries != READ_ATTEMPTS) {
+        failure = "slot in progress was read";
+        return false;
+    }
+    header->slots[latest].sequence.fetch_add(1);
+
+    writer.Close();
+    if (!IsClosed(memory.data())) {
+        failure = "close flag";
+        return false;
+    }
+    return true;
+}
+
+FrameShare::StressResult FrameShare::RunStressTest(uint32_t frames, int readers) {
+    const int width = 97, height = 31;     // Odd sizes: rows are not multiples of anything
+    const uint32_t capacity = width * height * 4;
+    std::vector<uint8_t> memory(MappingSize(capacity));
+    FrameShareWriter writer(memory.data(), capacity);
+    std::atomic<bool> done(false);
+
+    struct ReaderCounts {
+        uint64_t reads = 0, unchanged = 0, lapped = 0, torn = 0, outOfOrder = 0;
+    };
+    std::vector<ReaderCounts> counts(readers > 0 ? readers : 0);
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; r++) {
+        threads.emplace_back([&memory, &done, &counts, r]() {
+            ReaderCounts& mine = counts[r];
+            std::vector<uint32_t> pixels;
+            FrameInfo info;
+            uint64_t last = 0;
+            while (!done.load(std::memory_order_acquire)) {
+                ReadStatus status = Read(memory.data(), memory.size(), last, info, pixels);
+                if (status == READ_FRAME) {
+                    mine.reads++;
+                    mine.torn += Checksum(pixels.data(), pixels.size()) != info.checksum;
+                    mine.outOfOrder += info.frame < last;
+                    last = info.frame;
+                } else if (status == READ_UNCHANGED) {
+                    mine.unchanged++;
+                    std::this_thread::yield();
+                } else if (status == READ_LAPPED) {
+                    mine.lapped++;
+                }
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Canvas canvas(width, height);
+    uint32_t state = 4321;
+    for (uint64_t frame = 1; frame <= frames; frame++) {
+        writer.Publish(canvas, Scribble(canvas, state, frame));
+    }
+    done.store(true, std::memory_order_release);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    StressResult result = {};
+    result.published = writer.GetStats().published;
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    for (const ReaderCounts& reader : counts) {
+        result.reads += reader.reads;
+        result.unchanged += reader.unchanged;
+        result.lapped += reader.lapped;
+        result.torn += reader.torn;
+        result.outOfOrder += reader.outOfOrder;
+    }
+    return result;
+}
@@ -2,197 +2,366 @@
 #include "../include/memory_reader.h"
 #include "../include/logger.h"
 #include "../include/overlay_data.h"
-#include <codecvt>
-#include <locale>
+#include "../include/match_history.h"
+#include "../include/nickname_pool.h"
+#include "../include/character_table.h"
+#include "../include/frame_hook.h"
+#include "../include/input_display.h"
+#include "../include/highlight_log.h"
+#include "../include/widget_image.h"
+#include <ctime>
 
 GameData GameDataManager::currentData = {};
-GameData GameDataManager::previousData = {}; // Add this line
+GameData GameDataManager::previousData = {};
+std::shared_ptr<const GameData> GameDataManager::versionHistory[GameDataManager::VERSION_HISTORY_SIZE];
+uint32_t GameDataManager::versionFields[GameDataManager::VERSION_HISTORY_SIZE] = {};
+uint64_t GameDataManager::publishedVersion = 0;
+std::mutex GameDataManager::versionMutex;
+uint64_t GameDataManager::squashedFrom = 0;
+uint64_t GameDataManager::squashedTo = 0;
+uint32_t GameDataManager::squashedFields = 0;
 bool GameDataManager::initialized = false;
-bool GameDataManager::running = false;
-HANDLE GameDataManager::updateThread = nullptr;
+LoopTimer GameDataManager::sampleTimer;
+LoopTimer GameDataManager::cacheRefreshTimer;
+LoopTimer GameDataManager::overlayRefreshTimer;
+int GameDataManager::consecutiveFailures = 0;
+uint64_t GameDataManager::lastFrameTick = 0;
+NetplayTelemetry GameDataManager::netplayTelemetry;
+uint64_t GameDataManager::sampledAppliedCount = 0;
+uint64_t GameDataManager::lastNetplayPublishMs = 0;
+ComboTracker GameDataManager::comboTracker;
 
-// Initialize static variables
-DWORD GameDataManager::lastWinCountCheck = 0;
-DWORD GameDataManager::cachedP1WinCount = 0;
-DWORD GameDataManager::cachedP2WinCount = 0;
+std::atomic<uint64_t> GameDataManager::sampledTicks(0);
+std::atomic<uint64_t> GameDataManager::skippedTicks(0);
+
+bool GameDataManager::setInProgress = false;
+PlayerData GameDataManager::setP1 = {};
+PlayerData GameDataManager::setP2 = {};
+DWORD GameDataManager::setStartTick = 0;
+bool GameDataManager::setDecided = false;
 
 bool GameDataManager::Initialize() {
     Logger::Info("Initializing game data manager");
+    
+    // No nickname has been resolved yet (0 is a valid pool ID)
+    currentData.player1.nicknameId = NicknamePool::INVALID_ID;
+    currentData.player2.nicknameId = NicknamePool::INVALID_ID;
+    currentData.netplay = netplayTelemetry.GetStats();
+    currentData.combo = comboTracker.GetStats();
+    previousData = currentData;
+    versionHistory[0] = std::make_shared<const GameData>(currentData);
+    
     initialized = true;
-    running = true;
     
-    // Start the background update thread
-    updateThread = CreateThread(nullptr, 0, UpdateThreadProc, nullptr, 0, nullptr);
-    if (updateThread == nullptr) {
-        Logger::Error("Failed to create update thread");
-        return false;
-    }
+    // Sampling runs on the event loop thread alongside the other tasks
+    sampleTimer.callback = OnSampleTimer;
+    cacheRefreshTimer.callback = OnCacheRefreshTimer;
+    overlayRefreshTimer.callback = OnOverlayRefreshTimer;
+    overlayRefreshTimer.background = true;  // Recovery only; changes are written by the sample task
+    EventLoop::AddTimer(&sampleTimer, SAMPLE_INTERVAL_MS, SAMPLE_INTERVAL_MS);
+    EventLoop::AddTimer(&cacheRefreshTimer, CACHE_REFRESH_INTERVAL_MS, CACHE_REFRESH_INTERVAL_MS);
+    EventLoop::AddTimer(&overlayRefreshTimer, OVERLAY_REFRESH_INTERVAL_MS, OVERLAY_REFRESH_INTERVAL_MS);
     
     return true;
 }
 
-bool GameDataManager::HasDataChanged() {
-    // Check for significant changes only
-    return (currentData.player1.characterId != previousData.player1.characterId ||
-            currentData.player2.characterId != previousData.player2.characterId ||
-            currentData.player1.winCount != previousData.player1.winCount ||
-            currentData.player2.winCount != previousData.player2.winCount ||
-            currentData.gameActive != previousData.gameActive);
+static bool SameStats(const PlayerData& a, const PlayerData& b) {
+    const PlayerSummary& x = a.stats;
+    const PlayerSummary& y = b.stats;
+    return x.sets == y.sets && x.wins == y.wins && x.losses == y.losses && x.winRate == y.winRate &&
+           x.streak == y.streak && x.mostPlayedCharacterId == y.mostPlayedCharacterId &&
+           x.setTimePerGameMs == y.setTimePerGameMs && x.matchupWinRate == y.matchupWinRate &&
+           x.characterMatchupWinRate == y.characterMatchupWinRate &&
+           a.rating.rating == b.rating.rating && a.rating.deviation == b.rating.deviation;
 }
 
-void GameDataManager::LogChanges() {
-    // Only log the specific changes that occurred
-    if (currentData.player1.characterId != previousData.player1.characterId) {
-        Logger::Info("P1 character changed: " + 
-            (previousData.player1.character.empty() ? "None" : previousData.player1.character) + 
-            " -> " + currentData.player1.character);
+// Changed fields of one side, in FIELD_P1_* positions
+static uint32_t DiffPlayer(const PlayerData& a, const PlayerData& b, uint32_t candidates) {
+    uint32_t fields = 0;
+    if ((candidates & FIELD_P1_NICKNAME) && (a.nicknameId != b.nicknameId || a.nickname != b.nickname)) {
+        fields |= FIELD_P1_NICKNAME;
+    }
+    if ((candidates & FIELD_P1_CHARACTER) && (a.characterId != b.characterId || a.character != b.character)) {
+        fields |= FIELD_P1_CHARACTER;
+    }
+    if ((candidates & FIELD_P1_WINS) && a.winCount != b.winCount) fields |= FIELD_P1_WINS;
+    if ((candidates & FIELD_P1_STATS) && !SameStats(a, b)) fields |= FIELD_P1_STATS;
+    return fields;
+}
+
+uint32_t GameDelta::Diff(const GameData& oldData, const GameData& newData, uint32_t candidates) {
+    uint32_t fields = DiffPlayer(oldData.player1, newData.player1, candidates & 0xF) |
+                      (DiffPlayer(oldData.player2, newData.player2, (candidates >> 4) & 0xF) << 4);
+    if ((candidates & FIELD_GAME_ACTIVE) && oldData.gameActive != newData.gameActive) fields |= FIELD_GAME_ACTIVE;
+    if ((candidates & FIELD_LAYOUT) &&
+        (oldData.layout != newData.layout || oldData.layoutConfidence != newData.layoutConfidence)) {
+        fields |= FIELD_LAYOUT;
     }
+    if ((candidates & FIELD_NETPLAY) && oldData.netplay != newData.netplay) fields |= FIELD_NETPLAY;
+    if ((candidates & FIELD_COMBO) && oldData.combo != newData.combo) fields |= FIELD_COMBO;
+    return fields;
+}
+
+void GameDataManager::LogDelta(const GameDelta& delta) {
+    const GameData& before = *delta.oldData;
+    const GameData& after = *delta.newData;
     
-    if (currentData.player2.characterId != previousData.player2.characterId) {
-        Logger::Info("P2 character changed: " + 
-            (previousData.player2.character.empty() ? "None" : previousData.player2.character) + 
-            " -> " + currentData.player2.character);
+    if (delta.Has(FIELD_P1_NICKNAME)) {
+        Logger::Info("P1 nickname changed: '" + before.player1.nickname.str() + "' -> '" + after.player1.nickname.str() + "'");
+    }
+    if (delta.Has(FIELD_P2_NICKNAME)) {
+        Logger::Info("P2 nickname changed: '" + before.player2.nickname.str() + "' -> '" + after.player2.nickname.str() + "'");
     }
     
-    if (currentData.player1.winCount != previousData.player1.winCount) {
-        Logger::Info("P1 wins changed: " + std::to_string(previousData.player1.winCount) + 
-                    " -> " + std::to_string(currentData.player1.winCount));
+    if (delta.Has(FIELD_P1_CHARACTER)) {
+        Logger::Info("P1 character changed: " + 
+            (before.player1.character.empty() ? std::string("None") : before.player1.character.str()) + 
+            " -> " + after.player1.character.str());
+    }
+    if (delta.Has(FIELD_P2_CHARACTER)) {
+        Logger::Info("P2 character changed: " + 
+            (before.player2.character.empty() ? std::string("None") : before.player2.character.str()) + 
+            " -> " + after.player2.character.str());
     }
     
-    if (currentData.player2.winCount != previousData.player2.winCount) {
-        Logger::Info("P2 wins changed: " + std::to_string(previousData.player2.winCount) + 
-                    " -> " + std::to_string(currentData.player2.winCount));
+    if (delta.Has(FIELD_P1_WINS)) {
+        Logger::Info("P1 win count changed: " + std::to_string(before.player1.winCount) + 
+                    " -> " + std::to_string(after.player1.winCount));
+    }
+    if (delta.Has(FIELD_P2_WINS)) {
+        Logger::Info("P2 win count changed: " + std::to_string(before.player2.winCount) + 
+                    " -> " + std::to_string(after.player2.winCount));
     }
     
-    if (currentData.gameActive != previousData.gameActive) {
+    if (delta.Has(FIELD_GAME_ACTIVE)) {
         Logger::Info("Game state changed: " + 
-                    std::string(previousData.gameActive ? "active" : "inactive") + 
-                    " -> " + std::string(currentData.gameActive ? "active" : "inactive"));
+                    std::string(before.gameActive ? "active" : "inactive") + 
+                    " -> " + std::string(after.gameActive ? "active" : "inactive"));
+    }
+    
+    // Netplay health changes every second while connected; only log it coming and going
+    if (delta.Has(FIELD_NETPLAY) && before.netplay.available != after.netplay.available) {
+        Logger::Info(std::string("Netplay telemetry ") + (after.netplay.available ? "available" : "unavailable"));
     }
     
-    // Update previous data for next comparison
+    // Per hit while fighting; only log finished combos
+    for (int side = 0; side < 2 && delta.Has(FIELD_COMBO); side++) {
+        const ComboSide& was = before.combo.side[side];
+        const ComboSide& now = after.combo.side[side];
+        if (now.lastEndFrame != was.lastEndFrame && now.lastHits > 1) {
+            Logger::Debug("P" + std::to_string(side + 1) + " combo: " + std::to_string(now.lastHits) + " hits, " +
+                          std::to_string(now.lastDamage) + " damage (frames " + std::to_string(now.lastStartFrame) +
+                          "-" + std::to_string(now.lastEndFrame) + ")");
+        }
+    }
+    
+    if (delta.Has(FIELD_LAYOUT)) {
+        Logger::Info("Revival layout: " + (before.layout.empty() ? std::string("none") : before.layout.str()) +
+                     " -> " + after.layout.str() + " (confidence " +
+                     std::to_string((int)(after.layoutConfidence * 100.0f + 0.5f)) + "%)");
+    }
+}
+
+// Records currentData as the next version with the fields Decode found
+// changed, and logs them. The snapshot is shared, not copied, by consumers.
+void GameDataManager::PublishVersion(uint32_t changedFields) {
+    GameDelta delta = {};
+    delta.changedFields = changedFields;
+    delta.newData = std::make_shared<const GameData>(currentData);
+    {
+        std::lock_guard<std::mutex> lock(versionMutex);
+        delta.fromVersion = publishedVersion;
+        delta.oldData = versionHistory[publishedVersion % VERSION_HISTORY_SIZE];
+        publishedVersion++;
+        delta.toVersion = publishedVersion;
+        versionHistory[publishedVersion % VERSION_HISTORY_SIZE] = delta.newData;
+        versionFields[publishedVersion % VERSION_HISTORY_SIZE] = changedFields;
+    }
+    
+    LogDelta(delta);
     previousData = currentData;
 }
 
+uint64_t GameDataManager::GetVersion() {
+    std::lock_guard<std::mutex> lock(versionMutex);
+    return publishedVersion;
+}
+
+bool GameDataManager::GetDeltaSince(uint64_t version, GameDelta& delta) {
+    std::lock_guard<std::mutex> lock(versionMutex);
+    if (version >= publishedVersion) {
+        return false;
+    }
+    
+    delta.fromVersion = version;
+    delta.toVersion = publishedVersion;
+    delta.newData = versionHistory[publishedVersion % VERSION_HISTORY_SIZE];
+    delta.oldData = nullptr;
+    delta.resync = false;
+    
+    if (publishedVersion - version >= VERSION_HISTORY_SIZE) {
+        // The consumer fell too far behind; the old state is gone
+        delta.resync = true;
+        delta.changedFields = FIELD_ALL;
+        return true;
+    }
+    
+    delta.oldData = versionHistory[version % VERSION_HISTORY_SIZE];
+    if (publishedVersion - version == 1) {
+        delta.changedFields = versionFields[publishedVersion % VERSION_HISTORY_SIZE];
+    } else {
+        // Several versions: a field flagged on the way may have changed back
+        if (squashedFrom != version || squashedTo != publishedVersion) {
+            uint32_t candidates = 0;
+            for (uint64_t v = version + 1; v <= publishedVersion; v++) {
+                candidates |= versionFields[v % VERSION_HISTORY_SIZE];
+            }
+            squashedFields = GameDelta::Diff(*delta.oldData, *delta.newData, candidates);
+            squashedFrom = version;
+            squashedTo = publishedVersion;
+        }
+        delta.changedFields = squashedFields;
+    }
+    return true;
+}
+
+// Same time base as the frame sampler's QPC clock
+static uint64_t QpcMicros() {
+    LARGE_INTEGER frequency, now;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / frequency.QuadPart * 1000000 +
+                      now.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
+
 bool GameDataManager::Update() {
     if (!initialized) return false;
     
-    // Store previous data for change detection
-    GameData prevData = currentData;
+    // Read every memory block once; when none changed there is nothing to decode or compare
+    uint64_t changedSources = MemoryReader::RefreshBlocks();
+    // Timer sampling has no frame counter; number frames by time (60 per second)
+    uint64_t now = QpcMicros();
+    return Decode(changedSources, SampleFrame((uint32_t)(now * 60 / 1000000), now));
+}
+
+bool GameDataManager::UpdateFromSnapshot(const MemorySnapshot& snapshot, uint32_t frame, uint64_t timestampUs) {
+    if (!initialized) return false;
+    
+    uint64_t changedSources = MemoryReader::ApplyBlocks(snapshot);
+    return Decode(changedSources, SampleFrame(frame, timestampUs));
+}
+
+// Feeds the capture just applied (if any) to the per-frame analyzers and
+// reports whether a field they publish changed
+bool GameDataManager::SampleFrame(uint32_t frame, uint64_t timestampUs) {
+    uint64_t applied = MemoryReader::GetAppliedCount();
+    if (applied == sampledAppliedCount) {
+        return false;
+    }
+    sampledAppliedCount = applied;
+    
+    InputDisplay::OnCapture(frame);
     
+    ComboSample combo;
+    combo.frame = frame;
+    combo.timestampUs = timestampUs;
+    MemoryReader::GetComboSample(combo);
+    bool changed = comboTracker.Record(combo);
+    if (changed) {
+        currentData.combo = comboTracker.GetStats();
+    }
+    HighlightLog::OnFrame(combo, comboTracker.GetStats());
+    WidgetImage::OnFrame(combo);
+    return SampleNetplay(timestampUs) || changed;
+}
+
+// Records a netplay sample and reports whether the published summary changed
+bool GameDataManager::SampleNetplay(uint64_t timestampUs) {
+    NetplaySample sample;
+    sample.timestampUs = timestampUs;
+    MemoryReader::GetNetplaySample(sample);
+    netplayTelemetry.Record(sample);
+    
+    uint64_t now = EventLoop::GetTickMs();
+    if (now - lastNetplayPublishMs < NETPLAY_PUBLISH_MS) {
+        return false;
+    }
+    lastNetplayPublishMs = now;
+    NetplayStats stats = netplayTelemetry.GetStats();
+    if (stats == currentData.netplay) {
+        return false;
+    }
+    currentData.netplay = stats;
+    return true;
+}
+
+bool GameDataManager::Decode(uint64_t changedSources, bool sampledChanged) {
     try {
         // Check if we're transitioning from no characters to characters selected
-        bool wasCharacterSelected = (prevData.player1.characterId >= 0 || prevData.player2.characterId >= 0);
-        
-        // Update current game state from memory
-        // Convert wide strings to UTF-8
-        std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+        bool wasCharacterSelected = (previousData.player1.characterId >= 0 || previousData.player2.characterId >= 0);
         
-        // Update Player 1 data
-        std::wstring p1Nick = MemoryReader::GetP1Nickname();
-        currentData.player1.nickname = converter.to_bytes(p1Nick);
-        
-        // Get character data with forced refresh when needed
-        std::string p1CharRaw = MemoryReader::GetP1CharacterNameRaw();
-        if (!p1CharRaw.empty()) {
-            currentData.player1.characterId = MemoryReader::GetP1CharacterID();
-            currentData.player1.character = MemoryReader::GetP1CharacterName();
-        } else {
-            currentData.player1.characterId = -1;
-            currentData.player1.character = "Unknown";
+        sampledTicks++;
+        if (changedSources == 0 && !sampledChanged) {
+            skippedTicks++;
+            return false;
         }
         
-        // Check win counts less frequently (every 500ms)
-        DWORD currentTime = GetTickCount();
-        if (currentTime - lastWinCountCheck > WIN_COUNT_CHECK_INTERVAL_MS) {
-            // Only get win counts periodically to reduce calls
-            cachedP1WinCount = MemoryReader::GetP1WinCount();
-            cachedP2WinCount = MemoryReader::GetP2WinCount();
-            lastWinCountCheck = currentTime;
+        if (changedSources & (SCHEMA_FIELD_BIT(SCHEMA_P1_NICKNAME) | SCHEMA_FIELD_BIT(SCHEMA_P2_NICKNAME))) {
+            // Nicknames resolve to pool IDs; the UTF-8 copy is only refreshed when the ID changes
+            uint32_t p1NickId = MemoryReader::GetP1NicknameId();
+            if (p1NickId != currentData.player1.nicknameId) {
+                currentData.player1.nicknameId = p1NickId;
+                currentData.player1.nickname = NicknamePool::Get(p1NickId);
+            }
+            
+            uint32_t p2NickId = MemoryReader::GetP2NicknameId();
+            if (p2NickId != currentData.player2.nicknameId) {
+                currentData.player2.nicknameId = p2NickId;
+                currentData.player2.nickname = NicknamePool::Get(p2NickId);
+            }
         }
         
-        // Use cached win counts
-        currentData.player1.winCount = cachedP1WinCount;
+        if (changedSources & (SCHEMA_FIELD_BIT(SCHEMA_P1_WIN_COUNT) | SCHEMA_FIELD_BIT(SCHEMA_P2_WIN_COUNT))) {
+            currentData.player1.winCount = MemoryReader::GetP1WinCount();
+            currentData.player2.winCount = MemoryReader::GetP2WinCount();
+        }
         
-        // Update Player 2 data with similar protection
-        std::wstring p2Nick = MemoryReader::GetP2Nickname();
-        currentData.player2.nickname = converter.to_bytes(p2Nick);
+        // Character ID straight from the raw name field; display name from the same table
+        if (changedSources & SCHEMA_FIELD_BIT(SCHEMA_P1_CHARACTER_NAME)) {
+            currentData.player1.characterId = MemoryReader::GetP1CharacterID();
+            currentData.player1.character = CharacterTable::GetDisplayName(currentData.player1.characterId);
+        }
         
-        std::string p2CharRaw = MemoryReader::GetP2CharacterNameRaw();
-        if (!p2CharRaw.empty()) {
+        if (changedSources & SCHEMA_FIELD_BIT(SCHEMA_P2_CHARACTER_NAME)) {
             currentData.player2.characterId = MemoryReader::GetP2CharacterID();
-            currentData.player2.character = MemoryReader::GetP2CharacterName();
-        } else {
-            currentData.player2.characterId = -1;
-            currentData.player2.character = "Unknown";
+            currentData.player2.character = CharacterTable::GetDisplayName(currentData.player2.characterId);
         }
         
-        // Use cached win counts
-        currentData.player2.winCount = cachedP2WinCount;
-        
         // Check if game is active based on valid character IDs
         currentData.gameActive = (currentData.player1.characterId >= 0 && 
                                 currentData.player2.characterId >= 0);
         
-        // Only perform update operations if data has changed
-        bool hasDataChanged = false;
-        
-        // Check for changes in player 1 data
-        if (currentData.player1.nickname != prevData.player1.nickname || 
-            currentData.player1.character != prevData.player1.character ||
-            currentData.player1.characterId != prevData.player1.characterId ||
-            currentData.player1.winCount != prevData.player1.winCount) {
-            
-            hasDataChanged = true;
-            
-            // Log specific changes
-            if (currentData.player1.character != prevData.player1.character) {
-                Logger::Info("P1 character changed: " + 
-                           (prevData.player1.character.empty() ? "None" : prevData.player1.character) + 
-                           " -> " + currentData.player1.character);
-            }
-            
-            if (currentData.player1.winCount != prevData.player1.winCount) {
-                Logger::Info("P1 win count changed: " + std::to_string(prevData.player1.winCount) + 
-                           " -> " + std::to_string(currentData.player1.winCount));
-            }
-        }
+        currentData.layout = MemoryReader::GetLayoutName();
+        currentData.layoutConfidence = MemoryReader::GetLayoutStatus().confidence;
         
-        // Check for changes in player 2 data
-        if (currentData.player2.nickname != prevData.player2.nickname || 
-            currentData.player2.character != prevData.player2.character ||
-            currentData.player2.characterId != prevData.player2.characterId ||
-            currentData.player2.winCount != prevData.player2.winCount) {
-            
-            hasDataChanged = true;
-            
-            // Log specific changes
-            if (currentData.player2.character != prevData.player2.character) {
-                Logger::Info("P2 character changed: " + 
-                           (prevData.player2.character.empty() ? "None" : prevData.player2.character) + 
-                           " -> " + currentData.player2.character);
-            }
-            
-            if (currentData.player2.winCount != prevData.player2.winCount) {
-                Logger::Info("P2 win count changed: " + std::to_string(prevData.player2.winCount) + 
-                           " -> " + std::to_string(currentData.player2.winCount));
-            }
+        // Field-level diff against the last published version
+        uint32_t changedFields = GameDelta::Diff(previousData, currentData);
+        if (changedFields == 0) {
+            return false;
         }
         
-        // Check for game state changes
-        bool wasGameActive = prevData.gameActive;
-        currentData.gameActive = (currentData.player1.characterId >= 0 && currentData.player2.characterId >= 0);
-        
-        if (currentData.gameActive != wasGameActive) {
-            hasDataChanged = true;
-            Logger::Info("Game state changed: " + std::string(wasGameActive ? "active" : "inactive") + 
-                       " -> " + std::string(currentData.gameActive ? "active" : "inactive"));
+        // A decided game or new characters close the match for the combo maxima
+        if (changedFields & (FIELD_P1_WINS | FIELD_P2_WINS | FIELD_P1_CHARACTER | FIELD_P2_CHARACTER)) {
+            comboTracker.EndMatch();
         }
         
-        // If data changed, update the previousData member variable
-        if (hasDataChanged) {
-            previousData = currentData;
-        }
+        // Record a finished set before publishing so its stats show up immediately
+        TrackSetProgress(changedFields);
+        HighlightLog::OnScore((int)currentData.player1.winCount, (int)currentData.player2.winCount);
+        RefreshPlayerSummaries();
+        // A recorded set moves the summaries and ratings just refreshed
+        changedFields |= GameDelta::Diff(previousData, currentData, FIELD_P1_STATS | FIELD_P2_STATS);
+        PublishVersion(changedFields);
         
         // Check if we're just now detecting characters
         bool isCharacterSelected = (currentData.player1.characterId >= 0 || currentData.player2.characterId >= 0);
@@ -202,7 +371,7 @@ bool GameDataManager::Update() {
             MemoryReader::ForceRefreshCharacterData();
         }
         
-        return hasDataChanged;
+        return true;
         
     } catch (const std::exception& e) {
         Logger::Error("Error updating game data: " + std::string(e.what()));
@@ -210,6 +379,11 @@ bool GameDataManager::Update() {
     }
 }
 
+void GameDataManager::GetChangeDetectionStats(uint64_t& ticks, uint64_t& skipped) {
+    ticks = sampledTicks.load();
+    skipped = skippedTicks.load();
+}
+
 const GameData& GameDataManager::GetCurrentData() {
     return currentData;
 }
@@ -220,94 +394,324 @@ std::string GameDataManager::GetJSONData() {
 
 void GameDataManager::Shutdown() {
     Logger::Info("Shutting down game data manager");
-    running = false;
     
-    if (updateThread) {
-        WaitForSingleObject(updateThread, 5000);
-        CloseHandle(updateThread);
-        updateThread = nullptr;
-    }
+    EventLoop::CancelTimer(&sampleTimer);
+    EventLoop::CancelTimer(&cacheRefreshTimer);
+    EventLoop::CancelTimer(&overlayRefreshTimer);
+    
+    // Keep the set in progress rather than losing it on exit
+    FinalizeSet();
 }
 
-// Modify UpdateThreadProc to force cache clearing more aggressively
-DWORD WINAPI GameDataManager::UpdateThreadProc(LPVOID lpParam) {
-    Logger::Info("Game data update thread started");
+// A set runs while the same two nicknames are present. It ends as soon as
+// a counter reaches FirstTo (highlights.ini), so stats and ratings update
+// with the deciding game; with FirstTo=0 it ends only when either nickname
+// changes or the win counters drop back (Revival resets them).
+// Only runs on ticks with changes; returns true when a set was recorded.
+bool GameDataManager::TrackSetProgress(uint32_t changedFields) {
+    const PlayerData& p1 = currentData.player1;
+    const PlayerData& p2 = currentData.player2;
     
-    // Count consecutive failures for error reporting
-    int consecutiveFailures = 0;
-    DWORD updateCounter = 0;
+    bool recorded = false;
     
-    while (running) {
-        // Force cache clearing on periodic intervals to detect character changes
-        if (updateCounter % 15 == 0) {  // Every ~1.5 seconds
-            // Changed from private ClearCache to public ForceRefreshCharacterData
-            MemoryReader::ForceRefreshCharacterData();  // This ensures we detect character selection
+    const uint32_t setEndingFields = FIELD_P1_NICKNAME | FIELD_P2_NICKNAME | FIELD_P1_WINS | FIELD_P2_WINS;
+    if (setInProgress && (changedFields & setEndingFields)) {
+        bool samePlayers = (p1.nicknameId == setP1.nicknameId && p2.nicknameId == setP2.nicknameId);
+        bool countersReset = (p1.winCount < setP1.winCount || p2.winCount < setP2.winCount);
+        if (!samePlayers || countersReset) {
+            recorded = FinalizeSet();
         }
-        
-        bool shouldUpdateOverlay = false;
-        
-        // Only update overlay files when data has actually changed
-        bool updateResult = Update();
-        
-        // Track failures for diagnostic purposes
-        if (!updateResult) {
-            consecutiveFailures++;
-            
-            // Log an error only if we're consistently failing
-            if (consecutiveFailures == 10) {
-                Logger::Warning("Ten consecutive update failures detected - possible memory reading issue");
-            }
-            
-            // Slow down updates if we keep failing
-            if (consecutiveFailures > 30) {
-                Sleep(500);  // Increase delay when having issues
-            }
-        } else {
-            // Reset counter on success
-            if (consecutiveFailures > 0) {
-                consecutiveFailures = 0;
+    }
+    
+    if (!setInProgress) {
+        if (setDecided) {
+            // The recorded score stays on screen until the counters reset
+            bool samePlayers = (p1.nicknameId == setP1.nicknameId && p2.nicknameId == setP2.nicknameId);
+            bool countersReset = (p1.winCount < setP1.winCount || p2.winCount < setP2.winCount);
+            if (samePlayers && !countersReset) {
+                return recorded;
             }
-            
-            // Mark for overlay update if data changed
-            shouldUpdateOverlay = true;
+            setDecided = false;
+        }
+        if (currentData.gameActive) {
+            setInProgress = true;
+            setP1 = p1;
+            setP2 = p2;
+            setStartTick = GetTickCount();
         }
+        return recorded;
+    }
+    
+    // Keep the latest score and the characters used for it
+    setP1.winCount = p1.winCount;
+    setP2.winCount = p2.winCount;
+    if (p1.characterId >= 0) {
+        setP1.characterId = p1.characterId;
+        setP1.character = p1.character;
+    }
+    if (p2.characterId >= 0) {
+        setP2.characterId = p2.characterId;
+        setP2.character = p2.character;
+    }
+    
+    int32_t firstTo = HighlightLog::GetConfig().firstTo;
+    if (firstTo > 0 && (setP1.winCount >= firstTo || setP2.winCount >= firstTo)) {
+        recorded = FinalizeSet() || recorded;
+        setDecided = true;
+    }
+    return recorded;
+}
+
+bool GameDataManager::FinalizeSet() {
+    if (!setInProgress) {
+        return false;
+    }
+    setInProgress = false;
+    
+    // Nothing was played (character select browsing, offline without counters)
+    if (setP1.winCount == 0 && setP2.winCount == 0) {
+        return false;
+    }
+    
+    MatchRecord record = {};
+    record.timestamp = (int64_t)std::time(nullptr);
+    MatchHistory::FillNickname(record.p1Nickname, setP1.nickname.str());
+    MatchHistory::FillNickname(record.p2Nickname, setP2.nickname.str());
+    record.p1CharacterId = (int8_t)setP1.characterId;
+    record.p2CharacterId = (int8_t)setP2.characterId;
+    record.p1Score = (uint8_t)setP1.winCount;
+    record.p2Score = (uint8_t)setP2.winCount;
+    record.durationMs = GetTickCount() - setStartTick;
+    
+    Logger::Info("Set finished: " + setP1.nickname.str() + " " + std::to_string(setP1.winCount) + " - " +
+                 std::to_string(setP2.winCount) + " " + setP2.nickname.str());
+    HighlightLog::OnSetEnd((int)setP1.winCount, (int)setP2.winCount, setP1.nicknameId, setP2.nicknameId);
+    if (!MatchHistory::AppendMatch(record)) {
+        return false;
+    }
+    
+    PlayerStats::RecordSet(record);
+    RatingService::RecordSet(record);
+    return true;
+}
+
+void GameDataManager::RefreshPlayerSummaries() {
+    PlayerData& p1 = currentData.player1;
+    PlayerData& p2 = currentData.player2;
+    p1.stats = PlayerStats::GetSummary(p1.nickname.str(), p1.characterId, p2.characterId);
+    p2.stats = PlayerStats::GetSummary(p2.nickname.str(), p2.characterId, p1.characterId);
+    p1.rating = RatingService::GetRating(p1.nickname.str());
+    p2.rating = RatingService::GetRating(p2.nickname.str());
+}
+
+// Loop thread, every SAMPLE_INTERVAL_MS: drains hooked frames, or polls
+// memory directly when the hook is off or the game has stalled
+void GameDataManager::OnSampleTimer(void* context) {
+    // Frame mode: decode every frame captured since the last tick, in order
+    FrameSampler* sampler = FrameHook::GetSampler();
+    if (sampler) {
+        bool changed = false;
+        for (const FrameSnapshot* frame = sampler->Front(); frame; frame = sampler->Front()) {
+            changed |= UpdateFromSnapshot(frame->blocks, (uint32_t)frame->frame, frame->timestampUs);
+            sampler->Pop();
+            lastFrameTick = EventLoop::GetTickMs();
+        }
+        if (changed) {
+            OverlayData::UpdateFiles();
+        }
+        // Keep sampling from here if the game stops pumping messages (modal dialogs, hangs)
+        if (EventLoop::GetTickMs() - lastFrameTick < FRAME_STALL_MS) {
+            return;
+        }
+    }
+    
+    // Only update overlay files when data has actually changed
+    bool updateResult = Update();
+    
+    // Track failures for diagnostic purposes
+    if (!updateResult) {
+        consecutiveFailures++;
         
-        // Force periodic updates even if data hasn't changed
-        if (++updateCounter >= 50) { // Every ~5 seconds
-            shouldUpdateOverlay = true;
-            updateCounter = 0;
-            
-            // Force a periodic re-read of character data
-            // This helps recover if we previously failed to detect characters
-            Logger::Debug("Performing periodic refresh of game data");
+        // Log an error only if we're consistently failing
+        if (consecutiveFailures == 10) {
+            Logger::Warning("Ten consecutive update failures detected - possible memory reading issue");
         }
         
-        if (shouldUpdateOverlay) {
-            OverlayData::UpdateFiles();
+        // Slow down updates if we keep failing
+        if (consecutiveFailures > 30) {
+            EventLoop::AddTimer(&sampleTimer, SAMPLE_BACKOFF_MS, SAMPLE_INTERVAL_MS);
         }
+    } else {
+        // Reset counter on success
+        consecutiveFailures = 0;
         
-        Sleep(100);
+        OverlayData::UpdateFiles();
     }
-    
-    Logger::Info("Game data update thread ended");
-    return 0;
+}
+
+// Force cache clearing on periodic intervals to detect character changes
+void GameDataManager::OnCacheRefreshTimer(void* context) {
+    MemoryReader::ForceRefreshCharacterData();
+}
+
+// Force periodic updates even if data hasn't changed
+void GameDataManager::OnOverlayRefreshTimer(void* context) {
+    // This helps recover if we previously failed to detect characters
+    Logger::Debug("Performing periodic refresh of game data");
+    OverlayData::UpdateFiles(true);
+}
+
+// Sanitized nicknames may contain quotes and backslashes
+static std::string EscapeJSON(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+static std::string SummaryToJSON(const PlayerSummary& stats) {
+    std::string json = "{\n";
+    json += "      \"sets\": " + std::to_string(stats.sets) + ",\n";
+    json += "      \"wins\": " + std::to_string(stats.wins) + ",\n";
+    json += "      \"losses\": " + std::to_string(stats.losses) + ",\n";
+    json += "      \"winRate\": " + std::to_string(stats.winRate) + ",\n";
+    json += "      \"streak\": " + std::to_string(stats.streak) + ",\n";
+    json += "      \"mostPlayedCharacterId\": " + std::to_string(stats.mostPlayedCharacterId) + ",\n";
+    json += "      \"setTimePerGameMs\": " + std::to_string(stats.setTimePerGameMs) + ",\n";
+    json += "      \"matchupWinRate\": " + std::to_string(stats.matchupWinRate) + ",\n";
+    json += "      \"characterMatchupWinRate\": " + std::to_string(stats.characterMatchupWinRate) + "\n";
+    json += "    }";
+    return json;
+}
+
+static std::string NetplayToJSON(const NetplayStats& netplay) {
+    std::string json = "{\n";
+    json += "    \"available\": " + std::string(netplay.available ? "true" : "false") + ",\n";
+    json += "    \"pingMs\": " + std::to_string(netplay.pingMs) + ",\n";
+    json += "    \"pingP50Ms\": " + std::to_string(netplay.pingP50Ms) + ",\n";
+    json += "    \"pingP95Ms\": " + std::to_string(netplay.pingP95Ms) + ",\n";
+    json += "    \"pingMaxMs\": " + std::to_string(netplay.pingMaxMs) + ",\n";
+    json += "    \"delayFrames\": " + std::to_string(netplay.delayFrames) + ",\n";
+    json += "    \"rollbacks\": " + std::to_string(netplay.rollbacks) + ",\n";
+    json += "    \"rollbacksPerSecond\": " + std::to_string(netplay.rollbacksPerSecond) + ",\n";
+    json += "    \"resyncs\": " + std::to_string(netplay.resyncs) + ",\n";
+    json += "    \"spectators\": " + std::to_string(netplay.spectators) + "\n";
+    json += "  }";
+    return json;
+}
+
+static std::string ComboSideToJSON(const ComboSide& side) {
+    std::string json = "{\n";
+    json += "      \"hits\": " + std::to_string(side.hits) + ",\n";
+    json += "      \"damage\": " + std::to_string(side.damage) + ",\n";
+    json += "      \"startFrame\": " + std::to_string(side.startFrame) + ",\n";
+    json += "      \"lastHits\": " + std::to_string(side.lastHits) + ",\n";
+    json += "      \"lastDamage\": " + std::to_string(side.lastDamage) + ",\n";
+    json += "      \"lastStartFrame\": " + std::to_string(side.lastStartFrame) + ",\n";
+    json += "      \"lastEndFrame\": " + std::to_string(side.lastEndFrame) + ",\n";
+    json += "      \"lastStartUs\": " + std::to_string(side.lastStartUs) + ",\n";
+    json += "      \"lastEndUs\": " + std::to_string(side.lastEndUs) + ",\n";
+    json += "      \"maxHits\": " + std::to_string(side.maxHits) + ",\n";
+    json += "      \"maxDamage\": " + std::to_string(side.maxDamage) + ",\n";
+    json += "      \"roundDamage\": " + std::to_string(side.roundDamage) + "\n";
+    json += "    }";
+    return json;
+}
+
+static std::string ComboToJSON(const ComboStats& combo) {
+    std::string json = "{\n";
+    json += "    \"available\": " + std::string(combo.available ? "true" : "false") + ",\n";
+    json += "    \"round\": " + std::to_string(combo.round) + ",\n";
+    json += "    \"player1\": " + ComboSideToJSON(combo.side[0]) + ",\n";
+    json += "    \"player2\": " + ComboSideToJSON(combo.side[1]) + "\n";
+    json += "  }";
+    return json;
 }
 
 std::string GameData::ToJSON() const {
     std::string json = "{\n";
     json += "  \"player1\": {\n";
-    json += "    \"nickname\": \"" + player1.nickname + "\",\n";
-    json += "    \"character\": \"" + player1.character + "\",\n";
+    json += "    \"nickname\": \"" + EscapeJSON(player1.nickname.str()) + "\",\n";
+    json += "    \"character\": \"" + player1.character.str() + "\",\n";
     json += "    \"characterId\": " + std::to_string(player1.characterId) + ",\n";
-    json += "    \"winCount\": " + std::to_string(player1.winCount) + "\n";
+    json += "    \"winCount\": " + std::to_string(player1.winCount) + ",\n";
+    json += "    \"rating\": " + std::to_string(player1.rating.rating) + ",\n";
+    json += "    \"ratingDeviation\": " + std::to_string(player1.rating.deviation) + ",\n";
+    json += "    \"stats\": " + SummaryToJSON(player1.stats) + "\n";
     json += "  },\n";
     json += "  \"player2\": {\n";
-    json += "    \"nickname\": \"" + player2.nickname + "\",\n";
-    json += "    \"character\": \"" + player2.character + "\",\n";
+    json += "    \"nickname\": \"" + EscapeJSON(player2.nickname.str()) + "\",\n";
+    json += "    \"character\": \"" + player2.character.str() + "\",\n";
     json += "    \"characterId\": " + std::to_string(player2.characterId) + ",\n";
-    json += "    \"winCount\": " + std::to_string(player2.winCount) + "\n";
+    json += "    \"winCount\": " + std::to_string(player2.winCount) + ",\n";
+    json += "    \"rating\": " + std::to_string(player2.rating.rating) + ",\n";
+    json += "    \"ratingDeviation\": " + std::to_string(player2.rating.deviation) + ",\n";
+    json += "    \"stats\": " + SummaryToJSON(player2.stats) + "\n";
     json += "  },\n";
-    json += "  \"gameActive\": " + std::string(gameActive ? "true" : "false") + "\n";
+    json += "  \"gameActive\": " + std::string(gameActive ? "true" : "false") + ",\n";
+    json += "  \"layout\": { \"mode\": \"" + layout.str() + "\", \"confidence\": " + std::to_string(layoutConfidence) + " },\n";
+    json += "  \"netplay\": " + NetplayToJSON(netplay) + ",\n";
+    json += "  \"combo\": " + ComboToJSON(combo) + "\n";
     json += "}";
     return json;
 }
+
+// Changed fields of one side; fields uses FIELD_P1_* positions
+static std::string PlayerDeltaToJSON(const PlayerData& player, uint32_t fields) {
+    std::string json;
+    auto add = [&json](const std::string& entry) {
+        json += (json.empty() ? "" : ",\n") + entry;
+    };
+    if (fields & FIELD_P1_NICKNAME) {
+        add("    \"nickname\": \"" + EscapeJSON(player.nickname.str()) + "\"");
+    }
+    if (fields & FIELD_P1_CHARACTER) {
+        add("    \"character\": \"" + player.character.str() + "\",\n    \"characterId\": " + std::to_string(player.characterId));
+    }
+    if (fields & FIELD_P1_WINS) {
+        add("    \"winCount\": " + std::to_string(player.winCount));
+    }
+    if (fields & FIELD_P1_STATS) {
+        add("    \"rating\": " + std::to_string(player.rating.rating) + ",\n" +
+            "    \"ratingDeviation\": " + std::to_string(player.rating.deviation) + ",\n" +
+            "    \"stats\": " + SummaryToJSON(player.stats));
+    }
+    return json;
+}
+
+std::string GameDelta::ToJSON() const {
+    std::string json = "{\n";
+    json += "  \"fromVersion\": " + std::to_string(fromVersion) + ",\n";
+    json += "  \"toVersion\": " + std::to_string(toVersion) + ",\n";
+    json += "  \"resync\": " + std::string(resync ? "true" : "false") + ",\n";
+    json += "  \"changedFields\": " + std::to_string(changedFields);
+    
+    uint32_t p1Fields = changedFields & 0xF;
+    uint32_t p2Fields = (changedFields >> 4) & 0xF;
+    if (p1Fields) {
+        json += ",\n  \"player1\": {\n" + PlayerDeltaToJSON(newData->player1, p1Fields) + "\n  }";
+    }
+    if (p2Fields) {
+        json += ",\n  \"player2\": {\n" + PlayerDeltaToJSON(newData->player2, p2Fields) + "\n  }";
+    }
+    if (changedFields & FIELD_GAME_ACTIVE) {
+        json += ",\n  \"gameActive\": " + std::string(newData->gameActive ? "true" : "false");
+    }
+    if (changedFields & FIELD_LAYOUT) {
+        json += ",\n  \"layout\": { \"mode\": \"" + newData->layout.str() + "\", \"confidence\": " +
+                std::to_string(newData->layoutConfidence) + " }";
+    }
+    if (changedFields & FIELD_NETPLAY) {
+        json += ",\n  \"netplay\": " + NetplayToJSON(newData->netplay);
+    }
+    if (changedFields & FIELD_COMBO) {
+        json += ",\n  \"combo\": " + ComboToJSON(newData->combo);
+    }
+    json += "\n}";
+    return json;
+}
@@ -0,0 +1,201 @@
+#include "../include/glyph_cache.h"
+#include <cmath>
+#include <cstring>
+
+// Private copy of stb_truetype; static so it never clashes with another one
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "imgui/imstb_truetype.h"
+
+struct GlyphCache::FontFace {
+    std::vector<uint8_t> data;
+    stbtt_fontinfo info;
+};
+
+// Next code point of UTF-8 text; malformed bytes become U+FFFD one at a time
+static uint32_t NextCodepoint(const std::string& text, size_t& index) {
+    uint8_t lead = (uint8_t)text[index++];
+    if (lead < 0x80) {
+        return lead;
+    }
+    int length = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : -1;
+    if (length < 0 || lead > 0xF4 || index + length > text.size()) {
+        return 0xFFFD;
+    }
+    uint32_t codepoint = lead & (0x3F >> length);
+    for (int i = 0; i < length; i++) {
+        uint8_t next = (uint8_t)text[index + i];
+        if ((next & 0xC0) != 0x80) {
+            return 0xFFFD;
+        }
+        codepoint = codepoint << 6 | (next & 0x3F);
+    }
+    index += length;
+    return codepoint;
+}
+
+GlyphCache::GlyphCache() {
+    atlas.assign((size_t)ATLAS_SIZE * ATLAS_SIZE, 0);
+    memset(&stats, 0, sizeof(stats));
+    ClearAtlas();
+}
+
+GlyphCache::~GlyphCache() = default;
+
+bool GlyphCache::AddFont(std::vector<uint8_t> data, std::string& error) {
+    std::unique_ptr<FontFace> face(new FontFace());
+    face->data = std::move(data);
+    int offset = face->data.empty() ? -1 : stbtt_GetFontOffsetForIndex(face->data.data(), 0);
+    if (offset < 0 || !stbtt_InitFont(&face->info, face->data.data(), offset)) {
+        error = "not a TrueType font";
+        return false;
+    }
+    fonts.push_back(std::move(face));
+    // Fallback order changed what some code points resolve to
+    ClearAtlas();
+    return true;
+}
+
+void GlyphCache::ClearAtlas() {
+    glyphs.clear();
+    shelfX = 0;
+    shelfY = 0;
+    shelfHeight = 0;
+}
+
+// Shelves: left to right along the current row, a new row below the
+// tallest glyph of the last one
+bool GlyphCache::Pack(int width, int height, int& x, int& y) {
+    if (width + 1 > ATLAS_SIZE || height + 1 > ATLAS_SIZE) {
+        return false;
+    }
+    if (shelfX + width + 1 > ATLAS_SIZE) {
+        shelfY += shelfHeight;
+        shelfX = 0;
+        shelfHeight = 0;
+    }
+    if (shelfY + height + 1 > ATLAS_SIZE) {
+        return false;
+    }
+    x = shelfX;
+    y = shelfY;
+    shelfX += width + 1;
+    shelfHeight = height + 1 > shelfHeight ? height + 1 : shelfHeight;
+    return true;
+}
+
+const GlyphCache::Glyph* GlyphCache::Lookup(uint32_t codepoint, int pixelSize) {
+    uint64_t key = (uint64_t)codepoint << 8 | (uint64_t)pixelSize;
+    auto found = glyphs.find(key);
+    if (found != glyphs.end()) {
+        stats.hits++;
+        return &found->second;
+    }
+    stats.misses++;
+
+    // First font that has it, else the first font's missing-glyph box
+    int font = 0;
+    int index = 0;
+    for (size_t candidate = 0; candidate < fonts.size() && index == 0; candidate++) {
+        index = stbtt_FindGlyphIndex(&fonts[candidate]->info, (int)codepoint);
+        font = index ? (int)candidate : 0;
+    }
+    const stbtt_fontinfo& info = fonts[font]->info;
+    float scale = stbtt_ScaleForPixelHeight(&info, (float)pixelSize);
+
+    int advance, bearing, x0, y0, x1, y1;
+    stbtt_GetGlyphHMetrics(&info, index, &advance, &bearing);
+    stbtt_GetGlyphBitmapBox(&info, index, scale, scale, &x0, &y0, &x1, &y1);
+
+    Glyph glyph = {};
+    glyph.width = (int16_t)(x1 - x0);
+    glyph.height = (int16_t)(y1 - y0);
+    glyph.offsetX = (int16_t)x0;
+    glyph.offsetY = (int16_t)y0;
+    glyph.advance = advance * scale;
+    glyph.font = font;
+    glyph.index = index;
+
+    int atlasX = 0, atlasY = 0;
+    if (glyph.width > 0 && glyph.height > 0) {
+        if (!Pack(glyph.width, glyph.height, atlasX, atlasY)) {
+            stats.flushes++;
+            ClearAtlas();
+            if (!Pack(glyph.width, glyph.height, atlasX, atlasY)) {
+                glyph.width = 0;    // Larger than the atlas: advance only
+                glyph.height = 0;
+            }
+        }
+        if (glyph.width > 0) {
+            stbtt_MakeGlyphBitmap(&info, atlas.data() + (size_t)atlasY * ATLAS_SIZE + atlasX, glyph.width,
+                                  glyph.height, ATLAS_SIZE, scale, scale, index);
+        }
+    }
+    glyph.atlasX = (int16_t)atlasX;
+    glyph.atlasY = (int16_t)atlasY;
+    return &glyphs.emplace(key, glyph).first->second;
+}
+
+void GlyphCache::GetLineMetrics(int pixelSize, int& ascent, int& descent) {
+    ascent = 0;
+    descent = 0;
+    if (fonts.empty()) {
+        return;
+    }
+    const stbtt_fontinfo& info = fonts[0]->info;
+    float scale = stbtt_ScaleForPixelHeight(&info, (float)pixelSize);
+    int fontAscent, fontDescent, lineGap;
+    stbtt_GetFontVMetrics(&info, &fontAscent, &fontDescent, &lineGap);
+    ascent = (int)std::ceil(fontAscent * scale);
+    descent = (int)std::ceil(-fontDescent * scale);
+}
+
+// Measures (canvas == nullptr) or draws; both walk the same pen positions
+int GlyphCache::Layout(Canvas* canvas, int x, int y, const std::string& utf8, int pixelSize, uint32_t color,
+                       const CanvasRect& clip) {
+    if (fonts.empty() || pixelSize <= 0) {
+        return 0;
+    }
+    pixelSize = pixelSize > MAX_PIXEL_SIZE ? MAX_PIXEL_SIZE : pixelSize;
+    float pen = 0.0f;
+    int previousFont = -1, previousIndex = 0;
+    for (size_t i = 0; i < utf8.size();) {
+        const Glyph* glyph = Lookup(NextCodepoint(utf8, i), pixelSize);
+        if (glyph->font == previousFont) {
+            const stbtt_fontinfo& info = fonts[glyph->font]->info;
+            pen += stbtt_GetGlyphKernAdvance(&info, previousIndex, glyph->index) *
+                   stbtt_ScaleForPixelHeight(&info, (float)pixelSize);
+        }
+        if (canvas && glyph->width > 0) {
+            int left = x + (int)std::lround(pen) + glyph->offsetX;
+            const uint8_t* mask = atlas.data() + (size_t)glyph->atlasY * ATLAS_SIZE + glyph->atlasX;
+            canvas->BlendMask(left, y + glyph->offsetY, mask, ATLAS_SIZE, glyph->width, glyph->height, color, clip);
+        }
+        pen += glyph->advance;
+        previousFont = glyph->font;
+        previousIndex = glyph->index;
+    }
+    return (int)std::lround(pen);
+}
+
+int GlyphCache::MeasureText(const std::string& utf8, int pixelSize) {
+    return Layout(nullptr, 0, 0, utf8, pixelSize, 0, CanvasRect());
+}
+
+int GlyphCache::DrawText(Canvas& canvas, int x, int y, const std::string& utf8, int pixelSize, uint32_t color,
+                         const CanvasRect& clip) {
+    return Layout(&canvas, x, y, utf8, pixelSize, color, clip);
+}
+
+GlyphCache::Stats GlyphCache::GetStats() const {
+    Stats result = stats;
+    result.glyphs = glyphs.size();
+    result.atlasRowsUsed = shelfY + shelfHeight;
+    return result;
+}
+
+void GlyphCache::ResetStats() {
+    stats.hits = 0;
+    stats.misses = 0;
+    stats.flushes = 0;
+}
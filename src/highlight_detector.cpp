@@ -0,0 +1,376 @@
+#include "../include/highlight_detector.h"
+#include <cstring>
+
+static const char* const TYPE_NAMES[HIGHLIGHT_TYPE_COUNT] = {
+    "long_combo", "perfect", "comeback", "match_point", "set_win",
+};
+
+HighlightDetector::HighlightDetector() {
+    Reset();
+}
+
+void HighlightDetector::Reset() {
+    queueHead = 0;
+    queueCount = 0;
+    dropped = 0;
+    lastFrame = 0;
+    lastUs = 0;
+    roundOpen = false;
+    roundClean = false;
+    round = 0;
+    memset(roundStartHp, 0, sizeof(roundStartHp));
+    memset(lastHp, 0, sizeof(lastHp));
+    memset(maxDeficit, 0, sizeof(maxDeficit));
+    memset(seenComboEnd, 0, sizeof(seenComboEnd));
+    scoreKnown = false;
+    StartSet();
+    memset(wins, 0, sizeof(wins));
+}
+
+void HighlightDetector::StartSet() {
+    setWon = false;
+    maxGameDeficit[0] = 0;
+    maxGameDeficit[1] = 0;
+}
+
+// Queued at the last frame seen; a full queue keeps the older events
+HighlightEvent* HighlightDetector::Emit(HighlightType type, int player, int score, int32_t value, int32_t detail) {
+    if (queueCount == QUEUE_SIZE) {
+        dropped++;
+        return nullptr;
+    }
+    HighlightEvent& event = queue[(queueHead + queueCount) % QUEUE_SIZE];
+    event.type = type;
+    event.player = player;
+    event.frame = lastFrame;
+    event.timestampUs = lastUs;
+    event.score = score > 100 ? 100 : score;
+    event.value = value;
+    event.detail = detail;
+    queueCount++;
+    return &event;
+}
+
+bool HighlightDetector::Pop(HighlightEvent& event) {
+    if (queueCount == 0) {
+        return false;
+    }
+    event = queue[queueHead];
+    queueHead = (queueHead + 1) % QUEUE_SIZE;
+    queueCount--;
+    return true;
+}
+
+// lastHp still holds the round's final frame
+void HighlightDetector::EndRound(bool refilled) {
+    roundOpen = false;
+    if (lastHp[0] == lastHp[1]) {
+        return;
+    }
+    int winner = lastHp[0] > lastHp[1] ? 0 : 1;
+    // Players leaving mid-round is not a result
+    if (!refilled && lastHp[1 - winner] > 0) {
+        return;
+    }
+    if (roundClean && lastHp[winner] >= roundStartHp[winner]) {
+        Emit(HIGHLIGHT_PERFECT, winner, 85, lastHp[winner], 0);
+    }
+    if (maxDeficit[winner] >= config.comebackHp && config.comebackHp > 0) {
+        int score = 60 + (maxDeficit[winner] - config.comebackHp) / 200;
+        Emit(HIGHLIGHT_COMEBACK, winner, score > 90 ? 90 : score, maxDeficit[winner], 0);
+    }
+}
+
+void HighlightDetector::OnFrame(const ComboSample& sample, const ComboStats& combo) {
+    lastFrame = sample.frame;
+    lastUs = sample.timestampUs;
+
+    // Finished combos, marked where they started
+    for (int attacker = 0; attacker < 2; attacker++) {
+        const ComboSide& side = combo.side[attacker];
+        if (side.lastEndFrame == seenComboEnd[attacker]) {
+            continue;
+        }
+        seenComboEnd[attacker] = side.lastEndFrame;
+        if (side.lastHits == 0 ||
+            (side.lastHits < config.longComboHits && side.lastDamage < config.bigComboDamage)) {
+            continue;
+        }
+        int score = 30 + (int)side.lastHits * 2 + side.lastDamage / 250;
+        HighlightEvent* event =
+            Emit(HIGHLIGHT_LONG_COMBO, attacker, score > 90 ? 90 : score, (int32_t)side.lastHits, side.lastDamage);
+        if (event) {
+            event->frame = side.lastStartFrame;
+            event->timestampUs = side.lastStartUs;
+        }
+    }
+
+    if (!combo.available) {
+        if (roundOpen) {
+            EndRound(false);
+        }
+        return;
+    }
+
+    if (!roundOpen || combo.round != round) {
+        if (roundOpen) {
+            EndRound(true);
+        }
+        roundOpen = true;
+        round = combo.round;
+        roundClean = sample.hp[0] == sample.hp[1];
+        for (int player = 0; player < 2; player++) {
+            roundStartHp[player] = sample.hp[player];
+            maxDeficit[player] = 0;
+        }
+    }
+
+    for (int player = 0; player < 2; player++) {
+        int32_t deficit = sample.hp[1 - player] - sample.hp[player];
+        maxDeficit[player] = deficit > maxDeficit[player] ? deficit : maxDeficit[player];
+        lastHp[player] = sample.hp[player];
+    }
+}
+
+void HighlightDetector::OnScore(int p1Wins, int p2Wins) {
+    int now[2] = {p1Wins, p2Wins};
+    if (!scoreKnown || now[0] < wins[0] || now[1] < wins[1]) {
+        // Attached mid-set, new players, or the counters were reset
+        scoreKnown = true;
+        StartSet();
+        wins[0] = now[0];
+        wins[1] = now[1];
+        setWon = config.firstTo > 0 && (now[0] >= config.firstTo || now[1] >= config.firstTo);
+        return;
+    }
+
+    bool scored[2] = {now[0] > wins[0], now[1] > wins[1]};
+    wins[0] = now[0];
+    wins[1] = now[1];
+    for (int player = 0; player < 2; player++) {
+        int deficit = wins[1 - player] - wins[player];
+        maxGameDeficit[player] = deficit > maxGameDeficit[player] ? deficit : maxGameDeficit[player];
+    }
+    if (config.firstTo <= 0 || setWon) {
+        return;
+    }
+
+    for (int player = 0; player < 2; player++) {
+        if (!scored[player]) {
+            continue;
+        }
+        if (wins[player] >= config.firstTo) {
+            setWon = true;
+            Emit(HIGHLIGHT_SET_WIN, player, 100, wins[player], wins[1 - player]);
+            if (config.comebackGames > 0 && maxGameDeficit[player] >= config.comebackGames) {
+                Emit(HIGHLIGHT_COMEBACK, player, 95, maxGameDeficit[player], 1);
+            }
+        } else if (wins[player] == config.firstTo - 1) {
+            if (wins[1 - player] == config.firstTo - 1) {
+                Emit(HIGHLIGHT_MATCH_POINT, -1, 75, wins[0], wins[1]);
+            } else {
+                Emit(HIGHLIGHT_MATCH_POINT, player, 60, wins[player], wins[1 - player]);
+            }
+        }
+    }
+}
+
+void HighlightDetector::OnSetEnd(int p1Wins, int p2Wins) {
+    if (!setWon && p1Wins != p2Wins) {
+        int winner = p1Wins > p2Wins ? 0 : 1;
+        int winnerGames = winner == 0 ? p1Wins : p2Wins;
+        int loserGames = winner == 0 ? p2Wins : p1Wins;
+        Emit(HIGHLIGHT_SET_WIN, winner, 100, winnerGames, loserGames);
+        if (config.comebackGames > 0 && maxGameDeficit[winner] >= config.comebackGames) {
+            Emit(HIGHLIGHT_COMEBACK, winner, 95, maxGameDeficit[winner], 1);
+        }
+    }
+    // The next counters belong to a new set
+    scoreKnown = false;
+    StartSet();
+}
+
+const char* HighlightDetector::GetTypeName(HighlightType type) {
+    return type >= 0 && type < HIGHLIGHT_TYPE_COUNT ? TYPE_NAMES[type] : "unknown";
+}
+
+std::string HighlightDetector::Describe(const HighlightEvent& event, const std::string& p1Name,
+                                        const std::string& p2Name) {
+    std::string name = event.player == 1 ? p2Name : p1Name;
+    std::string score = std::to_string(event.value) + "-" + std::to_string(event.detail);
+    switch (event.type) {
+    case HIGHLIGHT_LONG_COMBO:
+        return name + " " + std::to_string(event.value) + "-hit combo (" + std::to_string(event.detail) + " damage)";
+    case HIGHLIGHT_PERFECT:
+        return name + " perfect round";
+    case HIGHLIGHT_COMEBACK:
+        if (event.detail == 1) {
+            return name + " comes back from " + std::to_string(event.value) + " games down";
+        }
+        return name + " comeback from " + std::to_string(event.value) + " HP behind";
+    case HIGHLIGHT_MATCH_POINT:
+        if (event.player < 0) {
+            return "Deciding game (" + score + ")";
+        }
+        return name + " match point (" + score + ")";
+    case HIGHLIGHT_SET_WIN:
+        return name + " wins the set " + score;
+    default:
+        return name + " " + GetTypeName(event.type);
+    }
+}
+
+// Scripted frames for the self-test: a ComboTracker turns HP into stats
+// exactly as the sampler would
+struct HighlightScript {
+    ComboTracker tracker;
+    HighlightDetector detector;
+    uint32_t frame = 0;
+
+    void Play(int32_t hp1, int32_t hitstun1, int32_t hp2, int32_t hitstun2) {
+        ComboSample sample;
+        sample.frame = frame;
+        sample.timestampUs = (uint64_t)frame * 16667;
+        sample.hp[0] = hp1;
+        sample.hp[1] = hp2;
+        sample.hitstun[0] = hitstun1;
+        sample.hitstun[1] = hitstun2;
+        tracker.Record(sample);
+        detector.OnFrame(sample, tracker.GetStats());
+        frame++;
+    }
+
+    std::string Take(HighlightType type, int player, HighlightEvent* out = nullptr) {
+        HighlightEvent event;
+        if (!detector.Pop(event)) {
+            return std::string("no event, expected ") + HighlightDetector::GetTypeName(type);
+        }
+        if (event.type != type || event.player != player) {
+            return std::string("got ") + HighlightDetector::Describe(event) + ", expected " +
+                   HighlightDetector::GetTypeName(type);
+        }
+        if (out) {
+            *out = event;
+        }
+        return "";
+    }
+};
+
+bool HighlightDetector::RunSelfTest(std::string& failure) {
+    failure.clear();
+    HighlightScript script;
+    HighlightEvent event;
+
+    // Round 1: player 1 lands a 16-hit combo and wins without being touched
+    script.Play(10000, 0, 10000, 0);
+    script.Play(10000, 0, 10000, 0);
+    uint32_t comboStart = script.frame;
+    int32_t hp = 10000;
+    for (int hit = 0; hit < 16; hit++) {
+        hp -= 500;
+        script.Play(10000, 0, hp, 20);
+    }
+    script.Play(10000, 0, hp, 0);
+    if ((failure = script.Take(HIGHLIGHT_LONG_COMBO, 0, &event)) != "") return false;
+    if (event.value != 16 || event.detail != 8000 || event.frame != comboStart) {
+        failure = "long combo: " + Describe(event) + " at frame " + std::to_string(event.frame);
+        return false;
+    }
+    script.Play(10000, 0, 0, 30);
+    script.Play(10000, 0, 0, 0);
+    script.Play(10000, 0, 10000, 0);    // Refill: round 2
+    if ((failure = script.Take(HIGHLIGHT_PERFECT, 0)) != "") return false;
+    if (script.detector.GetPending() != 0) {
+        failure = "perfect round also reported a comeback";
+        return false;
+    }
+
+    // A short weak combo is not a highlight; player 2 then wins from 7000 HP behind
+    script.Play(10000, 0, 9000, 10);
+    script.Play(10000, 0, 8000, 10);
+    script.Play(10000, 0, 8000, 0);
+    script.Play(10000, 0, 3000, 0);     // Chip, no combo
+    script.Play(2000, 0, 3000, 0);
+    script.Play(0, 0, 3000, 0);
+    script.Play(10000, 0, 10000, 0);
+    if ((failure = script.Take(HIGHLIGHT_COMEBACK, 1, &event)) != "") return false;
+    if (event.value != 7000 || event.detail != 0) {
+        failure = "round comeback: " + Describe(event);
+        return false;
+    }
+    if (script.detector.GetPending() != 0) {
+        failure = "a 2-hit combo or a damaged win was marked";
+        return false;
+    }
+
+    // Players leaving mid-round decide nothing; leaving at 0 HP does
+    script.Play(10000, 0, 9000, 0);
+    script.Play(-1, -1, -1, -1);
+    if (script.detector.GetPending() != 0) {
+        failure = "abandoned round was scored";
+        return false;
+    }
+    script.Play(10000, 0, 10000, 0);
+    script.Play(10000, 0, 0, 0);
+    script.Play(-1, -1, -1, -1);
+    if ((failure = script.Take(HIGHLIGHT_PERFECT, 0)) != "") return false;
+
+    // First to 3: match points, a deciding game and a set comeback
+    HighlightDetector& detector = script.detector;
+    detector.OnScore(0, 0);
+    detector.OnScore(0, 1);
+    detector.OnScore(0, 2);
+    if ((failure = script.Take(HIGHLIGHT_MATCH_POINT, 1)) != "") return false;
+    detector.OnScore(1, 2);
+    detector.OnScore(2, 2);
+    if ((failure = script.Take(HIGHLIGHT_MATCH_POINT, -1)) != "") return false;
+    detector.OnScore(3, 2);
+    if ((failure = script.Take(HIGHLIGHT_SET_WIN, 0, &event)) != "") return false;
+    if (event.value != 3 || event.detail != 2) {
+        failure = "set win: " + Describe(event);
+        return false;
+    }
+    if ((failure = script.Take(HIGHLIGHT_COMEBACK, 0, &event)) != "") return false;
+    if (event.value != 2 || event.detail != 1) {
+        failure = "set comeback: " + Describe(event);
+        return false;
+    }
+
+    // The set is recorded when the counters reset; it is not marked twice
+    detector.OnSetEnd(3, 2);
+    detector.OnScore(0, 0);
+    if (detector.GetPending() != 0) {
+        failure = "set end marked an already won set";
+        return false;
+    }
+
+    // Attaching mid-set only sets the baseline; without a set length the
+    // winner is marked when the set is recorded
+    HighlightConfig config = detector.GetConfig();
+    config.firstTo = 0;
+    detector.Configure(config);
+    detector.OnSetEnd(0, 0);
+    detector.OnScore(4, 1);
+    detector.OnScore(5, 1);
+    if (detector.GetPending() != 0) {
+        failure = "unknown set length produced a match point";
+        return false;
+    }
+    detector.OnSetEnd(5, 1);
+    if ((failure = script.Take(HIGHLIGHT_SET_WIN, 0, &event)) != "") return false;
+    if (Describe(event, "Alice", "Bob") != "Alice wins the set 5-1") {
+        failure = "description: " + Describe(event, "Alice", "Bob");
+        return false;
+    }
+
+    // A full queue keeps the oldest events
+    for (size_t i = 0; i < QUEUE_SIZE + 3; i++) {
+        detector.OnSetEnd(1, 0);
+    }
+    if (detector.GetPending() != QUEUE_SIZE || detector.GetDropped() != 3) {
+        failure = "queue overflow: " + std::to_string(detector.GetPending()) + " queued, " +
+                  std::to_string(detector.GetDropped()) + " dropped";
+        return false;
+    }
+    return true;
+}
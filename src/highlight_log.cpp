@@ -0,0 +1,395 @@
+#include "../include/highlight_log.h"
+#include "../include/game_data.h"
+#include "../include/nickname_pool.h"
+#include "../include/logger.h"
+#include <filesystem>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+bool HighlightLog::enabled = false;
+HighlightDetector HighlightLog::detector;
+std::vector<HighlightLog::Marker> HighlightLog::markers;
+HighlightLog::LogFile HighlightLog::files[HighlightLog::LOG_FILE_COUNT];
+LoopTimer HighlightLog::flushTimer;
+int64_t HighlightLog::streamStartUs = 0;
+uint32_t HighlightLog::frameRate = 60;
+int HighlightLog::chapterMinScore = 60;
+uint32_t HighlightLog::edlEvents = 0;
+HighlightLog::Stats HighlightLog::stats = {};
+
+static const char* const FILE_NAMES[] = {"highlights.csv", "highlights.edl", "highlights_chapters.txt"};
+static const char* const FILE_HEADERS[] = {
+    "timecode,seconds,wall_clock,type,player,score,description\r\n",
+    "TITLE: EFZ highlights\r\nFCM: NON-DROP FRAME\r\n\r\n",
+    "",
+};
+// Resolve marker colours, by HighlightType
+static const char* const EDL_COLORS[HIGHLIGHT_TYPE_COUNT] = {
+    "ResolveColorBlue", "ResolveColorYellow", "ResolveColorRed", "ResolveColorPurple", "ResolveColorGreen",
+};
+
+// Same clock as the sampler's timestamps
+static int64_t QpcMicros() {
+    LARGE_INTEGER frequency, now;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return (int64_t)(now.QuadPart / frequency.QuadPart * 1000000 +
+                     now.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
+
+static int64_t LocalTimeTo100ns(const SYSTEMTIME& time) {
+    FILETIME file;
+    SystemTimeToFileTime(&time, &file);
+    return (int64_t)(((uint64_t)file.dwHighDateTime << 32) | file.dwLowDateTime);
+}
+
+// Local wall clock time to the sampler clock; false if the text is not a time
+static bool ParseStreamStart(const char* text, int64_t& startUs) {
+    SYSTEMTIME now;
+    GetLocalTime(&now);
+    SYSTEMTIME start = now;
+    int year, month, day, hour, minute, second;
+    if (sscanf(text, "%d-%d-%d %d:%d:%d", &year, &month, &day, &hour, &minute, &second) == 6) {
+        start.wYear = (WORD)year;
+        start.wMonth = (WORD)month;
+        start.wDay = (WORD)day;
+    } else if (sscanf(text, "%d:%d:%d", &hour, &minute, &second) != 3) {
+        return false;
+    }
+    start.wHour = (WORD)hour;
+    start.wMinute = (WORD)minute;
+    start.wSecond = (WORD)second;
+    start.wMilliseconds = 0;
+    start.wDayOfWeek = 0;
+    startUs = QpcMicros() - (LocalTimeTo100ns(now) - LocalTimeTo100ns(start)) / 10;
+    return true;
+}
+
+// "H:MM:SS" with optional milliseconds; negative times (before the stream) are 0
+static std::string FormatClock(int64_t us, bool milliseconds) {
+    us = us > 0 ? us : 0;
+    int64_t seconds = us / 1000000;
+    char text[32];
+    if (milliseconds) {
+        snprintf(text, sizeof(text), "%d:%02d:%02d.%03d", (int)(seconds / 3600), (int)(seconds / 60 % 60),
+                 (int)(seconds % 60), (int)(us / 1000 % 1000));
+    } else {
+        snprintf(text, sizeof(text), "%d:%02d:%02d", (int)(seconds / 3600), (int)(seconds / 60 % 60),
+                 (int)(seconds % 60));
+    }
+    return text;
+}
+
+// SMPTE HH:MM:SS:FF
+static std::string FormatTimecode(int64_t us, uint32_t frameRate) {
+    us = us > 0 ? us : 0;
+    int64_t frames = us * frameRate / 1000000;
+    int64_t seconds = frames / frameRate;
+    char text[32];
+    snprintf(text, sizeof(text), "%02d:%02d:%02d:%02d", (int)(seconds / 3600), (int)(seconds / 60 % 60),
+             (int)(seconds % 60), (int)(frames % frameRate));
+    return text;
+}
+
+static std::string NicknameOrSide(uint32_t id, const char* side) {
+    if (id == NicknamePool::INVALID_ID) {
+        return side;
+    }
+    std::string name = NicknamePool::Get(id).str();
+    return name.empty() ? side : name;
+}
+
+static std::string QuoteCsv(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        quoted += c;
+        if (c == '"') {
+            quoted += '"';
+        }
+    }
+    return quoted + "\"";
+}
+
+void HighlightLog::LoadConfig(const std::string& path) {
+    const char* section = "Highlights";
+    const char* file = path.c_str();
+
+    if (!std::filesystem::exists(path)) {
+        WritePrivateProfileStringA(section, "Enabled", "1", file);
+        WritePrivateProfileStringA(section, "StreamStart", "", file);
+        WritePrivateProfileStringA(section, "FrameRate", "60", file);
+        WritePrivateProfileStringA(section, "ChapterMinScore", "60", file);
+        WritePrivateProfileStringA(section, "FirstTo", "3", file);
+        WritePrivateProfileStringA(section, "LongComboHits", "15", file);
+        WritePrivateProfileStringA(section, "BigComboDamage", "4000", file);
+        WritePrivateProfileStringA(section, "ComebackHp", "4000", file);
+        WritePrivateProfileStringA(section, "ComebackGames", "2", file);
+    }
+
+    HighlightConfig config;
+    enabled = GetPrivateProfileIntA(section, "Enabled", 1, file) != 0;
+    frameRate = GetPrivateProfileIntA(section, "FrameRate", 60, file);
+    frameRate = frameRate ? frameRate : 60;
+    chapterMinScore = (int)GetPrivateProfileIntA(section, "ChapterMinScore", 60, file);
+    config.firstTo = (int32_t)GetPrivateProfileIntA(section, "FirstTo", config.firstTo, file);
+    config.longComboHits = GetPrivateProfileIntA(section, "LongComboHits", config.longComboHits, file);
+    config.bigComboDamage = (int32_t)GetPrivateProfileIntA(section, "BigComboDamage", config.bigComboDamage, file);
+    config.comebackHp = (int32_t)GetPrivateProfileIntA(section, "ComebackHp", config.comebackHp, file);
+    config.comebackGames = (int32_t)GetPrivateProfileIntA(section, "ComebackGames", config.comebackGames, file);
+    detector.Configure(config);
+
+    char start[64] = {};
+    GetPrivateProfileStringA(section, "StreamStart", "", start, sizeof(start), file);
+    streamStartUs = QpcMicros();
+    if (start[0] != '\0' && !ParseStreamStart(start, streamStartUs)) {
+        Logger::Warning(std::string("Ignoring StreamStart=") + start + " (expected YYYY-MM-DD HH:MM:SS or HH:MM:SS)");
+    }
+}
+
+bool HighlightLog::Initialize(const std::string& directory) {
+    LoadConfig((std::filesystem::path(directory) / "highlights.ini").string());
+    if (!enabled) {
+        Logger::Info("Highlight markers disabled");
+        return false;
+    }
+
+    // Continue the EDL's event numbers across sessions
+    std::string edlPath = (std::filesystem::path(directory) / FILE_NAMES[LOG_EDL]).string();
+    std::ifstream edl(edlPath);
+    for (std::string line; std::getline(edl, line);) {
+        if (!line.empty() && line[0] >= '0' && line[0] <= '9') {
+            edlEvents++;
+        }
+    }
+
+    bool opened = true;
+    for (int index = 0; index < LOG_FILE_COUNT; index++) {
+        std::string path = (std::filesystem::path(directory) / FILE_NAMES[index]).string();
+        opened = Open(files[index], path, FILE_HEADERS[index]) && opened;
+    }
+    markers.reserve(HighlightDetector::QUEUE_SIZE);
+
+    flushTimer.callback = OnFlushTimer;
+    flushTimer.background = true;
+    EventLoop::AddTimer(&flushTimer, FLUSH_INTERVAL_MS, FLUSH_INTERVAL_MS);
+    Logger::Info("Highlight markers: " + FormatClock(QpcMicros() - streamStartUs, false) +
+                 " into the stream, first to " + std::to_string(detector.GetConfig().firstTo));
+    return opened;
+}
+
+// Opened for appending only; overlapped writes at offset 0xFFFFFFFF'FFFFFFFF
+// land at the end of the file
+bool HighlightLog::Open(LogFile& file, const std::string& path, const char* header) {
+    file.handle = CreateFileA(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
+    if (file.handle == INVALID_HANDLE_VALUE) {
+        LOG_WIN32_ERROR("Could not open " + path);
+        return false;
+    }
+    LARGE_INTEGER size = {};
+    GetFileSizeEx(file.handle, &size);
+    if (size.QuadPart == 0) {
+        file.pending = header;
+    }
+
+    file.handler.callback = OnWriteComplete;
+    file.handler.context = &file;
+    if (!EventLoop::AssociateHandle(file.handle, &file.handler)) {
+        CloseHandle(file.handle);
+        file.handle = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    return true;
+}
+
+void HighlightLog::Shutdown() {
+    EventLoop::CancelTimer(&flushTimer);
+    if (!enabled) {
+        return;
+    }
+
+    // The loop runs no more tasks: finish what is in flight, then write the rest
+    // synchronously (the low bit on hEvent keeps it off the port)
+    Collect(GameDataManager::GetCurrentData().player1.nicknameId, GameDataManager::GetCurrentData().player2.nicknameId);
+    for (const Marker& marker : markers) {
+        Format(marker);
+    }
+    markers.clear();
+
+    HANDLE event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    for (LogFile& file : files) {
+        if (file.handle == INVALID_HANDLE_VALUE) {
+            continue;
+        }
+        DWORD bytes = 0;
+        if (file.busy && !GetOverlappedResult(file.handle, &file.overlapped, &bytes, TRUE)) {
+            file.pending = file.writing + file.pending;
+        }
+        if (!file.pending.empty() && event) {
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = 0xFFFFFFFF;
+            overlapped.OffsetHigh = 0xFFFFFFFF;
+            overlapped.hEvent = (HANDLE)((ULONG_PTR)event | 1);
+            if (WriteFile(file.handle, file.pending.data(), (DWORD)file.pending.size(), nullptr, &overlapped) ||
+                GetLastError() == ERROR_IO_PENDING) {
+                GetOverlappedResult(file.handle, &overlapped, &bytes, TRUE);
+            }
+        }
+        CloseHandle(file.handle);
+        file.handle = INVALID_HANDLE_VALUE;
+    }
+    if (event) {
+        CloseHandle(event);
+    }
+}
+
+void HighlightLog::OnFrame(const ComboSample& sample, const ComboStats& combo) {
+    if (!enabled) {
+        return;
+    }
+    detector.OnFrame(sample, combo);
+    if (detector.GetPending()) {
+        const GameData& data = GameDataManager::GetCurrentData();
+        Collect(data.player1.nicknameId, data.player2.nicknameId);
+    }
+}
+
+void HighlightLog::OnScore(int p1Wins, int p2Wins) {
+    if (!enabled) {
+        return;
+    }
+    detector.OnScore(p1Wins, p2Wins);
+    if (detector.GetPending()) {
+        const GameData& data = GameDataManager::GetCurrentData();
+        Collect(data.player1.nicknameId, data.player2.nicknameId);
+    }
+}
+
+// The set's own players; the current ones may already be the next pair
+void HighlightLog::OnSetEnd(int p1Wins, int p2Wins, uint32_t p1NicknameId, uint32_t p2NicknameId) {
+    if (!enabled) {
+        return;
+    }
+    detector.OnSetEnd(p1Wins, p2Wins);
+    Collect(p1NicknameId, p2NicknameId);
+}
+
+// Moves queued events out of the detector; formatting waits for the flush
+void HighlightLog::Collect(uint32_t p1NicknameId, uint32_t p2NicknameId) {
+    Marker marker;
+    marker.p1NicknameId = p1NicknameId;
+    marker.p2NicknameId = p2NicknameId;
+    while (detector.Pop(marker.event)) {
+        markers.push_back(marker);
+    }
+}
+
+void HighlightLog::MarkStreamStart() {
+    streamStartUs = QpcMicros();
+    Logger::Info("Highlight markers now count from the stream start");
+}
+
+void HighlightLog::Format(const Marker& marker) {
+    const HighlightEvent& event = marker.event;
+    std::string p1 = NicknameOrSide(marker.p1NicknameId, "P1");
+    std::string p2 = NicknameOrSide(marker.p2NicknameId, "P2");
+    std::string description = HighlightDetector::Describe(event, p1, p2);
+    std::string player = event.player < 0 ? "both" : (event.player == 0 ? p1 : p2);
+    int64_t offsetUs = (int64_t)event.timestampUs - streamStartUs;
+
+    // Wall clock from how long ago the event was sampled
+    SYSTEMTIME now;
+    GetLocalTime(&now);
+    int64_t wall100ns = LocalTimeTo100ns(now) - (QpcMicros() - (int64_t)event.timestampUs) * 10;
+    FILETIME wallFile = {(DWORD)wall100ns, (DWORD)((uint64_t)wall100ns >> 32)};
+    SYSTEMTIME wall;
+    FileTimeToSystemTime(&wallFile, &wall);
+    char wallText[32];
+    snprintf(wallText, sizeof(wallText), "%04d-%02d-%02d %02d:%02d:%02d", wall.wYear, wall.wMonth, wall.wDay,
+             wall.wHour, wall.wMinute, wall.wSecond);
+
+    char seconds[32];
+    snprintf(seconds, sizeof(seconds), "%.3f", (offsetUs > 0 ? offsetUs : 0) / 1e6);
+    files[LOG_CSV].pending += FormatClock(offsetUs, true) + "," + seconds + "," + wallText + "," +
+                              HighlightDetector::GetTypeName(event.type) + "," + QuoteCsv(player) + "," +
+                              std::to_string(event.score) + "," + QuoteCsv(description) + "\r\n";
+
+    // One-frame marker event; '|' separates the marker fields
+    std::string name = description;
+    for (char& c : name) {
+        c = c == '|' ? '/' : c;
+    }
+    std::string in = FormatTimecode(offsetUs, frameRate);
+    std::string out = FormatTimecode(offsetUs + 1000000 / frameRate, frameRate);
+    char number[16];
+    snprintf(number, sizeof(number), "%03u", ++edlEvents);
+    files[LOG_EDL].pending += std::string(number) + "  001      V     C        " + in + " " + out + " " + in + " " + out +
+                              "\r\n |C:" + EDL_COLORS[event.type] + " |M:" + name + " |D:1\r\n\r\n";
+
+    if (event.score >= chapterMinScore) {
+        files[LOG_CHAPTERS].pending += FormatClock(offsetUs, false) + " " + description + "\r\n";
+    }
+    stats.markers++;
+}
+
+// One write in flight per file; what arrives meanwhile goes out with the next
+void HighlightLog::StartWrite(LogFile& file) {
+    if (file.busy || file.pending.empty() || file.handle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    file.writing.swap(file.pending);
+    file.pending.clear();
+    memset(&file.overlapped, 0, sizeof(file.overlapped));
+    file.overlapped.Offset = 0xFFFFFFFF;
+    file.overlapped.OffsetHigh = 0xFFFFFFFF;
+    file.busy = true;
+    // Completes through the port even when WriteFile finishes immediately
+    if (!WriteFile(file.handle, file.writing.data(), (DWORD)file.writing.size(), nullptr, &file.overlapped) &&
+        GetLastError() != ERROR_IO_PENDING) {
+        LOG_WIN32_ERROR("Highlight marker append failed");
+        file.busy = false;
+        file.pending = file.writing + file.pending;
+        file.writing.clear();
+        stats.failedWrites++;
+    }
+}
+
+void HighlightLog::OnWriteComplete(void* context, OVERLAPPED* overlapped, DWORD bytes, DWORD error) {
+    LogFile& file = *static_cast<LogFile*>(context);
+    file.busy = false;
+    if (error != 0 || bytes != file.writing.size()) {
+        Logger::Warning("Highlight marker append failed (error " + std::to_string(error) + "), retrying");
+        file.pending = file.writing.substr(error == 0 ? bytes : 0) + file.pending;
+        stats.failedWrites++;
+    } else {
+        stats.writes++;
+    }
+    stats.bytes += bytes;
+    file.writing.clear();
+}
+
+void HighlightLog::Flush() {
+    for (const Marker& marker : markers) {
+        Format(marker);
+    }
+    markers.clear();
+    for (LogFile& file : files) {
+        StartWrite(file);
+    }
+}
+
+void HighlightLog::OnFlushTimer(void* context) {
+    Flush();
+}
+
+HighlightLog::Stats HighlightLog::GetStats() {
+    Stats result = stats;
+    result.dropped = detector.GetDropped();
+    result.pendingBytes = 0;
+    for (const LogFile& file : files) {
+        result.pendingBytes += file.pending.size() + file.writing.size();
+    }
+    result.streamSeconds = (QpcMicros() - streamStartUs) / 1e6;
+    return result;
+}
@@ -0,0 +1,132 @@
+#include "../include/input_display.h"
+#include "../include/memory_reader.h"
+#include "../include/logger.h"
+#include <filesystem>
+#include <fstream>
+#include <new>
+
+HANDLE InputDisplay::mapping = nullptr;
+InputRing* InputDisplay::ring = nullptr;
+InputRecorder* InputDisplay::recorder = nullptr;
+uint64_t InputDisplay::recordedApplied = 0;
+uint32_t InputDisplay::jsonSequence = 0;
+std::string InputDisplay::jsonPath;
+LoopTimer InputDisplay::jsonTimer;
+uint64_t InputDisplay::captures = 0;
+uint64_t InputDisplay::captureTicks = 0;
+uint64_t InputDisplay::maxCaptureTicks = 0;
+
+bool InputDisplay::Initialize(const std::string& directory) {
+    jsonPath = (std::filesystem::path(directory) / "input_display.json").string();
+
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(InputRing),
+                                 INPUT_RING_MAPPING_NAME);
+    void* view = nullptr;
+    if (!mapping) {
+        LOG_WIN32_ERROR("Input display mapping unavailable");
+    } else {
+        view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(InputRing));
+        if (!view) {
+            LOG_WIN32_ERROR("MapViewOfFile failed for input display");
+            CloseHandle(mapping);
+            mapping = nullptr;
+        }
+    }
+    // Without the mapping the JSON file still works from a private ring
+    ring = view ? new (view) InputRing() : new InputRing();
+    recorder = new InputRecorder(ring);
+
+    jsonTimer.callback = OnJsonTimer;
+    EventLoop::AddTimer(&jsonTimer, JSON_INTERVAL_MS, JSON_INTERVAL_MS);
+    Logger::Info(std::string("Input display ready (") + (mapping ? INPUT_RING_MAPPING_NAME : "not shared") + ", " +
+                 std::to_string(sizeof(InputRing)) + " bytes)");
+    return mapping != nullptr;
+}
+
+void InputDisplay::Shutdown() {
+    EventLoop::CancelTimer(&jsonTimer);
+    delete recorder;
+    recorder = nullptr;
+    if (mapping) {
+        UnmapViewOfFile(ring);
+        CloseHandle(mapping);
+        mapping = nullptr;
+    } else {
+        delete ring;
+    }
+    ring = nullptr;
+
+    std::error_code error;
+    std::filesystem::remove(jsonPath, error);
+}
+
+void InputDisplay::OnCapture(uint32_t frame) {
+    uint64_t applied = MemoryReader::GetAppliedCount();
+    if (!recorder || applied == recordedApplied) {
+        return;
+    }
+    recordedApplied = applied;
+
+    LARGE_INTEGER start, end;
+    QueryPerformanceCounter(&start);
+    uint8_t p1, p2;
+    if (!MemoryReader::GetInputs(p1, p2)) {
+        return;
+    }
+    recorder->Record(frame, p1, p2);
+    QueryPerformanceCounter(&end);
+
+    uint64_t ticks = (uint64_t)(end.QuadPart - start.QuadPart);
+    captures++;
+    captureTicks += ticks;
+    maxCaptureTicks = ticks > maxCaptureTicks ? ticks : maxCaptureTicks;
+}
+
+void InputDisplay::OnJsonTimer(void* context) {
+    if (!ring) {
+        return;
+    }
+    uint32_t sequence = ring->sequence.load(std::memory_order_acquire);
+    if (sequence != jsonSequence && WriteJson()) {
+        jsonSequence = sequence;
+    }
+}
+
+// Replaced in one step so an overlay polling the file never sees half of it
+bool InputDisplay::WriteJson() {
+    std::string temporary = jsonPath + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file << InputRecorder::ToJSON(*ring, JSON_RUNS);
+        if (!file) {
+            Logger::Warning("Could not write " + temporary);
+            return false;
+        }
+    }
+    if (!MoveFileExA(temporary.c_str(), jsonPath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        LOG_WIN32_ERROR("Could not replace input display file");
+        return false;
+    }
+    return true;
+}
+
+InputDisplay::Stats InputDisplay::GetStats() {
+    Stats stats = {};
+    if (recorder) {
+        stats.recorder = recorder->GetStats();
+    }
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    double nsPerTick = 1e9 / (double)frequency.QuadPart;
+    stats.captures = captures;
+    stats.averageCaptureNs = captures ? (double)captureTicks * nsPerTick / (double)captures : 0.0;
+    stats.maxCaptureNs = (double)maxCaptureTicks * nsPerTick;
+    stats.shared = mapping != nullptr;
+    return stats;
+}
+
+void InputDisplay::ResetStats() {
+    captures = 0;
+    captureTicks = 0;
+    maxCaptureTicks = 0;
+}
@@ -0,0 +1,366 @@
+#include "../include/input_recorder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+static const uint32_t RING_MASK = INPUT_RING_CAPACITY - 1;
+static const uint32_t MAX_HELD = 0xFFFF;
+static const int READ_ATTEMPTS = 64;
+
+static_assert((INPUT_RING_CAPACITY & RING_MASK) == 0, "INPUT_RING_CAPACITY must be a power of two");
+static_assert(sizeof(InputRun) == 8, "InputRun is part of the shared layout");
+
+InputRecorder::InputRecorder(InputRing* ring) : ring(ring) {
+    ring->magic = INPUT_RING_MAGIC;
+    ring->version = INPUT_RING_VERSION;
+    ring->capacity = INPUT_RING_CAPACITY;
+    ring->size = sizeof(InputRing);
+    ring->sequence.store(0, std::memory_order_relaxed);
+    Reset();
+}
+
+void InputRecorder::Reset() {
+    uint32_t sequence = ring->sequence.load(std::memory_order_relaxed);
+    ring->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ring->lastFrame = 0;
+    ring->written[0] = ring->written[1] = 0;
+    ring->sequence.store(sequence + 2, std::memory_order_release);
+    started = false;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void InputRecorder::Append(int player, uint32_t frame, uint32_t held, uint8_t input, uint8_t flags) {
+    uint32_t index = ring->written[player];
+    InputRun& run = ring->runs[player][index & RING_MASK];
+    run.frame = frame;
+    run.held = (uint16_t)held;
+    run.input = input;
+    run.flags = flags;
+    ring->written[player] = index + 1;
+}
+
+// Adds frames to the newest run when the input is the same and it has room
+void InputRecorder::Extend(int player, uint32_t frames, uint8_t input, uint8_t flags, uint32_t frame) {
+    uint32_t written = ring->written[player];
+    if (written > 0) {
+        InputRun& last = ring->runs[player][(written - 1) & RING_MASK];
+        if (last.input == input && last.held + frames <= MAX_HELD) {
+            last.held = (uint16_t)(last.held + frames);
+            last.flags |= flags;
+            return;
+        }
+    }
+    Append(player, frame, frames, input, flags);
+}
+
+void InputRecorder::Record(uint32_t frame, uint8_t p1, uint8_t p2) {
+    if (started && frame == ring->lastFrame) {
+        stats.duplicates++;
+        return;
+    }
+
+    uint32_t sequence = ring->sequence.load(std::memory_order_relaxed);
+    ring->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Going backwards (sampling mode changed) or a gap no run can hold
+    if (started && (frame < ring->lastFrame || frame - ring->lastFrame > MAX_HELD)) {
+        ring->written[0] = ring->written[1] = 0;
+        started = false;
+        stats.restarts++;
+    }
+
+    uint32_t gap = started ? frame - ring->lastFrame - 1 : 0;
+    const uint8_t inputs[2] = { p1, p2 };
+    for (int player = 0; player < 2; player++) {
+        if (gap > 0) {
+            // Frames the sampler skipped: assume the previous input was still held
+            uint8_t previous = ring->runs[player][(ring->written[player] - 1) & RING_MASK].input;
+            Extend(player, gap, previous, INPUT_RUN_FILLED, ring->lastFrame + 1);
+        }
+        Extend(player, 1, inputs[player], 0, frame);
+    }
+    ring->lastFrame = frame;
+    started = true;
+    stats.frames += gap + 1;
+    stats.gaps += gap;
+
+    ring->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+uint32_t InputRecorder::ReadLatest(const InputRing& ring, int player, InputRun* out, uint32_t count) {
+    if (ring.magic != INPUT_RING_MAGIC || ring.version != INPUT_RING_VERSION || player < 0 || player > 1) {
+        return 0;
+    }
+    for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+        uint32_t before = ring.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        uint32_t written = ring.written[player];
+        uint32_t copied = written < count ? written : count;
+        copied = copied < INPUT_RING_CAPACITY ? copied : INPUT_RING_CAPACITY;
+        for (uint32_t i = 0; i < copied; i++) {
+            out[i] = ring.runs[player][(written - copied + i) & RING_MASK];
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (ring.sequence.load(std::memory_order_relaxed) == before) {
+            return copied;
+        }
+    }
+    return 0;
+}
+
+std::string InputRecorder::FormatInput(uint8_t input) {
+    // Opposite directions cancel out, as they do in game
+    int vertical = ((input & INPUT_UP) ? 1 : 0) - ((input & INPUT_DOWN) ? 1 : 0);
+    int horizontal = ((input & INPUT_RIGHT) ? 1 : 0) - ((input & INPUT_LEFT) ? 1 : 0);
+    std::string text(1, (char)('5' + vertical * 3 + horizontal));
+    static const char BUTTONS[] = { 'A', 'B', 'C', 'D' };
+    bool first = true;
+    for (int b = 0; b < 4; b++) {
+        if (input & (INPUT_A << b)) {
+            if (!first) {
+                text += '+';
+            }
+            text += BUTTONS[b];
+            first = false;
+        }
+    }
+    return text;
+}
+
+std::string InputRecorder::ToJSON(const InputRing& ring, uint32_t count) {
+    if (count > INPUT_RING_CAPACITY) {
+        count = INPUT_RING_CAPACITY;
+    }
+    InputRun runs[INPUT_RING_CAPACITY];
+    std::string json = "{\n";
+    json += "  \"frame\": " + std::to_string(ring.lastFrame) + ",\n";
+    for (int player = 0; player < 2; player++) {
+        uint32_t copied = ReadLatest(ring, player, runs, count);
+        json += std::string("  \"") + (player == 0 ? "p1" : "p2") + "\": [";
+        for (uint32_t i = 0; i < copied; i++) {
+            json += std::string(i ? "," : "") + "\n    { \"input\": \"" + FormatInput(runs[i].input) +
+                    "\", \"bits\": " + std::to_string(runs[i].input) +
+                    ", \"frame\": " + std::to_string(runs[i].frame) +
+                    ", \"held\": " + std::to_string(runs[i].held) +
+                    ", \"filled\": " + ((runs[i].flags & INPUT_RUN_FILLED) ? "true" : "false") + " }";
+        }
+        json += copied ? "\n  ]" : "]";
+        json += player == 0 ? ",\n" : "\n";
+    }
+    return json + "}\n";
+}
+
+static bool ExpectRun(const InputRun& run, uint32_t frame, uint32_t held, uint8_t input, uint8_t flags,
+                      const char* what, std::string& failure) {
+    if (run.frame != frame || run.held != held || run.input != input || run.flags != flags) {
+        failure = std::string(what) + ": run at frame " + std::to_string(run.frame) + " held " +
+                  std::to_string(run.held) + " input " + std::to_string(run.input);
+        return false;
+    }
+    return true;
+}
+
+bool InputRecorder::RunSelfTest(std::string& failure) {
+    failure.clear();
+    std::unique_ptr<InputRing> storage(new InputRing());
+    InputRecorder recorder(storage.get());
+    const InputRing& ring = recorder.GetRing();
+    InputRun runs[INPUT_RING_CAPACITY];
+
+    // Held forward, then forward+A; player 2 idle throughout
+    for (uint32_t frame = 100; frame < 110; frame++) {
+        recorder.Record(frame, frame < 105 ? INPUT_RIGHT : INPUT_RIGHT | INPUT_A, 0);
+    }
+    if (ReadLatest(ring, 0, runs, 8) != 2 ||
+        !ExpectRun(runs[0], 100, 5, INPUT_RIGHT, 0, "hold", failure) ||
+        !ExpectRun(runs[1], 105, 5, INPUT_RIGHT | INPUT_A, 0, "press", failure)) {
+        failure = failure.empty() ? "player 1 not encoded as two runs" : failure;
+        return false;
+    }
+    if (ReadLatest(ring, 1, runs, 8) != 1 || !ExpectRun(runs[0], 100, 10, 0, 0, "idle", failure)) {
+        failure = failure.empty() ? "player 2 not encoded as one run" : failure;
+        return false;
+    }
+
+    // Duplicate frames are ignored; skipped frames extend the previous input
+    recorder.Record(109, INPUT_DOWN, INPUT_DOWN);
+    recorder.Record(113, INPUT_DOWN, 0);
+    if (ReadLatest(ring, 0, runs, 2) != 2 ||
+        !ExpectRun(runs[0], 105, 8, INPUT_RIGHT | INPUT_A, INPUT_RUN_FILLED, "gap", failure) ||
+        !ExpectRun(runs[1], 113, 1, INPUT_DOWN, 0, "after gap", failure)) {
+        failure = failure.empty() ? "gap not filled with the previous input" : failure;
+        return false;
+    }
+    if (ReadLatest(ring, 1, runs, 1) != 1 || !ExpectRun(runs[0], 100, 14, 0, INPUT_RUN_FILLED, "idle gap", failure)) {
+        failure = failure.empty() ? "idle run not extended over the gap" : failure;
+        return false;
+    }
+    Stats stats = recorder.GetStats();
+    if (stats.frames != 14 || stats.gaps != 3 || stats.duplicates != 1) {
+        failure = "stats: " + std::to_string(stats.frames) + " frames, " + std::to_string(stats.gaps) + " gaps";
+        return false;
+    }
+
+    // A frame number going backwards starts over
+    recorder.Record(5, INPUT_UP, INPUT_UP);
+    if (recorder.GetStats().restarts != 1 || ReadLatest(ring, 0, runs, 8) != 1 ||
+        !ExpectRun(runs[0], 5, 1, INPUT_UP, 0, "restart", failure)) {
+        failure = failure.empty() ? "restart kept old runs" : failure;
+        return false;
+    }
+
+    // A hold longer than a run can count is split
+    for (uint32_t frame = 6; frame < 6 + MAX_HELD + 10; frame++) {
+        recorder.Record(frame, INPUT_UP, INPUT_UP);
+    }
+    if (ReadLatest(ring, 0, runs, 8) != 2 ||
+        !ExpectRun(runs[0], 5, MAX_HELD, INPUT_UP, 0, "split", failure) ||
+        !ExpectRun(runs[1], 5 + MAX_HELD, 11, INPUT_UP, 0, "split rest", failure)) {
+        failure = failure.empty() ? "long hold not split" : failure;
+        return false;
+    }
+
+    // Wrap around: only the newest runs survive, in order
+    uint32_t frame = ring.lastFrame + 1;
+    for (uint32_t i = 0; i < INPUT_RING_CAPACITY * 3; i++, frame++) {
+        recorder.Record(frame, (uint8_t)(i & 1 ? INPUT_A : INPUT_B), 0);
+    }
+    if (ReadLatest(ring, 0, runs, INPUT_RING_CAPACITY * 2) != INPUT_RING_CAPACITY ||
+        runs[INPUT_RING_CAPACITY - 1].frame != frame - 1 || runs[INPUT_RING_CAPACITY - 1].input != INPUT_A ||
+        runs[0].frame != frame - INPUT_RING_CAPACITY) {
+        failure = "wrapped ring did not return the newest runs in order";
+        return false;
+    }
+
+    // A reader never returns data from the middle of an update
+    storage->sequence.fetch_add(1);
+    if (ReadLatest(ring, 0, runs, 4) != 0) {
+        failure = "read succeeded while an update was in progress";
+        return false;
+    }
+    storage->sequence.fetch_add(1);
+
+    if (FormatInput(0) != "5" || FormatInput(INPUT_DOWN | INPUT_RIGHT | INPUT_A) != "3A" ||
+        FormatInput(INPUT_B | INPUT_C) != "5B+C" || FormatInput(INPUT_UP | INPUT_DOWN | INPUT_LEFT) != "4") {
+        failure = "numpad notation";
+        return false;
+    }
+    return true;
+}
+
+// Deterministic replay: mostly short presses and mashing, some long holds
+// and charges, and about one frame in a hundred not captured
+struct ReplayFrame {
+    uint32_t frame;
+    uint8_t input[2];
+};
+
+static void BuildReplay(std::vector<ReplayFrame>& replay, uint32_t frames) {
+    static const uint8_t DIRECTIONS[] = {
+        0, INPUT_RIGHT, INPUT_LEFT, INPUT_DOWN, INPUT_DOWN | INPUT_RIGHT, INPUT_DOWN | INPUT_LEFT, INPUT_UP,
+        INPUT_UP | INPUT_RIGHT
+    };
+    uint32_t seed = 2024;
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+    uint32_t holdLeft[2] = { 0, 0 };
+    uint8_t current[2] = { 0, 0 };
+    uint32_t frame = 0;
+    replay.reserve(frames);
+    while (replay.size() < frames) {
+        ReplayFrame entry;
+        entry.frame = frame;
+        for (int p = 0; p < 2; p++) {
+            if (holdLeft[p] == 0) {
+                uint32_t roll = next();
+                holdLeft[p] = (roll % 100) < 40 ? 1 + next() % 3 : (roll % 100) < 90 ? 4 + next() % 20 : 30 + next() % 90;
+                current[p] = DIRECTIONS[next() % 8];
+                if (next() % 3 == 0) {
+                    current[p] |= (uint8_t)(INPUT_A << (next() % 4));
+                }
+            }
+            holdLeft[p]--;
+            entry.input[p] = current[p];
+        }
+        replay.push_back(entry);
+        frame += (next() % 100) == 0 ? 2 : 1;
+    }
+}
+
+// Expands the newest runs of a player back to one input per frame and
+// compares them with the replay's tail (missing frames take the previous input)
+static bool VerifyTail(const InputRing& ring, const std::vector<ReplayFrame>& replay, int player) {
+    InputRun runs[INPUT_RING_CAPACITY];
+    uint32_t count = InputRecorder::ReadLatest(ring, player, runs, INPUT_RING_CAPACITY);
+    if (count == 0 || replay.empty()) {
+        return false;
+    }
+    // The oldest run held may have been split by the wrap; check from the second
+    size_t index = replay.size() - 1;
+    for (uint32_t r = count; r-- > 1;) {
+        for (uint32_t f = runs[r].frame + runs[r].held; f-- > runs[r].frame;) {
+            while (replay[index].frame > f) {
+                if (index == 0) {
+                    return false;
+                }
+                index--;
+            }
+            if (replay[index].input[player] != runs[r].input) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+InputRecorder::BenchmarkResult InputRecorder::RunBenchmark(uint32_t frames) {
+    std::vector<ReplayFrame> replay;
+    BuildReplay(replay, frames);
+    std::unique_ptr<InputRing> storage(new InputRing());
+    InputRecorder recorder(storage.get());
+
+    BenchmarkResult result = {};
+    result.frames = frames;
+    result.nsPerFrame = 1e30;
+    for (int round = 0; round < 5; round++) {
+        recorder.Reset();
+        auto start = std::chrono::steady_clock::now();
+        for (const ReplayFrame& entry : replay) {
+            recorder.Record(entry.frame, entry.input[0], entry.input[1]);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / (double)frames;
+        result.nsPerFrame = ns < result.nsPerFrame ? ns : result.nsPerFrame;
+    }
+
+    // Once more frame by frame for the tail
+    std::vector<double> frameNs;
+    frameNs.reserve(replay.size());
+    recorder.Reset();
+    for (const ReplayFrame& entry : replay) {
+        auto start = std::chrono::steady_clock::now();
+        recorder.Record(entry.frame, entry.input[0], entry.input[1]);
+        auto end = std::chrono::steady_clock::now();
+        frameNs.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    if (!frameNs.empty()) {
+        std::vector<double>::iterator p999 = frameNs.begin() + (frameNs.size() - 1) * 999 / 1000;
+        std::nth_element(frameNs.begin(), p999, frameNs.end());
+        result.p999FrameNs = *p999;
+        result.maxFrameNs = *std::max_element(p999, frameNs.end());
+    }
+
+    const InputRing& ring = recorder.GetRing();
+    result.runs = (uint64_t)ring.written[0] + ring.written[1];
+    result.framesPerRun = result.runs ? (double)recorder.GetStats().frames * 2.0 / (double)result.runs : 0.0;
+    result.verified = VerifyTail(ring, replay, 0) && VerifyTail(ring, replay, 1);
+    return result;
+}
@@ -0,0 +1,269 @@
+#include "../include/layout_classifier.h"
+#include <cstring>
+
+LayoutClassifier::LayoutClassifier() {
+    Reset();
+}
+
+void LayoutClassifier::Reset() {
+    sessionKey = 0;
+    sessions = 0;
+    decisions = 0;
+    switches = 0;
+    StartSession(STATE_OFFLINE);
+}
+
+void LayoutClassifier::StartSession(State initial) {
+    state = initial;
+    variant = SCHEMA_ANY_VARIANT;
+    confidence = initial == STATE_FIXED ? 1.0f : 0.0f;
+    samples = 0;
+    memset(evidence, 0, sizeof(evidence));
+    checked = 0;
+    contrary = 0;
+}
+
+// Mixes one value into a session key (FNV-1a over the 32-bit words)
+static uint64_t MixKey(uint64_t key, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        key ^= (value >> (i * 8)) & 0xFF;
+        key *= 1099511628211ull;
+    }
+    return key;
+}
+
+void LayoutClassifier::Observe(const ReadPlan& plan, const MemorySnapshot& snapshot, bool changed) {
+    uint64_t key = MixKey(MixKey(14695981039346656037ull, plan.id), snapshot.moduleGeneration);
+    bool readable = false;
+    for (uint32_t b = 0; b < plan.blockCount; b++) {
+        if (plan.variantBlockMask & (1u << b)) {
+            key = MixKey(key, snapshot.blockBase[b]);
+            readable = readable || snapshot.blockBase[b] != 0;
+        }
+    }
+    if (key != sessionKey) {
+        sessionKey = key;
+        sessions++;
+        if (plan.variantCount < 2 || plan.variantFields == 0) {
+            StartSession(STATE_FIXED);
+        } else {
+            StartSession(readable ? STATE_DETECTING : STATE_OFFLINE);
+        }
+        changed = true;
+    }
+    if (!changed || state == STATE_OFFLINE || state == STATE_FIXED) {
+        return;
+    }
+
+    // One pass over the variant-dependent fields; the data is already in the capture
+    uint32_t valid[SCHEMA_MAX_LOCATIONS] = {};
+    uint32_t fieldCount = 0;
+    for (int f = 0; f < SCHEMA_FIELD_COUNT; f++) {
+        if (!(plan.variantFields & SCHEMA_FIELD_BIT(f))) {
+            continue;
+        }
+        fieldCount++;
+        for (uint32_t v = 0; v < plan.variantCount; v++) {
+            if (plan.Validates((SchemaField)f, plan.variants[v].locations[f], snapshot)) {
+                valid[v]++;
+            }
+        }
+    }
+
+    if (state == STATE_DETECTING) {
+        for (uint32_t v = 0; v < plan.variantCount; v++) {
+            evidence[v] += valid[v];
+        }
+        checked += fieldCount;
+        samples++;
+        if (samples >= DECIDE_SAMPLES) {
+            Decide(plan);
+        }
+        return;
+    }
+
+    // Locked: one odd capture (a name being retyped, a round reset) is not
+    // enough to move; a run of them means the session kind really changed
+    bool outvoted = false;
+    for (uint32_t v = 0; v < plan.variantCount; v++) {
+        if ((int)v != variant && valid[v] > valid[variant]) {
+            outvoted = true;
+        }
+    }
+    contrary = outvoted ? contrary + 1 : 0;
+    if (contrary >= SWITCH_SAMPLES) {
+        switches++;
+        StartSession(STATE_DETECTING);
+    }
+}
+
+// Locks the variant with the most evidence; a tie keeps detecting, and the
+// decoders keep trying every location meanwhile
+void LayoutClassifier::Decide(const ReadPlan& plan) {
+    uint32_t best = 0;
+    for (uint32_t v = 1; v < plan.variantCount; v++) {
+        if (evidence[v] > evidence[best]) {
+            best = v;
+        }
+    }
+    for (uint32_t v = 0; v < plan.variantCount; v++) {
+        if (v != best && evidence[v] == evidence[best]) {
+            return;
+        }
+    }
+    state = STATE_LOCKED;
+    variant = (int)best;
+    confidence = checked ? (float)evidence[best] / (float)checked : 0.0f;
+    contrary = 0;
+    decisions++;
+}
+
+LayoutClassifier::Status LayoutClassifier::GetStatus() const {
+    Status status;
+    status.state = state;
+    status.variant = variant;
+    status.confidence = confidence;
+    status.sessions = sessions;
+    status.decisions = decisions;
+    status.switches = switches;
+    return status;
+}
+
+const char* LayoutClassifier::GetStateName(State state) {
+    switch (state) {
+        case STATE_OFFLINE: return "offline";
+        case STATE_DETECTING: return "detecting";
+        case STATE_LOCKED: return "locked";
+        case STATE_FIXED: return "fixed";
+        default: return "?";
+    }
+}
+
+static void PutWins(MemorySnapshot& snapshot, const ReadPlan& plan, int variant, uint32_t p1, uint32_t p2) {
+    memcpy(snapshot.data + plan.variants[variant].locations[SCHEMA_P1_WIN_COUNT].dataOffset, &p1, sizeof(p1));
+    memcpy(snapshot.data + plan.variants[variant].locations[SCHEMA_P2_WIN_COUNT].dataOffset, &p2, sizeof(p2));
+}
+
+static void PutNames(MemorySnapshot& snapshot, const ReadPlan& plan, int variant, const char16_t* p1, const char16_t* p2) {
+    memcpy(snapshot.data + plan.variants[variant].locations[SCHEMA_P1_NICKNAME].dataOffset, p1,
+           (std::char_traits<char16_t>::length(p1) + 1) * sizeof(char16_t));
+    memcpy(snapshot.data + plan.variants[variant].locations[SCHEMA_P2_NICKNAME].dataOffset, p2,
+           (std::char_traits<char16_t>::length(p2) + 1) * sizeof(char16_t));
+}
+
+static void Feed(LayoutClassifier& classifier, const ReadPlan& plan, const MemorySnapshot& snapshot, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        classifier.Observe(plan, snapshot, true);
+    }
+}
+
+bool LayoutClassifier::RunSelfTest(std::string& failure) {
+    failure.clear();
+    ModuleFingerprint fingerprints[SCHEMA_MODULE_COUNT] = {
+        { true, 0x3B000000, 0, 0x400000 },
+        { true, 0x5F5E1000, 0x1234, 0x100000 }
+    };
+    ReadPlan plan;
+    std::string error;
+    if (!OffsetSchema::Compile(OffsetSchema::BuiltInSchema(), fingerprints, plan, error)) {
+        failure = "built-in schema: " + error;
+        return false;
+    }
+    if (plan.variantCount != 2 || plan.variants[0].name != "player" || plan.variants[1].name != "spectator") {
+        failure = "built-in schema lacks player/spectator variants";
+        return false;
+    }
+
+    MemorySnapshot snapshot = {};
+    for (uint32_t b = 0; b < plan.blockCount; b++) {
+        snapshot.blockBase[b] = 0x1000;
+    }
+
+    // Player session: only the player offsets hold names
+    LayoutClassifier classifier;
+    PutWins(snapshot, plan, 0, 3, 1);
+    PutNames(snapshot, plan, 0, u"Kiri", u"Ayase");
+    Feed(classifier, plan, snapshot, DECIDE_SAMPLES - 1);
+    if (classifier.GetStatus().state != STATE_DETECTING || classifier.GetVariant() != SCHEMA_ANY_VARIANT) {
+        failure = "locked before enough evidence";
+        return false;
+    }
+    Feed(classifier, plan, snapshot, 1);
+    Status status = classifier.GetStatus();
+    if (status.state != STATE_LOCKED || status.variant != 0 || status.confidence != 1.0f) {
+        failure = "player session not locked to player variant";
+        return false;
+    }
+    int64_t wins = -1;
+    plan.DecodeInteger(SCHEMA_P1_WIN_COUNT, snapshot, wins, classifier.GetVariant());
+    if (wins != 3) {
+        failure = "locked variant decoded " + std::to_string(wins) + " wins";
+        return false;
+    }
+
+    // A burst that looks like spectator data does not move a locked variant
+    MemorySnapshot noisy = snapshot;
+    PutNames(noisy, plan, 0, u"", u"");
+    PutNames(noisy, plan, 1, u"Kiri", u"Ayase");
+    Feed(classifier, plan, noisy, SWITCH_SAMPLES - 1);
+    Feed(classifier, plan, snapshot, 1);
+    Feed(classifier, plan, noisy, SWITCH_SAMPLES - 1);
+    if (classifier.GetVariant() != 0 || classifier.GetStatus().switches != 0) {
+        failure = "hysteresis: variant flipped on a short burst";
+        return false;
+    }
+    // Unchanged captures are not evidence
+    for (uint32_t i = 0; i < SWITCH_SAMPLES * 2; i++) {
+        classifier.Observe(plan, noisy, false);
+    }
+    if (classifier.GetVariant() != 0) {
+        failure = "unchanged captures moved the variant";
+        return false;
+    }
+    // A sustained run does, followed by a fresh decision
+    Feed(classifier, plan, noisy, 1 + DECIDE_SAMPLES);
+    status = classifier.GetStatus();
+    if (status.state != STATE_LOCKED || status.variant != 1 || status.switches != 1 || status.decisions != 2) {
+        failure = "sustained spectator data did not switch variants";
+        return false;
+    }
+
+    // New session with nothing to tell the variants apart: stays detecting
+    MemorySnapshot blank = {};
+    for (uint32_t b = 0; b < plan.blockCount; b++) {
+        blank.blockBase[b] = 0x2000;
+    }
+    Feed(classifier, plan, blank, DECIDE_SAMPLES * 2);
+    status = classifier.GetStatus();
+    if (status.state != STATE_DETECTING || status.variant != SCHEMA_ANY_VARIANT) {
+        failure = "tied evidence locked a variant";
+        return false;
+    }
+
+    // Revival block unreadable: offline
+    for (uint32_t b = 0; b < plan.blockCount; b++) {
+        blank.blockBase[b] = 0;
+    }
+    Feed(classifier, plan, blank, 1);
+    if (classifier.GetStatus().state != STATE_OFFLINE) {
+        failure = "unreadable block not reported offline";
+        return false;
+    }
+
+    // A layout without variants needs no classification
+    const char* single =
+        "{ \"schemaVersion\": 1, \"layouts\": [ {"
+        "    \"blocks\": { \"r\": { \"module\": \"efz.exe\", \"pointer\": [\"0x20\"], \"start\": 0, \"size\": 8 } },"
+        "    \"fields\": { \"p1.winCount\": { \"type\": \"u32\", \"locations\": [ { \"block\": \"r\", \"offset\": 0 } ] } } } ] }";
+    ReadPlan fixed;
+    if (!OffsetSchema::Compile(single, fingerprints, fixed, error)) {
+        failure = "single variant schema: " + error;
+        return false;
+    }
+    Feed(classifier, fixed, snapshot, 1);
+    if (classifier.GetStatus().state != STATE_FIXED) {
+        failure = "single variant plan was classified";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,541 @@
+#include "../include/match_history.h"
+#include "../include/constants.h"
+#include "../include/logger.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <map>
+
+std::mutex MatchHistory::mutex;
+bool MatchHistory::initialized = false;
+HANDLE MatchHistory::fileHandle = INVALID_HANDLE_VALUE;
+HANDLE MatchHistory::mappingHandle = nullptr;
+BYTE* MatchHistory::view = nullptr;
+uint32_t MatchHistory::capacity = 0;
+uint32_t MatchHistory::indexedCount = 0;
+
+std::unordered_map<std::string, uint32_t> MatchHistory::playerIds;
+std::vector<std::vector<uint32_t>> MatchHistory::playerMatches;
+std::vector<std::vector<uint32_t>> MatchHistory::characterPairMatches;
+std::unordered_map<uint64_t, HeadToHeadRecord> MatchHistory::headToHead;
+const uint32_t MatchHistory::INITIAL_CAPACITY;
+
+bool MatchHistory::Initialize(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (initialized) {
+        return true;
+    }
+
+    std::string path = (std::filesystem::path(directory) / "match_history.bin").string();
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                             nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        LOG_WIN32_ERROR("Failed to open match history file " + path);
+        return false;
+    }
+
+    // Size the mapping from the existing file so reopening never truncates it
+    LARGE_INTEGER fileSize = {};
+    GetFileSizeEx(fileHandle, &fileSize);
+    uint32_t existingCapacity = 0;
+    if (fileSize.QuadPart > (LONGLONG)sizeof(MatchLogHeader)) {
+        existingCapacity = (uint32_t)((fileSize.QuadPart - sizeof(MatchLogHeader)) / sizeof(MatchRecord));
+    }
+
+    if (!MapFile((std::max)(existingCapacity, INITIAL_CAPACITY))) {
+        CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+        return false;
+    }
+
+    MatchLogHeader* header = reinterpret_cast<MatchLogHeader*>(view);
+    if (header->magic != MATCH_LOG_MAGIC) {
+        // New (zero-filled) file
+        memset(header, 0, sizeof(MatchLogHeader));
+        header->magic = MATCH_LOG_MAGIC;
+        header->version = MATCH_LOG_VERSION;
+        header->recordSize = sizeof(MatchRecord);
+        FlushViewOfFile(view, sizeof(MatchLogHeader));
+    } else if (header->version != MATCH_LOG_VERSION || header->recordSize != sizeof(MatchRecord)) {
+        Logger::Error("Unsupported match history format (version " + std::to_string(header->version) + ")");
+        UnmapFile();
+        return false;
+    }
+
+    if (header->recordCount > capacity) {
+        Logger::Warning("Match history header claims more records than the file holds - truncating");
+        header->recordCount = capacity;
+    }
+
+    characterPairMatches.assign((MAX_CHARACTER_ID + 1) * (MAX_CHARACTER_ID + 1), std::vector<uint32_t>());
+    indexedCount = 0;
+    IndexNewRecords();
+
+    initialized = true;
+    Logger::Info("Match history opened: " + std::to_string(header->recordCount) + " sets, " +
+                 std::to_string(playerIds.size()) + " players");
+    return true;
+}
+
+void MatchHistory::Shutdown() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!initialized) {
+        return;
+    }
+
+    UnmapFile();
+    playerIds.clear();
+    playerMatches.clear();
+    characterPairMatches.clear();
+    headToHead.clear();
+    indexedCount = 0;
+    initialized = false;
+    Logger::Info("Match history closed");
+}
+
+bool MatchHistory::MapFile(uint32_t recordCapacity) {
+    uint64_t bytes = sizeof(MatchLogHeader) + (uint64_t)recordCapacity * sizeof(MatchRecord);
+
+    // Mapping a file larger than its current size extends it with zeros
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE,
+                                       (DWORD)(bytes >> 32), (DWORD)(bytes & 0xFFFFFFFF), nullptr);
+    if (!mappingHandle) {
+        LOG_WIN32_ERROR("CreateFileMapping failed for match history");
+        return false;
+    }
+
+    view = static_cast<BYTE*>(MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)bytes));
+    if (!view) {
+        LOG_WIN32_ERROR("MapViewOfFile failed for match history");
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+        return false;
+    }
+
+    capacity = recordCapacity;
+    return true;
+}
+
+void MatchHistory::UnmapFile() {
+    if (view) {
+        FlushViewOfFile(view, 0);
+        UnmapViewOfFile(view);
+        view = nullptr;
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+    }
+    capacity = 0;
+}
+
+bool MatchHistory::Grow() {
+    uint32_t newCapacity = capacity * 2;
+
+    FlushViewOfFile(view, 0);
+    UnmapViewOfFile(view);
+    view = nullptr;
+    CloseHandle(mappingHandle);
+    mappingHandle = nullptr;
+
+    if (!MapFile(newCapacity)) {
+        // Fall back to the old size so already-committed records stay readable
+        if (!MapFile(capacity)) {
+            // Nothing is mapped: close the log rather than leave the indexes pointing at it
+            Logger::Error("Match history could not be remapped - history closed");
+            UnmapFile();
+            playerIds.clear();
+            playerMatches.clear();
+            characterPairMatches.clear();
+            headToHead.clear();
+            indexedCount = 0;
+            initialized = false;
+        }
+        return false;
+    }
+
+    Logger::Debug("Match history grown to " + std::to_string(newCapacity) + " records");
+    return true;
+}
+
+const MatchRecord* MatchHistory::RecordAt(uint32_t index) {
+    return reinterpret_cast<const MatchRecord*>(view + sizeof(MatchLogHeader)) + index;
+}
+
+uint64_t MatchHistory::PairKey(uint32_t a, uint32_t b) {
+    return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+int MatchHistory::CharacterPairSlot(int a, int b) {
+    if (a < 0 || b < 0 || a > MAX_CHARACTER_ID || b > MAX_CHARACTER_ID) {
+        return -1;
+    }
+    if (a > b) {
+        std::swap(a, b);
+    }
+    return a * (MAX_CHARACTER_ID + 1) + b;
+}
+
+uint32_t MatchHistory::InternPlayer(const char* nickname) {
+    std::string key(nickname, strnlen(nickname, MATCH_NICKNAME_BYTES));
+    auto it = playerIds.find(key);
+    if (it != playerIds.end()) {
+        return it->second;
+    }
+
+    uint32_t id = (uint32_t)playerMatches.size();
+    playerIds.emplace(std::move(key), id);
+    playerMatches.emplace_back();
+    return id;
+}
+
+// Index every record committed since the last call. Called on open and after
+// each append, so the cost is proportional to the new records only.
+void MatchHistory::IndexNewRecords() {
+    const MatchLogHeader* header = reinterpret_cast<const MatchLogHeader*>(view);
+
+    for (; indexedCount < header->recordCount; indexedCount++) {
+        const MatchRecord* record = RecordAt(indexedCount);
+        uint32_t p1 = InternPlayer(record->p1Nickname);
+        uint32_t p2 = InternPlayer(record->p2Nickname);
+
+        playerMatches[p1].push_back(indexedCount);
+        if (p2 != p1) {
+            playerMatches[p2].push_back(indexedCount);
+        }
+
+        int slot = CharacterPairSlot(record->p1CharacterId, record->p2CharacterId);
+        if (slot >= 0) {
+            characterPairMatches[slot].push_back(indexedCount);
+        }
+
+        // Head-to-head totals are stored from the lower player ID's point of view
+        HeadToHeadRecord& h2h = headToHead[PairKey(p1, p2)];
+        h2h.sets++;
+        if (record->p1Score == record->p2Score) {
+            h2h.draws++;
+        } else {
+            bool p1Won = record->p1Score > record->p2Score;
+            uint32_t winner = p1Won ? p1 : p2;
+            uint32_t loser = p1Won ? p2 : p1;
+            if (winner < loser) {
+                h2h.firstWins++;
+            } else {
+                h2h.secondWins++;
+            }
+        }
+    }
+}
+
+bool MatchHistory::AppendMatch(const MatchRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!initialized) {
+        return false;
+    }
+
+    MatchLogHeader* header = reinterpret_cast<MatchLogHeader*>(view);
+    if (header->recordCount >= capacity && !Grow()) {
+        Logger::Error("Match history is full and could not be grown");
+        return false;
+    }
+    // Grow() remapped the view
+    header = reinterpret_cast<MatchLogHeader*>(view);
+
+    // Write the record first and commit it by bumping the count afterwards,
+    // so a crash mid-write leaves the log at the previous consistent state
+    MatchRecord* slot = const_cast<MatchRecord*>(RecordAt(header->recordCount));
+    memcpy(slot, &record, sizeof(MatchRecord));
+    slot->p1Nickname[MATCH_NICKNAME_BYTES - 1] = '\0';
+    slot->p2Nickname[MATCH_NICKNAME_BYTES - 1] = '\0';
+    FlushViewOfFile(slot, sizeof(MatchRecord));
+
+    header->recordCount++;
+    FlushViewOfFile(header, sizeof(MatchLogHeader));
+
+    IndexNewRecords();
+    return true;
+}
+
+size_t MatchHistory::GetMatchCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return initialized ? indexedCount : 0;
+}
+
+HeadToHeadRecord MatchHistory::GetHeadToHead(const std::string& first, const std::string& second) {
+    std::lock_guard<std::mutex> lock(mutex);
+    HeadToHeadRecord result;
+    if (!initialized) {
+        return result;
+    }
+
+    auto firstIt = playerIds.find(first);
+    auto secondIt = playerIds.find(second);
+    if (firstIt == playerIds.end() || secondIt == playerIds.end()) {
+        return result;
+    }
+
+    auto it = headToHead.find(PairKey(firstIt->second, secondIt->second));
+    if (it == headToHead.end()) {
+        return result;
+    }
+
+    result = it->second;
+    if (firstIt->second > secondIt->second) {
+        std::swap(result.firstWins, result.secondWins);
+    }
+    return result;
+}
+
+std::vector<MatchRecord> MatchHistory::GetRecentMatches(const std::string& player, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<MatchRecord> result;
+    if (!initialized) {
+        return result;
+    }
+
+    auto it = playerIds.find(player);
+    if (it == playerIds.end()) {
+        return result;
+    }
+
+    const std::vector<uint32_t>& indices = playerMatches[it->second];
+    size_t n = (std::min)(count, indices.size());
+    result.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        result.push_back(*RecordAt(indices[indices.size() - 1 - i]));
+    }
+    return result;
+}
+
+std::vector<MatchRecord> MatchHistory::GetRecentMatchups(int characterA, int characterB, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<MatchRecord> result;
+    int slot = CharacterPairSlot(characterA, characterB);
+    if (!initialized || slot < 0) {
+        return result;
+    }
+
+    const std::vector<uint32_t>& indices = characterPairMatches[slot];
+    size_t n = (std::min)(count, indices.size());
+    result.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        result.push_back(*RecordAt(indices[indices.size() - 1 - i]));
+    }
+    return result;
+}
+
+void MatchHistory::ForEachMatch(const std::function<void(const MatchRecord&, uint32_t p1Id, uint32_t p2Id)>& visitor) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!initialized) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < indexedCount; i++) {
+        const MatchRecord* record = RecordAt(i);
+        uint32_t p1Id = playerIds.at(std::string(record->p1Nickname, strnlen(record->p1Nickname, MATCH_NICKNAME_BYTES)));
+        uint32_t p2Id = playerIds.at(std::string(record->p2Nickname, strnlen(record->p2Nickname, MATCH_NICKNAME_BYTES)));
+        visitor(*record, p1Id, p2Id);
+    }
+}
+
+int MatchHistory::FindPlayerId(const std::string& nickname) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = playerIds.find(nickname);
+    return it != playerIds.end() ? (int)it->second : -1;
+}
+
+void MatchHistory::FillNickname(char (&dest)[MATCH_NICKNAME_BYTES], const std::string& nickname) {
+    memset(dest, 0, MATCH_NICKNAME_BYTES);
+
+    // Truncate on a UTF-8 character boundary
+    size_t length = (std::min)(nickname.size(), (size_t)MATCH_NICKNAME_BYTES - 1);
+    while (length > 0 && length < nickname.size() && (nickname[length] & 0xC0) == 0x80) {
+        length--;
+    }
+    memcpy(dest, nickname.data(), length);
+}
+
+// Everything Initialize() sets up, so a test log can stand in for the open one
+struct MatchHistory::State {
+    bool initialized = false;
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = nullptr;
+    BYTE* view = nullptr;
+    uint32_t capacity = 0;
+    uint32_t indexedCount = 0;
+    std::unordered_map<std::string, uint32_t> playerIds;
+    std::vector<std::vector<uint32_t>> playerMatches;
+    std::vector<std::vector<uint32_t>> characterPairMatches;
+    std::unordered_map<uint64_t, HeadToHeadRecord> headToHead;
+};
+
+void MatchHistory::SwapState(State& other) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::swap(initialized, other.initialized);
+    std::swap(fileHandle, other.fileHandle);
+    std::swap(mappingHandle, other.mappingHandle);
+    std::swap(view, other.view);
+    std::swap(capacity, other.capacity);
+    std::swap(indexedCount, other.indexedCount);
+    playerIds.swap(other.playerIds);
+    playerMatches.swap(other.playerMatches);
+    characterPairMatches.swap(other.characterPairMatches);
+    headToHead.swap(other.headToHead);
+}
+
+static double ElapsedMs(const LARGE_INTEGER& start, const LARGE_INTEGER& end) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+}
+
+static std::string SyntheticName(uint32_t player) {
+    return "player" + std::to_string(player);
+}
+
+bool MatchHistory::RunOnTemporaryLog(uint32_t sets, BenchmarkResult& result, std::string& failure) {
+    const uint32_t playerCount = 500;
+    result = BenchmarkResult();
+
+    std::error_code error;
+    std::filesystem::path directory = std::filesystem::temp_directory_path(error) / "efz_history_test";
+    std::filesystem::create_directories(directory, error);
+    std::filesystem::remove(directory / "match_history.bin", error);
+
+    // Expected totals from the lower-numbered player's side, and each player's last set
+    std::map<std::pair<uint32_t, uint32_t>, HeadToHeadRecord> expected;
+    std::vector<int64_t> lastSet(playerCount, -1);
+
+    State saved;
+    SwapState(saved);
+    bool passed = false;
+    LARGE_INTEGER start, end;
+    do {
+        if (!Initialize(directory.string())) {
+            failure = "could not create " + (directory / "match_history.bin").string();
+            break;
+        }
+
+        uint32_t seed = 0x2545F491;
+        QueryPerformanceCounter(&start);
+        bool appended = true;
+        for (uint32_t i = 0; i < sets && appended; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            uint32_t p1 = (seed >> 8) % playerCount;
+            seed = seed * 1664525u + 1013904223u;
+            uint32_t p2 = (p1 + 1 + (seed >> 8) % (playerCount - 1)) % playerCount;
+            bool p1Won = (seed & 1) != 0;
+
+            MatchRecord record = {};
+            record.timestamp = i;   // Doubles as the set's position in the log
+            FillNickname(record.p1Nickname, SyntheticName(p1));
+            FillNickname(record.p2Nickname, SyntheticName(p2));
+            record.p1CharacterId = (int8_t)(p1 % (MAX_CHARACTER_ID + 1));
+            record.p2CharacterId = (int8_t)(p2 % (MAX_CHARACTER_ID + 1));
+            record.p1Score = p1Won ? 2 : 1;
+            record.p2Score = p1Won ? 1 : 2;
+            appended = AppendMatch(record);
+
+            HeadToHeadRecord& h2h = expected[std::make_pair((std::min)(p1, p2), (std::max)(p1, p2))];
+            h2h.sets++;
+            if (p1Won == (p1 < p2)) {
+                h2h.firstWins++;
+            } else {
+                h2h.secondWins++;
+            }
+            lastSet[p1] = lastSet[p2] = i;
+        }
+        QueryPerformanceCounter(&end);
+        result.appendMs = ElapsedMs(start, end);
+        if (!appended) {
+            failure = "append failed";
+            break;
+        }
+
+        // Everything below must come back from the file, not the append path
+        Shutdown();
+        QueryPerformanceCounter(&start);
+        bool reopened = Initialize(directory.string());
+        QueryPerformanceCounter(&end);
+        result.reopenMs = ElapsedMs(start, end);
+        if (!reopened) {
+            failure = "reopen failed";
+            break;
+        }
+        if (GetMatchCount() != sets) {
+            failure = "reopened log has " + std::to_string(GetMatchCount()) + " sets, expected " + std::to_string(sets);
+            break;
+        }
+
+        bool indexesMatch = true;
+        for (const auto& entry : expected) {
+            HeadToHeadRecord h2h = GetHeadToHead(SyntheticName(entry.first.first), SyntheticName(entry.first.second));
+            HeadToHeadRecord reversed = GetHeadToHead(SyntheticName(entry.first.second), SyntheticName(entry.first.first));
+            if (h2h.sets != entry.second.sets || h2h.firstWins != entry.second.firstWins ||
+                h2h.secondWins != entry.second.secondWins || reversed.firstWins != h2h.secondWins) {
+                failure = "head-to-head " + SyntheticName(entry.first.first) + " vs " +
+                          SyntheticName(entry.first.second) + " does not match the appended sets";
+                indexesMatch = false;
+                break;
+            }
+        }
+        for (uint32_t player = 0; player < playerCount && indexesMatch; player++) {
+            std::vector<MatchRecord> recent = GetRecentMatches(SyntheticName(player), 10);
+            int64_t expectedLast = lastSet[player];
+            if ((expectedLast < 0) != recent.empty() || (!recent.empty() && recent[0].timestamp != expectedLast)) {
+                failure = "recent sets of " + SyntheticName(player) + " do not end with its last set";
+                indexesMatch = false;
+            }
+            for (size_t i = 1; i < recent.size() && indexesMatch; i++) {
+                if (recent[i].timestamp >= recent[i - 1].timestamp) {
+                    failure = "recent sets of " + SyntheticName(player) + " are not newest first";
+                    indexesMatch = false;
+                }
+            }
+        }
+        if (!indexesMatch) {
+            break;
+        }
+
+        const uint32_t queries = 100000;
+        uint32_t checksum = 0;
+        QueryPerformanceCounter(&start);
+        for (uint32_t i = 0; i < queries; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            checksum += GetHeadToHead(SyntheticName((seed >> 8) % playerCount),
+                                      SyntheticName((seed >> 16) % playerCount)).sets;
+        }
+        QueryPerformanceCounter(&end);
+        result.headToHeadUs = ElapsedMs(start, end) * 1000.0 / queries;
+
+        QueryPerformanceCounter(&start);
+        for (uint32_t i = 0; i < queries; i++) {
+            checksum += (uint32_t)GetRecentMatches(SyntheticName(i % playerCount), 10).size();
+        }
+        QueryPerformanceCounter(&end);
+        result.recentMatchesUs = ElapsedMs(start, end) * 1000.0 / queries;
+        passed = checksum != 0;
+        if (!passed) {
+            failure = "queries found no sets";
+        }
+    } while (false);
+
+    Shutdown();
+    SwapState(saved);
+    std::filesystem::remove_all(directory, error);
+    return passed;
+}
+
+bool MatchHistory::RunSelfTest(std::string& failure) {
+    // Past INITIAL_CAPACITY, so the log grows at least once
+    BenchmarkResult ignored;
+    return RunOnTemporaryLog(INITIAL_CAPACITY * 2 + 100, ignored, failure);
+}
+
+bool MatchHistory::RunBenchmark(uint32_t sets, BenchmarkResult& result, std::string& failure) {
+    return RunOnTemporaryLog(sets, result, failure);
+}
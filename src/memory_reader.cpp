@@ -1,19 +1,20 @@
 #include "../include/memory_reader.h"
 #include "../include/constants.h"
 #include "../include/logger.h"
-#include <tlhelp32.h>
-#include <psapi.h>
+#include "../include/nickname_pool.h"
+#include "../include/nickname_sanitizer.h"
+#include "../include/character_table.h"
+#include "../include/block_hash.h"
+#include "../include/module_monitor.h"
+#include "../include/schema_loader.h"
 #include <cstring>
 #include <thread>
-#include <map>
 #include <algorithm>
 #include <unordered_map>
 HANDLE MemoryReader::hProcess = nullptr;
 DWORD MemoryReader::processId = 0;
 HMODULE MemoryReader::efzModule = nullptr;
-HMODULE MemoryReader::efzRevivalModule = nullptr;
-HANDLE MemoryReader::moduleWatcherThread = nullptr;
-std::atomic<bool> MemoryReader::watcherRunning(false);
+uint32_t MemoryReader::seenModuleGeneration = 0;
 
 // Initialize static cache variables
 std::unordered_map<DWORD, std::string> MemoryReader::stringCache;
@@ -21,6 +22,15 @@ std::unordered_map<DWORD, int> MemoryReader::byteCache;
 std::unordered_map<DWORD, DWORD> MemoryReader::dwordCache;
 bool MemoryReader::enableReadCache = true;
 DWORD MemoryReader::lastCacheClearTime = 0;
+MemoryReader::NicknameSlot MemoryReader::nicknameSlots[2] = {
+    { {}, 0, NicknamePool::INVALID_ID },
+    { {}, 0, NicknamePool::INVALID_ID }
+};
+MemoryReader::MemoryBlock MemoryReader::blocks[SNAPSHOT_MAX_BLOCKS] = {};
+MemorySnapshot MemoryReader::applied = {};
+std::shared_ptr<const ReadPlan> MemoryReader::appliedPlan;
+LayoutClassifier MemoryReader::layoutClassifier;
+uint64_t MemoryReader::appliedCount = 0;
 
 bool MemoryReader::Initialize() {
     LOG_FUNCTION_ENTRY();
@@ -32,8 +42,8 @@ bool MemoryReader::Initialize() {
         return false;
     }
     
-    // Get module handles
-    efzModule = GetModuleHandle("efz.exe");
+    // The DLL runs inside efz.exe, so the loader can answer directly
+    efzModule = GetModuleHandleA("efz.exe");
     
     if (!efzModule) {
         Logger::Error("Failed to get efz.exe module handle");
@@ -43,8 +53,15 @@ bool MemoryReader::Initialize() {
         Logger::Info("Found efz.exe module at " + Logger::FormatHex((DWORD)efzModule));
     }
     
-    // Try to get EfzRevival.dll, but make it optional
-    TryLoadEfzRevivalModule();
+    // EfzRevival.dll is optional and may load (or reload) at any time
+    ModuleMonitor::Start();
+    seenModuleGeneration = ModuleMonitor::GetGeneration();
+    HMODULE revival = ModuleMonitor::GetBase(WATCHED_EFZ_REVIVAL);
+    if (revival) {
+        Logger::Info("Found EfzRevival.dll module at " + Logger::FormatHex((DWORD)revival));
+    } else {
+        Logger::Warning("EfzRevival.dll not loaded yet - using vanilla EFZ memory layout until it is");
+    }
     
     // Check key memory addresses
     DWORD p1BaseAddr = (DWORD)efzModule + EFZ_BASE_OFFSET_P1;
@@ -59,74 +76,27 @@ bool MemoryReader::Initialize() {
                  
     Logger::Info("Memory reader initialized successfully");
     
-    // Start watching for EfzRevival.dll if not found initially
-    if (!efzRevivalModule) {
-        Logger::Info("Starting background thread to monitor for EfzRevival.dll");
-        StartModuleWatcher();
-    }
-    
     LOG_FUNCTION_EXIT();
     return true;
 }
 
-bool MemoryReader::TryLoadEfzRevivalModule() {
-    // Try to get EfzRevival.dll
-    if (!efzRevivalModule) {
-        efzRevivalModule = GetModuleHandle("EfzRevival.dll");
-        if (efzRevivalModule) {
-            Logger::Info("Found EfzRevival.dll module at " + Logger::FormatHex((DWORD)efzRevivalModule));
-            return true;
-        } else {
-            Logger::Warning("EfzRevival.dll not found - using vanilla EFZ memory layout");
-            return false;
-        }
+// Drops everything derived from a module base after EfzRevival.dll loads,
+// unloads or reloads at a different address
+void MemoryReader::InvalidateModuleState() {
+    ClearCache();
+    for (MemoryBlock& block : blocks) {
+        block.valid = false;
     }
-    return efzRevivalModule != nullptr;
-}
-
-// Replace the standalone thread function with the class member function
-DWORD WINAPI MemoryReader::ModuleWatcherThreadProc(LPVOID lpParam) {
-    while (watcherRunning) {
-        if (TryLoadEfzRevivalModule()) {
-            // Found the module, stop watching
-            Logger::Info("EfzRevival.dll was loaded! Netplay/win count features now available.");
-            break;
-        }
-        Sleep(MODULE_CHECK_INTERVAL_MS);
-    }
-    return 0;
-}
-
-void MemoryReader::StartModuleWatcher() {
-    if (moduleWatcherThread == nullptr && !watcherRunning) {
-        watcherRunning = true;
-        moduleWatcherThread = CreateThread(NULL, 0, ModuleWatcherThreadProc, NULL, 0, NULL);
-        if (moduleWatcherThread) {
-            Logger::Info("Module watcher thread started");
-        } else {
-            LOG_WIN32_ERROR("Failed to start module watcher thread");
-        }
-    }
-}
-
-void MemoryReader::StopModuleWatcher() {
-    if (moduleWatcherThread != nullptr && watcherRunning) {
-        watcherRunning = false;
-        // Wait for thread to terminate
-        if (WaitForSingleObject(moduleWatcherThread, 1000) != WAIT_OBJECT_0) {
-            TerminateThread(moduleWatcherThread, 0);
-        }
-        CloseHandle(moduleWatcherThread);
-        moduleWatcherThread = nullptr;
-        Logger::Info("Module watcher thread stopped");
+    for (NicknameSlot& slot : nicknameSlots) {
+        slot.length = 0;
+        slot.id = NicknamePool::INVALID_ID;
     }
 }
 
 void MemoryReader::Shutdown() {
     LOG_FUNCTION_ENTRY();
     
-    // Stop the module watcher thread if it's running
-    StopModuleWatcher();
+    ModuleMonitor::Stop();
     
     if (hProcess != nullptr) {
         CloseHandle(hProcess);
@@ -134,97 +104,33 @@ void MemoryReader::Shutdown() {
     }
     
     efzModule = nullptr;
-    efzRevivalModule = nullptr;
     processId = 0;
     
     LOG_FUNCTION_EXIT();
 }
 
+// The DLL is loaded into efz.exe itself, so the target is the current
+// process. Walking a Toolhelp snapshot of every process cost startup time
+// and could pick another running efz.exe instance.
 bool MemoryReader::FindEFZProcess() {
     LOG_FUNCTION_ENTRY();
-    PROCESSENTRY32 pe32;
-    HANDLE hProcessSnap = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    processId = GetCurrentProcessId();
     
-    if (hProcessSnap == INVALID_HANDLE_VALUE) {
-        LOG_WIN32_ERROR("CreateToolhelp32Snapshot failed");
-        LOG_FUNCTION_EXIT();
-        return false;
-    }
-    
-    pe32.dwSize = sizeof(PROCESSENTRY32);
-    
-    if (!Process32First(hProcessSnap, &pe32)) {
-        LOG_WIN32_ERROR("Process32First failed");
-        CloseHandle(hProcessSnap);
-        LOG_FUNCTION_EXIT();
-        return false;
-    }
-    
-    Logger::Debug("Searching for efz.exe process");
-    
-    do {
-        // Use strcmp with pe32.szExeFile which is char[], not wchar_t[]
-        if (strcmp(pe32.szExeFile, "efz.exe") == 0) {
-            processId = pe32.th32ProcessID;
-            Logger::Info("Found efz.exe process with ID: " + std::to_string(processId));
-            
-            // Request both PROCESS_VM_READ and PROCESS_QUERY_INFORMATION access
-            hProcess = OpenProcess(PROCESS_VM_READ | PROCESS_QUERY_INFORMATION, FALSE, processId);
-            if (hProcess == nullptr) {
-                LOG_WIN32_ERROR("OpenProcess failed");
-            } else {
-                Logger::Info("Successfully opened process handle: " + Logger::FormatHex((DWORD)hProcess));
-            }
-            
-            CloseHandle(hProcessSnap);
-            LOG_FUNCTION_EXIT();
-            return hProcess != nullptr;
-        }
-    } while (Process32Next(hProcessSnap, &pe32));
-    
-    Logger::Error("EFZ process not found");
-    CloseHandle(hProcessSnap);
-    
-    #ifdef _DEBUG
-    std::wstring criticalMessage = L"Critical Error: Failed to find EFZ process after multiple attempts. Overlay will not function.";
-    MessageBoxW(NULL, criticalMessage.c_str(), L"Critical Error", MB_ICONERROR | MB_OK);
-    #endif
-    
-    return false;
-}
-
-// In the GetModuleHandle method, make sure this line is fixed
-HMODULE MemoryReader::GetModuleHandle(const std::string& moduleName) {
-    LOG_FUNCTION_ENTRY();
-    Logger::Debug("Getting module handle for: " + moduleName);
-    
-    HMODULE hMods[1024];
-    DWORD cbNeeded;
-    
-    if (EnumProcessModules(hProcess, hMods, sizeof(hMods), &cbNeeded)) {
-        DWORD numModules = cbNeeded / sizeof(HMODULE);
-        Logger::Debug("Found " + std::to_string(numModules) + " modules in process");
+    // Request both PROCESS_VM_READ and PROCESS_QUERY_INFORMATION access
+    hProcess = OpenProcess(PROCESS_VM_READ | PROCESS_QUERY_INFORMATION, FALSE, processId);
+    if (hProcess == nullptr) {
+        LOG_WIN32_ERROR("OpenProcess failed");
         
-        for (unsigned int i = 0; i < numModules; i++) {
-            char szModName[MAX_PATH]; // Make sure this is char, not WCHAR
-            
-            if (GetModuleBaseNameA(hProcess, hMods[i], szModName, sizeof(szModName))) {
-                Logger::Debug("Module found: " + std::string(szModName) + " at " + Logger::FormatHex((DWORD)hMods[i]));
-                
-                if (moduleName == szModName) {
-                    Logger::Info("Found target module: " + moduleName + " at " + Logger::FormatHex((DWORD)hMods[i]));
-                    LOG_FUNCTION_EXIT();
-                    return hMods[i];
-                }
-            }
-        }
+        #ifdef _DEBUG
+        std::wstring criticalMessage = L"Critical Error: Failed to open the EFZ process. Overlay will not function.";
+        MessageBoxW(NULL, criticalMessage.c_str(), L"Critical Error", MB_ICONERROR | MB_OK);
+        #endif
     } else {
-        LOG_WIN32_ERROR("EnumProcessModules failed");
+        Logger::Info("Opened efz.exe process " + std::to_string(processId) + ", handle: " + Logger::FormatHex((DWORD)hProcess));
     }
     
-    Logger::Error("Module not found: " + moduleName);
     LOG_FUNCTION_EXIT();
-    return nullptr;
+    return hProcess != nullptr;
 }
 
 bool MemoryReader::ReadMemory(DWORD address, void* buffer, size_t size) {
@@ -258,8 +164,14 @@ std::string MemoryReader::ReadString(DWORD address, size_t maxLength) {
         }
     }
     
-    // Not in cache, read from memory
-    char* buffer = new char[maxLength + 1];
+    // Not in cache, read from memory (short fields avoid the heap entirely)
+    char stackBuffer[64];
+    std::string heapBuffer;
+    char* buffer = stackBuffer;
+    if (maxLength + 1 > sizeof(stackBuffer)) {
+        heapBuffer.resize(maxLength + 1);
+        buffer = &heapBuffer[0];
+    }
     memset(buffer, 0, maxLength + 1);
     
     bool success = ReadMemory(address, buffer, maxLength);
@@ -286,7 +198,6 @@ std::string MemoryReader::ReadString(DWORD address, size_t maxLength) {
         }
     }
     
-    delete[] buffer;
     return result;
 }
 
@@ -332,439 +243,336 @@ int MemoryReader::ReadByte(DWORD address) {
     return (int)value;
 }
 
+// Win counts decode through the schema from the layout the classifier
+// locked; until it decides, locations are tried in order (player, then
+// spectator) and the first one inside the validation range wins
 DWORD MemoryReader::GetP1WinCount() {
-    // Remove these logging lines
-    // LOG_FUNCTION_ENTRY();
-    
-    // Temporarily increase log level for this operation
-    Logger::Level previousLevel = Logger::GetMinimumLevel();
-    Logger::SetMinimumLevel(Logger::LOG_INFO);  // Only log INFO or higher
-    
-    DWORD rawWinCount = 0;
-    
-    // Try again to find the module if not found yet
-    TryLoadEfzRevivalModule();
-    
-    if (efzRevivalModule) {
-        // Revival mod uses a different memory structure
-        DWORD baseAddr = (DWORD)efzRevivalModule + WIN_COUNT_BASE_OFFSET;
-        DWORD ptrValue = ReadDWORD(baseAddr);
-        if (ptrValue != 0) {
-            // Try player offset first
-            rawWinCount = ReadDWORD(ptrValue + P1_WIN_COUNT_OFFSET);
-
-            // If player win count is suspicious, try spectator offset
-            if (rawWinCount > 99) {
-                DWORD spectatorWinCount = ReadDWORD(ptrValue + P1_WIN_COUNT_OFFSET_SPECTATOR);
-                if (spectatorWinCount <= 99) {
-                    rawWinCount = spectatorWinCount;
-                }
-            }
-        }
+    int64_t value = 0;
+    if (appliedPlan) {
+        appliedPlan->DecodeInteger(SCHEMA_P1_WIN_COUNT, applied, value, layoutClassifier.GetVariant());
     }
-    
-    // Restore previous log level
-    Logger::SetMinimumLevel(previousLevel);
-    
-    // Remove this line
-    // LOG_FUNCTION_EXIT();
-    
-    return SanitizeWinCount(rawWinCount); // Apply sanitization to the return value
+    return (DWORD)value;
 }
 
 DWORD MemoryReader::GetP2WinCount() {
-    // Remove these logging lines
-    // LOG_FUNCTION_ENTRY();
-    
-    // Temporarily increase log level
-    Logger::Level previousLevel = Logger::GetMinimumLevel();
-    Logger::SetMinimumLevel(Logger::LOG_INFO);
-    
-    DWORD result = 0;
-    
-    // Try again to find the module if not found yet
-    TryLoadEfzRevivalModule();
-    
-    if (efzRevivalModule) {
-        DWORD baseAddr = (DWORD)efzRevivalModule + WIN_COUNT_BASE_OFFSET;
-        DWORD ptrValue = ReadDWORD(baseAddr);
-        if (ptrValue != 0) {
-            // Try player offset first
-            result = ReadDWORD(ptrValue + P2_WIN_COUNT_OFFSET);
-
-            // If player win count is suspicious, try spectator offset
-            if (result > 99) {
-                DWORD spectatorWinCount = ReadDWORD(ptrValue + P2_WIN_COUNT_OFFSET_SPECTATOR);
-                if (spectatorWinCount <= 99) {
-                    result = spectatorWinCount;
-                }
-            }
-        }
+    int64_t value = 0;
+    if (appliedPlan) {
+        appliedPlan->DecodeInteger(SCHEMA_P2_WIN_COUNT, applied, value, layoutClassifier.GetVariant());
     }
-    
-    // Restore previous log level
-    Logger::SetMinimumLevel(previousLevel);
-    
-    // Remove this line
-    // LOG_FUNCTION_EXIT();
-    
-    return SanitizeWinCount(result);
+    return (DWORD)value;
 }
 
-// Add these helper functions for data sanitization
+// Optional schema fields (netplay, HP, hitstun); undescribed or unreadable ones read as -1
+static int32_t DecodeOptionalField(const ReadPlan& plan, SchemaField field, const MemorySnapshot& snapshot, int variant) {
+    int64_t value = -1;
+    if (!plan.fields[field].present || !plan.DecodeInteger(field, snapshot, value, variant) || value < 0) {
+        return -1;
+    }
+    return value > INT32_MAX ? INT32_MAX : (int32_t)value;
+}
 
-bool MemoryReader::IsValidNicknameChar(wchar_t c) {
-    // Allow standard alphanumeric
-    if ((c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') || (c >= L'0' && c <= L'9')) {
-        return true;
+void MemoryReader::GetNetplaySample(NetplaySample& sample) {
+    sample.pingMs = sample.delayFrames = sample.rollbacks = sample.resyncs = sample.spectators = -1;
+    if (!appliedPlan) {
+        return;
+    }
+    int variant = layoutClassifier.GetVariant();
+    sample.pingMs = DecodeOptionalField(*appliedPlan, SCHEMA_NETPLAY_PING, applied, variant);
+    sample.delayFrames = DecodeOptionalField(*appliedPlan, SCHEMA_NETPLAY_DELAY, applied, variant);
+    sample.rollbacks = DecodeOptionalField(*appliedPlan, SCHEMA_NETPLAY_ROLLBACKS, applied, variant);
+    sample.resyncs = DecodeOptionalField(*appliedPlan, SCHEMA_NETPLAY_RESYNCS, applied, variant);
+    sample.spectators = DecodeOptionalField(*appliedPlan, SCHEMA_NETPLAY_SPECTATORS, applied, variant);
+}
+
+void MemoryReader::GetComboSample(ComboSample& sample) {
+    sample.hp[0] = sample.hp[1] = sample.hitstun[0] = sample.hitstun[1] = -1;
+    if (!appliedPlan) {
+        return;
     }
-    
-    // Common symbols for nicknames
-    const wchar_t* allowedSymbols = L" -_.!?+#@$%&*()[]{}:;<>,'\"\\|/~^";
-    for (size_t i = 0; allowedSymbols[i] != 0; i++) {
-        if (c == allowedSymbols[i]) return true;
+    int variant = layoutClassifier.GetVariant();
+    sample.hp[0] = DecodeOptionalField(*appliedPlan, SCHEMA_P1_HP, applied, variant);
+    sample.hp[1] = DecodeOptionalField(*appliedPlan, SCHEMA_P2_HP, applied, variant);
+    sample.hitstun[0] = DecodeOptionalField(*appliedPlan, SCHEMA_P1_HITSTUN, applied, variant);
+    sample.hitstun[1] = DecodeOptionalField(*appliedPlan, SCHEMA_P2_HITSTUN, applied, variant);
+}
+
+bool MemoryReader::GetInputs(uint8_t& p1, uint8_t& p2) {
+    if (!appliedPlan || !appliedPlan->fields[SCHEMA_P1_INPUT].present || !appliedPlan->fields[SCHEMA_P2_INPUT].present) {
+        return false;
     }
-    
-    // Allow common CJK characters
-    if ((c >= 0x3040 && c <= 0x30FF) ||    // Hiragana & Katakana
-        (c >= 0x4E00 && c <= 0x9FFF) ||    // Common CJK
-        (c >= 0xAC00 && c <= 0xD7AF)) {    // Hangul
-        return true;
+    int variant = layoutClassifier.GetVariant();
+    int64_t value1 = 0, value2 = 0;
+    if (!appliedPlan->DecodeInteger(SCHEMA_P1_INPUT, applied, value1, variant) ||
+        !appliedPlan->DecodeInteger(SCHEMA_P2_INPUT, applied, value2, variant)) {
+        return false;
     }
-    
-    return false;
+    p1 = (uint8_t)value1;
+    p2 = (uint8_t)value2;
+    return true;
 }
 
-std::wstring MemoryReader::SanitizeNickname(const std::wstring& nickname) {
-    std::wstring result;
-    
-    // If empty, return default
-    if (nickname.empty()) {
-        return L"Player";
+std::string MemoryReader::GetLayoutName() {
+    LayoutClassifier::Status status = layoutClassifier.GetStatus();
+    if (appliedPlan && status.variant >= 0 && (uint32_t)status.variant < appliedPlan->variantCount) {
+        return appliedPlan->variants[status.variant].name;
     }
+    return LayoutClassifier::GetStateName(status.state);
+}
+
+// Add these helper functions for data sanitization
+
+std::u16string MemoryReader::SanitizeNickname(const std::u16string& nickname) {
+    // Empty if nothing valid remains; the caller substitutes its default
+    return NicknameSanitizer::Sanitize(nickname);
+}
+
+// Nickname readers decode from the Revival block: the raw units are compared
+// against the previous value and only handed to the NicknamePool (sanitize +
+// convert) when they change
+uint32_t MemoryReader::GetP1NicknameId() {
+    return ReadNicknameId(1);
+}
+
+uint32_t MemoryReader::GetP2NicknameId() {
+    return ReadNicknameId(2);
+}
+
+uint32_t MemoryReader::ReadNicknameId(int player) {
+    const char* fallback = (player == 1) ? "Player 1" : "Player 2";
+    char16_t raw[MAX_NICKNAME_LENGTH + 1] = {};
+    size_t length = 0;
     
-    // Maximum length check and sanitization
-    size_t validChars = 0;
-    for (size_t i = 0; i < nickname.length() && validChars < 16; i++) {
-        if (IsValidNicknameChar(nickname[i])) {
-            result += nickname[i];
-            validChars++;
-        }
-        else {
-            // Replace invalid characters with underscore
-            if (!result.empty() && result.back() != L'_') {
-                result += L'_';
-                validChars++;
-            }
-        }
+    // While the layout is undecided the schema rejects empty and default
+    // names at the player offset in favour of the spectator offset
+    if (appliedPlan) {
+        SchemaField field = (player == 1) ? SCHEMA_P1_NICKNAME : SCHEMA_P2_NICKNAME;
+        length = appliedPlan->DecodeString16(field, applied, raw, MAX_NICKNAME_LENGTH + 1, layoutClassifier.GetVariant());
     }
     
-    // If after sanitization we have nothing valid, return default
-    if (result.empty()) {
-        return L"Player";
+    NicknameSlot& slot = nicknameSlots[player - 1];
+    if (slot.id != NicknamePool::INVALID_ID && slot.length == length && memcmp(slot.raw, raw, length * sizeof(char16_t)) == 0) {
+        NicknamePool::Touch(slot.id);   // Keeps the name on screen out of eviction
+        return slot.id;
     }
     
-    return result;
+    slot.id = NicknamePool::Intern(raw, length, fallback);
+    memcpy(slot.raw, raw, length * sizeof(char16_t));
+    slot.length = length;
+    return slot.id;
+}
+
+// Runs on the game thread in frame mode: no logging, no shared state
+static bool ReadQuiet(HANDLE process, DWORD address, void* buffer, size_t size) {
+    SIZE_T bytesRead;
+    return ReadProcessMemory(process, (LPCVOID)address, buffer, size, &bytesRead) && bytesRead == size;
 }
 
-// Sanitize win counts to prevent unreasonable values
-DWORD MemoryReader::SanitizeWinCount(DWORD count) {
-    // Keep win count in a reasonable range
-    if (count > 99) {
-        Logger::Warning("Suspicious win count detected: " + std::to_string(count));
+// Follows a block's pointer chain from its module; 0 if any link is null or unreadable
+static DWORD ResolveChain(HANDLE process, DWORD moduleBase, const PlanBlock& block) {
+    if (moduleBase == 0) {
         return 0;
     }
-    return count;
+    DWORD address = moduleBase + block.chain[0];
+    DWORD pointer = 0;
+    for (uint32_t i = 0; i < block.chainLength; i++) {
+        if (!ReadQuiet(process, address, &pointer, sizeof(pointer)) || pointer == 0) {
+            return 0;
+        }
+        if (i + 1 < block.chainLength) {
+            address = pointer + block.chain[i + 1];
+        }
+    }
+    return pointer;
 }
 
-// Updated nickname reader with proper sanitization
-std::wstring MemoryReader::GetP1Nickname() {
-    // Implementation depends on your memory reading logic
-    std::wstring rawNickname;
+bool MemoryReader::CaptureBlocks(MemorySnapshot& snapshot) {
+    std::shared_ptr<const ReadPlan> plan = SchemaLoader::GetPlan();
+    if (!hProcess || !efzModule || !plan) {
+        return false;
+    }
     
-    // Try again to find the module if not found yet
-    TryLoadEfzRevivalModule();
+    snapshot.moduleGeneration = ModuleMonitor::GetGeneration();
+    snapshot.planId = plan->id;
+    DWORD moduleBases[SCHEMA_MODULE_COUNT] = {
+        (DWORD)efzModule,
+        (DWORD)ModuleMonitor::GetBase(WATCHED_EFZ_REVIVAL)
+    };
     
-    if (efzRevivalModule) {
-        // Revival mod uses a different memory structure
-        DWORD baseAddr = (DWORD)efzRevivalModule + WIN_COUNT_BASE_OFFSET;
-        DWORD ptrValue = ReadDWORD(baseAddr);
-        if (ptrValue != 0) {
-            // Try player offset first
-            rawNickname = ReadWideString(ptrValue + P1_NICKNAME_OFFSET, MAX_NICKNAME_LENGTH);
-
-            // If the nickname is empty or default, try the spectator offset
-            if (rawNickname.empty() || rawNickname == L"Player 1") {
-                std::wstring specNickname = ReadWideString(ptrValue + P1_NICKNAME_OFFSET_SPECTATOR, MAX_NICKNAME_LENGTH);
-                if (!specNickname.empty()) {
-                    rawNickname = specNickname;
-                }
-            }
+    // One read per block, straight into its slot in the snapshot
+    for (uint32_t i = 0; i < plan->blockCount; i++) {
+        const PlanBlock& block = plan->blocks[i];
+        uint8_t* data = snapshot.data + block.dataOffset;
+        DWORD base = ResolveChain(hProcess, moduleBases[block.module], block);
+        if (base == 0 || !ReadQuiet(hProcess, base + block.start, data, block.size)) {
+            memset(data, 0, block.size);
+            base = 0;
         }
+        snapshot.blockBase[i] = base;
     }
-    
-    // Sanitize and provide default if needed
-    return SanitizeNickname(rawNickname);
+    return true;
 }
 
-std::wstring MemoryReader::GetP2Nickname() {
-    // Try again to find the module if not found yet
-    TryLoadEfzRevivalModule();
+void MemoryReader::TrackBlockBase(uint32_t index, const PlanBlock& block, DWORD base) {
+    DWORD lastBase = blocks[index].base;
+    if (base == lastBase) {
+        return;
+    }
+    Logger::Info("Block '" + block.name + "' base: " + Logger::FormatHex(lastBase) + " -> " + Logger::FormatHex(base));
     
-    std::wstring result;
-    if (efzRevivalModule) {
-        // Revival mod uses a different memory structure
-        DWORD baseAddr = (DWORD)efzRevivalModule + WIN_COUNT_BASE_OFFSET;
-        DWORD ptrValue = ReadDWORD(baseAddr);
-        if (ptrValue != 0) {
-            // Try player offset first
-            result = ReadWideString(ptrValue + P2_NICKNAME_OFFSET, MAX_NICKNAME_LENGTH);
+    // Force cache clear when pointer changes - this is important for character selection
+    if (base != 0 && lastBase == 0) {
+        ClearCache();
+    }
+}
 
-            // If the nickname is empty or default, try the spectator offset
-            if (result.empty() || result == L"Player 2") {
-                std::wstring specNickname = ReadWideString(ptrValue + P2_NICKNAME_OFFSET_SPECTATOR, MAX_NICKNAME_LENGTH);
-                if (!specNickname.empty()) {
-                    result = specNickname;
-                }
-            }
-        }
-    } 
-    // If empty or failed to read, use a default
-    if (result.empty()) {
-        result = L"Player 2";
+uint64_t MemoryReader::RefreshBlocks() {
+    MemorySnapshot snapshot;
+    if (!CaptureBlocks(snapshot)) {
+        return 0;
     }
-    
-    return result;
+    return ApplyBlocks(snapshot);
 }
 
-// Replace these functions to use the string values instead of byte IDs
-std::string MemoryReader::GetP1CharacterNameRaw() {
-    // Get base address and read pointer
-    DWORD baseAddr = (DWORD)efzModule + EFZ_BASE_OFFSET_P1;
-    DWORD p1Addr = ReadDWORD(baseAddr);
-    
-    // Log pointer changes less frequently
-    static DWORD lastP1Addr = 0;
-    if (p1Addr != lastP1Addr) {
-        Logger::Info("P1 base pointer: " + Logger::FormatHex(baseAddr) + 
-                    " -> " + Logger::FormatHex(p1Addr));
-        
-        // Force cache clear when pointer changes - this is important for character selection
-        if (p1Addr != 0 && lastP1Addr == 0) {
-            ClearCache(); // Character was just selected, clear cache
+uint64_t MemoryReader::ApplyBlocks(const MemorySnapshot& snapshot) {
+    // Module loads and unloads are published by the monitor; react once per change
+    uint32_t generation = ModuleMonitor::GetGeneration();
+    if (generation != seenModuleGeneration) {
+        seenModuleGeneration = generation;
+        InvalidateModuleState();
+        HMODULE revivalModule = ModuleMonitor::GetBase(WATCHED_EFZ_REVIVAL);
+        if (revivalModule) {
+            Logger::Info("EfzRevival.dll loaded at " + Logger::FormatHex((DWORD)revivalModule) +
+                         " - netplay/win count features available");
+        } else {
+            Logger::Warning("EfzRevival.dll unloaded - cached pointers dropped");
         }
-        
-        lastP1Addr = p1Addr;
+        // A different Revival build may need a different layout
+        SchemaLoader::Reselect();
     }
     
-    // If pointer is null, characters haven't been selected yet
-    if (p1Addr == 0) {
-        Logger::DebugThrottled("P1 character pointer is null - waiting for character selection", "p1ptr_null", 10000);
-        return "";
+    // Frames queued before a module change point into the old image
+    if (snapshot.moduleGeneration != seenModuleGeneration) {
+        return 0;
     }
     
-    // When reading character data during selection, temporarily disable caching
-    static DWORD lastReadTime = GetTickCount();
-    DWORD currentTime = GetTickCount();
-    bool wasCacheEnabled = enableReadCache;
-    
-    // Disable cache for 1 second after pointer change to ensure fresh reads
-    if (currentTime - lastReadTime < 1000) {
-        enableReadCache = false;
+    // Decode with the plan the capture was laid out by, even if a reload
+    // has published a newer one since
+    std::shared_ptr<const ReadPlan> plan = SchemaLoader::GetPlan(snapshot.planId);
+    if (!plan) {
+        return 0;
     }
-    
-    // Read character name at pointer + offset
-    std::string charName = ReadString(p1Addr + CHARACTER_NAME_OFFSET, 12);
-    
-    // Restore cache setting
-    enableReadCache = wasCacheEnabled;
-    
-    // Only log changes to avoid spam
-    static std::string lastP1Char = "";
-    if (charName != lastP1Char) {
-        if (!charName.empty()) {
-            Logger::Info("Found P1 raw character name: '" + charName + "'");
-            lastReadTime = currentTime; // Update last read time on character change
+    if (plan != appliedPlan) {
+        appliedPlan = plan;
+        for (MemoryBlock& block : blocks) {
+            block.valid = false;
         }
-        lastP1Char = charName;
     }
     
-    return charName;
-}
-
-std::string MemoryReader::GetP2CharacterNameRaw() {
-    DWORD baseAddr = (DWORD)efzModule + EFZ_BASE_OFFSET_P2;
-    DWORD p2Addr = ReadDWORD(baseAddr);
+    appliedCount++;
+    applied.moduleGeneration = snapshot.moduleGeneration;
+    applied.planId = snapshot.planId;
+    memcpy(applied.blockBase, snapshot.blockBase, sizeof(applied.blockBase));
+    memcpy(applied.data, snapshot.data, plan->dataSize);
     
-    static DWORD lastP2Addr = 0;
-    if (p2Addr != lastP2Addr) {
-        Logger::Info("P2 base pointer: " + Logger::FormatHex(baseAddr) + 
-                    " -> " + Logger::FormatHex(p2Addr));
-        lastP2Addr = p2Addr;
+    uint32_t changedBlocks = 0;
+    for (uint32_t i = 0; i < plan->blockCount; i++) {
+        const PlanBlock& block = plan->blocks[i];
+        TrackBlockBase(i, block, snapshot.blockBase[i]);
+        if (UpdateBlock(i, snapshot.blockBase[i], applied.data + block.dataOffset, block.size)) {
+            changedBlocks |= 1u << i;
+        }
     }
+    uint64_t changed = plan->FieldsInBlocks(changedBlocks);
     
-    if (p2Addr == 0) {
-        Logger::DebugThrottled("P2 character pointer is null - waiting for character selection", "p2ptr_null", 10000);
-        return "";
+    // A new layout decision moves fields without any byte changing
+    int variant = layoutClassifier.GetVariant();
+    layoutClassifier.Observe(*plan, applied, (changedBlocks & plan->variantBlockMask) != 0);
+    if (layoutClassifier.GetVariant() != variant) {
+        changed |= plan->variantFields;
     }
     
-    static std::string lastP2Char = "";
-    std::string charName = ReadString(p2Addr + CHARACTER_NAME_OFFSET, 12);
-    
-    if (charName != lastP2Char) {
-        if (!charName.empty()) {
-            Logger::Info("Found P2 raw character name: '" + charName + "'");
+    for (int player = 1; player <= 2; player++) {
+        SchemaField field = (player == 1) ? SCHEMA_P1_CHARACTER_NAME : SCHEMA_P2_CHARACTER_NAME;
+        char name[CHARACTER_NAME_FIELD_SIZE];
+        if (!(changed & SCHEMA_FIELD_BIT(field)) || !plan->DecodeBytes(field, applied, name, sizeof(name)) || name[0] == '\0') {
+            continue;
+        }
+        std::string rawName(name, strnlen(name, CHARACTER_NAME_FIELD_SIZE));
+        int characterId = CharacterTable::ResolveRawName(name);
+        if (characterId >= 0) {
+            Logger::Info("Character detected for P" + std::to_string(player) + ": '" + rawName + "' -> ID " +
+                         std::to_string(characterId) + " (" + CharacterTable::GetDisplayName(characterId) + ")");
+        } else {
+            Logger::Warning("Unknown character name for P" + std::to_string(player) + ": '" + rawName + "'");
         }
-        lastP2Char = charName;
     }
     
-    return charName;
+    return changed;
 }
 
-// Optimize MapRawCharacterNameToID to avoid repetitive logging
-int MemoryReader::MapRawCharacterNameToID(const std::string& rawName) {
-    // Don't process empty names
-    if (rawName.empty()) {
-        return -1;
-    }
-    
-    // Track only one instance of the character name per session
-    static std::unordered_map<std::string, int> sessionNameCache;
-    
-    // Check session cache first for super-fast lookups
-    auto cacheIt = sessionNameCache.find(rawName);
-    if (cacheIt != sessionNameCache.end()) {
-        return cacheIt->second;
-    }
-    
-    // Convert to uppercase for case-insensitive comparison
-    std::string upperName = rawName;
-    std::transform(upperName.begin(), upperName.end(), upperName.begin(), 
-                   [](unsigned char c) -> unsigned char { return static_cast<unsigned char>(std::toupper(c)); });
-    
-    // Define mapping from character names to IDs
-    static const std::map<std::string, int> nameToIdMap = {
-        {"AKANE", CHAR_ID_AKANE},
-        {"AKIKO", CHAR_ID_AKIKO},
-        {"IKUMI", CHAR_ID_IKUMI},
-        {"MISAKI", CHAR_ID_MISAKI},
-        {"SAYURI", CHAR_ID_SAYURI},
-        {"KANNA", CHAR_ID_KANNA},
-        {"KAORI", CHAR_ID_KAORI},
-        {"MAKOTO", CHAR_ID_MAKOTO},
-        {"MINAGI", CHAR_ID_MINAGI},
-        {"MIO", CHAR_ID_MIO},
-        {"MISHIO", CHAR_ID_MISHIO},
-        {"MISUZU", CHAR_ID_MISUZU},
-        {"MIZUKA", CHAR_ID_MIZUKA},
-        {"NAGAMORI", CHAR_ID_NAGAMORI},
-        {"NANASE", CHAR_ID_NANASE},
-        {"EXNANASE", CHAR_ID_EXNANASE},
-        {"NAYUKI", CHAR_ID_NAYUKI},
-        {"NAYUKIB", CHAR_ID_NAYUKIB},
-        {"SHIORI", CHAR_ID_SHIORI},
-        {"AYU", CHAR_ID_AYU},
-        {"MAI", CHAR_ID_MAI},
-        {"MAYU", CHAR_ID_MAYU},
-        {"MIZUKAB", CHAR_ID_MIZUKAB},
-        {"KANO", CHAR_ID_KANO}
-    };
-    
-    // First try exact match
-    auto it = nameToIdMap.find(upperName);
-    int result = -1;
-    
-    if (it != nameToIdMap.end()) {
-        result = it->second;
-    } else {
-        // If no exact match, try prefix match
-        for (const auto& pair : nameToIdMap) {
-            if (upperName.find(pair.first) == 0) {
-                result = pair.second;
-                break;
-            }
-        }
-    }
-    
-    // Log only the first time we see this character name
-    if (result >= 0) {
-        Logger::Info("Character detected: '" + rawName + "' -> ID " + std::to_string(result) +
-                    " (" + GetCharacterNameFromID(result) + ")");
-    } else {
-        Logger::Warning("Unknown character name: '" + rawName + "'");
+bool MemoryReader::UpdateBlock(uint32_t index, DWORD base, const void* data, size_t size) {
+    uint64_t hash = BlockHash::Hash(data, size, base);
+    MemoryBlock& block = blocks[index];
+    bool changed = !block.valid || block.hash != hash;
+    block.base = base;
+    block.hash = hash;
+    block.valid = true;
+    return changed;
+}
+
+// Copies the character name field for one side from the last refresh.
+// Returns false while the character pointer is null (nothing selected yet).
+bool MemoryReader::ReadCharacterNameField(int player, char (&field)[CHARACTER_NAME_FIELD_SIZE]) {
+    if (!appliedPlan) {
+        memset(field, 0, sizeof(field));
+        return false;
     }
-    
-    // Store in the session cache
-    sessionNameCache[rawName] = result;
-    
-    return result;
+    return appliedPlan->DecodeBytes(player == 1 ? SCHEMA_P1_CHARACTER_NAME : SCHEMA_P2_CHARACTER_NAME,
+                                    applied, field, sizeof(field));
 }
 
-// Now update the character ID getter functions
+std::string MemoryReader::GetP1CharacterNameRaw() {
+    char field[CHARACTER_NAME_FIELD_SIZE];
+    ReadCharacterNameField(1, field);
+    return std::string(field, strnlen(field, sizeof(field)));
+}
+
+std::string MemoryReader::GetP2CharacterNameRaw() {
+    char field[CHARACTER_NAME_FIELD_SIZE];
+    ReadCharacterNameField(2, field);
+    return std::string(field, strnlen(field, sizeof(field)));
+}
+
+// Character IDs resolve on the raw field through the compile-time table, -1 if unknown
 int MemoryReader::GetP1CharacterID() {
-    std::string rawName = GetP1CharacterNameRaw();
-    return MapRawCharacterNameToID(rawName);
+    char field[CHARACTER_NAME_FIELD_SIZE];
+    return ReadCharacterNameField(1, field) ? CharacterTable::ResolveRawName(field) : -1;
 }
 
 int MemoryReader::GetP2CharacterID() {
-    std::string rawName = GetP2CharacterNameRaw();
-    return MapRawCharacterNameToID(rawName);
-}
-
-// Add this implementation for GetModuleHandleDynamic
-HMODULE MemoryReader::GetModuleHandleDynamic(const char* moduleName) {
-    HMODULE result = GetModuleHandleA(moduleName);
-    if (result) {
-        return result;
-    }
-    
-    // If the above fails, try the more thorough approach
-    return GetModuleHandle(std::string(moduleName));
-}
-
-// Add this helper function in the implementation (private section)
-std::string MemoryReader::GetCharacterNameFromID(int id) {
-    switch (id) {
-        case CHAR_ID_AKANE: return "Akane";
-        case CHAR_ID_AKIKO: return "Akiko";
-        case CHAR_ID_IKUMI: return "Ikumi";
-        case CHAR_ID_MISAKI: return "Misaki";
-        case CHAR_ID_SAYURI: return "Sayuri";
-        case CHAR_ID_KANNA: return "Kanna";
-        case CHAR_ID_KAORI: return "Kaori";
-        case CHAR_ID_MAKOTO: return "Makoto";
-        case CHAR_ID_MINAGI: return "Minagi";
-        case CHAR_ID_MIO: return "Mio";
-        case CHAR_ID_MISHIO: return "Mishio";
-        case CHAR_ID_MISUZU: return "Misuzu";
-        case CHAR_ID_MIZUKA: return "UNKNOWN?!";
-        case CHAR_ID_NAGAMORI: return "Mizuka";
-        case CHAR_ID_NANASE: return "Rumi";
-        case CHAR_ID_EXNANASE: return "Doppel Nanase";
-        case CHAR_ID_NAYUKI: return "Nayuki(Asleep)";
-        case CHAR_ID_NAYUKIB: return "Nayuki(Awake)";
-        case CHAR_ID_SHIORI: return "Shiori";
-        case CHAR_ID_AYU: return "Ayu";
-        case CHAR_ID_MAI: return "Mai";
-        case CHAR_ID_MAYU: return "Mayu";
-        case CHAR_ID_MIZUKAB: return "UNKNOWN";
-        case CHAR_ID_KANO: return "Kano";
-        default: return "Undefined";
-    }
+    char field[CHARACTER_NAME_FIELD_SIZE];
+    return ReadCharacterNameField(2, field) ? CharacterTable::ResolveRawName(field) : -1;
 }
 
 // Add the public facing character name functions
 std::string MemoryReader::GetP1CharacterName() {
-    int characterId = GetP1CharacterID();
-    return GetCharacterNameFromID(characterId);
+    return CharacterTable::GetDisplayName(GetP1CharacterID());
 }
 
 std::string MemoryReader::GetP2CharacterName() {
-    int characterId = GetP2CharacterID();
-    return GetCharacterNameFromID(characterId);
+    return CharacterTable::GetDisplayName(GetP2CharacterID());
+}
+
+std::u16string MemoryReader::ReadWideString(DWORD address, size_t maxLength) {
+    std::u16string result(maxLength + 1, u'\0');
+    size_t length = ReadWideStringInto(address, &result[0], maxLength);
+    result.resize(length);
+    return result;
 }
 
-std::wstring MemoryReader::ReadWideString(DWORD address, size_t maxLength) {
+// Reads up to maxLength UTF-16 units into a caller buffer of maxLength + 1
+// units and returns the length up to the first NUL (0 on failure)
+size_t MemoryReader::ReadWideStringInto(DWORD address, char16_t* buffer, size_t maxLength) {
     // Check if we need to clear cache (every 5 seconds)
     DWORD currentTime = GetTickCount();
     if (currentTime - lastCacheClearTime > CACHE_CLEAR_INTERVAL_MS) {
@@ -772,29 +580,12 @@ std::wstring MemoryReader::ReadWideString(DWORD address, size_t maxLength) {
         lastCacheClearTime = currentTime;
     }
     
-    // Not using cache for wide strings yet to keep it simple
-    
-    // Read from memory
-    wchar_t* buffer = new wchar_t[maxLength + 1];
-    memset(buffer, 0, sizeof(wchar_t) * (maxLength + 1));
-    
-    bool success = ReadMemory(address, buffer, maxLength * sizeof(wchar_t));
-    
-    std::wstring result;
-    if (success) {
-        result = std::wstring(buffer);
-        
-        // Only log non-empty strings
-        if (!result.empty()) {
-            // For logging, just note that we read a wide string and its length
-            // This avoids needing codecvt conversion for logging
-            Logger::Debug("Reading wide string at " + Logger::FormatHex(address) + 
-                " (length: " + std::to_string(result.length()) + " chars)");
-        }
+    buffer[maxLength] = u'\0';
+    if (!ReadMemory(address, buffer, maxLength * sizeof(char16_t))) {
+        buffer[0] = u'\0';
+        return 0;
     }
-    
-    delete[] buffer;
-    return result;
+    return std::char_traits<char16_t>::length(buffer);
 }
 
 // Helper to read a single value from memory with caching
@@ -0,0 +1,156 @@
+#include "../include/module_monitor.h"
+#include "../include/logger.h"
+
+std::atomic<HMODULE> ModuleMonitor::bases[WATCHED_MODULE_COUNT] = {};
+std::atomic<uint32_t> ModuleMonitor::generation(0);
+void* ModuleMonitor::cookie = nullptr;
+LoopTimer ModuleMonitor::pollTimer;
+
+static const wchar_t* const WATCHED_MODULE_NAMES[WATCHED_MODULE_COUNT] = {
+    L"EfzRevival.dll"
+};
+static const char* const WATCHED_MODULE_NAMES_A[WATCHED_MODULE_COUNT] = {
+    "EfzRevival.dll"
+};
+
+// ntdll loader notification API (documented, but not declared in the SDK headers)
+struct LdrUnicodeString {
+    USHORT Length;          // In bytes
+    USHORT MaximumLength;
+    PWSTR Buffer;
+};
+
+struct LdrDllNotificationData {
+    ULONG Flags;
+    const LdrUnicodeString* FullDllName;
+    const LdrUnicodeString* BaseDllName;
+    PVOID DllBase;
+    ULONG SizeOfImage;
+};
+
+#define LDR_DLL_NOTIFICATION_REASON_LOADED 1
+#define LDR_DLL_NOTIFICATION_REASON_UNLOADED 2
+
+typedef VOID (CALLBACK* LdrDllNotificationFunction)(ULONG reason, const LdrDllNotificationData* data, PVOID context);
+typedef LONG (NTAPI* LdrRegisterDllNotificationFn)(ULONG flags, LdrDllNotificationFunction callback, PVOID context, PVOID* cookie);
+typedef LONG (NTAPI* LdrUnregisterDllNotificationFn)(PVOID cookie);
+
+// Runs under the loader lock: no allocation, no logging
+static VOID CALLBACK OnLoaderNotification(ULONG reason, const LdrDllNotificationData* data, PVOID context) {
+    if (!data || !data->BaseDllName || !data->BaseDllName->Buffer) {
+        return;
+    }
+    ModuleEventType type = (reason == LDR_DLL_NOTIFICATION_REASON_LOADED) ? MODULE_EVENT_LOADED : MODULE_EVENT_UNLOADED;
+    ModuleMonitor::Notify(type, data->BaseDllName->Buffer, data->BaseDllName->Length / sizeof(wchar_t),
+                          (HMODULE)data->DllBase);
+}
+
+// ASCII case-insensitive compare; module names are plain ASCII
+static bool SameModuleName(const wchar_t* name, size_t length, const wchar_t* watched) {
+    size_t i = 0;
+    for (; i < length && watched[i] != L'\0'; i++) {
+        wchar_t a = name[i];
+        wchar_t b = watched[i];
+        if (a >= L'A' && a <= L'Z') a = (wchar_t)(a - L'A' + L'a');
+        if (b >= L'A' && b <= L'Z') b = (wchar_t)(b - L'A' + L'a');
+        if (a != b) {
+            return false;
+        }
+    }
+    return i == length && watched[i] == L'\0';
+}
+
+void ModuleMonitor::Publish(WatchedModule module, HMODULE base) {
+    HMODULE previous = bases[module].exchange(base, std::memory_order_acq_rel);
+    if (previous != base) {
+        generation.fetch_add(1, std::memory_order_acq_rel);
+    }
+}
+
+void ModuleMonitor::Notify(ModuleEventType type, const wchar_t* baseName, size_t length, HMODULE base) {
+    for (int i = 0; i < WATCHED_MODULE_COUNT; i++) {
+        if (!SameModuleName(baseName, length, WATCHED_MODULE_NAMES[i])) {
+            continue;
+        }
+        WatchedModule module = (WatchedModule)i;
+        if (type == MODULE_EVENT_LOADED) {
+            Publish(module, base);
+        } else {
+            // Only clear if the unloaded image is the one we published
+            HMODULE expected = base;
+            if (bases[module].compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel)) {
+                generation.fetch_add(1, std::memory_order_acq_rel);
+            }
+        }
+        return;
+    }
+}
+
+const char* ModuleMonitor::GetModuleName(WatchedModule module) {
+    return WATCHED_MODULE_NAMES_A[module];
+}
+
+// Fallback when the loader API is missing: detect load, unload and reload by
+// comparing GetModuleHandle against the published base
+void ModuleMonitor::OnPollTimer(void* context) {
+    for (int i = 0; i < WATCHED_MODULE_COUNT; i++) {
+        WatchedModule module = (WatchedModule)i;
+        HMODULE current = GetModuleHandleW(WATCHED_MODULE_NAMES[i]);
+        HMODULE published = GetBase(module);
+        if (current == published) {
+            continue;
+        }
+        const wchar_t* name = WATCHED_MODULE_NAMES[i];
+        size_t length = wcslen(name);
+        if (published) {
+            Notify(MODULE_EVENT_UNLOADED, name, length, published);
+        }
+        if (current) {
+            Notify(MODULE_EVENT_LOADED, name, length, current);
+        }
+    }
+}
+
+bool ModuleMonitor::Start() {
+    HMODULE ntdll = GetModuleHandleW(L"ntdll.dll");
+    LdrRegisterDllNotificationFn registerNotification = ntdll ?
+        (LdrRegisterDllNotificationFn)GetProcAddress(ntdll, "LdrRegisterDllNotification") : nullptr;
+
+    // Register before checking what is already loaded, so a module loading
+    // in between is seen by at least one of the two
+    if (registerNotification && registerNotification(0, OnLoaderNotification, nullptr, &cookie) != 0) {
+        cookie = nullptr;
+    }
+
+    for (int i = 0; i < WATCHED_MODULE_COUNT; i++) {
+        HMODULE base = GetModuleHandleW(WATCHED_MODULE_NAMES[i]);
+        if (base) {
+            Publish((WatchedModule)i, base);
+        }
+    }
+
+    if (cookie) {
+        Logger::Info("Module monitor registered for loader notifications");
+        return true;
+    }
+
+    Logger::Warning("LdrRegisterDllNotification unavailable - polling for module changes");
+    pollTimer.callback = OnPollTimer;
+    pollTimer.background = true;
+    EventLoop::AddTimer(&pollTimer, POLL_INTERVAL_MS, POLL_INTERVAL_MS);
+    return true;
+}
+
+void ModuleMonitor::Stop() {
+    if (cookie) {
+        HMODULE ntdll = GetModuleHandleW(L"ntdll.dll");
+        LdrUnregisterDllNotificationFn unregisterNotification = ntdll ?
+            (LdrUnregisterDllNotificationFn)GetProcAddress(ntdll, "LdrUnregisterDllNotification") : nullptr;
+        if (unregisterNotification) {
+            unregisterNotification(cookie);
+        }
+        cookie = nullptr;
+    }
+
+    EventLoop::CancelTimer(&pollTimer);
+}
@@ -0,0 +1,310 @@
+#include "../include/netplay_telemetry.h"
+#include <cstring>
+
+bool NetplayStats::operator==(const NetplayStats& other) const {
+    return available == other.available && pingMs == other.pingMs && pingP50Ms == other.pingP50Ms &&
+           pingP95Ms == other.pingP95Ms && pingMaxMs == other.pingMaxMs && delayFrames == other.delayFrames &&
+           rollbacksPerSecond == other.rollbacksPerSecond && rollbacks == other.rollbacks &&
+           resyncs == other.resyncs && spectators == other.spectators;
+}
+
+NetplayTelemetry::NetplayTelemetry() {
+    Reset();
+}
+
+void NetplayTelemetry::Reset() {
+    head = 0;
+    count = 0;
+    windowTail = 0;
+    windowCount = 0;
+    memset(pingCounts, 0, sizeof(pingCounts));
+    pingSamples = 0;
+    windowRollbacks = 0;
+    windowRollbackReadings = 0;
+    windowReadable = 0;
+    memset(secondTotals, 0, sizeof(secondTotals));
+    secondsFilled = 0;
+    secondCursor = 0;
+    currentSecond = 0;
+    currentSecondRollbacks = 0;
+    secondStarted = false;
+    lastRollbackCounter = -1;
+    lastResyncCounter = -1;
+    totalRollbacks = 0;
+    totalResyncs = 0;
+}
+
+static uint32_t PingBucket(int32_t pingMs) {
+    uint32_t bucket = (uint32_t)pingMs / NetplayTelemetry::PING_BUCKET_MS;
+    return bucket < NetplayTelemetry::PING_BUCKETS ? bucket : NetplayTelemetry::PING_BUCKETS - 1;
+}
+
+// Growth of a cumulative counter; a smaller value means the game restarted
+// it, so everything it now holds is new. The first reading is the baseline.
+static uint32_t CounterDelta(int32_t value, int32_t& last) {
+    if (value < 0) {
+        return 0;
+    }
+    uint32_t delta = 0;
+    if (last >= 0) {
+        delta = (uint32_t)(value >= last ? value - last : value);
+    }
+    last = value;
+    return delta;
+}
+
+void NetplayTelemetry::Uncount(Entry& entry) {
+    if (entry.sample.pingMs >= 0) {
+        pingCounts[PingBucket(entry.sample.pingMs)]--;
+        pingSamples--;
+    }
+    windowRollbacks -= entry.rollbackDelta;
+    if (entry.sample.rollbacks >= 0) {
+        windowRollbackReadings--;
+    }
+    if (entry.readable) {
+        windowReadable--;
+    }
+}
+
+void NetplayTelemetry::Expire(uint64_t nowUs) {
+    while (windowCount > 0 && ring[windowTail].sample.timestampUs + WINDOW_US <= nowUs) {
+        Uncount(ring[windowTail]);
+        windowTail = (windowTail + 1) % RING_SIZE;
+        windowCount--;
+    }
+}
+
+void NetplayTelemetry::CloseSecond() {
+    secondTotals[secondCursor] = currentSecondRollbacks;
+    secondCursor = (secondCursor + 1) % WINDOW_SECONDS;
+    if (secondsFilled < WINDOW_SECONDS) {
+        secondsFilled++;
+    }
+    currentSecondRollbacks = 0;
+    currentSecond++;
+}
+
+void NetplayTelemetry::Record(const NetplaySample& sample) {
+    Expire(sample.timestampUs);
+
+    // A full ring overwrites its oldest entry, which may still be counted
+    if (count == RING_SIZE) {
+        if (windowCount == RING_SIZE) {
+            Uncount(ring[windowTail]);
+            windowTail = (windowTail + 1) % RING_SIZE;
+            windowCount--;
+        }
+        count--;
+    }
+
+    Entry& entry = ring[head];
+    entry.sample = sample;
+    entry.rollbackDelta = CounterDelta(sample.rollbacks, lastRollbackCounter);
+    totalRollbacks += entry.rollbackDelta;
+    totalResyncs += CounterDelta(sample.resyncs, lastResyncCounter);
+    entry.readable = sample.pingMs >= 0 || sample.delayFrames >= 0 || sample.rollbacks >= 0 ||
+                     sample.resyncs >= 0 || sample.spectators >= 0;
+
+    if (windowCount == 0) {
+        windowTail = head;
+    }
+    if (sample.pingMs >= 0) {
+        pingCounts[PingBucket(sample.pingMs)]++;
+        pingSamples++;
+    }
+    windowRollbacks += entry.rollbackDelta;
+    if (sample.rollbacks >= 0) {
+        windowRollbackReadings++;
+    }
+    if (entry.readable) {
+        windowReadable++;
+    }
+    windowCount++;
+    head = (head + 1) % RING_SIZE;
+    count++;
+
+    // Whole seconds between samples close with whatever they counted (zero)
+    uint64_t second = sample.timestampUs / 1000000;
+    if (!secondStarted) {
+        secondStarted = true;
+        currentSecond = second;
+    }
+    if (second > currentSecond + WINDOW_SECONDS) {
+        currentSecond = second - WINDOW_SECONDS;
+    }
+    while (currentSecond < second) {
+        CloseSecond();
+    }
+    currentSecondRollbacks += entry.rollbackDelta;
+}
+
+const NetplaySample& NetplayTelemetry::GetSample(size_t age) const {
+    return ring[(head + RING_SIZE - 1 - (age % RING_SIZE)) % RING_SIZE].sample;
+}
+
+// Midpoint of the bucket holding the rank-th sample (1-based)
+static int PingAtRank(const uint32_t (&counts)[NetplayTelemetry::PING_BUCKETS], uint32_t rank) {
+    uint32_t seen = 0;
+    for (uint32_t b = 0; b < NetplayTelemetry::PING_BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= rank) {
+            return (int)(b * NetplayTelemetry::PING_BUCKET_MS + NetplayTelemetry::PING_BUCKET_MS / 2);
+        }
+    }
+    return -1;
+}
+
+NetplayStats NetplayTelemetry::GetStats() const {
+    NetplayStats stats = {};
+    stats.available = windowReadable > 0;
+    stats.rollbacksPerSecond = -1.0f;
+    stats.pingMs = stats.pingP50Ms = stats.pingP95Ms = stats.pingMaxMs = -1;
+    stats.delayFrames = -1;
+    stats.spectators = -1;
+    stats.rollbacks = totalRollbacks;
+    stats.resyncs = totalResyncs;
+    if (windowCount == 0) {
+        return stats;
+    }
+
+    const NetplaySample& newest = GetSample(0);
+    stats.pingMs = newest.pingMs;
+    stats.delayFrames = newest.delayFrames;
+    stats.spectators = newest.spectators;
+    if (pingSamples > 0) {
+        stats.pingP50Ms = PingAtRank(pingCounts, (pingSamples + 1) / 2);
+        stats.pingP95Ms = PingAtRank(pingCounts, (pingSamples * 95 + 99) / 100);
+        stats.pingMaxMs = PingAtRank(pingCounts, pingSamples);
+    }
+
+    // Rate over the span actually covered, at least a second while warming up
+    if (windowRollbackReadings == 0) {
+        stats.rollbacksPerSecond = -1.0f;
+        return stats;
+    }
+    uint64_t spanUs = newest.timestampUs - ring[windowTail].sample.timestampUs;
+    double seconds = spanUs < 1000000 ? 1.0 : (double)spanUs / 1000000.0;
+    stats.rollbacksPerSecond = (float)((double)windowRollbacks / seconds);
+    return stats;
+}
+
+void NetplayTelemetry::GetPingHistogram(Histogram& histogram) const {
+    memcpy(histogram.counts, pingCounts, sizeof(pingCounts));
+    histogram.bucketCount = PING_BUCKETS;
+    histogram.bucketWidth = PING_BUCKET_MS;
+    histogram.total = pingSamples;
+}
+
+void NetplayTelemetry::GetRollbackHistogram(Histogram& histogram) const {
+    memset(histogram.counts, 0, sizeof(histogram.counts));
+    histogram.bucketCount = ROLLBACK_BUCKETS;
+    histogram.bucketWidth = 1;
+    histogram.total = secondsFilled;
+    for (uint32_t i = 0; i < secondsFilled; i++) {
+        uint32_t total = secondTotals[i];
+        histogram.counts[total < ROLLBACK_BUCKETS ? total : ROLLBACK_BUCKETS - 1]++;
+    }
+}
+
+static std::string CountsToJSON(const NetplayTelemetry::Histogram& histogram) {
+    std::string json = "[";
+    for (uint32_t b = 0; b < histogram.bucketCount; b++) {
+        json += (b ? "," : "") + std::to_string(histogram.counts[b]);
+    }
+    return json + "]";
+}
+
+std::string NetplayTelemetry::HistogramsToJSON() const {
+    Histogram ping, rollbacks;
+    GetPingHistogram(ping);
+    GetRollbackHistogram(rollbacks);
+    std::string json = "{\n";
+    json += "  \"windowSeconds\": " + std::to_string(WINDOW_SECONDS) + ",\n";
+    json += "  \"ping\": { \"bucketMs\": " + std::to_string(ping.bucketWidth) + ", \"samples\": " +
+            std::to_string(ping.total) + ", \"counts\": " + CountsToJSON(ping) + " },\n";
+    json += "  \"rollbacksPerSecond\": { \"seconds\": " + std::to_string(rollbacks.total) + ", \"counts\": " +
+            CountsToJSON(rollbacks) + " }\n";
+    json += "}";
+    return json;
+}
+
+static NetplaySample MakeSample(uint64_t timestampUs, int32_t ping, int32_t rollbacks) {
+    NetplaySample sample = { timestampUs, ping, 2, rollbacks, 0, 3 };
+    return sample;
+}
+
+bool NetplayTelemetry::RunSelfTest(std::string& failure) {
+    failure.clear();
+    NetplayTelemetry telemetry;
+
+    // 20 s at 60 fps: ping 40 ms with every tenth sample at 120 ms, a rollback every 30 frames
+    const uint64_t frameUs = 16667;
+    uint32_t frames = 20 * 60;
+    for (uint32_t i = 0; i < frames; i++) {
+        telemetry.Record(MakeSample(1000000 + i * frameUs, (i % 10 == 9) ? 120 : 40, (int32_t)(i / 30)));
+    }
+    NetplayStats stats = telemetry.GetStats();
+    Histogram ping, rollbacks;
+    telemetry.GetPingHistogram(ping);
+    telemetry.GetRollbackHistogram(rollbacks);
+    if (!stats.available || stats.pingP50Ms != 42 || stats.pingP95Ms != 122 || stats.pingMaxMs != 122 ||
+        stats.delayFrames != 2 || stats.spectators != 3) {
+        failure = "percentiles: p50 " + std::to_string(stats.pingP50Ms) + ", p95 " + std::to_string(stats.pingP95Ms);
+        return false;
+    }
+    if (ping.total < 595 || ping.total > 601 || stats.rollbacks != (frames - 1) / 30 ||
+        stats.rollbacksPerSecond < 1.8f || stats.rollbacksPerSecond > 2.2f) {
+        failure = "window: " + std::to_string(ping.total) + " ping samples, " + std::to_string(stats.rollbacks) +
+                  " rollbacks, " + std::to_string(stats.rollbacksPerSecond) + "/s";
+        return false;
+    }
+    if (rollbacks.total != WINDOW_SECONDS || rollbacks.counts[2] < WINDOW_SECONDS - 1) {
+        failure = "rollback histogram: " + std::to_string(rollbacks.counts[2]) + " of " +
+                  std::to_string(rollbacks.total) + " seconds at 2/s";
+        return false;
+    }
+
+    // The game restarting its counter is not a negative rollback count
+    uint64_t now = 1000000 + frames * frameUs;
+    telemetry.Record(MakeSample(now, 40, 0));
+    telemetry.Record(MakeSample(now + frameUs, 40, 3));
+    if (telemetry.GetStats().rollbacks != stats.rollbacks + 3) {
+        failure = "counter reset: " + std::to_string(telemetry.GetStats().rollbacks) + " rollbacks";
+        return false;
+    }
+
+    // A long gap expires the whole window
+    telemetry.Record(MakeSample(now + 30000000, 200, 3));
+    telemetry.GetPingHistogram(ping);
+    stats = telemetry.GetStats();
+    if (ping.total != 1 || stats.pingP50Ms != 202 || stats.rollbacksPerSecond != 0.0f) {
+        failure = "expiry: " + std::to_string(ping.total) + " samples left";
+        return false;
+    }
+
+    // More samples inside the window than the ring holds
+    NetplayTelemetry fast;
+    for (uint32_t i = 0; i < 10000; i++) {
+        fast.Record(MakeSample(i * 500, (int32_t)(i % 100), (int32_t)i));
+    }
+    fast.GetPingHistogram(ping);
+    if (ping.total != RING_SIZE || fast.GetSampleCount() != RING_SIZE || fast.GetSample(0).timestampUs != 9999 * 500) {
+        failure = "ring overwrite: " + std::to_string(ping.total) + " counted";
+        return false;
+    }
+
+    // Fields the schema does not describe leave the telemetry unavailable
+    NetplayTelemetry blind;
+    NetplaySample unknown = { 0, -1, -1, -1, -1, -1 };
+    for (uint32_t i = 0; i < 100; i++) {
+        unknown.timestampUs = i * frameUs;
+        blind.Record(unknown);
+    }
+    stats = blind.GetStats();
+    if (stats.available || stats.pingP50Ms != -1 || stats.rollbacks != 0 || stats.rollbacksPerSecond >= 0.0f) {
+        failure = "unreadable fields reported as available";
+        return false;
+    }
+    return true;
+}
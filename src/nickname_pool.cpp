@@ -0,0 +1,212 @@
+#include "../include/nickname_pool.h"
+#include "../include/nickname_sanitizer.h"
+#include "../include/utf_transcoder.h"
+#include "../include/alloc_tracker.h"
+#include "../include/logger.h"
+#include <cstring>
+
+const uint32_t NicknamePool::INVALID_ID;
+const uint32_t NicknamePool::CAPACITY;
+std::mutex NicknamePool::mutex;
+std::vector<NicknamePool::Entry> NicknamePool::entries;
+std::vector<uint32_t> NicknamePool::buckets;
+uint32_t NicknamePool::useClock = 0;
+
+uint32_t NicknamePool::Hash(const char16_t* raw, size_t length, const char* fallback) {
+    // FNV-1a over the raw units plus the fallback identity (P1 and P2 default differently)
+    uint32_t hash = 2166136261u ^ (uint32_t)(uintptr_t)fallback;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= raw[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Deleting from linear probing would break the chains; with CAPACITY
+// entries a rebuild is cheap, and it only happens when a name is replaced
+void NicknamePool::Rehash() {
+    buckets.assign(BUCKET_COUNT, INVALID_ID);
+    for (uint32_t index = 0; index < entries.size(); index++) {
+        size_t slot = entries[index].hash & (BUCKET_COUNT - 1);
+        while (buckets[slot] != INVALID_ID) {
+            slot = (slot + 1) & (BUCKET_COUNT - 1);
+        }
+        buckets[slot] = index;
+    }
+}
+
+NicknamePool::Entry* NicknamePool::Find(uint32_t id) {
+    uint32_t index = id & ((1u << INDEX_BITS) - 1);
+    if (id == INVALID_ID || index >= entries.size() || entries[index].id != id) {
+        return nullptr;
+    }
+    return &entries[index];
+}
+
+uint32_t NicknamePool::Intern(const char16_t* raw, size_t length, const char* fallback) {
+    if (length > MAX_NICKNAME_LENGTH) {
+        length = MAX_NICKNAME_LENGTH;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (buckets.empty()) {
+        entries.reserve(CAPACITY);
+        Rehash();
+    }
+    useClock++;
+
+    uint32_t hash = Hash(raw, length, fallback);
+    size_t slot = hash & (BUCKET_COUNT - 1);
+    while (buckets[slot] != INVALID_ID) {
+        Entry& entry = entries[buckets[slot]];
+        if (entry.hash == hash && entry.length == length && entry.fallback == fallback &&
+            memcmp(entry.raw, raw, length * sizeof(char16_t)) == 0) {
+            entry.lastUse = useClock;
+            return entry.id;
+        }
+        slot = (slot + 1) & (BUCKET_COUNT - 1);
+    }
+
+    // First time this raw name is seen: sanitize and convert once
+    Entry entry = {};
+    entry.hash = hash;
+    entry.lastUse = useClock;
+    entry.length = (uint8_t)length;
+    memcpy(entry.raw, raw, length * sizeof(char16_t));
+    entry.fallback = fallback;
+
+    char16_t sanitized[MAX_SANITIZED_NICKNAME_LENGTH];
+    size_t sanitizedLength = NicknameSanitizer::Sanitize(raw, length, sanitized);
+    if (sanitizedLength == 0) {
+        entry.utf8 = fallback;
+    } else {
+        char utf8[NicknameString::capacity()];
+        size_t utf8Length = Utf16Transcoder::ToUtf8(sanitized, sanitizedLength, utf8, sizeof(utf8));
+        entry.utf8.assign(utf8, utf8Length);
+    }
+
+    if (entries.size() < CAPACITY) {
+        entry.id = (uint32_t)entries.size();
+        entries.push_back(entry);
+        buckets[slot] = entry.id;
+    } else {
+        // Full: the least recently used name gives up its slot, under the
+        // next generation so its old ID stops resolving
+        uint32_t victim = 0;
+        for (uint32_t index = 1; index < CAPACITY; index++) {
+            if (useClock - entries[index].lastUse > useClock - entries[victim].lastUse) {
+                victim = index;
+            }
+        }
+        uint32_t generation = (entries[victim].id >> INDEX_BITS) + 1;
+        entry.id = (generation << INDEX_BITS) | victim;
+        if (entry.id == INVALID_ID) {
+            entry.id = victim;
+        }
+        entries[victim] = entry;
+        Rehash();
+    }
+
+    Logger::Debug("Interned nickname #" + std::to_string(entry.id) + ": '" + entry.utf8.str() + "'");
+    return entry.id;
+}
+
+void NicknamePool::Touch(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry* entry = Find(id)) {
+        entry->lastUse = ++useClock;
+    }
+}
+
+NicknameString NicknamePool::Get(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry* entry = Find(id);
+    if (!entry) {
+        return NicknameString();
+    }
+    entry->lastUse = ++useClock;
+    return entry->utf8;
+}
+
+size_t NicknamePool::Size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+// Runs on the process-wide pool with names no game produces, and puts
+// the pool back afterwards so the flood does not age out the players'
+// names. Call from the loop thread, which does all the interning.
+bool NicknamePool::RunSelfTest(std::string& failure) {
+    failure.clear();
+    std::vector<Entry> savedEntries;
+    std::vector<uint32_t> savedBuckets;
+    uint32_t savedClock;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        savedEntries = entries;
+        savedBuckets = buckets;
+        savedClock = useClock;
+    }
+    bool passed = CheckPool(failure);
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.assign(savedEntries.begin(), savedEntries.end());
+    buckets = savedBuckets;
+    useClock = savedClock;
+    return passed;
+}
+
+bool NicknamePool::CheckPool(std::string& failure) {
+    static const char* fallback = "Self-test";
+    const char16_t alice[] = {0x01, 'A', 'l', 'i', 'c', 'e'};
+    const char16_t bob[] = {0x01, 'B', 'o', 'b'};
+
+    uint32_t aliceId = Intern(alice, 6, fallback);
+    uint32_t bobId = Intern(bob, 4, fallback);
+    if (aliceId == bobId || Intern(alice, 6, fallback) != aliceId) {
+        failure = "same name did not keep its ID";
+        return false;
+    }
+    if (Get(aliceId).empty()) {
+        failure = "interned name reads back empty";
+        return false;
+    }
+
+    // Unchanged names: a lookup and a memcmp, nothing on the heap
+    size_t before = AllocTracker::GetThreadAllocations();
+    for (int i = 0; i < 1000; i++) {
+        Intern(alice, 6, fallback);
+        Touch(bobId);
+    }
+    size_t allocations = AllocTracker::GetThreadAllocations() - before;
+    if (allocations != 0) {
+        failure = std::to_string(allocations) + " allocations re-interning a pooled name";
+        return false;
+    }
+
+    // Flood with distinct garbage while both names stay in use
+    char16_t garbage[4] = {0x01, 0, 0, 0};
+    uint32_t firstGarbage = INVALID_ID;
+    for (uint32_t i = 0; i < CAPACITY * 4; i++) {
+        garbage[1] = (char16_t)(0xE100 + (i & 0xFF));
+        garbage[2] = (char16_t)(0xE100 + (i >> 8));
+        uint32_t id = Intern(garbage, 3, fallback);
+        firstGarbage = i == 0 ? id : firstGarbage;
+        if (i % 16 == 0) {
+            Touch(aliceId);
+            Touch(bobId);
+        }
+    }
+    if (Size() > CAPACITY) {
+        failure = "pool grew past its capacity to " + std::to_string(Size());
+        return false;
+    }
+    if (Intern(alice, 6, fallback) != aliceId || Intern(bob, 4, fallback) != bobId) {
+        failure = "a name in use was evicted";
+        return false;
+    }
+    if (!Get(firstGarbage).empty()) {
+        failure = "an evicted ID still resolves";
+        return false;
+    }
+    return true;
+}
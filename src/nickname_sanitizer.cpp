@@ -0,0 +1,291 @@
+#include "../include/nickname_sanitizer.h"
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define EFZ_SANITIZER_SSE2 1
+#endif
+
+namespace {
+
+struct ClassRange {
+    char16_t first;
+    char16_t last;
+    uint8_t charClass;
+};
+
+// Applied in order, later entries override earlier ones. Everything not
+// listed (symbols, emoji halves, private use, unassigned) is disallowed.
+const ClassRange CLASS_RANGES[] = {
+    { 0x0000, 0x001F, NicknameSanitizer::CHAR_CONTROL },
+    { 0x0020, 0x007E, NicknameSanitizer::CHAR_ALLOWED },
+    { u'=',   u'=',   NicknameSanitizer::CHAR_DISALLOWED },
+    { u'`',   u'`',   NicknameSanitizer::CHAR_DISALLOWED },
+    { 0x007F, 0x009F, NicknameSanitizer::CHAR_CONTROL },
+    { 0x00A0, 0x00A0, NicknameSanitizer::CHAR_CONFUSABLE },   // No-break space
+    { 0x00AD, 0x00AD, NicknameSanitizer::CHAR_CONTROL },      // Soft hyphen
+    { 0x00C0, 0x024F, NicknameSanitizer::CHAR_ALLOWED },      // Latin-1 letters, Latin Extended-A/B
+    { 0x00D7, 0x00D7, NicknameSanitizer::CHAR_DISALLOWED },   // Multiplication sign
+    { 0x00F7, 0x00F7, NicknameSanitizer::CHAR_DISALLOWED },   // Division sign
+    { 0x0300, 0x036F, NicknameSanitizer::CHAR_COMBINING },    // Combining diacritics
+    { 0x0370, 0x03FF, NicknameSanitizer::CHAR_ALLOWED },      // Greek
+    { 0x0400, 0x052F, NicknameSanitizer::CHAR_ALLOWED },      // Cyrillic + supplement
+    { 0x0483, 0x0489, NicknameSanitizer::CHAR_COMBINING },    // Cyrillic combining marks
+    { 0x1100, 0x11FF, NicknameSanitizer::CHAR_ALLOWED },      // Hangul Jamo
+    { 0x1AB0, 0x1AFF, NicknameSanitizer::CHAR_COMBINING },
+    { 0x1DC0, 0x1DFF, NicknameSanitizer::CHAR_COMBINING },
+    { 0x1E00, 0x1EFF, NicknameSanitizer::CHAR_ALLOWED },      // Latin Extended Additional (Vietnamese)
+    { 0x2000, 0x200A, NicknameSanitizer::CHAR_CONFUSABLE },   // Typographic spaces
+    { 0x200B, 0x200F, NicknameSanitizer::CHAR_CONTROL },      // Zero-width and direction marks
+    { 0x2010, 0x2015, NicknameSanitizer::CHAR_CONFUSABLE },   // Hyphens and dashes
+    { 0x2018, 0x201B, NicknameSanitizer::CHAR_CONFUSABLE },   // Single quotes
+    { 0x201C, 0x201F, NicknameSanitizer::CHAR_CONFUSABLE },   // Double quotes
+    { 0x2024, 0x2024, NicknameSanitizer::CHAR_CONFUSABLE },   // One dot leader
+    { 0x2028, 0x202F, NicknameSanitizer::CHAR_CONTROL },      // Separators, bidi embeddings
+    { 0x202F, 0x202F, NicknameSanitizer::CHAR_CONFUSABLE },   // Narrow no-break space
+    { 0x2039, 0x203A, NicknameSanitizer::CHAR_CONFUSABLE },   // Single angle quotes
+    { 0x2060, 0x206F, NicknameSanitizer::CHAR_CONTROL },      // Invisible operators, bidi isolates
+    { 0x20D0, 0x20FF, NicknameSanitizer::CHAR_COMBINING },
+    { 0x2212, 0x2212, NicknameSanitizer::CHAR_CONFUSABLE },   // Minus sign
+    { 0x3000, 0x3000, NicknameSanitizer::CHAR_CONFUSABLE },   // Ideographic space
+    { 0x3001, 0x303F, NicknameSanitizer::CHAR_ALLOWED },      // CJK punctuation (「」、。々〜)
+    { 0x3040, 0x30FF, NicknameSanitizer::CHAR_ALLOWED },      // Hiragana & Katakana
+    { 0x3099, 0x309A, NicknameSanitizer::CHAR_COMBINING },    // Kana voicing marks
+    { 0x3130, 0x318F, NicknameSanitizer::CHAR_ALLOWED },      // Hangul compatibility Jamo
+    { 0x31F0, 0x31FF, NicknameSanitizer::CHAR_ALLOWED },      // Katakana extensions
+    { 0x3400, 0x4DBF, NicknameSanitizer::CHAR_ALLOWED },      // CJK extension A
+    { 0x4E00, 0x9FFF, NicknameSanitizer::CHAR_ALLOWED },      // CJK unified ideographs
+    { 0xAC00, 0xD7A3, NicknameSanitizer::CHAR_ALLOWED },      // Hangul syllables
+    { 0xFE00, 0xFE0F, NicknameSanitizer::CHAR_CONTROL },      // Variation selectors
+    { 0xFE20, 0xFE2F, NicknameSanitizer::CHAR_COMBINING },
+    { 0xFEFF, 0xFEFF, NicknameSanitizer::CHAR_CONTROL },      // BOM / zero-width no-break space
+    { 0xFF01, 0xFF5E, NicknameSanitizer::CHAR_CONFUSABLE },   // Fullwidth ASCII
+    { 0xFF61, 0xFF9F, NicknameSanitizer::CHAR_ALLOWED },      // Halfwidth katakana
+};
+
+struct FoldRange {
+    char16_t first;
+    char16_t last;
+    char16_t replacement;
+};
+
+// Fullwidth forms are folded arithmetically; these cover the rest
+const FoldRange FOLD_RANGES[] = {
+    { 0x00A0, 0x00A0, u' ' },
+    { 0x2000, 0x200A, u' ' },
+    { 0x2010, 0x2015, u'-' },
+    { 0x2018, 0x201B, u'\'' },
+    { 0x201C, 0x201F, u'"' },
+    { 0x2024, 0x2024, u'.' },
+    { 0x202F, 0x202F, u' ' },
+    { 0x2039, 0x2039, u'<' },
+    { 0x203A, 0x203A, u'>' },
+    { 0x2212, 0x2212, u'-' },
+    { 0x3000, 0x3000, u' ' },
+};
+
+} // namespace
+
+void NicknameSanitizer::BuildTables(Tables& tables) {
+    std::vector<uint8_t> flat(0x10000, CHAR_DISALLOWED);
+    for (const ClassRange& range : CLASS_RANGES) {
+        memset(&flat[range.first], range.charClass, (size_t)range.last - range.first + 1);
+    }
+
+    // Share identical 256-unit blocks (most of the BMP is uniform)
+    tables.blockCount = 0;
+    for (size_t high = 0; high < 256; high++) {
+        const uint8_t* block = &flat[high << 8];
+        size_t index = 0;
+        while (index < tables.blockCount && memcmp(tables.blocks[index], block, 256) != 0) {
+            index++;
+        }
+        if (index == tables.blockCount) {
+            if (tables.blockCount == MAX_BLOCKS) {
+                index = 0; // Unreachable with the ranges above; block 0 is the safe default
+            } else {
+                memcpy(tables.blocks[tables.blockCount++], block, 256);
+            }
+        }
+        tables.blockIndex[high] = (uint8_t)index;
+    }
+}
+
+const NicknameSanitizer::Tables& NicknameSanitizer::GetTables() {
+    static const Tables tables = []() {
+        Tables built = {};
+        BuildTables(built);
+        return built;
+    }();
+    return tables;
+}
+
+NicknameSanitizer::CharClass NicknameSanitizer::Classify(char16_t c) {
+    const Tables& tables = GetTables();
+    return (CharClass)tables.blocks[tables.blockIndex[c >> 8]][c & 0xFF];
+}
+
+char16_t NicknameSanitizer::Fold(char16_t c) {
+    if (c >= 0xFF01 && c <= 0xFF5E) {
+        return (char16_t)(c - 0xFEE0);
+    }
+    for (const FoldRange& range : FOLD_RANGES) {
+        if (c >= range.first && c <= range.last) {
+            return range.replacement;
+        }
+    }
+    return c;
+}
+
+#ifdef EFZ_SANITIZER_SSE2
+// True when all 8 units are printable ASCII other than '=' and '`', i.e. can be copied unchanged
+static inline bool IsPlainAscii8(const char16_t* units) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(units));
+    // Signed compares: units >= 0x8000 are negative and fail the lower bound
+    __m128i ok = _mm_and_si128(_mm_cmpgt_epi16(v, _mm_set1_epi16(0x1F)), _mm_cmplt_epi16(v, _mm_set1_epi16(0x7F)));
+    ok = _mm_andnot_si128(_mm_cmpeq_epi16(v, _mm_set1_epi16(u'=')), ok);
+    ok = _mm_andnot_si128(_mm_cmpeq_epi16(v, _mm_set1_epi16(u'`')), ok);
+    return _mm_movemask_epi8(ok) == 0xFFFF;
+}
+#endif
+
+size_t NicknameSanitizer::Sanitize(const char16_t* input, size_t length, char16_t* output) {
+    const Tables& tables = GetTables();
+    const size_t limit = MAX_SANITIZED_NICKNAME_LENGTH;
+    size_t in = 0;
+    size_t out = 0;
+    bool afterBase = false;     // Combining marks only attach to a kept character
+    int combiningRun = 0;
+
+    while (in < length && out < limit) {
+#ifdef EFZ_SANITIZER_SSE2
+        if (in + 8 <= length && out + 8 <= limit && IsPlainAscii8(input + in)) {
+            memcpy(output + out, input + in, 8 * sizeof(char16_t));
+            in += 8;
+            out += 8;
+            afterBase = true;
+            combiningRun = 0;
+            continue;
+        }
+#endif
+
+        char16_t c = input[in++];
+        CharClass charClass;
+        if (c >= 0xD800 && c <= 0xDBFF && in < length && input[in] >= 0xDC00 && input[in] <= 0xDFFF) {
+            in++; // Supplementary plane (emoji etc.): one replacement for the pair
+            charClass = CHAR_DISALLOWED;
+        } else {
+            charClass = (CharClass)tables.blocks[tables.blockIndex[c >> 8]][c & 0xFF];
+            if (charClass == CHAR_CONFUSABLE) {
+                c = Fold(c);
+                charClass = (CharClass)tables.blocks[tables.blockIndex[c >> 8]][c & 0xFF];
+            }
+        }
+
+        switch (charClass) {
+        case CHAR_ALLOWED:
+            output[out++] = c;
+            afterBase = true;
+            combiningRun = 0;
+            break;
+        case CHAR_COMBINING:
+            if (afterBase && combiningRun < 2) {
+                output[out++] = c;
+                combiningRun++;
+            }
+            break;
+        case CHAR_CONTROL:
+            break;
+        default:
+            // Replace invalid characters with a single underscore per run
+            if (out > 0 && output[out - 1] != u'_') {
+                output[out++] = u'_';
+            }
+            afterBase = false;
+            break;
+        }
+    }
+    return out;
+}
+
+std::u16string NicknameSanitizer::Sanitize(const std::u16string& input) {
+    char16_t buffer[MAX_SANITIZED_NICKNAME_LENGTH];
+    return std::u16string(buffer, Sanitize(input.data(), input.size(), buffer));
+}
+
+bool NicknameSanitizer::RunSelfTest(std::string& failure) {
+    struct Case {
+        const char16_t* input;
+        const char16_t* expected;
+        const char* description;
+    };
+    const Case cases[] = {
+        { u"Player", u"Player", "plain ASCII" },
+        { u"xX_Sniper_Xx [JP]", u"xX_Sniper_Xx [JP", "ASCII truncated to 16" },
+        { u"\x0412\x0430\x0441\x044F", u"\x0412\x0430\x0441\x044F", "Cyrillic" },
+        { u"Jos\x00E9 Pe\x00F1" u"a", u"Jos\x00E9 Pe\x00F1" u"a", "accented Latin" },
+        { u"Nguy\x1EC5n", u"Nguy\x1EC5n", "Vietnamese" },
+        { u"\xFF21\xFF22\xFF23\xFF11\xFF12\xFF13", u"ABC123", "fullwidth to ASCII" },
+        { u"\x3042\x3000\x30AB", u"\x3042 \x30AB", "ideographic space" },
+        { u"\x307F\x3055\x304D", u"\x307F\x3055\x304D", "hiragana" },
+        { u"\xD55C\xAD6D", u"\xD55C\xAD6D", "Hangul" },
+        { u"a\x200B" u"b\x202E" u"c", u"abc", "zero-width and bidi controls dropped" },
+        { u"e\x0301", u"e\x0301", "combining after base" },
+        { u"\x0301" u"a", u"a", "leading combining dropped" },
+        { u"a\x0301\x0302\x0303\x0304", u"a\x0301\x0302", "combining run capped" },
+        { u"a\xD83D\xDE00" u"b", u"a_b", "emoji pair becomes one underscore" },
+        { u"a==b", u"a_b", "disallowed run collapsed" },
+        { u"==a", u"a", "no leading underscore" },
+        { u"\x2014" u"dash\x2014", u"-dash-", "em dash folded" },
+        { u"\xFF1D" u"x", u"x", "fullwidth '=' stays disallowed" },
+        { u"\xD800", u"", "lone surrogate" },
+    };
+
+    for (const Case& test : cases) {
+        std::u16string input(test.input);
+        std::u16string result = Sanitize(input);
+        if (result != test.expected) {
+            failure = test.description;
+            return false;
+        }
+    }
+
+#ifdef EFZ_SANITIZER_SSE2
+    // The SIMD run check must agree with the table for every unit
+    for (uint32_t c = 0; c < 0x10000; c++) {
+        char16_t units[8];
+        for (char16_t& unit : units) unit = (char16_t)c;
+        bool plain = c < 0x80 && Classify((char16_t)c) == CHAR_ALLOWED;
+        if (IsPlainAscii8(units) != plain) {
+            failure = "ASCII fast path disagrees with the table at U+" + std::to_string(c);
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+double NicknameSanitizer::RunBenchmark(size_t names) {
+    // Mix of name shapes seen in netplay lobbies
+    const std::u16string samples[] = {
+        u"Player 1",
+        u"xX_Sniper_Xx",
+        u"\x0412\x0430\x0441\x044F_\x041F\x0443\x043F\x043A\x0438\x043D",
+        u"\xFF21\xFF22\xFF23\x3000\xFF11\xFF12\xFF13",
+        u"\x307F\x3055\x304D\x3061\x3083\x3093",
+        u"Jos\x00E9 \x2014 \xD83D\xDE00",
+    };
+    const size_t sampleCount = sizeof(samples) / sizeof(samples[0]);
+
+    char16_t output[MAX_SANITIZED_NICKNAME_LENGTH];
+    volatile size_t sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < names; i++) {
+        const std::u16string& sample = samples[i % sampleCount];
+        sink = sink + Sanitize(sample.data(), sample.size(), output);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return names ? seconds * 1e9 / (double)names : 0.0;
+}
@@ -0,0 +1,885 @@
+#include "../include/offset_schema.h"
+#include "../include/constants.h"
+#include "../include/character_table.h"
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+using nlohmann::json;
+
+namespace {
+
+const char* const FIELD_NAMES[SCHEMA_FIELD_COUNT] = {
+    "p1.winCount",
+    "p2.winCount",
+    "p1.nickname",
+    "p2.nickname",
+    "p1.characterName",
+    "p2.characterName",
+    "p1.input",
+    "p2.input",
+    "p1.hp",
+    "p2.hp",
+    "p1.hitstun",
+    "p2.hitstun",
+    "netplay.ping",
+    "netplay.delay",
+    "netplay.rollbacks",
+    "netplay.resyncs",
+    "netplay.spectators"
+};
+
+const char* const MODULE_NAMES[SCHEMA_MODULE_COUNT] = {
+    "efz.exe",
+    "EfzRevival.dll"
+};
+
+struct TypeInfo {
+    const char* name;
+    SchemaFieldType type;
+    uint32_t unitSize;
+    bool isString;
+};
+
+const TypeInfo TYPES[] = {
+    { "u8",    FIELD_TYPE_U8,    1, false },
+    { "u16",   FIELD_TYPE_U16,   2, false },
+    { "u32",   FIELD_TYPE_U32,   4, false },
+    { "i32",   FIELD_TYPE_I32,   4, false },
+    { "utf16", FIELD_TYPE_UTF16, 2, true },
+    { "ascii", FIELD_TYPE_ASCII, 1, true }
+};
+
+const TypeInfo& GetTypeInfo(SchemaFieldType type) {
+    for (const TypeInfo& info : TYPES) {
+        if (info.type == type) {
+            return info;
+        }
+    }
+    return TYPES[0];
+}
+
+// Every compile gets a fresh ID so snapshots can name the plan they used
+std::atomic<uint32_t> nextPlanId(1);
+
+struct SchemaError : std::runtime_error {
+    explicit SchemaError(const std::string& message) : std::runtime_error(message) {}
+};
+
+// JSON integer or "0x..." / decimal string
+int64_t ParseNumber(const json& value, const std::string& what) {
+    if (value.is_number_integer()) {
+        return value.get<int64_t>();
+    }
+    if (value.is_string()) {
+        const std::string& text = value.get_ref<const std::string&>();
+        char* end = nullptr;
+        long long parsed = strtoll(text.c_str(), &end, 0);
+        if (!text.empty() && end && *end == '\0') {
+            return parsed;
+        }
+    }
+    throw SchemaError(what + ": expected a number or hex string");
+}
+
+uint32_t ParseOffset(const json& value, const std::string& what) {
+    int64_t number = ParseNumber(value, what);
+    if (number < 0 || number > 0xFFFFFFFFll) {
+        throw SchemaError(what + ": out of range");
+    }
+    return (uint32_t)number;
+}
+
+const json& Require(const json& object, const char* key, const std::string& what) {
+    auto it = object.find(key);
+    if (it == object.end()) {
+        throw SchemaError(what + ": missing \"" + key + "\"");
+    }
+    return *it;
+}
+
+std::u16string Utf8ToUtf16(const std::string& text) {
+    std::u16string result;
+    for (size_t i = 0; i < text.size();) {
+        unsigned char lead = (unsigned char)text[i];
+        uint32_t codePoint;
+        size_t extra;
+        if (lead < 0x80) { codePoint = lead; extra = 0; }
+        else if ((lead & 0xE0) == 0xC0) { codePoint = lead & 0x1F; extra = 1; }
+        else if ((lead & 0xF0) == 0xE0) { codePoint = lead & 0x0F; extra = 2; }
+        else { codePoint = lead & 0x07; extra = 3; }
+        if (i + extra >= text.size()) {
+            break;  // Truncated sequence
+        }
+        for (size_t k = 1; k <= extra; k++) {
+            codePoint = (codePoint << 6) | ((unsigned char)text[i + k] & 0x3F);
+        }
+        i += extra + 1;
+        if (codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            result += (char16_t)(0xD800 + (codePoint >> 10));
+            result += (char16_t)(0xDC00 + (codePoint & 0x3FF));
+        } else {
+            result += (char16_t)codePoint;
+        }
+    }
+    return result;
+}
+
+bool MatchesFingerprint(const json& match, const ModuleFingerprint fingerprints[SCHEMA_MODULE_COUNT]) {
+    for (auto it = match.begin(); it != match.end(); ++it) {
+        int module = -1;
+        for (int m = 0; m < SCHEMA_MODULE_COUNT; m++) {
+            if (it.key() == MODULE_NAMES[m]) {
+                module = m;
+            }
+        }
+        if (module < 0) {
+            throw SchemaError("match: unknown module \"" + it.key() + "\"");
+        }
+        const ModuleFingerprint& fingerprint = fingerprints[module];
+        if (!fingerprint.loaded) {
+            return false;
+        }
+        const json& expected = it.value();
+        if (expected.contains("timestamp") && ParseOffset(expected["timestamp"], "match.timestamp") != fingerprint.timestamp) {
+            return false;
+        }
+        if (expected.contains("checksum") && ParseOffset(expected["checksum"], "match.checksum") != fingerprint.checksum) {
+            return false;
+        }
+        if (expected.contains("imageSize") && ParseOffset(expected["imageSize"], "match.imageSize") != fingerprint.imageSize) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// What a compile needs to know about the process besides the document
+struct CompileContext {
+    const ModuleFingerprint* fingerprints;
+    SignatureResolver* resolver;
+};
+
+// chain[0] as a signature object; see OffsetSchema
+uint32_t ResolveSignature(const json& source, const std::string& what, SchemaModule module,
+                          const CompileContext& context, ReadPlan& plan, bool& scanned) {
+    SignatureSpec spec;
+    const json& pattern = Require(source, "signature", what);
+    if (!pattern.is_string()) {
+        throw SchemaError(what + ".signature: expected a string");
+    }
+    spec.pattern = pattern.get<std::string>();
+    spec.operand = ParseOffset(Require(source, "operand", what), what + ".operand");
+    spec.kind = OPERAND_ABSOLUTE;
+    if (source.contains("kind")) {
+        const json& kind = source["kind"];
+        if (kind == "relative") {
+            spec.kind = OPERAND_RELATIVE;
+        } else if (kind != "absolute") {
+            throw SchemaError(what + ".kind: expected \"absolute\" or \"relative\"");
+        }
+    }
+    BytePattern parsed;
+    std::string error;
+    if (!BytePattern::Parse(spec.pattern, parsed, error)) {
+        throw SchemaError(what + ".signature: " + error);
+    }
+    if ((size_t)spec.operand + 4 > parsed.bytes.size()) {
+        throw SchemaError(what + ".operand: past the end of the signature");
+    }
+
+    bool hasFallback = source.contains("fallback");
+    uint32_t fallback = hasFallback ? ParseOffset(source["fallback"], what + ".fallback") : 0;
+
+    scanned = false;
+    if (!context.resolver || !context.fingerprints[module].loaded) {
+        if (!hasFallback) {
+            throw SchemaError(what + ": signature cannot be resolved now and has no fallback");
+        }
+        return fallback;
+    }
+    uint32_t rva = 0;
+    if (!context.resolver->Resolve(module, spec, rva, error)) {
+        if (!hasFallback) {
+            throw SchemaError(what + ": " + error);
+        }
+        char text[16];
+        snprintf(text, sizeof(text), "0x%X", fallback);
+        plan.warnings.push_back(what + ": " + error + "; using fallback " + text);
+        return fallback;
+    }
+    if (hasFallback && rva != fallback) {
+        char text[48];
+        snprintf(text, sizeof(text), "0x%X instead of fallback 0x%X", rva, fallback);
+        plan.warnings.push_back(what + ": signature found the global at " + text);
+    }
+    scanned = true;
+    return rva;
+}
+
+void CompileBlocks(const json& layout, const CompileContext& context, ReadPlan& plan) {
+    const json& blocks = Require(layout, "blocks", "layout");
+    if (!blocks.is_object() || blocks.empty()) {
+        throw SchemaError("blocks: expected a non-empty object");
+    }
+    if (blocks.size() > SNAPSHOT_MAX_BLOCKS) {
+        throw SchemaError("blocks: at most " + std::to_string(SNAPSHOT_MAX_BLOCKS) + " allowed");
+    }
+
+    uint32_t dataOffset = 0;
+    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+        std::string what = "block \"" + it.key() + "\"";
+        const json& source = it.value();
+        PlanBlock& block = plan.blocks[plan.blockCount];
+        block.name = it.key();
+
+        const json& module = Require(source, "module", what);
+        block.module = SCHEMA_MODULE_COUNT;
+        for (int m = 0; m < SCHEMA_MODULE_COUNT; m++) {
+            if (module.is_string() && module.get_ref<const std::string&>() == MODULE_NAMES[m]) {
+                block.module = (SchemaModule)m;
+            }
+        }
+        if (block.module == SCHEMA_MODULE_COUNT) {
+            throw SchemaError(what + ": unknown module " + module.dump());
+        }
+
+        const json& pointer = Require(source, "pointer", what);
+        if (!pointer.is_array() || pointer.empty() || pointer.size() > SCHEMA_MAX_POINTER_CHAIN) {
+            throw SchemaError(what + ": pointer must list 1 to " + std::to_string(SCHEMA_MAX_POINTER_CHAIN) + " offsets");
+        }
+        block.chainLength = (uint32_t)pointer.size();
+        block.scanned = false;
+        for (uint32_t i = 0; i < block.chainLength; i++) {
+            block.chain[i] = (i == 0 && pointer[i].is_object())
+                ? ResolveSignature(pointer[i], what + ".pointer", block.module, context, plan, block.scanned)
+                : ParseOffset(pointer[i], what + ".pointer");
+        }
+
+        block.start = ParseOffset(Require(source, "start", what), what + ".start");
+        block.size = ParseOffset(Require(source, "size", what), what + ".size");
+        if (block.size == 0 || block.size > SNAPSHOT_DATA_SIZE - dataOffset) {
+            throw SchemaError(what + ": size must be 1 to " + std::to_string(SNAPSHOT_DATA_SIZE - dataOffset) +
+                              " bytes (snapshot holds " + std::to_string(SNAPSHOT_DATA_SIZE) + ")");
+        }
+        // Keep every block 4-byte aligned inside the snapshot
+        block.dataOffset = dataOffset;
+        dataOffset += (block.size + 3) & ~3u;
+        if (dataOffset > SNAPSHOT_DATA_SIZE) {
+            dataOffset = SNAPSHOT_DATA_SIZE;
+        }
+        plan.blockCount++;
+    }
+    plan.dataSize = dataOffset;
+}
+
+void CompileField(const std::string& name, const json& source, ReadPlan& plan, PlanField& field) {
+    std::string what = "field \"" + name + "\"";
+
+    const json& type = Require(source, "type", what);
+    const TypeInfo* info = nullptr;
+    for (const TypeInfo& candidate : TYPES) {
+        if (type.is_string() && type.get_ref<const std::string&>() == candidate.name) {
+            info = &candidate;
+        }
+    }
+    if (!info) {
+        throw SchemaError(what + ": unknown type " + type.dump());
+    }
+    field.type = info->type;
+    field.length = info->isString ? ParseOffset(Require(source, "length", what), what + ".length") : 1;
+    if (field.length == 0) {
+        throw SchemaError(what + ": length must be positive");
+    }
+    uint32_t byteSize = field.length * info->unitSize;
+
+    field.hasRange = source.contains("range");
+    if (field.hasRange) {
+        const json& range = source["range"];
+        if (info->isString || !range.is_array() || range.size() != 2) {
+            throw SchemaError(what + ": range must be [min, max] on an integer field");
+        }
+        field.minValue = ParseNumber(range[0], what + ".range");
+        field.maxValue = ParseNumber(range[1], what + ".range");
+        if (field.minValue > field.maxValue) {
+            throw SchemaError(what + ": range min is above max");
+        }
+    }
+    field.defaultValue = source.contains("default") ? ParseNumber(source["default"], what + ".default") : 0;
+
+    if (source.contains("reject")) {
+        if (!info->isString || !source["reject"].is_array()) {
+            throw SchemaError(what + ": reject must be a list of strings on a string field");
+        }
+        for (const json& value : source["reject"]) {
+            if (!value.is_string()) {
+                throw SchemaError(what + ": reject must be a list of strings");
+            }
+            field.reject.push_back(Utf8ToUtf16(value.get<std::string>()));
+        }
+    }
+
+    const json& locations = Require(source, "locations", what);
+    if (!locations.is_array() || locations.empty() || locations.size() > SCHEMA_MAX_LOCATIONS) {
+        throw SchemaError(what + ": locations must list 1 to " + std::to_string(SCHEMA_MAX_LOCATIONS) + " entries");
+    }
+    for (const json& entry : locations) {
+        const json& blockName = Require(entry, "block", what + ".locations");
+        uint32_t blockIndex = plan.blockCount;
+        for (uint32_t b = 0; b < plan.blockCount; b++) {
+            if (blockName.is_string() && plan.blocks[b].name == blockName.get_ref<const std::string&>()) {
+                blockIndex = b;
+            }
+        }
+        if (blockIndex == plan.blockCount) {
+            throw SchemaError(what + ": unknown block " + blockName.dump());
+        }
+
+        // Validation range: the field must sit entirely inside its block
+        const PlanBlock& block = plan.blocks[blockIndex];
+        uint32_t offset = ParseOffset(Require(entry, "offset", what + ".locations"), what + ".offset");
+        if (offset < block.start || (uint64_t)offset + byteSize > (uint64_t)block.start + block.size) {
+            throw SchemaError(what + ": offset " + std::to_string(offset) + " (+" + std::to_string(byteSize) +
+                              " bytes) is outside block \"" + block.name + "\"");
+        }
+
+        PlanLocation& location = field.locations[field.locationCount++];
+        location.block = blockIndex;
+        location.offset = offset;
+        location.dataOffset = block.dataOffset + (offset - block.start);
+        field.blockMask |= 1u << blockIndex;
+    }
+    field.present = true;
+}
+
+// Precompiles one location per field for each named variant
+void CompileVariants(const json& layout, ReadPlan& plan) {
+    plan.variantCount = 1;
+    plan.variants[0].name = "default";
+    if (layout.contains("variants")) {
+        const json& names = layout["variants"];
+        if (!names.is_array() || names.empty() || names.size() > SCHEMA_MAX_LOCATIONS) {
+            throw SchemaError("variants: must list 1 to " + std::to_string(SCHEMA_MAX_LOCATIONS) + " names");
+        }
+        plan.variantCount = (uint32_t)names.size();
+        for (uint32_t v = 0; v < plan.variantCount; v++) {
+            if (!names[v].is_string()) {
+                throw SchemaError("variants: expected names");
+            }
+            plan.variants[v].name = names[v].get<std::string>();
+        }
+    }
+
+    for (int f = 0; f < SCHEMA_FIELD_COUNT; f++) {
+        const PlanField& field = plan.fields[f];
+        if (!field.present) {
+            continue;
+        }
+        if (field.locationCount > 1 && field.locationCount != plan.variantCount) {
+            plan.warnings.push_back(std::string("field \"") + FIELD_NAMES[f] + "\" has " +
+                                    std::to_string(field.locationCount) + " locations for " +
+                                    std::to_string(plan.variantCount) + " variants");
+        }
+        for (uint32_t v = 0; v < plan.variantCount; v++) {
+            uint32_t index = v < field.locationCount ? v : field.locationCount - 1;
+            plan.variants[v].locations[f] = field.locations[index];
+            if (plan.variants[v].locations[f].dataOffset != plan.variants[0].locations[f].dataOffset) {
+                plan.variantFields |= SCHEMA_FIELD_BIT(f);
+                plan.variantBlockMask |= (1u << plan.variants[v].locations[f].block) |
+                                         (1u << plan.variants[0].locations[f].block);
+            }
+        }
+    }
+}
+
+void CompileLayout(const json& layout, const CompileContext& context, ReadPlan& plan) {
+    plan.layout = layout.contains("name") && layout["name"].is_string() ? layout["name"].get<std::string>() : "unnamed";
+    CompileBlocks(layout, context, plan);
+
+    const json& fields = Require(layout, "fields", "layout");
+    if (!fields.is_object()) {
+        throw SchemaError("fields: expected an object");
+    }
+    for (auto it = fields.begin(); it != fields.end(); ++it) {
+        int index = -1;
+        for (int f = 0; f < SCHEMA_FIELD_COUNT; f++) {
+            if (it.key() == FIELD_NAMES[f]) {
+                index = f;
+            }
+        }
+        if (index < 0) {
+            // Newer schemas may describe fields this build does not decode yet
+            plan.warnings.push_back("unknown field \"" + it.key() + "\" ignored");
+            continue;
+        }
+        CompileField(it.key(), it.value(), plan, plan.fields[index]);
+    }
+    for (int f = 0; f < SCHEMA_FIRST_OPTIONAL_FIELD; f++) {
+        if (!plan.fields[f].present) {
+            plan.warnings.push_back(std::string("field \"") + FIELD_NAMES[f] + "\" not described");
+        }
+    }
+    CompileVariants(layout, plan);
+}
+
+// Reads one integer of the field's type at a snapshot position
+int64_t LoadInteger(SchemaFieldType type, const uint8_t* data) {
+    switch (type) {
+        case FIELD_TYPE_U8:
+            return data[0];
+        case FIELD_TYPE_U16: {
+            uint16_t value;
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        case FIELD_TYPE_U32: {
+            uint32_t value;
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        case FIELD_TYPE_I32: {
+            int32_t value;
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        default:
+            return 0;
+    }
+}
+
+}
+
+const char* OffsetSchema::GetFieldName(SchemaField field) {
+    return (field >= 0 && field < SCHEMA_FIELD_COUNT) ? FIELD_NAMES[field] : "?";
+}
+
+const char* OffsetSchema::GetModuleName(SchemaModule module) {
+    return (module >= 0 && module < SCHEMA_MODULE_COUNT) ? MODULE_NAMES[module] : "?";
+}
+
+const char* OffsetSchema::GetTypeName(SchemaFieldType type) {
+    return GetTypeInfo(type).name;
+}
+
+bool OffsetSchema::Compile(const std::string& text, const ModuleFingerprint fingerprints[SCHEMA_MODULE_COUNT],
+                           ReadPlan& plan, std::string& error, SignatureResolver* resolver) {
+    json document = json::parse(text, nullptr, false);
+    if (document.is_discarded() || !document.is_object()) {
+        error = "not a valid JSON object";
+        return false;
+    }
+
+    try {
+        int64_t version = ParseNumber(Require(document, "schemaVersion", "schema"), "schemaVersion");
+        if (version != SCHEMA_VERSION) {
+            throw SchemaError("schemaVersion " + std::to_string(version) + " is not supported (expected " +
+                              std::to_string(SCHEMA_VERSION) + ")");
+        }
+
+        const json& layouts = Require(document, "layouts", "schema");
+        if (!layouts.is_array() || layouts.empty()) {
+            throw SchemaError("layouts: expected a non-empty array");
+        }
+        for (const json& layout : layouts) {
+            if (layout.contains("match") && !MatchesFingerprint(layout["match"], fingerprints)) {
+                continue;
+            }
+            ReadPlan compiled = ReadPlan();
+            CompileLayout(layout, { fingerprints, resolver }, compiled);
+            compiled.id = nextPlanId++;
+            plan = compiled;
+            return true;
+        }
+        throw SchemaError("no layout matches the loaded modules");
+    } catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+}
+
+uint64_t ReadPlan::FieldsInBlocks(uint32_t blockMask) const {
+    uint64_t result = 0;
+    for (int f = 0; f < SCHEMA_FIELD_COUNT; f++) {
+        if (fields[f].blockMask & blockMask) {
+            result |= SCHEMA_FIELD_BIT(f);
+        }
+    }
+    return result;
+}
+
+uint32_t ReadPlan::GetLocations(SchemaField field, int variant, const PlanLocation*& locations) const {
+    if (variant >= 0 && (uint32_t)variant < variantCount) {
+        locations = &variants[variant].locations[field];
+        return 1;
+    }
+    locations = fields[field].locations;
+    return fields[field].locationCount;
+}
+
+bool ReadPlan::Validates(SchemaField field, const PlanLocation& location, const MemorySnapshot& snapshot) const {
+    const PlanField& entry = fields[field];
+    if (!entry.present || snapshot.blockBase[location.block] == 0) {
+        return false;
+    }
+    const uint8_t* data = snapshot.data + location.dataOffset;
+    if (entry.type == FIELD_TYPE_ASCII) {
+        return data[0] >= 0x20 && data[0] < 0x7F;
+    }
+    if (entry.type != FIELD_TYPE_UTF16) {
+        int64_t value = LoadInteger(entry.type, data);
+        return !entry.hasRange || (value >= entry.minValue && value <= entry.maxValue);
+    }
+
+    char16_t units[SNAPSHOT_DATA_SIZE / 2];
+    memcpy(units, data, entry.length * sizeof(char16_t));
+    size_t length = 0;
+    while (length < entry.length && units[length] != u'\0') {
+        if (units[length] < 0x20) {
+            return false;
+        }
+        length++;
+    }
+    if (length == 0) {
+        return false;
+    }
+    for (const std::u16string& value : entry.reject) {
+        if (value.size() == length && std::char_traits<char16_t>::compare(units, value.data(), length) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ReadPlan::DecodeInteger(SchemaField field, const MemorySnapshot& snapshot, int64_t& value, int variant) const {
+    const PlanField& entry = fields[field];
+    value = entry.defaultValue;
+    if (!entry.present || entry.type == FIELD_TYPE_UTF16 || entry.type == FIELD_TYPE_ASCII) {
+        return false;
+    }
+    const PlanLocation* locations;
+    uint32_t count = GetLocations(field, variant, locations);
+    for (uint32_t i = 0; i < count; i++) {
+        const PlanLocation& location = locations[i];
+        if (snapshot.blockBase[location.block] == 0) {
+            continue;
+        }
+        int64_t candidate = LoadInteger(entry.type, snapshot.data + location.dataOffset);
+        if (entry.hasRange && (candidate < entry.minValue || candidate > entry.maxValue)) {
+            continue;
+        }
+        value = candidate;
+        return true;
+    }
+    return false;
+}
+
+size_t ReadPlan::DecodeString16(SchemaField field, const MemorySnapshot& snapshot, char16_t* out, size_t capacity,
+                                int variant) const {
+    const PlanField& entry = fields[field];
+    out[0] = u'\0';
+    if (!entry.present || entry.type != FIELD_TYPE_UTF16 || capacity == 0) {
+        return 0;
+    }
+    size_t maxLength = entry.length < capacity - 1 ? entry.length : capacity - 1;
+
+    const PlanLocation* locations;
+    uint32_t count = GetLocations(field, variant, locations);
+    bool haveFirst = false;
+    for (uint32_t i = 0; i < count; i++) {
+        const PlanLocation& location = locations[i];
+        if (snapshot.blockBase[location.block] == 0) {
+            continue;
+        }
+        char16_t candidate[SNAPSHOT_DATA_SIZE / 2 + 1];
+        memcpy(candidate, snapshot.data + location.dataOffset, maxLength * sizeof(char16_t));
+        candidate[maxLength] = u'\0';
+        size_t length = std::char_traits<char16_t>::length(candidate);
+
+        bool rejected = false;
+        for (const std::u16string& value : entry.reject) {
+            if (value.size() == length && std::char_traits<char16_t>::compare(candidate, value.data(), length) == 0) {
+                rejected = true;
+            }
+        }
+        // A rejected first location is still the answer if nothing better turns up
+        if (!rejected || !haveFirst) {
+            memcpy(out, candidate, (length + 1) * sizeof(char16_t));
+            haveFirst = true;
+        }
+        if (!rejected) {
+            return length;
+        }
+    }
+    return std::char_traits<char16_t>::length(out);
+}
+
+bool ReadPlan::DecodeBytes(SchemaField field, const MemorySnapshot& snapshot, char* out, size_t capacity,
+                           int variant) const {
+    const PlanField& entry = fields[field];
+    memset(out, 0, capacity);
+    if (!entry.present || entry.type != FIELD_TYPE_ASCII) {
+        return false;
+    }
+    const PlanLocation* locations;
+    uint32_t count = GetLocations(field, variant, locations);
+    for (uint32_t i = 0; i < count; i++) {
+        const PlanLocation& location = locations[i];
+        if (snapshot.blockBase[location.block] == 0) {
+            continue;
+        }
+        memcpy(out, snapshot.data + location.dataOffset, entry.length < capacity ? entry.length : capacity);
+        return true;
+    }
+    return false;
+}
+
+static json Hex(uint32_t value) {
+    char text[16];
+    snprintf(text, sizeof(text), "0x%X", value);
+    return text;
+}
+
+static json Location(const char* block, uint32_t offset) {
+    return json{ { "block", block }, { "offset", Hex(offset) } };
+}
+
+// mov ecx, [EfzRevival+global] / mov eax, [ecx+P1_WIN_COUNT_OFFSET]
+static std::string WinCountSignature() {
+    char text[64];
+    snprintf(text, sizeof(text), "8B 0D ?? ?? ?? ?? 8B 81 %02X %02X %02X %02X",
+             P1_WIN_COUNT_OFFSET & 0xFF, (P1_WIN_COUNT_OFFSET >> 8) & 0xFF,
+             (P1_WIN_COUNT_OFFSET >> 16) & 0xFF, (P1_WIN_COUNT_OFFSET >> 24) & 0xFF);
+    return text;
+}
+
+std::string OffsetSchema::BuiltInSchema() {
+    json revivalPointer = { { "signature", WinCountSignature() }, { "operand", 2 }, { "kind", "absolute" },
+                            { "fallback", Hex(WIN_COUNT_BASE_OFFSET) } };
+    json blocks;
+    blocks["revival"] = { { "module", MODULE_NAMES[SCHEMA_MODULE_REVIVAL] },
+                          { "pointer", json::array({ revivalPointer }) },
+                          { "start", Hex(REVIVAL_BLOCK_START) },
+                          { "size", REVIVAL_BLOCK_SIZE } };
+    blocks["p1Character"] = { { "module", MODULE_NAMES[SCHEMA_MODULE_EFZ] },
+                              { "pointer", json::array({ Hex(EFZ_BASE_OFFSET_P1) }) },
+                              { "start", Hex(CHARACTER_NAME_OFFSET) },
+                              { "size", CHARACTER_NAME_FIELD_SIZE } };
+    blocks["p2Character"] = { { "module", MODULE_NAMES[SCHEMA_MODULE_EFZ] },
+                              { "pointer", json::array({ Hex(EFZ_BASE_OFFSET_P2) }) },
+                              { "start", Hex(CHARACTER_NAME_OFFSET) },
+                              { "size", CHARACTER_NAME_FIELD_SIZE } };
+
+    // Player offsets first; spectator mode keeps the same data elsewhere.
+    // Location order matches "variants".
+    json fields;
+    fields["p1.winCount"] = { { "type", "u32" }, { "range", { 0, 99 } }, { "default", 0 },
+                              { "locations", { Location("revival", P1_WIN_COUNT_OFFSET),
+                                               Location("revival", P1_WIN_COUNT_OFFSET_SPECTATOR) } } };
+    fields["p2.winCount"] = { { "type", "u32" }, { "range", { 0, 99 } }, { "default", 0 },
+                              { "locations", { Location("revival", P2_WIN_COUNT_OFFSET),
+                                               Location("revival", P2_WIN_COUNT_OFFSET_SPECTATOR) } } };
+    fields["p1.nickname"] = { { "type", "utf16" }, { "length", MAX_NICKNAME_LENGTH }, { "reject", { "", "Player 1" } },
+                              { "locations", { Location("revival", P1_NICKNAME_OFFSET),
+                                               Location("revival", P1_NICKNAME_OFFSET_SPECTATOR) } } };
+    fields["p2.nickname"] = { { "type", "utf16" }, { "length", MAX_NICKNAME_LENGTH }, { "reject", { "", "Player 2" } },
+                              { "locations", { Location("revival", P2_NICKNAME_OFFSET),
+                                               Location("revival", P2_NICKNAME_OFFSET_SPECTATOR) } } };
+    fields["p1.characterName"] = { { "type", "ascii" }, { "length", CHARACTER_NAME_FIELD_SIZE },
+                                   { "locations", { Location("p1Character", CHARACTER_NAME_OFFSET) } } };
+    fields["p2.characterName"] = { { "type", "ascii" }, { "length", CHARACTER_NAME_FIELD_SIZE },
+                                   { "locations", { Location("p2Character", CHARACTER_NAME_OFFSET) } } };
+
+    json layout;
+    layout["name"] = "EfzRevival (built-in)";
+    layout["variants"] = { "player", "spectator" };
+    layout["blocks"] = blocks;
+    layout["fields"] = fields;
+
+    json document;
+    document["schemaVersion"] = SCHEMA_VERSION;
+    document["layouts"] = json::array({ layout });
+    return document.dump(2);
+}
+
+static const PlanBlock* FindBlock(const ReadPlan& plan, const char* name) {
+    for (uint32_t b = 0; b < plan.blockCount; b++) {
+        if (plan.blocks[b].name == name) {
+            return &plan.blocks[b];
+        }
+    }
+    return nullptr;
+}
+
+static void PutU32(MemorySnapshot& snapshot, const ReadPlan& plan, const char* block, uint32_t offset, uint32_t value) {
+    for (uint32_t b = 0; b < plan.blockCount; b++) {
+        if (plan.blocks[b].name == block) {
+            memcpy(snapshot.data + plan.blocks[b].dataOffset + (offset - plan.blocks[b].start), &value, sizeof(value));
+        }
+    }
+}
+
+static void PutString16(MemorySnapshot& snapshot, const ReadPlan& plan, const char* block, uint32_t offset, const char16_t* text) {
+    for (uint32_t b = 0; b < plan.blockCount; b++) {
+        if (plan.blocks[b].name == block) {
+            memcpy(snapshot.data + plan.blocks[b].dataOffset + (offset - plan.blocks[b].start), text,
+                   (std::char_traits<char16_t>::length(text) + 1) * sizeof(char16_t));
+        }
+    }
+}
+
+bool OffsetSchema::RunSelfTest(std::string& failure) {
+    failure.clear();
+    ModuleFingerprint fingerprints[SCHEMA_MODULE_COUNT] = {
+        { true, 0x3B000000, 0, 0x400000 },
+        { true, 0x5F5E1000, 0x1234, 0x100000 }
+    };
+
+    // Built-in schema: player offsets win, spectator offsets fill in
+    ReadPlan plan;
+    std::string error;
+    if (!Compile(BuiltInSchema(), fingerprints, plan, error)) {
+        failure = "built-in schema: " + error;
+        return false;
+    }
+    if (!plan.warnings.empty()) {
+        failure = "built-in schema warns: " + plan.warnings[0];
+        return false;
+    }
+    const PlanBlock* revival = FindBlock(plan, "revival");
+    if (!revival || revival->scanned || revival->chain[0] != WIN_COUNT_BASE_OFFSET) {
+        failure = "built-in schema without a resolver did not use the fallback";
+        return false;
+    }
+
+    MemorySnapshot snapshot = {};
+    for (uint32_t b = 0; b < plan.blockCount; b++) {
+        snapshot.blockBase[b] = 0x1000;
+    }
+    PutU32(snapshot, plan, "revival", P1_WIN_COUNT_OFFSET, 3);
+    PutU32(snapshot, plan, "revival", P2_WIN_COUNT_OFFSET, 1234);          // Garbage: falls back
+    PutU32(snapshot, plan, "revival", P2_WIN_COUNT_OFFSET_SPECTATOR, 2);
+    PutString16(snapshot, plan, "revival", P1_NICKNAME_OFFSET, u"Player 1");  // Default: falls back
+    PutString16(snapshot, plan, "revival", P1_NICKNAME_OFFSET_SPECTATOR, u"Kiri");
+    PutString16(snapshot, plan, "revival", P2_NICKNAME_OFFSET, u"Ayase");
+
+    int64_t p1Wins = -1, p2Wins = -1;
+    plan.DecodeInteger(SCHEMA_P1_WIN_COUNT, snapshot, p1Wins);
+    plan.DecodeInteger(SCHEMA_P2_WIN_COUNT, snapshot, p2Wins);
+    char16_t p1Name[MAX_NICKNAME_LENGTH + 1], p2Name[MAX_NICKNAME_LENGTH + 1];
+    plan.DecodeString16(SCHEMA_P1_NICKNAME, snapshot, p1Name, MAX_NICKNAME_LENGTH + 1);
+    plan.DecodeString16(SCHEMA_P2_NICKNAME, snapshot, p2Name, MAX_NICKNAME_LENGTH + 1);
+    if (p1Wins != 3 || p2Wins != 2 || std::u16string(p1Name) != u"Kiri" || std::u16string(p2Name) != u"Ayase") {
+        failure = "built-in decode: wins " + std::to_string(p1Wins) + "-" + std::to_string(p2Wins);
+        return false;
+    }
+
+    // A variant reads its own location only
+    uint64_t moving = SCHEMA_FIELD_BIT(SCHEMA_P1_WIN_COUNT) | SCHEMA_FIELD_BIT(SCHEMA_P2_WIN_COUNT) |
+                      SCHEMA_FIELD_BIT(SCHEMA_P1_NICKNAME) | SCHEMA_FIELD_BIT(SCHEMA_P2_NICKNAME);
+    if (plan.variantCount != 2 || plan.variantFields != moving ||
+        !plan.DecodeInteger(SCHEMA_P2_WIN_COUNT, snapshot, p2Wins, 1) || p2Wins != 2 ||
+        plan.DecodeInteger(SCHEMA_P2_WIN_COUNT, snapshot, p2Wins, 0) ||
+        plan.DecodeString16(SCHEMA_P1_NICKNAME, snapshot, p1Name, MAX_NICKNAME_LENGTH + 1, 0) != 8) {
+        failure = "player/spectator variants";
+        return false;
+    }
+
+    // Nothing valid anywhere: integers take the default, strings the first location
+    PutU32(snapshot, plan, "revival", P2_WIN_COUNT_OFFSET_SPECTATOR, 500);
+    PutString16(snapshot, plan, "revival", P1_NICKNAME_OFFSET_SPECTATOR, u"");
+    if (plan.DecodeInteger(SCHEMA_P2_WIN_COUNT, snapshot, p2Wins) || p2Wins != 0) {
+        failure = "out-of-range win count was accepted";
+        return false;
+    }
+    if (plan.DecodeString16(SCHEMA_P1_NICKNAME, snapshot, p1Name, MAX_NICKNAME_LENGTH + 1) != 8) {
+        failure = "rejected nickname did not fall back to the first location";
+        return false;
+    }
+
+    // An unreadable block hides every field in it
+    for (uint32_t b = 0; b < plan.blockCount; b++) {
+        if (plan.blocks[b].name == "revival") {
+            snapshot.blockBase[b] = 0;
+        }
+    }
+    if (plan.DecodeInteger(SCHEMA_P1_WIN_COUNT, snapshot, p1Wins)) {
+        failure = "decoded from an unreadable block";
+        return false;
+    }
+
+    // Layout selection by fingerprint, and rejection of malformed layouts
+    const char* versioned =
+        "{ \"schemaVersion\": 1, \"layouts\": ["
+        "  { \"name\": \"new\", \"match\": { \"EfzRevival.dll\": { \"timestamp\": \"0x5F5E1000\" } },"
+        "    \"blocks\": { \"r\": { \"module\": \"EfzRevival.dll\", \"pointer\": [\"0x10\", 4], \"start\": 0, \"size\": 8 } },"
+        "    \"fields\": { \"p1.winCount\": { \"type\": \"u32\", \"locations\": [ { \"block\": \"r\", \"offset\": 4 } ] },"
+        "                  \"p9.future\": { \"type\": \"u8\", \"locations\": [ { \"block\": \"r\", \"offset\": 0 } ] } } },"
+        "  { \"name\": \"old\","
+        "    \"blocks\": { \"r\": { \"module\": \"efz.exe\", \"pointer\": [\"0x20\"], \"start\": 0, \"size\": 4 } },"
+        "    \"fields\": {} } ] }";
+    if (!Compile(versioned, fingerprints, plan, error) || plan.layout != "new" ||
+        plan.blocks[0].chainLength != 2 || plan.fields[SCHEMA_P1_WIN_COUNT].locations[0].dataOffset != 4) {
+        failure = "fingerprint match: " + (error.empty() ? plan.layout : error);
+        return false;
+    }
+    fingerprints[SCHEMA_MODULE_REVIVAL].timestamp = 0x60000000;
+    if (!Compile(versioned, fingerprints, plan, error) || plan.layout != "old") {
+        failure = "fingerprint fallback: " + (error.empty() ? plan.layout : error);
+        return false;
+    }
+
+    // Signatures: a resolved RVA replaces the fallback, a failed scan keeps it
+    struct TestResolver : SignatureResolver {
+        bool found;
+        bool Resolve(SchemaModule module, const SignatureSpec& spec, uint32_t& rva, std::string& error) override {
+            if (!found || module != SCHEMA_MODULE_REVIVAL || spec.operand != 2 || spec.kind != OPERAND_ABSOLUTE) {
+                error = "not found";
+                return false;
+            }
+            rva = 0xB12CC;
+            return true;
+        }
+    } resolver;
+    resolver.found = true;
+    if (!Compile(BuiltInSchema(), fingerprints, plan, error, &resolver) || !(revival = FindBlock(plan, "revival")) ||
+        !revival->scanned || revival->chain[0] != 0xB12CC || plan.warnings.size() != 1) {
+        failure = "signature resolve: " + error;
+        return false;
+    }
+    resolver.found = false;
+    if (!Compile(BuiltInSchema(), fingerprints, plan, error, &resolver) || !(revival = FindBlock(plan, "revival")) ||
+        revival->scanned || revival->chain[0] != WIN_COUNT_BASE_OFFSET || plan.warnings.size() != 1) {
+        failure = "signature fallback: " + error;
+        return false;
+    }
+    const char* unresolved =
+        "{ \"schemaVersion\": 1, \"layouts\": [ {"
+        "    \"blocks\": { \"r\": { \"module\": \"EfzRevival.dll\", \"start\": 0, \"size\": 4,"
+        "                          \"pointer\": [ { \"signature\": \"A1 ?? ?? ?? ??\", \"operand\": 1 } ] } },"
+        "    \"fields\": {} } ] }";
+    if (Compile(unresolved, fingerprints, plan, error, &resolver)) {
+        failure = "signature without fallback survived a failed scan";
+        return false;
+    }
+
+    const char* outside =
+        "{ \"schemaVersion\": 1, \"layouts\": [ {"
+        "    \"blocks\": { \"r\": { \"module\": \"efz.exe\", \"pointer\": [0], \"start\": 16, \"size\": 8 } },"
+        "    \"fields\": { \"p1.winCount\": { \"type\": \"u32\", \"locations\": [ { \"block\": \"r\", \"offset\": 22 } ] } } } ] }";
+    uint32_t previousId = plan.id;
+    if (Compile(outside, fingerprints, plan, error) || plan.id != previousId) {
+        failure = "field outside its block was accepted";
+        return false;
+    }
+    if (Compile("{ \"schemaVersion\": 2, \"layouts\": [] }", fingerprints, plan, error) ||
+        Compile("{ not json", fingerprints, plan, error)) {
+        failure = "unsupported or malformed document was accepted";
+        return false;
+    }
+
+    return true;
+}
@@ -1,6 +1,10 @@
 #include "../include/overlay_data.h"
 #include "../include/game_data.h"
 #include "../include/logger.h"
+#include "../include/character_table.h"
+#include "../include/match_history.h"
+#include "../include/scoreboard_image.h"
+#include "../include/widget_image.h"
 #include "../include/constants.h" // Ensure constants are included
 #include <string>
 #include <fstream>
@@ -12,6 +16,24 @@ EXTERN_C IMAGE_DOS_HEADER __ImageBase;
 
 std::string OverlayData::outputDirectory = "";
 bool OverlayData::initialized = false;
+uint64_t OverlayData::writtenVersion = 0;
+
+// Statistics files written for each side, prefixed with "p1"/"p2"
+static const char* STATS_FILE_SUFFIXES[] = {
+    "_rating.txt", "_winrate.txt", "_streak.txt", "_main.txt", "_set_time_per_game.txt", "_matchup.txt", "_char_matchup.txt"
+};
+
+// Combo files for each side as the attacker, prefixed with "p1"/"p2"; "-"
+// while the schema does not locate HP
+static const char* COMBO_FILE_SUFFIXES[] = {
+    "_combo.txt", "_combo_damage.txt", "_max_combo.txt", "_max_damage.txt", "_round_damage.txt"
+};
+
+// Netplay telemetry files, "-" while the schema does not locate the field
+static const char* NETPLAY_FILES[] = {
+    "netplay_ping.txt", "netplay_ping_p95.txt", "netplay_delay.txt", "netplay_rollbacks.txt",
+    "netplay_spectators.txt", "netplay_histograms.json"
+};
 
 
 // README file for portraits folder
@@ -19,7 +41,7 @@ const std::string portraitsReadme = R"END_OF_STRING(Place character portrait ima
 
 akane.png, akiko.png, ikumi.png, misaki.png, sayuri.png, kanna.png,
 kaori.png, makoto.png, minagi.png, mio.png, mishio.png, misuzu.png,
-mizuka.png, nagamori.png, nanase.png, exnanase.png, nayuki.png, nayukib.png,
+nagamori.png, nanase.png, exnanase.png, nayuki.png, nayukib.png,
 shiori.png, ayu.png, mai.png, mayu.png, mizukab.png, kano.png, unknown.png
 
 Recommended portrait dimensions: 200x300 pixels
@@ -63,58 +85,80 @@ bool OverlayData::Initialize() {
     return true;
 }
 
-void OverlayData::UpdateFiles() {
-    const GameData& data = GameDataManager::GetCurrentData();
-    static int lastP1CharId = -1;
-    static int lastP2CharId = -1;
+// Copies the portrait for a character over <prefix>_portrait.png
+static void CopyPortrait(const std::filesystem::path& assetsPath, const char* prefix, int characterId) {
+    std::filesystem::path portraitsPath = assetsPath / "portraits";
+    std::string portraitFile = CharacterTable::GetPortrait(characterId);
+    
+    try {
+        std::filesystem::path sourceFile = portraitsPath / portraitFile;
+        if (std::filesystem::exists(sourceFile)) {
+            std::filesystem::copy(sourceFile, assetsPath / (std::string(prefix) + "_portrait.png"),
+                                  std::filesystem::copy_options::overwrite_existing);
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        Logger::Error("Failed to copy " + std::string(prefix) + " portrait: " + std::string(e.what()));
+    }
+}
+
+// Rewrites only the files whose fields changed since the last written
+// version. forceAll rewrites everything (periodic recovery).
+void OverlayData::UpdateFiles(bool forceAll) {
+    GameDelta delta = {};
+    if (!GameDataManager::GetDeltaSince(writtenVersion, delta)) {
+        if (!forceAll) {
+            return;
+        }
+        // Nothing new was published: rewrite the current state as a resync
+        delta.fromVersion = writtenVersion;
+        delta.toVersion = writtenVersion;
+        delta.resync = true;
+        delta.newData = std::make_shared<const GameData>(GameDataManager::GetCurrentData());
+    }
+    if (forceAll) {
+        delta.changedFields = FIELD_ALL;
+    }
+    const GameData& data = *delta.newData;
 
     // Get the absolute path to the assets directory
     std::filesystem::path assetsPath = std::filesystem::absolute(outputDirectory);
 
     // Update text files for nicknames, characters, and wins
-    WriteToFile(assetsPath / "p1_nickname.txt", data.player1.nickname);
-    WriteToFile(assetsPath / "p2_nickname.txt", data.player2.nickname);
-    WriteToFile(assetsPath / "p1_character.txt", data.player1.character);
-    WriteToFile(assetsPath / "p2_character.txt", data.player2.character);
-    WriteToFile(assetsPath / "p1_wins.txt", std::to_string(data.player1.winCount));
-    WriteToFile(assetsPath / "p2_wins.txt", std::to_string(data.player2.winCount));
-
-    // --- Logic for hot-swapping portrait files ---
-    if (data.player1.characterId != lastP1CharId) {
-        std::filesystem::path portraitsPath = assetsPath / "portraits";
-        std::string p1_portrait_file = "unknown.png";
-        if (data.player1.characterId >= 0 && data.player1.characterId <= MAX_CHARACTER_ID) {
-            p1_portrait_file = CHARACTER_PORTRAITS[data.player1.characterId];
-        }
-        
-        try {
-            std::filesystem::path sourceFile = portraitsPath / p1_portrait_file;
-            if (std::filesystem::exists(sourceFile)) {
-                std::filesystem::copy(sourceFile, assetsPath / "p1_portrait.png", std::filesystem::copy_options::overwrite_existing);
-            }
-            lastP1CharId = data.player1.characterId;
-        } catch (const std::filesystem::filesystem_error& e) {
-            Logger::Error("Failed to copy P1 portrait: " + std::string(e.what()));
-        }
+    if (delta.Has(FIELD_P1_NICKNAME)) WriteToFile(assetsPath / "p1_nickname.txt", data.player1.nickname.str());
+    if (delta.Has(FIELD_P2_NICKNAME)) WriteToFile(assetsPath / "p2_nickname.txt", data.player2.nickname.str());
+    if (delta.Has(FIELD_P1_CHARACTER)) WriteToFile(assetsPath / "p1_character.txt", data.player1.character.str());
+    if (delta.Has(FIELD_P2_CHARACTER)) WriteToFile(assetsPath / "p2_character.txt", data.player2.character.str());
+    if (delta.Has(FIELD_P1_WINS)) WriteToFile(assetsPath / "p1_wins.txt", std::to_string(data.player1.winCount));
+    if (delta.Has(FIELD_P2_WINS)) WriteToFile(assetsPath / "p2_wins.txt", std::to_string(data.player2.winCount));
+
+    // Lifetime head-to-head record between the current players (changes with either name or a recorded set)
+    if (delta.Has(FIELD_P1_NICKNAME | FIELD_P2_NICKNAME | FIELD_P1_STATS | FIELD_P2_STATS)) {
+        HeadToHeadRecord h2h = MatchHistory::GetHeadToHead(data.player1.nickname.str(), data.player2.nickname.str());
+        WriteToFile(assetsPath / "h2h_record.txt", std::to_string(h2h.firstWins) + " - " + std::to_string(h2h.secondWins));
     }
 
-    if (data.player2.characterId != lastP2CharId) {
-        std::filesystem::path portraitsPath = assetsPath / "portraits";
-        std::string p2_portrait_file = "unknown.png";
-        if (data.player2.characterId >= 0 && data.player2.characterId <= MAX_CHARACTER_ID) {
-            p2_portrait_file = CHARACTER_PORTRAITS[data.player2.characterId];
-        }
-        
-        try {
-            std::filesystem::path sourceFile = portraitsPath / p2_portrait_file;
-            if (std::filesystem::exists(sourceFile)) {
-                std::filesystem::copy(sourceFile, assetsPath / "p2_portrait.png", std::filesystem::copy_options::overwrite_existing);
-            }
-            lastP2CharId = data.player2.characterId;
-        } catch (const std::filesystem::filesystem_error& e) {
-            Logger::Error("Failed to copy P2 portrait: " + std::string(e.what()));
-        }
+    // Per-player statistics, refreshed by the data manager when a set ends
+    if (delta.Has(FIELD_P1_STATS)) WritePlayerStatsFiles(assetsPath, "p1", data.player1);
+    if (delta.Has(FIELD_P2_STATS)) WritePlayerStatsFiles(assetsPath, "p2", data.player2);
+
+    // Connection health for casters; histograms for correlating stutter with spikes
+    if (delta.Has(FIELD_NETPLAY)) WriteNetplayFiles(assetsPath, data.netplay);
+
+    // Combo counter shows the combo in progress, then keeps the last one up
+    if (delta.Has(FIELD_COMBO)) {
+        WriteComboFiles(assetsPath, "p1", data.combo, 0);
+        WriteComboFiles(assetsPath, "p2", data.combo, 1);
     }
+
+    // --- Hot-swap portrait files ---
+    if (delta.Has(FIELD_P1_CHARACTER)) CopyPortrait(assetsPath, "p1", data.player1.characterId);
+    if (delta.Has(FIELD_P2_CHARACTER)) CopyPortrait(assetsPath, "p2", data.player2.characterId);
+
+    // The same change as one composited image
+    ScoreboardImage::Update(data, delta.changedFields);
+    WidgetImage::Update(data, delta.changedFields);
+
+    writtenVersion = delta.toVersion;
 }
 
 void OverlayData::Shutdown() {
@@ -130,10 +174,23 @@ void OverlayData::Shutdown() {
                 "p1_nickname.txt", "p2_nickname.txt",
                 "p1_character.txt", "p2_character.txt",
                 "p1_wins.txt", "p2_wins.txt",
+                "h2h_record.txt",
                 "p1_portrait.png", "p2_portrait.png"
             };
+            std::vector<std::string> allFiles = filesToDelete;
+            for (const char* name : NETPLAY_FILES) {
+                allFiles.push_back(name);
+            }
+            for (const char* prefix : { "p1", "p2" }) {
+                for (const char* suffix : STATS_FILE_SUFFIXES) {
+                    allFiles.push_back(std::string(prefix) + suffix);
+                }
+                for (const char* suffix : COMBO_FILE_SUFFIXES) {
+                    allFiles.push_back(std::string(prefix) + suffix);
+                }
+            }
 
-            for (const auto& filename : filesToDelete) {
+            for (const auto& filename : allFiles) {
                 std::filesystem::path filePath = std::filesystem::path(outputDirectory) / filename;
                 if (std::filesystem::exists(filePath)) {
                     std::filesystem::remove(filePath);
@@ -159,6 +216,12 @@ void OverlayData::ResetData() {
     WriteToFile(assetsDir / "p2_character.txt", "Unknown");
     WriteToFile(assetsDir / "p1_wins.txt", "0");
     WriteToFile(assetsDir / "p2_wins.txt", "0");
+    WriteToFile(assetsDir / "h2h_record.txt", "0 - 0");
+    WritePlayerStatsFiles(assetsDir, "p1", PlayerData());
+    WritePlayerStatsFiles(assetsDir, "p2", PlayerData());
+    WriteNetplayFiles(assetsDir, GameDataManager::GetNetplayTelemetry().GetStats());
+    WriteComboFiles(assetsDir, "p1", ComboStats(), 0);
+    WriteComboFiles(assetsDir, "p2", ComboStats(), 1);
     
     // Create placeholder portrait files by copying unknown.png if it exists
     // (Assuming unknown.png is provided by the user in the portraits folder)
@@ -190,3 +253,48 @@ bool OverlayData::WriteToFile(const std::filesystem::path& filePath, const std::
         return false;
     }
 }
+
+void OverlayData::WritePlayerStatsFiles(const std::filesystem::path& dir, const std::string& prefix, const PlayerData& player) {
+    const PlayerSummary& stats = player.stats;
+    std::string mainCharacter = "-";
+    if (stats.mostPlayedCharacterId >= 0 && stats.mostPlayedCharacterId <= MAX_CHARACTER_ID) {
+        mainCharacter = CharacterTable::GetDisplayName(stats.mostPlayedCharacterId);
+    }
+
+    WriteToFile(dir / (prefix + "_rating.txt"), player.rating.rating < 0 ? "-" : std::to_string(player.rating.rating));
+    WriteToFile(dir / (prefix + "_winrate.txt"), PlayerStats::FormatWinRate(stats.winRate));
+    WriteToFile(dir / (prefix + "_streak.txt"), PlayerStats::FormatStreak(stats.streak));
+    WriteToFile(dir / (prefix + "_main.txt"), mainCharacter);
+    WriteToFile(dir / (prefix + "_set_time_per_game.txt"), PlayerStats::FormatDuration(stats.setTimePerGameMs));
+    WriteToFile(dir / (prefix + "_matchup.txt"), PlayerStats::FormatWinRate(stats.matchupWinRate));
+    WriteToFile(dir / (prefix + "_char_matchup.txt"), PlayerStats::FormatWinRate(stats.characterMatchupWinRate));
+}
+
+void OverlayData::WriteComboFiles(const std::filesystem::path& dir, const std::string& prefix, const ComboStats& combo,
+                                  int side) {
+    const ComboSide& attacker = combo.side[side];
+    bool inProgress = attacker.hits > 0;
+    auto orDash = [&combo](int64_t value, const char* unit) {
+        return combo.available ? std::to_string(value) + unit : std::string("-");
+    };
+    WriteToFile(dir / (prefix + COMBO_FILE_SUFFIXES[0]), orDash(inProgress ? attacker.hits : attacker.lastHits, " hits"));
+    WriteToFile(dir / (prefix + COMBO_FILE_SUFFIXES[1]), orDash(inProgress ? attacker.damage : attacker.lastDamage, ""));
+    WriteToFile(dir / (prefix + COMBO_FILE_SUFFIXES[2]), orDash(attacker.maxHits, " hits"));
+    WriteToFile(dir / (prefix + COMBO_FILE_SUFFIXES[3]), orDash(attacker.maxDamage, ""));
+    WriteToFile(dir / (prefix + COMBO_FILE_SUFFIXES[4]), orDash(attacker.roundDamage, ""));
+}
+
+void OverlayData::WriteNetplayFiles(const std::filesystem::path& dir, const NetplayStats& netplay) {
+    auto orDash = [](int value, const char* unit) {
+        return value < 0 ? std::string("-") : std::to_string(value) + unit;
+    };
+    char rate[32];
+    snprintf(rate, sizeof(rate), "%.1f/s", netplay.rollbacksPerSecond);
+
+    WriteToFile(dir / NETPLAY_FILES[0], orDash(netplay.pingMs, " ms"));
+    WriteToFile(dir / NETPLAY_FILES[1], orDash(netplay.pingP95Ms, " ms"));
+    WriteToFile(dir / NETPLAY_FILES[2], orDash(netplay.delayFrames, "f"));
+    WriteToFile(dir / NETPLAY_FILES[3], netplay.rollbacksPerSecond < 0.0f ? std::string("-") : std::string(rate));
+    WriteToFile(dir / NETPLAY_FILES[4], orDash(netplay.spectators, ""));
+    WriteToFile(dir / NETPLAY_FILES[5], GameDataManager::GetNetplayTelemetry().HistogramsToJSON());
+}
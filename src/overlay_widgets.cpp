@@ -0,0 +1,416 @@
+#include "../include/overlay_widgets.h"
+#include "imgui/imgui.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+
+std::mutex OverlayWidgets::contextLock;
+
+static const ImU32 COLOR_PANEL = IM_COL32(20, 26, 36, 208);
+static const ImU32 COLOR_FRAME = IM_COL32(10, 12, 18, 230);
+static const ImU32 COLOR_TEXT = IM_COL32(255, 255, 255, 255);
+static const ImU32 COLOR_DIM = IM_COL32(176, 184, 200, 255);
+static const ImU32 COLOR_GOLD = IM_COL32(255, 208, 112, 255);
+static const ImU32 COLOR_TRAIL = IM_COL32(230, 60, 50, 255);
+static const float MARGIN = 8.0f;
+static const float TRAIL_HOLD_RATE = 0.5f;     // Of a full bar per second
+
+static double ElapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+OverlayWidgets::OverlayWidgets() = default;
+
+OverlayWidgets::~OverlayWidgets() {
+    if (context) {
+        std::lock_guard<std::mutex> lock(contextLock);
+        ImGui::DestroyContext(context);
+    }
+}
+
+bool OverlayWidgets::Initialize(const Config& newConfig, std::string& error) {
+    config = newConfig;
+    maxHp = std::max(config.maxHp, (int32_t)1);
+    if (config.width <= 0 || config.height <= 0 || config.width > 4096 || config.height > 4096) {
+        error = "size out of range";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(contextLock);
+    ImGuiContext* previous = ImGui::GetCurrentContext();
+    context = ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.LogFilename = nullptr;
+    io.BackendRendererName = "efz_cpu_rasterizer";
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+    io.DisplaySize = ImVec2((float)config.width, (float)config.height);
+
+    // Two sizes rasterized once into the atlas; the data stays ours
+    for (float size : {config.fontSize, config.fontSize * 2.0f}) {
+        ImFontConfig fontConfig;
+        fontConfig.SizePixels = size;
+        fontConfig.FontDataOwnedByAtlas = false;
+        ImFont* added = config.font.empty()
+                            ? io.Fonts->AddFontDefault(&fontConfig)
+                            : io.Fonts->AddFontFromMemoryTTF(config.font.data(), (int)config.font.size(), size,
+                                                             &fontConfig);
+        if (!font) {
+            font = added;
+        } else {
+            largeFont = added;
+        }
+    }
+    unsigned char* pixels = nullptr;
+    int atlasWidth = 0, atlasHeight = 0;
+    if (!font || !largeFont || !io.Fonts->Build()) {
+        error = "font could not be loaded";
+    } else {
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &atlasWidth, &atlasHeight);
+    }
+    if (pixels) {
+        atlas.Resize(atlasWidth, atlasHeight);
+        const uint8_t* rgba = pixels;
+        for (int y = 0; y < atlasHeight; y++) {
+            uint32_t* row = atlas.Row(y);
+            for (int x = 0; x < atlasWidth; x++, rgba += 4) {
+                row[x] = Canvas::Premultiply((uint32_t)rgba[3] << 24 | (uint32_t)rgba[0] << 16 |
+                                             (uint32_t)rgba[1] << 8 | rgba[2]);
+            }
+        }
+        io.Fonts->SetTexID((ImTextureID)DrawListRasterizer::TextureId(&atlas));
+        io.Fonts->ClearTexData();
+    }
+    ImGui::SetCurrentContext(previous);
+    return pixels != nullptr;
+}
+
+// "H:MM:SS", or "MM:SS" in the first hour
+static void FormatClock(double seconds, char* text, size_t size) {
+    int total = seconds > 0 ? (int)seconds : 0;
+    if (total >= 3600) {
+        snprintf(text, size, "%d:%02d:%02d", total / 3600, total / 60 % 60, total % 60);
+    } else {
+        snprintf(text, size, "%02d:%02d", total / 60, total % 60);
+    }
+}
+
+// Text at x aligned left (0), centred (0.5) or right (1)
+static void AddAlignedText(ImDrawList* draw, ImFont* font, float x, float y, float align, ImU32 color,
+                           const char* text) {
+    float width = font->CalcTextSizeA(font->FontSize, FLT_MAX, 0.0f, text).x;
+    draw->AddText(font, font->FontSize, ImVec2(std::floor(x - width * align), y), color, text);
+}
+
+void OverlayWidgets::Build(const WidgetState& state, double time) {
+    ImGuiIO& io = ImGui::GetIO();
+    io.DeltaTime = (float)std::max(time - lastTime, 1e-4);
+    lastTime = time;
+    ImGui::NewFrame();
+    ImDrawList* draw = ImGui::GetBackgroundDrawList();
+
+    const float width = (float)config.width, height = (float)config.height;
+    const float size = font->FontSize, large = largeFont->FontSize;
+    const float center = std::floor(width * 0.5f);
+    const float boxHalf = std::floor(size * 2.8f);
+    const float barTop = MARGIN, barHeight = std::floor(size * 1.1f);
+    const float tickerHeight = state.ticker.empty() ? 0.0f : size + 8.0f;
+    char text[96];
+
+    // Clock and round between the bars
+    float boxBottom = barTop + large + size + 6.0f;
+    draw->AddRectFilled(ImVec2(center - boxHalf, barTop - 2.0f), ImVec2(center + boxHalf, boxBottom), COLOR_PANEL,
+                        6.0f);
+    draw->AddRect(ImVec2(center - boxHalf, barTop - 2.0f), ImVec2(center + boxHalf, boxBottom), COLOR_FRAME, 6.0f, 0,
+                  2.0f);
+    FormatClock(state.clockSeconds, text, sizeof(text));
+    AddAlignedText(draw, largeFont, center, barTop, 0.5f, COLOR_TEXT, text);
+    if (state.round > 0) {
+        snprintf(text, sizeof(text), "ROUND %u", state.round);
+        AddAlignedText(draw, font, center, barTop + large, 0.5f, COLOR_DIM, text);
+    }
+
+    float dt = io.DeltaTime;
+    for (int side = 0; side < 2; side++) {
+        // Player 1 on the left; both bars are anchored at the centre
+        float outer = side == 0 ? MARGIN : width - MARGIN;
+        float inner = side == 0 ? center - boxHalf - MARGIN : center + boxHalf + MARGIN;
+        float direction = side == 0 ? -1.0f : 1.0f;
+        float length = std::fabs(inner - outer);
+        ImVec2 barMin(std::min(inner, outer), barTop), barMax(std::max(inner, outer), barTop + barHeight);
+        draw->AddRectFilled(ImVec2(barMin.x - 2.0f, barMin.y - 2.0f), ImVec2(barMax.x + 2.0f, barMax.y + 2.0f),
+                            COLOR_FRAME, 4.0f);
+        draw->AddRectFilled(barMin, barMax, COLOR_PANEL, 3.0f);
+
+        int32_t hp = state.hp[side];
+        if (hp >= 0) {
+            maxHp = std::max(maxHp, hp);
+            // The trail jumps up with the bar and drains after it falls
+            float& shown = trail[side];
+            shown = shown < (float)hp ? (float)hp : std::max((float)hp, shown - TRAIL_HOLD_RATE * maxHp * dt);
+            float fill = length * (float)hp / (float)maxHp;
+            float trailFill = length * shown / (float)maxHp;
+            auto span = [&](float amount) {
+                float end = inner + direction * amount;
+                return std::make_pair(ImVec2(std::min(inner, end), barMin.y), ImVec2(std::max(inner, end), barMax.y));
+            };
+            if (trailFill > fill) {
+                auto trailSpan = span(trailFill);
+                draw->AddRectFilled(trailSpan.first, trailSpan.second, COLOR_TRAIL);
+            }
+            if (fill >= 1.0f) {
+                bool low = hp * 4 < maxHp;
+                ImU32 bright = low ? IM_COL32(255, 90, 60, 255) : IM_COL32(255, 226, 80, 255);
+                ImU32 deep = low ? IM_COL32(190, 30, 20, 255) : IM_COL32(236, 140, 20, 255);
+                auto fillSpan = span(fill);
+                draw->AddRectFilledMultiColor(fillSpan.first, fillSpan.second, side == 0 ? deep : bright,
+                                              side == 0 ? bright : deep, side == 0 ? bright : deep,
+                                              side == 0 ? deep : bright);
+            }
+        }
+        draw->AddRect(ImVec2(barMin.x - 1.0f, barMin.y - 1.0f), ImVec2(barMax.x + 1.0f, barMax.y + 1.0f),
+                      IM_COL32(255, 255, 255, 60), 3.0f);
+
+        // Nickname and rating under the bar, win pips beside the clock
+        float nameY = barMax.y + 6.0f;
+        float align = side == 0 ? 0.0f : 1.0f;
+        const char* nickname = state.nickname[side].empty() ? (side == 0 ? "Player 1" : "Player 2")
+                                                             : state.nickname[side].c_str();
+        AddAlignedText(draw, font, outer, nameY, align, COLOR_TEXT, nickname);
+        if (state.rating[side] >= 0) {
+            float nameWidth = font->CalcTextSizeA(size, FLT_MAX, 0.0f, nickname).x;
+            snprintf(text, sizeof(text), "%d", state.rating[side]);
+            AddAlignedText(draw, font, outer - direction * (nameWidth + size * 0.6f), nameY, align, COLOR_GOLD, text);
+        }
+        int pips = std::max(state.wins[side], 3);
+        float radius = std::floor(size * 0.3f);
+        for (int pip = 0; pip < pips && pip < 9; pip++) {
+            ImVec2 at(inner + direction * (radius + 2.0f + (float)pip * (radius * 2.0f + 5.0f)),
+                      nameY + size * 0.5f);
+            if (pip < state.wins[side]) {
+                draw->AddCircleFilled(at, radius, COLOR_GOLD);
+            }
+            draw->AddCircle(at, radius, IM_COL32(255, 255, 255, 140), 0, 1.5f);
+        }
+
+        // The combo in progress, or the best of the match
+        float comboY = nameY + size + 6.0f;
+        if (state.comboHits[side] >= 2) {
+            snprintf(text, sizeof(text), "%u HITS", state.comboHits[side]);
+            AddAlignedText(draw, largeFont, outer, comboY, align, IM_COL32(255, 160, 40, 255), text);
+            snprintf(text, sizeof(text), "%d damage", state.comboDamage[side]);
+            AddAlignedText(draw, font, outer, comboY + large, align, COLOR_TEXT, text);
+        } else if (state.bestHits[side] > 0 || state.roundDamage[side] > 0) {
+            snprintf(text, sizeof(text), "Best %u hits  Round %d", state.bestHits[side], state.roundDamage[side]);
+            AddAlignedText(draw, font, outer, comboY, align, COLOR_DIM, text);
+        }
+    }
+
+    // Ping meter under the clock
+    if (state.pingMs >= 0) {
+        ImU32 color = state.pingMs < 60    ? IM_COL32(90, 220, 110, 255)
+                      : state.pingMs < 120 ? IM_COL32(250, 210, 70, 255)
+                                           : IM_COL32(240, 80, 60, 255);
+        int lit = state.pingMs < 60 ? 4 : state.pingMs < 120 ? 3 : state.pingMs < 200 ? 2 : 1;
+        float baseY = boxBottom + size + 4.0f;
+        float barWidth = std::floor(size * 0.25f);
+        float x = center - boxHalf + 6.0f;
+        for (int bar = 0; bar < 4; bar++) {
+            float barTopY = baseY - (float)(bar + 1) * size * 0.22f;
+            draw->AddRectFilled(ImVec2(x, barTopY), ImVec2(x + barWidth, baseY),
+                                bar < lit ? color : IM_COL32(255, 255, 255, 50), 1.0f);
+            x += barWidth + 2.0f;
+        }
+        snprintf(text, sizeof(text), "%d ms", state.pingMs);
+        AddAlignedText(draw, font, center + boxHalf - 6.0f, baseY - size, 1.0f, COLOR_DIM, text);
+    }
+
+    // Ticker: the text repeated end to end, moving left
+    if (tickerHeight > 0.0f) {
+        ImVec2 stripMin(0.0f, height - tickerHeight), stripMax(width, height);
+        draw->AddRectFilled(stripMin, stripMax, COLOR_PANEL);
+        draw->AddLine(stripMin, ImVec2(width, stripMin.y), IM_COL32(255, 208, 112, 160), 2.0f);
+        const char* separator = "   /   ";
+        float textWidth = font->CalcTextSizeA(size, FLT_MAX, 0.0f, state.ticker.c_str()).x +
+                          font->CalcTextSizeA(size, FLT_MAX, 0.0f, separator).x;
+        float offset = (float)std::fmod(time * config.tickerSpeed, (double)textWidth);
+        draw->PushClipRect(stripMin, stripMax);
+        for (float x = std::floor(-offset); x < width; x += textWidth) {
+            ImVec2 at(x, stripMin.y + 4.0f);
+            draw->AddText(font, size, at, COLOR_TEXT, state.ticker.c_str());
+            at.x += font->CalcTextSizeA(size, FLT_MAX, 0.0f, state.ticker.c_str()).x;
+            draw->AddText(font, size, at, COLOR_GOLD, separator);
+        }
+        draw->PopClipRect();
+    }
+    ImGui::Render();
+}
+
+CanvasRect OverlayWidgets::Render(const WidgetState& state, double time) {
+    if (!context) {
+        return CanvasRect();
+    }
+    auto start = std::chrono::steady_clock::now();
+    const ImDrawData* data;
+    {
+        std::lock_guard<std::mutex> lock(contextLock);
+        ImGuiContext* previous = ImGui::GetCurrentContext();
+        ImGui::SetCurrentContext(context);
+        Build(state, time);
+        data = ImGui::GetDrawData();
+        ImGui::SetCurrentContext(previous);
+    }
+    // The draw data stays valid until this context's next frame
+    stats.lastBuildUs = ElapsedUs(start);
+    stats.vertices = data->TotalVtxCount;
+    stats.indices = data->TotalIdxCount;
+
+    start = std::chrono::steady_clock::now();
+    CanvasRect changed = rasterizer.Render(data, canvas);
+    stats.lastRasterUs = ElapsedUs(start);
+    stats.frames++;
+    stats.changedFrames += changed.Empty() ? 0 : 1;
+    return changed;
+}
+
+OverlayWidgets::Stats OverlayWidgets::GetStats() const {
+    Stats result = stats;
+    result.raster = rasterizer.GetStats();
+    return result;
+}
+
+WidgetState OverlayWidgets::SampleState() {
+    WidgetState state;
+    state.nickname[0] = "Kaori";
+    state.nickname[1] = "Mizuka_Rev";
+    state.wins[0] = 2;
+    state.wins[1] = 1;
+    state.rating[0] = 1684;
+    state.rating[1] = 1532;
+    state.hp[0] = 6420;
+    state.hp[1] = 2310;
+    state.comboHits[0] = 14;
+    state.comboDamage[0] = 3480;
+    state.comboHits[1] = 0;
+    state.comboDamage[1] = 0;
+    state.bestHits[0] = 21;
+    state.bestHits[1] = 9;
+    state.roundDamage[0] = 7690;
+    state.roundDamage[1] = 3580;
+    state.round = 4;
+    state.pingMs = 48;
+    state.clockSeconds = 5025.0;
+    state.ticker = "Kaori vs Mizuka_Rev  Head-to-head 7 - 5  Best combo 21 hits  Ping 48 ms  First to 3";
+    return state;
+}
+
+bool OverlayWidgets::RunSelfTest(std::string& failure) {
+    failure.clear();
+    if (!DrawListRasterizer::RunSelfTest(failure)) {
+        return false;
+    }
+    OverlayWidgets widgets;
+    Config config;
+    if (!widgets.Initialize(config, failure)) {
+        failure = "initialize: " + failure;
+        return false;
+    }
+    WidgetState state = SampleState();
+    const Canvas& canvas = widgets.GetCanvas();
+    CanvasRect all = {0, 0, config.width, config.height};
+    if (!(widgets.Render(state, 1.0) == all)) {
+        failure = "first frame did not cover the canvas";
+        return false;
+    }
+    int drawn = 0;
+    for (int y = 0; y < canvas.GetHeight(); y++) {
+        for (int x = 0; x < canvas.GetWidth(); x++) {
+            drawn += canvas.Row(y)[x] != 0;
+        }
+    }
+    if (drawn < canvas.GetWidth() * canvas.GetHeight() / 8) {
+        failure = "first frame is nearly empty";
+        return false;
+    }
+    if (!widgets.Render(state, 1.0).Empty()) {
+        failure = "an identical frame reported a change";
+        return false;
+    }
+
+    // Only the ticker moves with time
+    int tickerTop = config.height - (int)(config.fontSize + 8.0f);
+    CanvasRect moved = widgets.Render(state, 1.5);
+    if (moved.Empty() || moved.y0 < tickerTop - 1) {
+        failure = "ticker: the change was missing or reached above the strip";
+        return false;
+    }
+    // A hit shortens player 2's bar: the top rows change, the ticker does not
+    state.hp[1] -= 1000;
+    CanvasRect hit = widgets.Render(state, 1.5);
+    if (hit.Empty() || hit.y0 > (int)MARGIN || hit.y1 > tickerTop) {
+        failure = "health bar: the change was missing or in the wrong place";
+        return false;
+    }
+    return true;
+}
+
+OverlayWidgets::BenchmarkResult OverlayWidgets::RunBenchmark(const Config& config, int rounds) {
+    BenchmarkResult result = {};
+    result.level = DrawListRasterizer::GetSimdLevel();
+    OverlayWidgets widgets;
+    std::string error;
+    if (!widgets.Initialize(config, error)) {
+        return result;
+    }
+    WidgetState state = SampleState();
+    widgets.Render(state, 1.0);
+    result.vertices = widgets.stats.vertices;
+    result.triangles = widgets.stats.indices / 3;
+
+    auto best = [rounds](double& slot, auto&& body) {
+        slot = 1e30;
+        for (int round = 0; round < rounds; round++) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            slot = std::min(slot, ElapsedUs(start));
+        }
+    };
+    // Building the same frame again; the last build's draw data is what
+    // the raster rounds replay
+    best(result.buildUs, [&]() {
+        std::lock_guard<std::mutex> lock(contextLock);
+        ImGuiContext* previous = ImGui::GetCurrentContext();
+        ImGui::SetCurrentContext(widgets.context);
+        widgets.Build(state, 1.0);
+        ImGui::SetCurrentContext(previous);
+    });
+    const ImDrawData* data;
+    {
+        std::lock_guard<std::mutex> lock(contextLock);
+        ImGuiContext* previous = ImGui::GetCurrentContext();
+        ImGui::SetCurrentContext(widgets.context);
+        data = ImGui::GetDrawData();
+        ImGui::SetCurrentContext(previous);
+    }
+
+    DrawListRasterizer rasterizer;
+    Canvas target;
+    rasterizer.Render(data, target);
+    uint64_t entries = rasterizer.GetStats().binEntries;
+    best(result.rasterUs, [&]() { rasterizer.Render(data, target); });
+    result.binEntries = rasterizer.GetStats().binEntries - entries;
+    result.binEntries /= (uint64_t)std::max(rounds, 1);
+    best(result.firstFrameUs, [&]() {
+        Canvas empty;
+        rasterizer.Render(data, empty);
+    });
+    bool wasScalar = std::string(DrawListRasterizer::GetSimdLevel()) == "scalar";
+    DrawListRasterizer::ForceScalar(true);
+    best(result.scalarUs, [&]() { rasterizer.Render(data, target); });
+    DrawListRasterizer::ForceScalar(wasScalar);
+    rasterizer.SetBinning(false);
+    best(result.unbinnedUs, [&]() { rasterizer.Render(data, target); });
+    return result;
+}
@@ -0,0 +1,156 @@
+#include "../include/player_stats.h"
+#include "../include/logger.h"
+#include <cstring>
+
+std::mutex PlayerStats::mutex;
+std::vector<PlayerStatsRow> PlayerStats::players;
+CharacterStatsRow PlayerStats::characters[STATS_CHARACTER_COUNT] = {};
+
+void PlayerStats::Initialize() {
+    std::lock_guard<std::mutex> lock(mutex);
+    players.clear();
+    memset(characters, 0, sizeof(characters));
+
+    // One pass over the stored history; afterwards every set is applied incrementally
+    MatchHistory::ForEachMatch([](const MatchRecord& record, uint32_t p1Id, uint32_t p2Id) {
+        Accumulate(record, (int)p1Id, (int)p2Id);
+    });
+
+    Logger::Info("Player statistics built for " + std::to_string(players.size()) + " players");
+}
+
+void PlayerStats::Shutdown() {
+    std::lock_guard<std::mutex> lock(mutex);
+    players.clear();
+}
+
+void PlayerStats::RecordSet(const MatchRecord& record) {
+    int p1Id = MatchHistory::FindPlayerId(record.p1Nickname);
+    int p2Id = MatchHistory::FindPlayerId(record.p2Nickname);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Accumulate(record, p1Id, p2Id);
+}
+
+void PlayerStats::Accumulate(const MatchRecord& record, int p1Id, int p2Id) {
+    int p1Result = (record.p1Score > record.p2Score) ? 1 : (record.p1Score < record.p2Score ? -1 : 0);
+
+    AccumulateSide(p1Id, record.p1CharacterId, record.p2CharacterId, p1Result, record);
+    if (p2Id != p1Id) {
+        AccumulateSide(p2Id, record.p2CharacterId, record.p1CharacterId, -p1Result, record);
+    }
+
+    // Character rows are tracked once per side, mirror matches included
+    int c1 = record.p1CharacterId;
+    int c2 = record.p2CharacterId;
+    if (c1 >= 0 && c1 < STATS_CHARACTER_COUNT && c2 >= 0 && c2 < STATS_CHARACTER_COUNT) {
+        characters[c1].sets++;
+        characters[c1].matchupSets[c2]++;
+        characters[c2].sets++;
+        characters[c2].matchupSets[c1]++;
+        if (p1Result > 0) {
+            characters[c1].wins++;
+            characters[c1].matchupWins[c2]++;
+        } else if (p1Result < 0) {
+            characters[c2].wins++;
+            characters[c2].matchupWins[c1]++;
+        }
+    }
+}
+
+void PlayerStats::AccumulateSide(int playerId, int characterId, int opponentCharacterId,
+                                 int result, const MatchRecord& record) {
+    if (playerId < 0) {
+        return;
+    }
+    if ((size_t)playerId >= players.size()) {
+        PlayerStatsRow empty = {};
+        empty.mostPlayedCharacterId = -1;
+        players.resize(playerId + 1, empty);
+    }
+
+    PlayerStatsRow& row = players[playerId];
+    row.sets++;
+    row.games += record.p1Score + record.p2Score;
+    row.durationMs += record.durationMs;
+
+    if (result > 0) {
+        row.wins++;
+        row.streak = row.streak > 0 ? row.streak + 1 : 1;
+    } else if (result < 0) {
+        row.losses++;
+        row.streak = row.streak < 0 ? row.streak - 1 : -1;
+    } else {
+        row.streak = 0;
+    }
+
+    if (characterId >= 0 && characterId < STATS_CHARACTER_COUNT) {
+        row.characterSets[characterId]++;
+        if (row.mostPlayedCharacterId < 0 ||
+            row.characterSets[characterId] > row.characterSets[row.mostPlayedCharacterId]) {
+            row.mostPlayedCharacterId = characterId;
+        }
+    }
+
+    if (opponentCharacterId >= 0 && opponentCharacterId < STATS_CHARACTER_COUNT) {
+        row.matchupSets[opponentCharacterId]++;
+        if (result > 0) {
+            row.matchupWins[opponentCharacterId]++;
+        }
+    }
+}
+
+int PlayerStats::Percent(uint32_t wins, uint32_t total) {
+    return total > 0 ? (int)((wins * 100 + total / 2) / total) : -1;
+}
+
+PlayerSummary PlayerStats::GetSummary(const std::string& nickname, int characterId, int opponentCharacterId) {
+    PlayerSummary summary;
+    int playerId = MatchHistory::FindPlayerId(nickname);
+    bool validMatchup = (characterId >= 0 && characterId < STATS_CHARACTER_COUNT &&
+                         opponentCharacterId >= 0 && opponentCharacterId < STATS_CHARACTER_COUNT);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (validMatchup) {
+        const CharacterStatsRow& character = characters[characterId];
+        summary.characterMatchupWinRate = Percent(character.matchupWins[opponentCharacterId],
+                                                  character.matchupSets[opponentCharacterId]);
+    }
+
+    if (playerId < 0 || (size_t)playerId >= players.size()) {
+        return summary;
+    }
+
+    const PlayerStatsRow& row = players[playerId];
+    summary.sets = (int)row.sets;
+    summary.wins = (int)row.wins;
+    summary.losses = (int)row.losses;
+    summary.winRate = Percent(row.wins, row.sets);
+    summary.streak = row.streak;
+    summary.mostPlayedCharacterId = row.mostPlayedCharacterId;
+    summary.setTimePerGameMs = row.games > 0 ? (DWORD)(row.durationMs / row.games) : 0;
+    if (validMatchup) {
+        summary.matchupWinRate = Percent(row.matchupWins[opponentCharacterId], row.matchupSets[opponentCharacterId]);
+    }
+    return summary;
+}
+
+std::string PlayerStats::FormatWinRate(int winRate) {
+    return winRate < 0 ? "-" : std::to_string(winRate) + "%";
+}
+
+std::string PlayerStats::FormatStreak(int streak) {
+    if (streak > 0) return "W" + std::to_string(streak);
+    if (streak < 0) return "L" + std::to_string(-streak);
+    return "-";
+}
+
+std::string PlayerStats::FormatDuration(DWORD ms) {
+    if (ms == 0) {
+        return "-";
+    }
+    DWORD seconds = ms / 1000;
+    std::string secs = std::to_string(seconds % 60);
+    return std::to_string(seconds / 60) + ":" + (secs.size() < 2 ? "0" + secs : secs);
+}
@@ -0,0 +1,862 @@
+#include "../include/png_writer.h"
+#include <chrono>
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define EFZ_PNG_SSE2 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+bool PngWriter::forceScalar = false;
+
+static const int HASH_BITS = 14;
+static const int WINDOW = 32768;
+static const int MAX_MATCH = 258;
+static const uint32_t ADLER_BASE = 65521;
+static const size_t ADLER_NMAX = 5552;     // Largest run before s2 can overflow 32 bits
+
+// Tables built on first use: CRC-32 (slice by 8), round(c * 255 / a), and
+// the fixed Huffman codes bit-reversed for an LSB-first writer
+struct PngTables {
+    uint32_t crc[8][256];
+    uint8_t unpremultiply[256][256];
+    float reciprocal[256];                  // 1 / alpha, 0 for 0
+    uint16_t literalCode[288];
+    uint8_t literalBits[288];
+    uint32_t lengthCode[MAX_MATCH + 1];     // Code and extra bits, packed in write order
+    uint8_t lengthBits[MAX_MATCH + 1];
+    uint8_t distanceSymbol[512];            // By distance - 1 below 256, else 256 + ((distance - 1) >> 7)
+    uint8_t distanceCode[30];
+
+    PngTables();
+};
+
+static const uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                         31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                         2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DISTANCE_BASE[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                           193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                           6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static uint32_t Reverse(uint32_t code, int bits) {
+    uint32_t result = 0;
+    for (int i = 0; i < bits; i++) {
+        result = result << 1 | ((code >> i) & 1);
+    }
+    return result;
+}
+
+PngTables::PngTables() {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc[0][n] = c;
+    }
+    for (int n = 0; n < 256; n++) {
+        for (int slice = 1; slice < 8; slice++) {
+            crc[slice][n] = crc[0][crc[slice - 1][n] & 0xFF] ^ (crc[slice - 1][n] >> 8);
+        }
+    }
+
+    for (uint32_t alpha = 0; alpha < 256; alpha++) {
+        reciprocal[alpha] = alpha ? 1.0f / (float)alpha : 0.0f;
+        for (uint32_t c = 0; c < 256; c++) {
+            uint32_t value = alpha ? (c * 255 + alpha / 2) / alpha : 0;
+            unpremultiply[alpha][c] = (uint8_t)(value > 255 ? 255 : value);
+        }
+    }
+
+    // RFC 1951 3.2.6
+    for (int symbol = 0; symbol < 288; symbol++) {
+        int bits = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+        uint32_t code = symbol < 144   ? 0x30 + symbol
+                        : symbol < 256 ? 0x190 + (symbol - 144)
+                        : symbol < 280 ? (uint32_t)(symbol - 256)
+                                       : 0xC0 + (symbol - 280);
+        literalCode[symbol] = (uint16_t)Reverse(code, bits);
+        literalBits[symbol] = (uint8_t)bits;
+    }
+    for (int length = 3, code = 0; length <= MAX_MATCH; length++) {
+        while (code < 28 && length >= LENGTH_BASE[code + 1]) {
+            code++;
+        }
+        int symbol = 257 + code;
+        lengthCode[length] = literalCode[symbol] | (uint32_t)(length - LENGTH_BASE[code]) << literalBits[symbol];
+        lengthBits[length] = (uint8_t)(literalBits[symbol] + LENGTH_EXTRA[code]);
+    }
+    for (int code = 0; code < 30; code++) {
+        distanceCode[code] = (uint8_t)Reverse(code, 5);
+        for (int distance = DISTANCE_BASE[code]; distance < (code < 29 ? DISTANCE_BASE[code + 1] : WINDOW + 1);
+             distance++) {
+            int index = distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7);
+            distanceSymbol[index] = (uint8_t)code;
+        }
+    }
+}
+
+static const PngTables& Tables() {
+    static const PngTables tables;
+    return tables;
+}
+
+static uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size) {
+    const PngTables& tables = Tables();
+    crc = ~crc;
+    while (size >= 8) {
+        crc ^= (uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+        crc = tables.crc[7][crc & 0xFF] ^ tables.crc[6][(crc >> 8) & 0xFF] ^ tables.crc[5][(crc >> 16) & 0xFF] ^
+              tables.crc[4][crc >> 24] ^ tables.crc[3][data[4]] ^ tables.crc[2][data[5]] ^ tables.crc[1][data[6]] ^
+              tables.crc[0][data[7]];
+        data += 8;
+        size -= 8;
+    }
+    while (size--) {
+        crc = tables.crc[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint32_t Adler32Scalar(const uint8_t* data, size_t size) {
+    uint32_t s1 = 1, s2 = 0;
+    while (size > 0) {
+        size_t chunk = size < ADLER_NMAX ? size : ADLER_NMAX;
+        size -= chunk;
+        while (chunk--) {
+            s1 += *data++;
+            s2 += s1;
+        }
+        s1 %= ADLER_BASE;
+        s2 %= ADLER_BASE;
+    }
+    return s2 << 16 | s1;
+}
+
+#ifdef EFZ_PNG_SSE2
+// Sixteen bytes per step: s1 gains the byte sum, s2 gains 16 * s1 plus the
+// bytes weighted 16..1, so only the sums need carrying between blocks
+static uint32_t Adler32Sse2(const uint8_t* data, size_t size) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weightsLow = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+    const __m128i weightsHigh = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+    uint32_t s1 = 1, s2 = 0;
+    while (size >= 16) {
+        size_t blocks = (size < ADLER_NMAX ? size : ADLER_NMAX) / 16;
+        size -= blocks * 16;
+        // 64 bits: 16 * prefix alone can pass 2^32 on a full run
+        uint64_t high = s2 + (uint64_t)s1 * (blocks * 16);
+        __m128i sums = zero, prefix = zero, weighted = zero;
+        for (size_t i = 0; i < blocks; i++, data += 16) {
+            __m128i bytes = _mm_loadu_si128((const __m128i*)data);
+            prefix = _mm_add_epi32(prefix, sums);
+            sums = _mm_add_epi32(sums, _mm_sad_epu8(bytes, zero));
+            weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), weightsLow));
+            weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), weightsHigh));
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, sums);
+        s1 = (s1 + lanes[0] + lanes[2]) % ADLER_BASE;
+        _mm_storeu_si128((__m128i*)lanes, prefix);
+        high += ((uint64_t)lanes[0] + lanes[2]) * 16;
+        _mm_storeu_si128((__m128i*)lanes, weighted);
+        high += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        s2 = (uint32_t)(high % ADLER_BASE);
+    }
+    while (size--) {
+        s1 += *data++;
+        s2 += s1;
+    }
+    return (s2 % ADLER_BASE) << 16 | (s1 % ADLER_BASE);
+}
+#endif
+
+static uint32_t Adler32(const uint8_t* data, size_t size, bool scalar) {
+#ifdef EFZ_PNG_SSE2
+    if (!scalar) {
+        return Adler32Sse2(data, size);
+    }
+#endif
+    (void)scalar;
+    return Adler32Scalar(data, size);
+}
+
+static inline void PutBigEndian(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+static inline uint32_t Load32(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, 4);
+    return value;
+}
+
+static inline unsigned LowestBit(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+// How many bytes from a and b agree, up to limit; a may overlap b
+static inline size_t MatchLength(const uint8_t* a, const uint8_t* b, size_t limit, bool scalar) {
+    size_t length = 0;
+#ifdef EFZ_PNG_SSE2
+    if (!scalar) {
+        for (; length + 16 <= limit; length += 16) {
+            __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + length)),
+                                           _mm_loadu_si128((const __m128i*)(b + length)));
+            uint32_t differ = (uint32_t)_mm_movemask_epi8(equal) ^ 0xFFFF;
+            if (differ) {
+                return length + LowestBit(differ);
+            }
+        }
+    }
+#endif
+    (void)scalar;
+    while (length < limit && a[length] == b[length]) {
+        length++;
+    }
+    return length;
+}
+
+// LSB-first bit packer for the deflate stream; never more than 31 bits at once
+struct BitWriter {
+    uint8_t* out;
+    uint64_t bits;
+    int count;
+
+    void Put(uint32_t value, int length) {
+        bits |= (uint64_t)value << count;
+        count += length;
+        if (count >= 32) {
+            out[0] = (uint8_t)bits;
+            out[1] = (uint8_t)(bits >> 8);
+            out[2] = (uint8_t)(bits >> 16);
+            out[3] = (uint8_t)(bits >> 24);
+            out += 4;
+            bits >>= 32;
+            count -= 32;
+        }
+    }
+    void Literal(const PngTables& tables, uint8_t value) { Put(tables.literalCode[value], tables.literalBits[value]); }
+    void Match(const PngTables& tables, int length, int distance) {
+        Put(tables.lengthCode[length], tables.lengthBits[length]);
+        int symbol = tables.distanceSymbol[distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)];
+        Put(tables.distanceCode[symbol] | (uint32_t)(distance - DISTANCE_BASE[symbol]) << 5, 5 + DISTANCE_EXTRA[symbol]);
+    }
+    uint8_t* Finish() {
+        while (count > 0) {
+            *out++ = (uint8_t)bits;
+            bits >>= 8;
+            count -= 8;
+        }
+        return out;
+    }
+};
+
+// Straight RGBA bytes of one premultiplied row. The SSE2 path multiplies by
+// 1/a in float: for c <= a the product is within 2^-14 of
+// (c * 255 + a / 2) / a, far closer than the 1/255 between neighbouring
+// fractions, so truncating it plus a small bias gives the table's answer.
+static void UnpremultiplyRow(const uint32_t* source, int width, uint8_t* out, bool scalar) {
+    const PngTables& tables = Tables();
+    int x = 0;
+#ifdef EFZ_PNG_SSE2
+    if (!scalar) {
+        const __m128i low = _mm_set1_epi32(0xFF);
+        const __m128 scale = _mm_set1_ps(255.0f);
+        const __m128 bias = _mm_set1_ps(1.0f / 1024.0f);
+        const __m128 ceiling = _mm_set1_ps(255.0f);
+        const __m128i alphaMask = _mm_set1_epi32((int)0xFF000000);
+        const __m128i greenAlpha = _mm_set1_epi32((int)0xFF00FF00);
+        for (; x + 4 <= width; x += 4) {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(source + x));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(pixels, alphaMask), alphaMask)) == 0xFFFF) {
+                // Opaque: only swap the bytes either side of green
+                __m128i swapped = _mm_or_si128(_mm_and_si128(pixels, greenAlpha),
+                                               _mm_or_si128(_mm_and_si128(_mm_srli_epi32(pixels, 16), low),
+                                                            _mm_slli_epi32(_mm_and_si128(pixels, low), 16)));
+                _mm_storeu_si128((__m128i*)(out + x * 4), swapped);
+                continue;
+            }
+            // 1/0 is 0 in the table, which clears transparent pixels too
+            __m128 reciprocal = _mm_setr_ps(tables.reciprocal[source[x] >> 24], tables.reciprocal[source[x + 1] >> 24],
+                                            tables.reciprocal[source[x + 2] >> 24], tables.reciprocal[source[x + 3] >> 24]);
+            __m128i alpha = _mm_srli_epi32(pixels, 24);
+            __m128 half = _mm_cvtepi32_ps(_mm_srli_epi32(alpha, 1));
+            __m128i rgba = _mm_slli_epi32(alpha, 24);
+            for (int channel = 0; channel < 3; channel++) {
+                // R, G, B land in bytes 0, 1, 2
+                __m128i value = _mm_and_si128(_mm_srli_epi32(pixels, 16 - channel * 8), low);
+                __m128 numerator = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(value), scale), half);
+                __m128 quotient = _mm_min_ps(_mm_add_ps(_mm_mul_ps(numerator, reciprocal), bias), ceiling);
+                rgba = _mm_or_si128(rgba, _mm_slli_epi32(_mm_cvttps_epi32(quotient), channel * 8));
+            }
+            _mm_storeu_si128((__m128i*)(out + x * 4), rgba);
+        }
+    }
+#endif
+    (void)scalar;
+    for (; x < width; x++) {
+        uint32_t pixel = source[x];
+        const uint8_t* divide = tables.unpremultiply[pixel >> 24];
+        uint8_t* rgba = out + x * 4;
+        rgba[0] = divide[(pixel >> 16) & 0xFF];
+        rgba[1] = divide[(pixel >> 8) & 0xFF];
+        rgba[2] = divide[pixel & 0xFF];
+        rgba[3] = (uint8_t)(pixel >> 24);
+    }
+}
+
+// Up into up, Sub into sub; returns the residual cost of each, as the sum
+// of |residual| read as signed bytes
+static void FilterRow(const uint8_t* current, const uint8_t* previous, size_t size, uint8_t* up, uint8_t* sub,
+                      uint32_t& upCost, uint32_t& subCost, bool scalar) {
+    size_t i = 0;
+    upCost = 0;
+    subCost = 0;
+    // First pixel: Sub has no left neighbour
+    for (; i < 4 && i < size; i++) {
+        up[i] = (uint8_t)(current[i] - previous[i]);
+        sub[i] = current[i];
+        upCost += up[i] < 128 ? up[i] : 256 - up[i];
+        subCost += sub[i] < 128 ? sub[i] : 256 - sub[i];
+    }
+#ifdef EFZ_PNG_SSE2
+    if (!scalar) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i upSum = zero, subSum = zero;
+        for (; i + 16 <= size; i += 16) {
+            __m128i bytes = _mm_loadu_si128((const __m128i*)(current + i));
+            __m128i upResidual = _mm_sub_epi8(bytes, _mm_loadu_si128((const __m128i*)(previous + i)));
+            __m128i subResidual = _mm_sub_epi8(bytes, _mm_loadu_si128((const __m128i*)(current + i - 4)));
+            _mm_storeu_si128((__m128i*)(up + i), upResidual);
+            _mm_storeu_si128((__m128i*)(sub + i), subResidual);
+            upSum = _mm_add_epi32(upSum, _mm_sad_epu8(_mm_min_epu8(upResidual, _mm_sub_epi8(zero, upResidual)), zero));
+            subSum = _mm_add_epi32(subSum,
+                                   _mm_sad_epu8(_mm_min_epu8(subResidual, _mm_sub_epi8(zero, subResidual)), zero));
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, upSum);
+        upCost += lanes[0] + lanes[2];
+        _mm_storeu_si128((__m128i*)lanes, subSum);
+        subCost += lanes[0] + lanes[2];
+    }
+#endif
+    (void)scalar;
+    for (; i < size; i++) {
+        up[i] = (uint8_t)(current[i] - previous[i]);
+        sub[i] = (uint8_t)(current[i] - current[i - 4]);
+        upCost += up[i] < 128 ? up[i] : 256 - up[i];
+        subCost += sub[i] < 128 ? sub[i] : 256 - sub[i];
+    }
+}
+
+void PngWriter::Filter(const Canvas& image) {
+    int width = image.GetWidth(), height = image.GetHeight();
+    size_t rowBytes = (size_t)width * 4;
+    filtered.resize((rowBytes + 1) * height);
+    for (std::vector<uint8_t>& row : rows) {
+        row.resize(rowBytes);
+    }
+    memset(rows[0].data(), 0, rowBytes);
+
+    bool scalar = forceScalar;
+    uint8_t* previous = rows[0].data();
+    uint8_t* current = rows[1].data();
+    for (int y = 0; y < height; y++) {
+        UnpremultiplyRow(image.Row(y), width, current, scalar);
+        uint8_t* out = filtered.data() + (rowBytes + 1) * y;
+        uint32_t upCost, subCost;
+        FilterRow(current, previous, rowBytes, out + 1, rows[2].data(), upCost, subCost, scalar);
+        out[0] = 2;     // Up; also what None would be on the first row
+        if (subCost < upCost) {
+            out[0] = 1;
+            memcpy(out + 1, rows[2].data(), rowBytes);
+        }
+        uint8_t* swap = previous;
+        previous = current;
+        current = swap;
+    }
+}
+
+// zlib stream of data into out, which has room for the worst case
+size_t PngWriter::Deflate(const uint8_t* data, size_t size, Mode mode, uint8_t* out) {
+    const PngTables& tables = Tables();
+    uint8_t* start = out;
+    *out++ = 0x78;      // 32K window, deflate
+    *out++ = 0x01;      // Fastest, no dictionary
+
+    if (mode == STORED) {
+        size_t position = 0;
+        do {
+            size_t block = size - position < 65535 ? size - position : 65535;
+            *out++ = position + block == size ? 1 : 0;
+            out[0] = (uint8_t)block;
+            out[1] = (uint8_t)(block >> 8);
+            out[2] = (uint8_t)~block;
+            out[3] = (uint8_t)(~block >> 8);
+            memcpy(out + 4, data + position, block);
+            out += 4 + block;
+            position += block;
+        } while (position < size);
+    } else {
+        // One final block with the fixed codes
+        BitWriter writer = {out, 0, 0};
+        writer.Put(1 | 1 << 1, 3);
+        size_t i = 0;
+        bool scalar = forceScalar;
+        if (mode == RLE) {
+            // Runs of the previous byte are matches at distance 1
+            while (i < size) {
+                size_t limit = size - i < (size_t)MAX_MATCH ? size - i : (size_t)MAX_MATCH;
+                size_t run = 0;
+                if (i > 0 && limit >= 3 && data[i] == data[i - 1] && data[i + 1] == data[i - 1] &&
+                    data[i + 2] == data[i - 1]) {
+                    run = 3 + MatchLength(data + i + 2, data + i + 3, limit - 3, scalar);
+                }
+                if (run >= 3) {
+                    writer.Match(tables, (int)run, 1);
+                    i += run;
+                } else {
+                    writer.Literal(tables, data[i++]);
+                }
+            }
+        } else {
+            hashTable.assign((size_t)1 << HASH_BITS, -WINDOW - 1);
+            int32_t* table = hashTable.data();
+            while (i + 4 <= size) {
+                uint32_t word = Load32(data + i);
+                uint32_t hash = (word * 2654435761u) >> (32 - HASH_BITS);
+                int32_t candidate = table[hash];
+                table[hash] = (int32_t)i;
+                if ((int32_t)i - candidate <= WINDOW && Load32(data + candidate) == word) {
+                    size_t limit = size - i < (size_t)MAX_MATCH ? size - i : (size_t)MAX_MATCH;
+                    size_t length = 4 + MatchLength(data + candidate + 4, data + i + 4, limit - 4, scalar);
+                    writer.Match(tables, (int)length, (int)(i - candidate));
+                    i += length;
+                } else {
+                    writer.Literal(tables, data[i++]);
+                }
+            }
+            while (i < size) {
+                writer.Literal(tables, data[i++]);
+            }
+        }
+        writer.Put(tables.literalCode[256], tables.literalBits[256]);
+        out = writer.Finish();
+    }
+
+    PutBigEndian(out, Adler32(data, size, forceScalar));
+    return (size_t)(out + 4 - start);
+}
+
+const std::vector<uint8_t>& PngWriter::Encode(const Canvas& image, Mode mode) {
+    static const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    Filter(image);
+
+    // Worst cases: 9 bits a byte with fixed codes, 5 bytes per stored block
+    size_t size = filtered.size();
+    output.resize(8 + 25 + 12 + 2 + size + size / 8 + 5 * (size / 65535 + 1) + 16 + 12);
+    uint8_t* out = output.data();
+    memcpy(out, SIGNATURE, 8);
+
+    uint8_t* header = out + 8;
+    PutBigEndian(header, 13);
+    memcpy(header + 4, "IHDR", 4);
+    PutBigEndian(header + 8, (uint32_t)image.GetWidth());
+    PutBigEndian(header + 12, (uint32_t)image.GetHeight());
+    header[16] = 8;     // Bits per channel
+    header[17] = 6;     // RGBA
+    header[18] = 0;
+    header[19] = 0;
+    header[20] = 0;
+    PutBigEndian(header + 21, Crc32(0, header + 4, 17));
+
+    uint8_t* data = header + 25;
+    size_t length = Deflate(filtered.data(), size, mode, data + 8);
+    PutBigEndian(data, (uint32_t)length);
+    memcpy(data + 4, "IDAT", 4);
+    PutBigEndian(data + 8 + length, Crc32(0, data + 4, length + 4));
+
+    uint8_t* end = data + 12 + length;
+    PutBigEndian(end, 0);
+    memcpy(end + 4, "IEND", 4);
+    PutBigEndian(end + 8, Crc32(0, end + 4, 4));
+    output.resize((size_t)(end + 12 - output.data()));
+    return output;
+}
+
+const char* PngWriter::GetModeName(Mode mode) {
+    switch (mode) {
+        case STORED: return "stored";
+        case RLE: return "rle";
+        case FAST: return "fast";
+        default: return "?";
+    }
+}
+
+bool PngWriter::ParseMode(const std::string& name, Mode& mode) {
+    for (int candidate = 0; candidate < MODE_COUNT; candidate++) {
+        if (name == GetModeName((Mode)candidate)) {
+            mode = (Mode)candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* PngWriter::GetSimdLevel() {
+#ifdef EFZ_PNG_SSE2
+    return forceScalar ? "scalar" : "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+// Enough of inflate to read back what Deflate writes: stored and fixed blocks
+class FixedInflater {
+public:
+    FixedInflater(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    bool Run(std::vector<uint8_t>& out) {
+        bool last = false;
+        while (!last) {
+            last = Bits(1) != 0;
+            uint32_t type = Bits(2);
+            if (type == 0) {
+                bitCount = 0;   // Back to a byte boundary
+                uint32_t length = Bits(16);
+                if ((Bits(16) ^ 0xFFFF) != length || position + length > size) {
+                    return false;
+                }
+                out.insert(out.end(), data + position, data + position + length);
+                position += length;
+            } else if (type != 1 || !Fixed(out)) {
+                return false;
+            }
+            if (overrun) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t Consumed() const { return position; }
+
+private:
+    uint32_t Bits(int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++) {
+            if (bitCount == 0) {
+                if (position >= size) {
+                    overrun = true;
+                    return 0;
+                }
+                current = data[position++];
+                bitCount = 8;
+            }
+            value |= (uint32_t)(current & 1) << i;
+            current >>= 1;
+            bitCount--;
+        }
+        return value;
+    }
+
+    // Huffman codes arrive most significant bit first
+    int Symbol() {
+        uint32_t code = 0;
+        for (int length = 1; length <= 9 && !overrun; length++) {
+            code = code << 1 | Bits(1);
+            if (length == 7 && code <= 23) return 256 + (int)code;
+            if (length == 8 && code >= 48 && code <= 191) return (int)code - 48;
+            if (length == 8 && code >= 192 && code <= 199) return 280 + (int)code - 192;
+            if (length == 9 && code >= 400) return 144 + (int)code - 400;
+        }
+        return -1;
+    }
+
+    bool Fixed(std::vector<uint8_t>& out) {
+        for (;;) {
+            int symbol = Symbol();
+            if (symbol < 0 || symbol > 285) {
+                return false;
+            }
+            if (symbol < 256) {
+                out.push_back((uint8_t)symbol);
+                continue;
+            }
+            if (symbol == 256) {
+                return true;
+            }
+            int length = LENGTH_BASE[symbol - 257] + (int)Bits(LENGTH_EXTRA[symbol - 257]);
+            uint32_t distanceCode = Reverse(Bits(5), 5);
+            if (distanceCode >= 30) {
+                return false;
+            }
+            size_t distance = DISTANCE_BASE[distanceCode] + Bits(DISTANCE_EXTRA[distanceCode]);
+            if (distance > out.size() || distance > (size_t)WINDOW) {
+                return false;
+            }
+            for (int i = 0; i < length; i++) {
+                out.push_back(out[out.size() - distance]);
+            }
+        }
+    }
+
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;
+    uint32_t current = 0;
+    int bitCount = 0;
+    bool overrun = false;
+};
+
+static uint32_t ReadBigEndian(const uint8_t* data) {
+    return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3];
+}
+
+static uint32_t BitwiseCrc32(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) {
+            crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+// Straight RGBA pixels of a PNG as Encode writes it; empty error on success
+static std::vector<uint8_t> DecodePng(const std::vector<uint8_t>& png, int& width, int& height, std::string& error) {
+    std::vector<uint8_t> pixels, stream, inflated;
+    if (png.size() < 8 || memcmp(png.data(), "\x89PNG\r\n\x1A\n", 8) != 0) {
+        error = "signature";
+        return pixels;
+    }
+    bool ended = false;
+    for (size_t position = 8; position < png.size() && !ended;) {
+        if (position + 12 > png.size()) {
+            error = "truncated chunk";
+            return pixels;
+        }
+        uint32_t length = ReadBigEndian(png.data() + position);
+        if (position + 12 + length > png.size()) {
+            error = "chunk length";
+            return pixels;
+        }
+        const uint8_t* type = png.data() + position + 4;
+        const uint8_t* body = type + 4;
+        if (BitwiseCrc32(type, length + 4) != ReadBigEndian(body + length)) {
+            error = "CRC of " + std::string((const char*)type, 4);
+            return pixels;
+        }
+        if (memcmp(type, "IHDR", 4) == 0) {
+            width = (int)ReadBigEndian(body);
+            height = (int)ReadBigEndian(body + 4);
+            if (length != 13 || body[8] != 8 || body[9] != 6 || body[10] || body[11] || body[12]) {
+                error = "IHDR";
+                return pixels;
+            }
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            stream.insert(stream.end(), body, body + length);
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            ended = true;
+        }
+        position += 12 + length;
+    }
+    if (!ended || stream.size() < 6 || (stream[0] * 256 + stream[1]) % 31 != 0 || (stream[0] & 0x0F) != 8) {
+        error = "zlib header or IEND";
+        return pixels;
+    }
+    FixedInflater inflater(stream.data() + 2, stream.size() - 6);
+    size_t rowBytes = (size_t)width * 4;
+    if (!inflater.Run(inflated) || inflated.size() != (rowBytes + 1) * height) {
+        error = "inflate";
+        return pixels;
+    }
+    if (Adler32Scalar(inflated.data(), inflated.size()) != ReadBigEndian(stream.data() + stream.size() - 4)) {
+        error = "Adler-32";
+        return pixels;
+    }
+
+    pixels.assign(rowBytes * height, 0);
+    for (int y = 0; y < height; y++) {
+        const uint8_t* in = inflated.data() + (rowBytes + 1) * y;
+        uint8_t* row = pixels.data() + rowBytes * y;
+        const uint8_t* above = y > 0 ? row - rowBytes : nullptr;
+        for (size_t i = 0; i < rowBytes; i++) {
+            int left = i >= 4 ? row[i - 4] : 0;
+            int up = above ? above[i] : 0;
+            int corner = above && i >= 4 ? above[i - 4] : 0;
+            int predictor;
+            switch (in[0]) {
+                case 0: predictor = 0; break;
+                case 1: predictor = left; break;
+                case 2: predictor = up; break;
+                case 3: predictor = (left + up) / 2; break;
+                case 4: {
+                    int p = left + up - corner;
+                    int pa = p > left ? p - left : left - p;
+                    int pb = p > up ? p - up : up - p;
+                    int pc = p > corner ? p - corner : corner - p;
+                    predictor = pa <= pb && pa <= pc ? left : pb <= pc ? up : corner;
+                    break;
+                }
+                default:
+                    error = "filter type";
+                    pixels.clear();
+                    return pixels;
+            }
+            row[i] = (uint8_t)(in[1 + i] + predictor);
+        }
+    }
+    return pixels;
+}
+
+static uint32_t NextRandom(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state;
+}
+
+bool PngWriter::RunSelfTest(std::string& failure) {
+    failure.clear();
+    bool wasScalar = forceScalar;
+
+    // Noise (both paths of every loop, stored blocks past 64 KB), flat
+    // colour (runs longer than a match), a translucent panel with a bar,
+    // and sizes that leave SIMD tails
+    struct Case {
+        const char* name;
+        int width, height;
+        int kind;
+    };
+    const Case cases[] = {
+        {"1x1", 1, 1, 0}, {"noise", 37, 9, 0}, {"large noise", 150, 120, 0}, {"flat", 300, 200, 1},
+        {"panel", 61, 40, 2}, {"opaque", 17, 3, 3},
+    };
+    uint32_t state = 777;
+    PngWriter writer;
+    for (const Case& test : cases) {
+        Canvas image(test.width, test.height);
+        for (int y = 0; y < test.height; y++) {
+            for (int x = 0; x < test.width; x++) {
+                uint32_t random = NextRandom(state);
+                uint32_t argb = test.kind == 0   ? random
+                                : test.kind == 1 ? 0xFF2040C0u
+                                : test.kind == 2 ? (x > 20 && x < 30 ? 0xFFFFD070u : 0xD0141A24u)
+                                                 : (random | 0xFF000000u);
+                // Noise keeps some exactly clear and opaque pixels
+                if (test.kind == 0 && (random & 0x700) == 0) {
+                    argb = random & 0x800 ? argb | 0xFF000000u : 0;
+                }
+                image.Row(y)[x] = Canvas::Premultiply(argb);
+            }
+        }
+
+        std::vector<uint8_t> reference;
+        for (int mode = 0; mode < MODE_COUNT; mode++) {
+            std::vector<uint8_t> results[2];
+            for (int pass = 0; pass < 2; pass++) {
+                forceScalar = pass == 1;
+                results[pass] = writer.Encode(image, (Mode)mode);
+            }
+            forceScalar = wasScalar;
+            std::string where = std::string(test.name) + ", " + GetModeName((Mode)mode);
+            if (results[0] != results[1]) {
+                failure = where + ": SIMD and scalar output differ";
+                return false;
+            }
+            int width = 0, height = 0;
+            std::string error;
+            std::vector<uint8_t> pixels = DecodePng(results[0], width, height, error);
+            if (!error.empty() || width != test.width || height != test.height) {
+                failure = where + ": does not decode (" + (error.empty() ? "size" : error) + ")";
+                return false;
+            }
+            // Straight alpha that premultiplies back to the canvas
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    const uint8_t* rgba = pixels.data() + ((size_t)y * width + x) * 4;
+                    uint32_t argb = (uint32_t)rgba[3] << 24 | (uint32_t)rgba[0] << 16 | (uint32_t)rgba[1] << 8 | rgba[2];
+                    if (Canvas::Premultiply(argb) != image.Row(y)[x]) {
+                        failure = where + ": pixel " + std::to_string(x) + "," + std::to_string(y) + " changed";
+                        return false;
+                    }
+                }
+            }
+            if (mode == 0) {
+                reference = pixels;
+            } else if (pixels != reference) {
+                failure = where + ": pixels differ from stored mode";
+                return false;
+            }
+        }
+    }
+
+    // Adler-32 over sizes around the SIMD block and the overflow bound
+    std::vector<uint8_t> bytes(ADLER_NMAX * 3 + 37, 0xFF);
+    for (size_t size : {(size_t)0, (size_t)15, (size_t)16, (size_t)17, ADLER_NMAX, ADLER_NMAX + 16, bytes.size()}) {
+        if (Adler32(bytes.data(), size, false) != Adler32Scalar(bytes.data(), size)) {
+            failure = "Adler-32 of " + std::to_string(size) + " bytes";
+            return false;
+        }
+    }
+    if (Adler32Scalar((const uint8_t*)"Wikipedia", 9) != 0x11E60398 ||
+        Crc32(0, (const uint8_t*)"123456789", 9) != 0xCBF43926) {
+        failure = "checksum check values";
+        return false;
+    }
+    return true;
+}
+
+PngWriter::BenchmarkResult PngWriter::RunBenchmark(const Canvas& image, int rounds) {
+    BenchmarkResult result = {};
+    result.level = GetSimdLevel();
+    result.rawBytes = (size_t)image.GetWidth() * image.GetHeight() * 4;
+    result.rawUs = 1e30;
+    result.scalarUs = 1e30;
+    for (double& us : result.encodeUs) {
+        us = 1e30;
+    }
+    bool wasScalar = forceScalar;
+    PngWriter writer;
+    std::vector<uint8_t> raw(result.rawBytes);
+    for (int round = 0; round < rounds; round++) {
+        auto start = std::chrono::steady_clock::now();
+        if (!raw.empty()) {
+            memcpy(raw.data(), image.Row(0), raw.size());
+        }
+        auto end = std::chrono::steady_clock::now();
+        double us = std::chrono::duration<double, std::micro>(end - start).count();
+        result.rawUs = us < result.rawUs ? us : result.rawUs;
+
+        for (int mode = 0; mode <= MODE_COUNT; mode++) {
+            // One extra pass: FAST without SIMD
+            forceScalar = mode == MODE_COUNT;
+            start = std::chrono::steady_clock::now();
+            size_t bytes = writer.Encode(image, mode == MODE_COUNT ? FAST : (Mode)mode).size();
+            end = std::chrono::steady_clock::now();
+            us = std::chrono::duration<double, std::micro>(end - start).count();
+            double& best = mode == MODE_COUNT ? result.scalarUs : result.encodeUs[mode];
+            best = us < best ? us : best;
+            if (mode < MODE_COUNT) {
+                result.encodeBytes[mode] = bytes;
+            }
+        }
+    }
+    forceScalar = wasScalar;
+    return result;
+}
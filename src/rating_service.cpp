@@ -0,0 +1,518 @@
+#include "../include/rating_service.h"
+#include "../include/logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+std::mutex RatingService::mutex;
+bool RatingService::initialized = false;
+RatingMode RatingService::mode = RATING_MODE_GLICKO2;
+std::string RatingService::journalPath;
+HANDLE RatingService::journalFile = INVALID_HANDLE_VALUE;
+uint32_t RatingService::journalEntries = 0;
+
+std::unordered_map<std::string, uint32_t> RatingService::playerIds;
+std::vector<std::string> RatingService::playerNames;
+std::vector<RatingState> RatingService::ratings;
+
+// Journal layout: file header, then a sequence of entries each prefixed by a
+// checksum over the rest of the entry
+static const uint32_t RATING_JOURNAL_MAGIC = 0x52465A45; // "EZFR"
+static const uint16_t RATING_JOURNAL_VERSION = 1;
+static const uint8_t ENTRY_PLAYER = 1;  // id + nickname bytes
+static const uint8_t ENTRY_RATING = 2;  // id + rating state
+
+#pragma pack(push, 1)
+struct RatingJournalHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t mode;
+    uint8_t reserved[9];
+};
+
+struct RatingEntryHeader {
+    uint32_t checksum;
+    uint8_t type;
+    uint8_t length;
+    uint16_t reserved;
+};
+
+struct RatingEntryPayload {
+    uint32_t id;
+    float rating;
+    float deviation;
+    float volatility;
+    uint32_t sets;
+};
+#pragma pack(pop)
+
+// Glicko-2 system constants
+static const double GLICKO2_SCALE = 173.7178;
+static const double GLICKO2_TAU = 0.5;
+static const double GLICKO2_EPSILON = 0.000001;
+static const double ELO_K_FACTOR = 32.0;
+static const double PI = 3.14159265358979323846;
+
+bool RatingService::Initialize(const std::string& directory) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (initialized) {
+            return true;
+        }
+
+        journalPath = (std::filesystem::path(directory) / "ratings.bin").string();
+        journalFile = CreateFileA(journalPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                                  nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (journalFile == INVALID_HANDLE_VALUE) {
+            LOG_WIN32_ERROR("Failed to open rating journal " + journalPath);
+            return false;
+        }
+
+        bool loaded = LoadJournal();
+        initialized = true;
+
+        if (loaded) {
+            // Compact the journal once it is mostly superseded updates
+            if (journalEntries > playerNames.size() * 8 + 256) {
+                WriteSnapshot();
+            }
+
+            Logger::Info("Ratings loaded for " + std::to_string(playerNames.size()) + " players (" +
+                         std::string(mode == RATING_MODE_ELO ? "Elo" : "Glicko-2") + ")");
+            return true;
+        }
+    }
+
+    // New or unreadable journal: backfill from the history
+    Logger::Info("Rebuilding ratings from match history");
+    return RecomputeFromHistory();
+}
+
+void RatingService::Shutdown() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (journalFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(journalFile);
+        journalFile = INVALID_HANDLE_VALUE;
+    }
+    playerIds.clear();
+    playerNames.clear();
+    ratings.clear();
+    journalEntries = 0;
+    initialized = false;
+}
+
+RatingState RatingService::InitialState() {
+    RatingState state;
+    state.rating = 1500.0;
+    state.deviation = 350.0;
+    state.volatility = 0.06;
+    state.sets = 0;
+    return state;
+}
+
+uint32_t RatingService::Checksum(const uint8_t* data, size_t length) {
+    // FNV-1a, only used to detect torn or corrupted entries
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Returns false when the journal has to be rebuilt from the match history
+bool RatingService::LoadJournal() {
+    LARGE_INTEGER size = {};
+    GetFileSizeEx(journalFile, &size);
+    if (size.QuadPart < (LONGLONG)sizeof(RatingJournalHeader)) {
+        return false;
+    }
+
+    std::vector<uint8_t> data((size_t)size.QuadPart);
+    DWORD bytesRead = 0;
+    if (!ReadFile(journalFile, data.data(), (DWORD)data.size(), &bytesRead, nullptr) || bytesRead != data.size()) {
+        LOG_WIN32_ERROR("Failed to read rating journal");
+        return false;
+    }
+
+    RatingJournalHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != RATING_JOURNAL_MAGIC || header.version != RATING_JOURNAL_VERSION) {
+        Logger::Warning("Rating journal has an unknown format - rebuilding");
+        return false;
+    }
+    if (header.mode > RATING_MODE_ELO) {
+        return false;
+    }
+    mode = (RatingMode)header.mode; // The mode chosen last session sticks
+
+    size_t offset = sizeof(RatingJournalHeader);
+    while (offset + sizeof(RatingEntryHeader) <= data.size()) {
+        RatingEntryHeader entry;
+        memcpy(&entry, data.data() + offset, sizeof(entry));
+        size_t entrySize = sizeof(RatingEntryHeader) + entry.length;
+        if (offset + entrySize > data.size() ||
+            Checksum(data.data() + offset + sizeof(uint32_t), entrySize - sizeof(uint32_t)) != entry.checksum) {
+            break;
+        }
+
+        const uint8_t* payload = data.data() + offset + sizeof(RatingEntryHeader);
+        if (entry.type == ENTRY_PLAYER && entry.length > sizeof(uint32_t)) {
+            uint32_t id;
+            memcpy(&id, payload, sizeof(id));
+            if (id == playerNames.size()) {
+                std::string name((const char*)payload + sizeof(uint32_t), entry.length - sizeof(uint32_t));
+                playerIds[name] = id;
+                playerNames.push_back(name);
+                ratings.push_back(InitialState());
+            }
+        } else if (entry.type == ENTRY_RATING && entry.length == sizeof(RatingEntryPayload)) {
+            RatingEntryPayload value;
+            memcpy(&value, payload, sizeof(value));
+            if (value.id < ratings.size()) {
+                ratings[value.id].rating = value.rating;
+                ratings[value.id].deviation = value.deviation;
+                ratings[value.id].volatility = value.volatility;
+                ratings[value.id].sets = value.sets;
+            }
+        }
+
+        offset += entrySize;
+        journalEntries++;
+    }
+
+    // Drop a torn tail so later appends follow the last valid entry
+    LARGE_INTEGER end;
+    end.QuadPart = (LONGLONG)offset;
+    if (offset != data.size()) {
+        Logger::Warning("Rating journal had " + std::to_string(data.size() - offset) + " trailing bytes - truncated");
+        SetFilePointerEx(journalFile, end, nullptr, FILE_BEGIN);
+        SetEndOfFile(journalFile);
+    }
+    SetFilePointerEx(journalFile, end, nullptr, FILE_BEGIN);
+    return true;
+}
+
+// Rewrites the journal as one player + rating entry per player and swaps it in
+bool RatingService::WriteSnapshot() {
+    std::string tempPath = journalPath + ".tmp";
+    std::vector<uint8_t> buffer;
+    buffer.reserve(sizeof(RatingJournalHeader) + playerNames.size() * 96);
+
+    RatingJournalHeader header = {};
+    header.magic = RATING_JOURNAL_MAGIC;
+    header.version = RATING_JOURNAL_VERSION;
+    header.mode = (uint8_t)mode;
+    buffer.insert(buffer.end(), (const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+
+    auto appendEntry = [&buffer](uint8_t type, const void* payload, uint8_t length) {
+        size_t start = buffer.size();
+        RatingEntryHeader entry = {};
+        entry.type = type;
+        entry.length = length;
+        buffer.insert(buffer.end(), (const uint8_t*)&entry, (const uint8_t*)&entry + sizeof(entry));
+        buffer.insert(buffer.end(), (const uint8_t*)payload, (const uint8_t*)payload + length);
+        uint32_t checksum = Checksum(buffer.data() + start + sizeof(uint32_t), buffer.size() - start - sizeof(uint32_t));
+        memcpy(buffer.data() + start, &checksum, sizeof(checksum));
+    };
+
+    for (uint32_t id = 0; id < playerNames.size(); id++) {
+        uint8_t playerPayload[sizeof(uint32_t) + MATCH_NICKNAME_BYTES];
+        size_t nameLength = (std::min)(playerNames[id].size(), (size_t)MATCH_NICKNAME_BYTES - 1);
+        memcpy(playerPayload, &id, sizeof(id));
+        memcpy(playerPayload + sizeof(id), playerNames[id].data(), nameLength);
+        appendEntry(ENTRY_PLAYER, playerPayload, (uint8_t)(sizeof(id) + nameLength));
+
+        const RatingState& state = ratings[id];
+        RatingEntryPayload value = { id, (float)state.rating, (float)state.deviation, (float)state.volatility, state.sets };
+        appendEntry(ENTRY_RATING, &value, sizeof(value));
+    }
+
+    HANDLE tempFile = CreateFileA(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (tempFile == INVALID_HANDLE_VALUE) {
+        LOG_WIN32_ERROR("Failed to create rating snapshot " + tempPath);
+        return false;
+    }
+    DWORD written = 0;
+    bool ok = WriteFile(tempFile, buffer.data(), (DWORD)buffer.size(), &written, nullptr) && written == buffer.size();
+    FlushFileBuffers(tempFile);
+    CloseHandle(tempFile);
+    if (!ok) {
+        LOG_WIN32_ERROR("Failed to write rating snapshot");
+        DeleteFileA(tempPath.c_str());
+        return false;
+    }
+
+    if (journalFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(journalFile);
+        journalFile = INVALID_HANDLE_VALUE;
+    }
+    bool replaced = MoveFileExA(tempPath.c_str(), journalPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+    if (!replaced) {
+        LOG_WIN32_ERROR("Failed to replace rating journal - keeping the old one");
+        DeleteFileA(tempPath.c_str());
+    }
+
+    journalFile = CreateFileA(journalPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                              nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (journalFile == INVALID_HANDLE_VALUE) {
+        LOG_WIN32_ERROR("Failed to reopen rating journal");
+        return false;
+    }
+    LARGE_INTEGER zero = {};
+    SetFilePointerEx(journalFile, zero, nullptr, FILE_END);
+    if (!replaced) {
+        // Appends continue on the old journal, whose entry count still stands
+        return false;
+    }
+    journalEntries = (uint32_t)playerNames.size() * 2;
+    return true;
+}
+
+bool RatingService::AppendEntry(uint8_t type, const void* payload, uint8_t length) {
+    if (journalFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    uint8_t buffer[sizeof(RatingEntryHeader) + 255];
+    RatingEntryHeader entry = {};
+    entry.type = type;
+    entry.length = length;
+    memcpy(buffer, &entry, sizeof(entry));
+    memcpy(buffer + sizeof(entry), payload, length);
+    size_t total = sizeof(entry) + length;
+    uint32_t checksum = Checksum(buffer + sizeof(uint32_t), total - sizeof(uint32_t));
+    memcpy(buffer, &checksum, sizeof(checksum));
+
+    DWORD written = 0;
+    if (!WriteFile(journalFile, buffer, (DWORD)total, &written, nullptr) || written != total) {
+        LOG_WIN32_ERROR("Failed to append to rating journal");
+        return false;
+    }
+    FlushFileBuffers(journalFile);
+    journalEntries++;
+    return true;
+}
+
+bool RatingService::AppendRating(uint32_t id) {
+    const RatingState& state = ratings[id];
+    RatingEntryPayload value = { id, (float)state.rating, (float)state.deviation, (float)state.volatility, state.sets };
+    return AppendEntry(ENTRY_RATING, &value, sizeof(value));
+}
+
+uint32_t RatingService::InternPlayer(const std::string& nickname, bool journal) {
+    auto it = playerIds.find(nickname);
+    if (it != playerIds.end()) {
+        return it->second;
+    }
+
+    uint32_t id = (uint32_t)playerNames.size();
+    playerIds.emplace(nickname, id);
+    playerNames.push_back(nickname);
+    ratings.push_back(InitialState());
+
+    if (journal) {
+        uint8_t payload[sizeof(uint32_t) + MATCH_NICKNAME_BYTES];
+        size_t nameLength = (std::min)(nickname.size(), (size_t)MATCH_NICKNAME_BYTES - 1);
+        memcpy(payload, &id, sizeof(id));
+        memcpy(payload + sizeof(id), nickname.data(), nameLength);
+        AppendEntry(ENTRY_PLAYER, payload, (uint8_t)(sizeof(id) + nameLength));
+    }
+    return id;
+}
+
+void RatingService::RecordSet(const MatchRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!initialized) {
+        return;
+    }
+
+    std::string p1Name(record.p1Nickname, strnlen(record.p1Nickname, MATCH_NICKNAME_BYTES));
+    std::string p2Name(record.p2Nickname, strnlen(record.p2Nickname, MATCH_NICKNAME_BYTES));
+    uint32_t p1 = InternPlayer(p1Name, true);
+    uint32_t p2 = InternPlayer(p2Name, true);
+    if (p1 == p2) {
+        return; // Mirror nicknames (e.g. both defaults) can't be rated
+    }
+
+    double score = record.p1Score > record.p2Score ? 1.0 : (record.p1Score < record.p2Score ? 0.0 : 0.5);
+    if (mode == RATING_MODE_ELO) {
+        UpdateElo(ratings[p1], ratings[p2], score);
+    } else {
+        UpdateGlicko2(ratings[p1], ratings[p2], score);
+    }
+
+    AppendRating(p1);
+    AppendRating(p2);
+    Logger::Info("Ratings updated: " + p1Name + " " + std::to_string((int)ratings[p1].rating) + ", " +
+                 p2Name + " " + std::to_string((int)ratings[p2].rating));
+}
+
+RatingSnapshot RatingService::GetRating(const std::string& nickname) {
+    std::lock_guard<std::mutex> lock(mutex);
+    RatingSnapshot snapshot;
+    auto it = playerIds.find(nickname);
+    if (it == playerIds.end() || ratings[it->second].sets == 0) {
+        return snapshot;
+    }
+
+    const RatingState& state = ratings[it->second];
+    snapshot.rating = (int)std::lround(state.rating);
+    if (mode == RATING_MODE_GLICKO2) {
+        snapshot.deviation = (int)std::lround(state.deviation);
+    }
+    return snapshot;
+}
+
+bool RatingService::SetMode(RatingMode newMode) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (newMode == mode) {
+            return true;
+        }
+        mode = newMode;
+    }
+    return RecomputeFromHistory();
+}
+
+bool RatingService::RecomputeFromHistory() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!initialized) {
+        return false;
+    }
+
+    playerIds.clear();
+    playerNames.clear();
+    ratings.clear();
+
+    // Resolve names once; the rating pass itself only touches table indices
+    std::vector<RatingResult> results;
+    results.reserve(MatchHistory::GetMatchCount());
+    MatchHistory::ForEachMatch([&results](const MatchRecord& record, uint32_t, uint32_t) {
+        uint32_t p1 = InternPlayer(std::string(record.p1Nickname, strnlen(record.p1Nickname, MATCH_NICKNAME_BYTES)), false);
+        uint32_t p2 = InternPlayer(std::string(record.p2Nickname, strnlen(record.p2Nickname, MATCH_NICKNAME_BYTES)), false);
+        if (p1 != p2) {
+            float score = record.p1Score > record.p2Score ? 1.0f : (record.p1Score < record.p2Score ? 0.0f : 0.5f);
+            results.push_back({ p1, p2, score });
+        }
+    });
+
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    ApplyResults(results, ratings, mode);
+    QueryPerformanceCounter(&end);
+
+    double elapsedMs = (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+    Logger::Info("Recomputed ratings from " + std::to_string(results.size()) + " sets in " +
+                 std::to_string(elapsedMs) + " ms");
+    return WriteSnapshot();
+}
+
+void RatingService::ApplyResults(const std::vector<RatingResult>& results, std::vector<RatingState>& table, RatingMode ratingMode) {
+    for (const RatingResult& result : results) {
+        if (ratingMode == RATING_MODE_ELO) {
+            UpdateElo(table[result.p1], table[result.p2], result.p1Score);
+        } else {
+            UpdateGlicko2(table[result.p1], table[result.p2], result.p1Score);
+        }
+    }
+}
+
+void RatingService::UpdateElo(RatingState& a, RatingState& b, double scoreA) {
+    double expectedA = 1.0 / (1.0 + std::pow(10.0, (b.rating - a.rating) / 400.0));
+    double change = ELO_K_FACTOR * (scoreA - expectedA);
+    a.rating += change;
+    b.rating -= change;
+    a.sets++;
+    b.sets++;
+}
+
+// Each set is treated as its own rating period with a single game
+void RatingService::UpdateGlicko2(RatingState& a, RatingState& b, double scoreA) {
+    double muA = (a.rating - 1500.0) / GLICKO2_SCALE;
+    double muB = (b.rating - 1500.0) / GLICKO2_SCALE;
+    double phiA = a.deviation / GLICKO2_SCALE;
+    double phiB = b.deviation / GLICKO2_SCALE;
+
+    auto update = [](RatingState& self, double mu, double phi, double opponentMu, double opponentPhi, double score) {
+        double g = 1.0 / std::sqrt(1.0 + 3.0 * opponentPhi * opponentPhi / (PI * PI));
+        double expected = 1.0 / (1.0 + std::exp(-g * (mu - opponentMu)));
+        double v = 1.0 / (g * g * expected * (1.0 - expected));
+        double delta = v * g * (score - expected);
+
+        double sigma = Glicko2Volatility(phi, self.volatility, delta, v);
+        double phiStar = std::sqrt(phi * phi + sigma * sigma);
+        double newPhi = 1.0 / std::sqrt(1.0 / (phiStar * phiStar) + 1.0 / v);
+        double newMu = mu + newPhi * newPhi * g * (score - expected);
+
+        self.rating = newMu * GLICKO2_SCALE + 1500.0;
+        self.deviation = (std::min)(newPhi * GLICKO2_SCALE, 350.0);
+        self.volatility = sigma;
+        self.sets++;
+    };
+
+    update(a, muA, phiA, muB, phiB, scoreA);
+    update(b, muB, phiB, muA, phiA, 1.0 - scoreA);
+}
+
+// Illinois iteration from step 5 of Glickman's Glicko-2 description
+double RatingService::Glicko2Volatility(double phi, double sigma, double delta, double v) {
+    double a = std::log(sigma * sigma);
+    double phi2 = phi * phi;
+    double delta2 = delta * delta;
+    auto f = [&](double x) {
+        double ex = std::exp(x);
+        double denom = phi2 + v + ex;
+        return ex * (delta2 - phi2 - v - ex) / (2.0 * denom * denom) - (x - a) / (GLICKO2_TAU * GLICKO2_TAU);
+    };
+
+    double A = a;
+    double B;
+    if (delta2 > phi2 + v) {
+        B = std::log(delta2 - phi2 - v);
+    } else {
+        int k = 1;
+        while (f(a - k * GLICKO2_TAU) < 0 && k < 64) {
+            k++;
+        }
+        B = a - k * GLICKO2_TAU;
+    }
+
+    double fA = f(A);
+    double fB = f(B);
+    for (int i = 0; i < 100 && std::fabs(B - A) > GLICKO2_EPSILON; i++) {
+        double C = A + (A - B) * fA / (fB - fA);
+        double fC = f(C);
+        if (fC * fB <= 0) {
+            A = B;
+            fA = fB;
+        } else {
+            fA /= 2.0;
+        }
+        B = C;
+        fB = fC;
+    }
+    return std::exp(A / 2.0);
+}
+
+double RatingService::RunBenchmark(size_t matches, size_t playerCount) {
+    std::vector<RatingResult> results(matches);
+    uint32_t seed = 0x12345678;
+    for (RatingResult& result : results) {
+        seed = seed * 1664525u + 1013904223u;
+        result.p1 = (seed >> 8) % playerCount;
+        seed = seed * 1664525u + 1013904223u;
+        result.p2 = (uint32_t)((result.p1 + 1 + (seed >> 8) % (playerCount - 1)) % playerCount);
+        result.p1Score = (seed & 1) ? 1.0f : 0.0f;
+    }
+
+    std::vector<RatingState> table(playerCount, InitialState());
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    ApplyResults(results, table, mode);
+    QueryPerformanceCounter(&end);
+    return (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+}
@@ -0,0 +1,237 @@
+#include "../include/scheduling_policy.h"
+#include "../include/logger.h"
+#include <tlhelp32.h>
+#include <filesystem>
+#include <cstring>
+
+SchedulingConfig SchedulingPolicy::config;
+DWORD SchedulingPolicy::gameThreadId = 0;
+HANDLE SchedulingPolicy::gameThread = nullptr;
+std::atomic<int> SchedulingPolicy::gameCore(-1);
+LoopTimer SchedulingPolicy::recheckTimer;
+SchedulingPolicy::Counters SchedulingPolicy::counters = {};
+DWORD SchedulingPolicy::lastProcessor = (DWORD)-1;
+uint64_t SchedulingPolicy::resetTick = 0;
+uint64_t SchedulingPolicy::gameCpuAtReset = 0;
+
+struct PriorityName {
+    const char* name;
+    int priority;
+};
+
+static const PriorityName PRIORITY_NAMES[] = {
+    { "normal", THREAD_PRIORITY_NORMAL },
+    { "below_normal", THREAD_PRIORITY_BELOW_NORMAL },
+    { "lowest", THREAD_PRIORITY_LOWEST },
+    { "idle", THREAD_PRIORITY_IDLE }
+};
+
+static const char* PriorityToString(int priority) {
+    for (const PriorityName& entry : PRIORITY_NAMES) {
+        if (entry.priority == priority) {
+            return entry.name;
+        }
+    }
+    return "below_normal";
+}
+
+void SchedulingPolicy::LoadConfig(const std::string& path) {
+    const char* section = "Scheduling";
+    const char* file = path.c_str();
+
+    if (!std::filesystem::exists(path)) {
+        WritePrivateProfileStringA(section, "Enabled", "1", file);
+        WritePrivateProfileStringA(section, "PinThreads", "1", file);
+        WritePrivateProfileStringA(section, "GameCore", "-1", file);
+        WritePrivateProfileStringA(section, "Priority", "below_normal", file);
+        WritePrivateProfileStringA(section, "BackgroundTasks", "1", file);
+    }
+
+    config.enabled = GetPrivateProfileIntA(section, "Enabled", 1, file) != 0;
+    config.pinThreads = GetPrivateProfileIntA(section, "PinThreads", 1, file) != 0;
+    config.gameCore = (int)GetPrivateProfileIntA(section, "GameCore", -1, file);
+    config.backgroundTasks = GetPrivateProfileIntA(section, "BackgroundTasks", 1, file) != 0;
+
+    // Added after the first release; existing files get the section on their next load
+    const char* sampling = "Sampling";
+    char mode[16] = {};
+    GetPrivateProfileStringA(sampling, "Mode", "", mode, sizeof(mode), file);
+    if (mode[0] == '\0') {
+        WritePrivateProfileStringA(sampling, "Mode", "timer", file);
+        WritePrivateProfileStringA(sampling, "FrameBudgetUs", "200", file);
+        WritePrivateProfileStringA(sampling, "MinFrameIntervalUs", "12000", file);
+    }
+    config.frameSampling = _stricmp(mode, "frame") == 0;
+    config.frameBudgetUs = GetPrivateProfileIntA(sampling, "FrameBudgetUs", 200, file);
+    config.minFrameIntervalUs = GetPrivateProfileIntA(sampling, "MinFrameIntervalUs", 12000, file);
+
+    char priority[32] = {};
+    GetPrivateProfileStringA(section, "Priority", "below_normal", priority, sizeof(priority), file);
+    config.priority = THREAD_PRIORITY_BELOW_NORMAL;
+    for (const PriorityName& entry : PRIORITY_NAMES) {
+        if (_stricmp(priority, entry.name) == 0) {
+            config.priority = entry.priority;
+        }
+    }
+}
+
+// The game's main thread is the oldest thread in the process
+DWORD SchedulingPolicy::FindGameThread() {
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) {
+        LOG_WIN32_ERROR("Thread snapshot failed");
+        return 0;
+    }
+
+    DWORD processId = GetCurrentProcessId();
+    DWORD oldestId = 0;
+    FILETIME oldestCreation = {};
+
+    THREADENTRY32 entry;
+    entry.dwSize = sizeof(entry);
+    for (BOOL ok = Thread32First(snapshot, &entry); ok; ok = Thread32Next(snapshot, &entry)) {
+        if (entry.th32OwnerProcessID != processId) {
+            continue;
+        }
+        HANDLE thread = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, entry.th32ThreadID);
+        if (!thread) {
+            continue;
+        }
+        FILETIME creation, exitTime, kernel, user;
+        if (GetThreadTimes(thread, &creation, &exitTime, &kernel, &user) &&
+            (oldestId == 0 || CompareFileTime(&creation, &oldestCreation) < 0)) {
+            oldestId = entry.th32ThreadID;
+            oldestCreation = creation;
+        }
+        CloseHandle(thread);
+    }
+    CloseHandle(snapshot);
+    return oldestId;
+}
+
+// Configured core, else the game thread's ideal processor
+int SchedulingPolicy::DetectGameCore() {
+    if (config.gameCore >= 0) {
+        return config.gameCore;
+    }
+    PROCESSOR_NUMBER processor;
+    if (gameThread && GetThreadIdealProcessorEx(gameThread, &processor)) {
+        return processor.Number;
+    }
+    return -1;
+}
+
+// Every core the process may use except the game's; the whole process mask
+// when the game has been restricted to a single core
+DWORD_PTR SchedulingPolicy::ModThreadMask() {
+    DWORD_PTR processMask = 0, systemMask = 0;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+        return 0;
+    }
+    int core = gameCore;
+    if (core < 0 || core >= (int)(sizeof(DWORD_PTR) * 8)) {
+        return processMask;
+    }
+    DWORD_PTR mask = processMask & ~((DWORD_PTR)1 << core);
+    return mask ? mask : processMask;
+}
+
+void SchedulingPolicy::ApplyToCurrentThread() {
+    if (!config.enabled) {
+        return;
+    }
+    HANDLE thread = GetCurrentThread();
+    SetThreadPriority(thread, config.priority);
+    if (config.pinThreads) {
+        DWORD_PTR mask = ModThreadMask();
+        if (mask && !SetThreadAffinityMask(thread, mask)) {
+            LOG_WIN32_ERROR("Failed to set mod thread affinity");
+        }
+    }
+}
+
+void SchedulingPolicy::Initialize(const std::string& directory) {
+    LoadConfig((std::filesystem::path(directory) / "scheduling.ini").string());
+
+    gameThreadId = FindGameThread();
+    if (gameThreadId) {
+        gameThread = OpenThread(THREAD_QUERY_INFORMATION, FALSE, gameThreadId);
+    }
+    gameCore = DetectGameCore();
+
+    if (!config.enabled) {
+        // Undo the reduced priority the startup thread ran with
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+        Logger::Info("Scheduling policy disabled - mod threads use OS defaults");
+    } else {
+        ApplyToCurrentThread();
+        Logger::Info("Scheduling policy: game thread " + std::to_string(gameThreadId) + " on core " +
+                     std::to_string(gameCore.load()) + ", mod threads " + PriorityToString(config.priority) +
+                     (config.pinThreads ? ", affinity " + Logger::FormatHex((DWORD)ModThreadMask()) : std::string(", unpinned")));
+        EventLoop::EnableBackgroundTasks(config.backgroundTasks);
+    }
+
+    // Follow the game thread if the scheduler moves its ideal processor
+    recheckTimer.callback = OnRecheckTimer;
+    EventLoop::AddTimer(&recheckTimer, RECHECK_INTERVAL_MS, RECHECK_INTERVAL_MS);
+    EventLoop::SetWakeupHook(OnWakeup, nullptr);
+    ResetCounters();
+}
+
+void SchedulingPolicy::Shutdown() {
+    EventLoop::CancelTimer(&recheckTimer);
+    EventLoop::SetWakeupHook(nullptr, nullptr);
+    if (gameThread) {
+        CloseHandle(gameThread);
+        gameThread = nullptr;
+    }
+}
+
+void SchedulingPolicy::OnRecheckTimer(void* context) {
+    int core = DetectGameCore();
+    if (core == gameCore) {
+        return;
+    }
+    Logger::Info("Game thread core changed: " + std::to_string(gameCore.load()) + " -> " + std::to_string(core));
+    gameCore = core;
+    counters.gameCoreChanges++;
+    ApplyToCurrentThread();
+}
+
+// Runs on every loop wakeup; GetCurrentProcessorNumber does not enter the kernel
+void SchedulingPolicy::OnWakeup(void* context) {
+    DWORD processor = GetCurrentProcessorNumber();
+    counters.wakeups++;
+    if ((int)processor == gameCore) {
+        counters.wakeupsOnGameCore++;
+    }
+    if (lastProcessor != (DWORD)-1 && processor != lastProcessor) {
+        counters.migrations++;
+    }
+    lastProcessor = processor;
+}
+
+uint64_t SchedulingPolicy::GetGameThreadCpuTime() {
+    FILETIME creation, exitTime, kernel, user;
+    if (!gameThread || !GetThreadTimes(gameThread, &creation, &exitTime, &kernel, &user)) {
+        return 0;
+    }
+    uint64_t kernelTime = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    uint64_t userTime = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return kernelTime + userTime;
+}
+
+SchedulingPolicy::Counters SchedulingPolicy::GetCounters() {
+    Counters result = counters;
+    result.elapsedMs = (double)(EventLoop::GetTickMs() - resetTick);
+    uint64_t cpu = GetGameThreadCpuTime() - gameCpuAtReset;
+    result.gameThreadCpuPercent = result.elapsedMs > 0 ? (double)cpu / 10000.0 * 100.0 / result.elapsedMs : 0.0;
+    return result;
+}
+
+void SchedulingPolicy::ResetCounters() {
+    counters = Counters();
+    lastProcessor = (DWORD)-1;
+    resetTick = EventLoop::GetTickMs();
+    gameCpuAtReset = GetGameThreadCpuTime();
+}
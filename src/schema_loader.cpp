@@ -0,0 +1,292 @@
+#include "../include/schema_loader.h"
+#include "../include/module_monitor.h"
+#include "../include/logger.h"
+#include <nlohmann/json.hpp>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using nlohmann::json;
+
+std::string SchemaLoader::path;
+std::string SchemaLoader::text;
+bool SchemaLoader::usingFile = false;
+FILETIME SchemaLoader::lastWriteTime = {};
+std::shared_ptr<const ReadPlan> SchemaLoader::current;
+std::shared_ptr<const ReadPlan> SchemaLoader::previous;
+LoopWaitable SchemaLoader::directoryWatch;
+LoopTimer SchemaLoader::reloadTimer;
+std::string SchemaLoader::cachePath;
+std::map<std::string, int64_t> SchemaLoader::signatureCache;
+bool SchemaLoader::cacheDirty = false;
+
+static bool GetLastWriteTime(const std::string& file, FILETIME& time) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(file.c_str(), GetFileExInfoStandard, &attributes)) {
+        return false;
+    }
+    time = attributes.ftLastWriteTime;
+    return true;
+}
+
+// Identity from the PE headers of the image already mapped in this process
+static ModuleFingerprint FingerprintOf(HMODULE module) {
+    ModuleFingerprint fingerprint = {};
+    if (!module) {
+        return fingerprint;
+    }
+    const IMAGE_DOS_HEADER* dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(module);
+    const IMAGE_NT_HEADERS* nt = reinterpret_cast<const IMAGE_NT_HEADERS*>(
+        reinterpret_cast<const BYTE*>(module) + dos->e_lfanew);
+    fingerprint.loaded = true;
+    fingerprint.timestamp = nt->FileHeader.TimeDateStamp;
+    fingerprint.checksum = nt->OptionalHeader.CheckSum;
+    fingerprint.imageSize = nt->OptionalHeader.SizeOfImage;
+    return fingerprint;
+}
+
+// Every code section must be committed and readable before it is scanned;
+// a packed or partially unmapped module is reported instead of faulting
+static bool IsReadable(const BYTE* start, SIZE_T size) {
+    const BYTE* end = start + size;
+    while (start < end) {
+        MEMORY_BASIC_INFORMATION info;
+        if (!VirtualQuery(start, &info, sizeof(info)) || info.State != MEM_COMMIT ||
+            (info.Protect & (PAGE_NOACCESS | PAGE_GUARD))) {
+            return false;
+        }
+        start = reinterpret_cast<const BYTE*>(info.BaseAddress) + info.RegionSize;
+    }
+    return true;
+}
+
+class SchemaLoader::ModuleResolver : public SignatureResolver {
+public:
+    explicit ModuleResolver(const ModuleFingerprint* fingerprints) : fingerprints(fingerprints) {}
+
+    bool Resolve(SchemaModule module, const SignatureSpec& spec, uint32_t& rva, std::string& error) override {
+        const ModuleFingerprint& fingerprint = fingerprints[module];
+        std::string key = std::string(OffsetSchema::GetModuleName(module)) + "|" +
+                          Logger::FormatHex(fingerprint.timestamp) + "|" + Logger::FormatHex(fingerprint.checksum) + "|" +
+                          Logger::FormatHex(fingerprint.imageSize) + "|" + spec.pattern + "|" +
+                          std::to_string(spec.operand) + (spec.kind == OPERAND_RELATIVE ? "|relative" : "|absolute");
+
+        auto cached = signatureCache.find(key);
+        if (cached != signatureCache.end()) {
+            if (cached->second < 0) {
+                error = "signature not found in this build (cached)";
+                return false;
+            }
+            rva = (uint32_t)cached->second;
+            return true;
+        }
+
+        HMODULE base = (module == SCHEMA_MODULE_REVIVAL) ? ModuleMonitor::GetBase(WATCHED_EFZ_REVIVAL)
+                                                         : GetModuleHandleA("efz.exe");
+        if (!base) {
+            error = "module not loaded";
+            return false;
+        }
+        const uint8_t* image = reinterpret_cast<const uint8_t*>(base);
+        std::vector<ImageRange> code;
+        SignatureScanner::GetSections(image, fingerprint.imageSize, true, code);
+        for (const ImageRange& section : code) {
+            if (!IsReadable(image + section.offset, section.size)) {
+                error = "code section at +" + Logger::FormatHex(section.offset) + " is not readable";
+                return false;
+            }
+        }
+
+        LARGE_INTEGER frequency, start, end;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start);
+        bool found = SignatureScanner::Resolve(image, fingerprint.imageSize, (uint32_t)(uintptr_t)base, spec, rva, error);
+        QueryPerformanceCounter(&end);
+        double elapsedMs = (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+        Logger::Info(std::string("Signature scan of ") + OffsetSchema::GetModuleName(module) + " (" +
+                     std::to_string(fingerprint.imageSize / 1024) + " KB, " + SignatureScanner::GetSimdLevel() +
+                     "): " + (found ? "+" + Logger::FormatHex(rva) : error) + " in " + std::to_string(elapsedMs) + " ms");
+
+        signatureCache[key] = found ? (int64_t)rva : -1;
+        cacheDirty = true;
+        return found;
+    }
+
+private:
+    const ModuleFingerprint* fingerprints;
+};
+
+void SchemaLoader::LoadSignatureCache() {
+    std::ifstream file(cachePath, std::ios::binary);
+    if (!file) {
+        return;
+    }
+    json document = json::parse(file, nullptr, false);
+    if (document.is_discarded() || !document.is_object() || !document.contains("signatures") ||
+        !document["signatures"].is_object()) {
+        Logger::Warning("Signature cache " + cachePath + " is unreadable - signatures will be rescanned");
+        return;
+    }
+    for (auto it = document["signatures"].begin(); it != document["signatures"].end(); ++it) {
+        if (it.value().is_number_integer()) {
+            signatureCache[it.key()] = it.value().get<int64_t>();
+        }
+    }
+}
+
+// Written beside the schema and swapped in whole, so a crash mid-write
+// never leaves a truncated cache
+void SchemaLoader::SaveSignatureCache() {
+    if (!cacheDirty) {
+        return;
+    }
+    json signatures = json::object();
+    for (const auto& entry : signatureCache) {
+        signatures[entry.first] = entry.second;
+    }
+    json document;
+    document["signatures"] = signatures;
+
+    std::string temporary = cachePath + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file << document.dump(2) << "\n";
+        if (!file) {
+            Logger::Warning("Could not write signature cache " + temporary);
+            return;
+        }
+    }
+    if (!MoveFileExA(temporary.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        LOG_WIN32_ERROR("Could not replace signature cache");
+        return;
+    }
+    cacheDirty = false;
+}
+
+void SchemaLoader::ReadFingerprints(ModuleFingerprint fingerprints[SCHEMA_MODULE_COUNT]) {
+    fingerprints[SCHEMA_MODULE_EFZ] = FingerprintOf(GetModuleHandleA("efz.exe"));
+    fingerprints[SCHEMA_MODULE_REVIVAL] = FingerprintOf(ModuleMonitor::GetBase(WATCHED_EFZ_REVIVAL));
+}
+
+bool SchemaLoader::CompileAndPublish(const std::string& document, const char* origin) {
+    ModuleFingerprint fingerprints[SCHEMA_MODULE_COUNT];
+    ReadFingerprints(fingerprints);
+
+    std::shared_ptr<ReadPlan> plan = std::make_shared<ReadPlan>();
+    std::string error;
+    ModuleResolver resolver(fingerprints);
+    bool compiled = OffsetSchema::Compile(document, fingerprints, *plan, error, &resolver);
+    SaveSignatureCache();
+    if (!compiled) {
+        Logger::Error(std::string("Offset schema (") + origin + ") rejected: " + error);
+        return false;
+    }
+    for (const std::string& warning : plan->warnings) {
+        Logger::Warning("Offset schema: " + warning);
+    }
+
+    // Captures already queued with the old plan decode against it
+    previous = current;
+    std::atomic_store(&current, std::shared_ptr<const ReadPlan>(plan));
+    text = document;
+
+    std::string revival = fingerprints[SCHEMA_MODULE_REVIVAL].loaded
+        ? Logger::FormatHex(fingerprints[SCHEMA_MODULE_REVIVAL].timestamp) : std::string("not loaded");
+    Logger::Info(std::string("Offset schema (") + origin + "): layout '" + plan->layout + "', plan " +
+                 std::to_string(plan->id) + ", " + std::to_string(plan->blockCount) + " blocks, " +
+                 std::to_string(plan->dataSize) + " bytes per capture; EfzRevival.dll timestamp " + revival);
+    return true;
+}
+
+bool SchemaLoader::Initialize(const std::string& directory) {
+    path = (std::filesystem::path(directory) / "offsets.json").string();
+    cachePath = (std::filesystem::path(directory) / "signature_cache.json").string();
+    LoadSignatureCache();
+
+    if (!std::filesystem::exists(path)) {
+        std::ofstream file(path, std::ios::binary);
+        file << OffsetSchema::BuiltInSchema() << "\n";
+        Logger::Info("Wrote default offset schema to " + path);
+    }
+
+    // The built-in offsets keep the reader working if the file is broken
+    if (!Reload() && !current) {
+        CompileAndPublish(OffsetSchema::BuiltInSchema(), "built-in");
+    }
+
+    reloadTimer.callback = OnReloadTimer;
+    directoryWatch.handle = FindFirstChangeNotificationA(directory.c_str(), FALSE,
+                                                         FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+    if (directoryWatch.handle == INVALID_HANDLE_VALUE) {
+        directoryWatch.handle = nullptr;
+        LOG_WIN32_ERROR("Offset schema hot reload unavailable");
+    } else {
+        directoryWatch.callback = OnDirectoryChanged;
+        EventLoop::AddWaitable(&directoryWatch);
+    }
+    return current != nullptr;
+}
+
+void SchemaLoader::Shutdown() {
+    EventLoop::CancelTimer(&reloadTimer);
+    EventLoop::RemoveWaitable(&directoryWatch);
+    if (directoryWatch.handle) {
+        FindCloseChangeNotification(directoryWatch.handle);
+        directoryWatch.handle = nullptr;
+    }
+}
+
+bool SchemaLoader::Reload() {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        Logger::Warning("Offset schema " + path + " could not be opened - keeping the current plan");
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    GetLastWriteTime(path, lastWriteTime);
+
+    if (!CompileAndPublish(contents.str(), "offsets.json")) {
+        return false;
+    }
+    usingFile = true;
+    return true;
+}
+
+void SchemaLoader::Reselect() {
+    if (!text.empty()) {
+        CompileAndPublish(text, usingFile ? "offsets.json" : "built-in");
+    }
+}
+
+std::shared_ptr<const ReadPlan> SchemaLoader::GetPlan() {
+    return std::atomic_load(&current);
+}
+
+// Loop thread only: previous is not published atomically
+std::shared_ptr<const ReadPlan> SchemaLoader::GetPlan(uint32_t id) {
+    std::shared_ptr<const ReadPlan> plan = std::atomic_load(&current);
+    if (plan && plan->id == id) {
+        return plan;
+    }
+    if (previous && previous->id == id) {
+        return previous;
+    }
+    return nullptr;
+}
+
+// Any change in the directory re-arms the notification; only a newer
+// offsets.json schedules a reload, after the writes settle
+void SchemaLoader::OnDirectoryChanged(void* context) {
+    FindNextChangeNotification(directoryWatch.handle);
+
+    FILETIME writeTime;
+    if (GetLastWriteTime(path, writeTime) && CompareFileTime(&writeTime, &lastWriteTime) != 0) {
+        EventLoop::AddTimer(&reloadTimer, RELOAD_DELAY_MS, 0);
+    }
+}
+
+void SchemaLoader::OnReloadTimer(void* context) {
+    Logger::Info("Offset schema changed on disk - reloading");
+    Reload();
+}
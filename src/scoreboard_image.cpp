@@ -0,0 +1,328 @@
+#include "../include/scoreboard_image.h"
+#include "../include/game_data.h"
+#include "../include/character_table.h"
+#include "../include/match_history.h"
+#include "../include/logger.h"
+#include <wincodec.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+IWICImagingFactory* ScoreboardImage::factory = nullptr;
+ScoreboardRenderer* ScoreboardImage::renderer = nullptr;
+std::string ScoreboardImage::directory;
+std::string ScoreboardImage::templatePath;
+std::string ScoreboardImage::imagePath;
+std::unordered_map<int, Canvas> ScoreboardImage::portraits;
+PngWriter ScoreboardImage::writer;
+PngWriter::Mode ScoreboardImage::mode = PngWriter::FAST;
+bool ScoreboardImage::writeFile = true;
+HANDLE ScoreboardImage::frameMapping = nullptr;
+void* ScoreboardImage::frameView = nullptr;
+FrameShareWriter* ScoreboardImage::frameWriter = nullptr;
+ScoreboardImage::Stats ScoreboardImage::stats = {};
+
+static double ElapsedUs(const LARGE_INTEGER& start, const LARGE_INTEGER& end) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (double)(end.QuadPart - start.QuadPart) * 1e6 / (double)frequency.QuadPart;
+}
+
+static bool ReadFileBytes(const std::string& path, std::vector<uint8_t>& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !data.empty();
+}
+
+bool ScoreboardImage::Initialize(const std::string& outputDirectory) {
+    directory = outputDirectory;
+    templatePath = (std::filesystem::path(directory) / "scoreboard.json").string();
+    imagePath = (std::filesystem::path(directory) / "scoreboard.png").string();
+
+    // S_FALSE: this thread already joined the MTA
+    HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    if (FAILED(hr)) {
+        Logger::Error("Scoreboard image unavailable: COM initialization failed, hr " + std::to_string(hr));
+        return false;
+    }
+    hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+    if (FAILED(hr)) {
+        factory = nullptr;
+        Logger::Error("Scoreboard image unavailable: no WIC imaging factory, hr " + std::to_string(hr));
+        return false;
+    }
+
+    if (!std::filesystem::exists(templatePath)) {
+        std::ofstream file(templatePath, std::ios::binary);
+        file << ScoreboardRenderer::DefaultTemplate();
+        Logger::Info("Wrote default scoreboard template to " + templatePath);
+    }
+
+    stats.ready = true;
+    bool valid = LoadTemplate();
+    OpenFrameShare();
+    return valid;
+}
+
+// Sized for the loaded template with headroom; a reload that outgrows it
+// only loses the shared output (counted as tooLarge)
+void ScoreboardImage::OpenFrameShare() {
+    const Canvas& canvas = renderer->GetCanvas();
+    uint32_t capacity = (uint32_t)canvas.GetWidth() * (uint32_t)canvas.GetHeight() * 4;
+    if (capacity < FRAME_SHARE_MIN_CAPACITY) {
+        capacity = FRAME_SHARE_MIN_CAPACITY;
+    }
+    size_t size = FrameShare::MappingSize(capacity);
+    frameMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)size,
+                                      FRAME_SHARE_SCOREBOARD_NAME);
+    if (!frameMapping) {
+        LOG_WIN32_ERROR("Scoreboard frame mapping unavailable");
+        return;
+    }
+    frameView = MapViewOfFile(frameMapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!frameView) {
+        LOG_WIN32_ERROR("MapViewOfFile failed for scoreboard frames");
+        CloseHandle(frameMapping);
+        frameMapping = nullptr;
+        return;
+    }
+    frameWriter = new FrameShareWriter(frameView, capacity);
+    Logger::Info(std::string("Scoreboard frames shared as ") + FRAME_SHARE_SCOREBOARD_NAME + " (" +
+                 std::to_string(size) + " bytes)");
+}
+
+void ScoreboardImage::Shutdown() {
+    if (!renderer) {
+        return;
+    }
+    // Last task before the process exits: the factory is left to the
+    // process teardown rather than released after COM may have gone
+    std::error_code ignored;
+    std::filesystem::remove(imagePath, ignored);
+    if (frameWriter) {
+        // Readers see closed and stop waiting for frames
+        frameWriter->Close();
+        delete frameWriter;
+        frameWriter = nullptr;
+        UnmapViewOfFile(frameView);
+        CloseHandle(frameMapping);
+        frameView = nullptr;
+        frameMapping = nullptr;
+    }
+    delete renderer;
+    renderer = nullptr;
+    portraits.clear();
+    stats.ready = false;
+}
+
+void ScoreboardImage::Abandon() {
+    // No allocator or lock: a terminated thread may have held them
+    if (frameWriter) {
+        frameWriter->Close();
+        UnmapViewOfFile(frameView);
+        CloseHandle(frameMapping);
+        frameWriter = nullptr;
+    }
+}
+
+// Template and fonts; a broken file keeps the default layout on screen
+bool ScoreboardImage::LoadTemplate() {
+    std::string text, error;
+    std::vector<uint8_t> bytes;
+    if (ReadFileBytes(templatePath, bytes)) {
+        text.assign(bytes.begin(), bytes.end());
+    }
+    ScoreboardRenderer* loaded = new ScoreboardRenderer();
+    bool valid = loaded->LoadTemplate(text, error);
+    if (!valid) {
+        Logger::Warning("Scoreboard template " + templatePath + " rejected (" + error + "); using the default");
+        loaded->LoadTemplate(ScoreboardRenderer::DefaultTemplate(), error);
+    }
+
+    int fonts = 0;
+    for (const std::string& fontPath : loaded->GetFontPaths()) {
+        std::filesystem::path path = std::filesystem::path(fontPath);
+        if (path.is_relative()) {
+            path = std::filesystem::path(directory) / path;
+        }
+        std::vector<uint8_t> data;
+        if (!ReadFileBytes(path.string(), data)) {
+            Logger::Warning("Scoreboard font not found: " + path.string());
+        } else if (!loaded->GetGlyphs().AddFont(std::move(data), error)) {
+            Logger::Warning("Scoreboard font " + path.string() + ": " + error);
+        } else {
+            fonts++;
+        }
+    }
+    if (fonts == 0) {
+        Logger::Warning("Scoreboard has no usable font - text will not be drawn");
+    }
+
+    mode = PngWriter::FAST;
+    writeFile = loaded->GetEncoding() != "none";
+    if (writeFile && !PngWriter::ParseMode(loaded->GetEncoding(), mode)) {
+        Logger::Warning("Scoreboard encoding '" + loaded->GetEncoding() +
+                        "' unknown (stored, rle, fast, none); using fast");
+    }
+
+    delete renderer;
+    renderer = loaded;
+    Logger::Info("Scoreboard template loaded: " + std::to_string(renderer->GetCanvas().GetWidth()) + "x" +
+                 std::to_string(renderer->GetCanvas().GetHeight()) + ", " + std::to_string(fonts) + " fonts, " +
+                 (writeFile ? std::string(PngWriter::GetModeName(mode)) + " PNG" : std::string("no PNG")));
+    return valid;
+}
+
+bool ScoreboardImage::Reload() {
+    if (!renderer) {
+        return false;
+    }
+    bool valid = LoadTemplate();
+    Update(GameDataManager::GetCurrentData(), FIELD_ALL);
+    return valid;
+}
+
+// Any format WIC reads, converted to premultiplied BGRA
+bool ScoreboardImage::DecodeImage(const std::string& path, Canvas& image) {
+    std::wstring widePath = std::filesystem::path(path).wstring();
+    IWICBitmapDecoder* decoder = nullptr;
+    IWICBitmapFrameDecode* frame = nullptr;
+    IWICBitmapSource* converted = nullptr;
+    UINT width = 0, height = 0;
+    HRESULT hr = factory->CreateDecoderFromFilename(widePath.c_str(), nullptr, GENERIC_READ,
+                                                    WICDecodeMetadataCacheOnDemand, &decoder);
+    if (SUCCEEDED(hr)) hr = decoder->GetFrame(0, &frame);
+    if (SUCCEEDED(hr)) hr = WICConvertBitmapSource(GUID_WICPixelFormat32bppPBGRA, frame, &converted);
+    if (SUCCEEDED(hr)) hr = converted->GetSize(&width, &height);
+    if (SUCCEEDED(hr) && (width == 0 || height == 0 || width > 4096 || height > 4096)) {
+        hr = E_INVALIDARG;
+    }
+    if (SUCCEEDED(hr)) {
+        image.Resize((int)width, (int)height);
+        hr = converted->CopyPixels(nullptr, width * 4, width * height * 4, (BYTE*)image.Row(0));
+    }
+    if (converted) converted->Release();
+    if (frame) frame->Release();
+    if (decoder) decoder->Release();
+    if (FAILED(hr)) {
+        image.Resize(0, 0);
+        return false;
+    }
+    return true;
+}
+
+// Decoded once per character; a character without a file uses unknown.png
+const Canvas* ScoreboardImage::GetPortrait(int characterId) {
+    auto found = portraits.find(characterId);
+    if (found == portraits.end()) {
+        std::filesystem::path portraitsPath = std::filesystem::path(directory) / "portraits";
+        Canvas& image = portraits[characterId];
+        if (!DecodeImage((portraitsPath / CharacterTable::GetPortrait(characterId)).string(), image) &&
+            !DecodeImage((portraitsPath / "unknown.png").string(), image)) {
+            Logger::Debug("No portrait for character " + std::to_string(characterId));
+        }
+        found = portraits.find(characterId);
+    }
+    return found->second.GetWidth() > 0 ? &found->second : nullptr;
+}
+
+static void SetPlayerFields(ScoreboardRenderer& renderer, const std::string& prefix, const PlayerData& player) {
+    renderer.SetField(prefix + ".nickname", player.nickname.str());
+    renderer.SetField(prefix + ".character", player.character.str());
+    renderer.SetField(prefix + ".wins", std::to_string(player.winCount));
+    renderer.SetField(prefix + ".rating", player.rating.rating >= 0 ? std::to_string(player.rating.rating) : "");
+    renderer.SetField(prefix + ".record", player.stats.sets > 0 ? std::to_string(player.stats.wins) + "W " +
+                                                                    std::to_string(player.stats.losses) + "L"
+                                                                : "");
+    renderer.SetField(prefix + ".winrate", player.stats.winRate >= 0 ? std::to_string(player.stats.winRate) + "%" : "");
+    renderer.SetField(prefix + ".streak", player.stats.streak != 0 ? std::to_string(player.stats.streak) : "");
+}
+
+void ScoreboardImage::Update(const GameData& data, uint32_t fields) {
+    const uint32_t shown = FIELD_P1_NICKNAME | FIELD_P1_CHARACTER | FIELD_P1_WINS | FIELD_P1_STATS |
+                           FIELD_P2_NICKNAME | FIELD_P2_CHARACTER | FIELD_P2_WINS | FIELD_P2_STATS;
+    if (!renderer || !(fields & shown)) {
+        return;
+    }
+
+    SetPlayerFields(*renderer, "p1", data.player1);
+    SetPlayerFields(*renderer, "p2", data.player2);
+    if (fields & (FIELD_P1_NICKNAME | FIELD_P2_NICKNAME | FIELD_P1_STATS | FIELD_P2_STATS)) {
+        HeadToHeadRecord h2h = MatchHistory::GetHeadToHead(data.player1.nickname.str(), data.player2.nickname.str());
+        renderer->SetField("h2h", h2h.sets > 0 ? std::to_string(h2h.firstWins) + " - " + std::to_string(h2h.secondWins)
+                                               : "");
+    }
+    // Image IDs only have to change with the pixels: one per character
+    const Canvas* p1Portrait = GetPortrait(data.player1.characterId);
+    const Canvas* p2Portrait = GetPortrait(data.player2.characterId);
+    renderer->SetImage("p1.portrait", p1Portrait, p1Portrait ? (uint64_t)data.player1.characterId + 1 : 0);
+    renderer->SetImage("p2.portrait", p2Portrait, p2Portrait ? (uint64_t)data.player2.characterId + 1 : 0);
+
+    Publish();
+}
+
+void ScoreboardImage::Publish() {
+    LARGE_INTEGER start, rendered, encoded, written;
+    QueryPerformanceCounter(&start);
+    CanvasRect dirty = renderer->Render();
+    QueryPerformanceCounter(&rendered);
+    stats.lastRenderUs = ElapsedUs(start, rendered);
+    if (dirty.Empty()) {
+        return;
+    }
+    stats.lastDirty = dirty;
+    if (frameWriter) {
+        frameWriter->Publish(renderer->GetCanvas(), dirty);
+    }
+    if (!writeFile) {
+        return;
+    }
+    const std::vector<uint8_t>& png = writer.Encode(renderer->GetCanvas(), mode);
+    QueryPerformanceCounter(&encoded);
+    if (WriteImage(png)) {
+        stats.images++;
+    }
+    QueryPerformanceCounter(&written);
+    stats.lastEncodeUs = ElapsedUs(rendered, encoded);
+    stats.lastWriteUs = ElapsedUs(encoded, written);
+    stats.lastBytes = png.size();
+}
+
+// Written beside the old file and moved over it so OBS never reads a
+// partial image
+bool ScoreboardImage::WriteImage(const std::vector<uint8_t>& png) {
+    std::string temporary = imagePath + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write((const char*)png.data(), (std::streamsize)png.size());
+        if (!file) {
+            Logger::Warning("Could not write " + temporary);
+            return false;
+        }
+    }
+    if (!MoveFileExA(temporary.c_str(), imagePath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        LOG_WIN32_ERROR("Could not replace scoreboard image");
+        return false;
+    }
+    return true;
+}
+
+ScoreboardImage::Stats ScoreboardImage::GetStats() {
+    Stats result = stats;
+    if (renderer) {
+        result.renderer = renderer->GetStats();
+        result.glyphs = renderer->GetGlyphs().GetStats();
+    }
+    result.portraits = portraits.size();
+    result.encoding = writeFile ? PngWriter::GetModeName(mode) : "none";
+    result.shared = frameWriter != nullptr;
+    result.frames = frameWriter ? frameWriter->GetStats() : FrameShareWriter::Stats{};
+    return result;
+}
+
+const Canvas* ScoreboardImage::GetCanvas() {
+    return renderer ? &renderer->GetCanvas() : nullptr;
+}
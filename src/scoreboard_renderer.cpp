@@ -0,0 +1,400 @@
+#include "../include/scoreboard_renderer.h"
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+namespace {
+
+class TemplateError : public std::runtime_error {
+public:
+    explicit TemplateError(const std::string& message) : std::runtime_error(message) {}
+};
+
+int RequireInt(const json& object, const char* key, const std::string& context) {
+    auto found = object.find(key);
+    if (found == object.end() || !found->is_number_integer()) {
+        throw TemplateError(context + ": \"" + key + "\" must be an integer");
+    }
+    return found->get<int>();
+}
+
+// #RRGGBB or #AARRGGBB, premultiplied
+uint32_t ParseColor(const json& object, const char* key, const char* fallback, const std::string& context) {
+    std::string text = object.contains(key) && object[key].is_string() ? object[key].get<std::string>() : fallback;
+    size_t digits = text.empty() ? 0 : text.size() - 1;
+    if (text.empty() || text[0] != '#' || (digits != 6 && digits != 8) ||
+        text.find_first_not_of("0123456789abcdefABCDEF", 1) != std::string::npos) {
+        throw TemplateError(context + ": \"" + key + "\" is not a #RRGGBB or #AARRGGBB colour");
+    }
+    uint32_t value = (uint32_t)std::stoul(text.substr(1), nullptr, 16);
+    return Canvas::Premultiply(digits == 6 ? 0xFF000000 | value : value);
+}
+
+}
+
+ScoreboardRenderer::ScoreboardRenderer() : background(0), encoding("fast"), fullRedraw(true), stats() {
+}
+
+bool ScoreboardRenderer::LoadTemplate(const std::string& text, std::string& error) {
+    json document = json::parse(text, nullptr, false);
+    if (document.is_discarded() || !document.is_object()) {
+        error = "not a valid JSON object";
+        return false;
+    }
+
+    try {
+        int width = RequireInt(document, "width", "template");
+        int height = RequireInt(document, "height", "template");
+        if (width <= 0 || height <= 0 || width > 4096 || height > 4096) {
+            throw TemplateError("template: size must be 1-4096 pixels per side");
+        }
+        uint32_t newBackground = ParseColor(document, "background", "#00000000", "template");
+
+        std::vector<std::string> newFonts;
+        if (document.contains("fonts")) {
+            for (const json& font : document["fonts"]) {
+                if (!font.is_string()) {
+                    throw TemplateError("fonts: expected file paths");
+                }
+                newFonts.push_back(font.get<std::string>());
+            }
+        }
+
+        std::string newEncoding = "fast";
+        if (document.contains("encoding")) {
+            if (!document["encoding"].is_string()) {
+                throw TemplateError("encoding: expected a name");
+            }
+            newEncoding = document["encoding"].get<std::string>();
+        }
+
+        if (!document.contains("elements") || !document["elements"].is_array()) {
+            throw TemplateError("template: \"elements\" must be an array");
+        }
+        std::vector<ScoreboardElement> newElements;
+        for (const json& item : document["elements"]) {
+            std::string context = "element " + std::to_string(newElements.size());
+            if (!item.is_object() || !item.contains("type") || !item["type"].is_string()) {
+                throw TemplateError(context + ": expected an object with a \"type\"");
+            }
+            ScoreboardElement element = ScoreboardElement();
+            std::string type = item["type"].get<std::string>();
+            element.rect = CanvasRect::Make(RequireInt(item, "x", context), RequireInt(item, "y", context),
+                                            RequireInt(item, "w", context), RequireInt(item, "h", context));
+            element.color = ParseColor(item, "color", "#FFFFFFFF", context);
+            if (type == "rect") {
+                element.type = ScoreboardElement::RECT;
+            } else if (type == "text") {
+                element.type = ScoreboardElement::TEXT;
+                element.text = item.value("text", "");
+                element.size = item.value("size", element.rect.y1 - element.rect.y0);
+                std::string align = item.value("align", "left");
+                element.align = align == "center" ? ScoreboardElement::ALIGN_CENTER
+                              : align == "right"  ? ScoreboardElement::ALIGN_RIGHT
+                                                  : ScoreboardElement::ALIGN_LEFT;
+            } else if (type == "image") {
+                element.type = ScoreboardElement::IMAGE;
+                element.source = item.value("source", "");
+            } else {
+                throw TemplateError(context + ": unknown type \"" + type + "\"");
+            }
+            newElements.push_back(element);
+        }
+
+        canvas.Resize(width, height);
+        background = newBackground;
+        fontPaths = newFonts;
+        encoding = newEncoding;
+        elements = newElements;
+        fullRedraw = true;
+        return true;
+    } catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+}
+
+void ScoreboardRenderer::SetField(const std::string& name, const std::string& value) {
+    fields[name] = value;
+}
+
+void ScoreboardRenderer::SetImage(const std::string& name, const Canvas* image, uint64_t id) {
+    images[name] = {image, image ? id : 0};
+}
+
+std::string ScoreboardRenderer::Substitute(const std::string& text) const {
+    std::string result;
+    size_t position = 0;
+    while (position < text.size()) {
+        size_t open = text.find('{', position);
+        size_t close = open == std::string::npos ? std::string::npos : text.find('}', open);
+        if (close == std::string::npos) {
+            result.append(text, position, std::string::npos);
+            break;
+        }
+        result.append(text, position, open - position);
+        auto found = fields.find(text.substr(open + 1, close - open - 1));
+        if (found != fields.end()) {
+            result += found->second;
+        }
+        position = close + 1;
+    }
+    return result;
+}
+
+std::string ScoreboardRenderer::KeyOf(const ScoreboardElement& element) const {
+    switch (element.type) {
+    case ScoreboardElement::TEXT:
+        return Substitute(element.text);
+    case ScoreboardElement::IMAGE: {
+        auto found = images.find(element.source);
+        return std::to_string(found == images.end() ? 0 : found->second.id);
+    }
+    default:
+        return "";
+    }
+}
+
+// Work that only depends on the key: text fitting and image scaling
+void ScoreboardRenderer::Prepare(ScoreboardElement& element) {
+    int width = element.rect.x1 - element.rect.x0;
+    int height = element.rect.y1 - element.rect.y0;
+    if (element.type == ScoreboardElement::TEXT) {
+        element.fittedSize = element.size;
+        element.textWidth = glyphs.MeasureText(element.key, element.size);
+        if (element.textWidth > width && element.textWidth > 0) {
+            int fitted = element.size * width / element.textWidth;
+            element.fittedSize = fitted > 8 ? fitted : 8;
+            element.textWidth = glyphs.MeasureText(element.key, element.fittedSize);
+        }
+    } else if (element.type == ScoreboardElement::IMAGE) {
+        auto found = images.find(element.source);
+        const Canvas* image = found == images.end() ? nullptr : found->second.image;
+        if (!image || image->GetWidth() == 0 || image->GetHeight() == 0) {
+            element.scaled.Resize(0, 0);
+            return;
+        }
+        // Fit inside the rect keeping the aspect ratio, centred
+        int fittedWidth = width;
+        int fittedHeight = (int)((int64_t)image->GetHeight() * width / image->GetWidth());
+        if (fittedHeight > height) {
+            fittedHeight = height;
+            fittedWidth = (int)((int64_t)image->GetWidth() * height / image->GetHeight());
+        }
+        element.scaled.Resize(fittedWidth, fittedHeight);
+        element.scaled.ScaleFrom(*image);
+        element.imageRect = CanvasRect::Make(element.rect.x0 + (width - fittedWidth) / 2,
+                                             element.rect.y0 + (height - fittedHeight) / 2, fittedWidth,
+                                             fittedHeight);
+    }
+}
+
+void ScoreboardRenderer::Draw(ScoreboardElement& element, const CanvasRect& clip) {
+    CanvasRect area = element.rect.Intersect(clip);
+    if (area.Empty()) {
+        return;
+    }
+    switch (element.type) {
+    case ScoreboardElement::RECT:
+        canvas.FillBlend(area, element.color);
+        break;
+    case ScoreboardElement::IMAGE:
+        if (element.scaled.GetWidth() > 0) {
+            canvas.BlendCanvas(element.imageRect.x0, element.imageRect.y0, element.scaled, area);
+        }
+        break;
+    case ScoreboardElement::TEXT: {
+        if (element.key.empty()) {
+            break;
+        }
+        int ascent, descent;
+        glyphs.GetLineMetrics(element.fittedSize, ascent, descent);
+        int width = element.rect.x1 - element.rect.x0;
+        int height = element.rect.y1 - element.rect.y0;
+        int x = element.rect.x0;
+        if (element.align == ScoreboardElement::ALIGN_CENTER) {
+            x += (width - element.textWidth) / 2;
+        } else if (element.align == ScoreboardElement::ALIGN_RIGHT) {
+            x += width - element.textWidth;
+        }
+        int baseline = element.rect.y0 + (height - ascent - descent) / 2 + ascent;
+        glyphs.DrawText(canvas, x, baseline, element.key, element.fittedSize, element.color, area);
+        break;
+    }
+    }
+}
+
+// Overlapping dirty rects merge so no pixel is drawn twice
+void ScoreboardRenderer::AddDirty(std::vector<CanvasRect>& dirty, CanvasRect rect) {
+    for (size_t i = 0; i < dirty.size();) {
+        if (!dirty[i].Intersect(rect).Empty()) {
+            rect = rect.Union(dirty[i]);
+            dirty.erase(dirty.begin() + i);
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+    dirty.push_back(rect);
+}
+
+CanvasRect ScoreboardRenderer::Render() {
+    dirty.clear();
+    CanvasRect bounds = canvas.GetBounds();
+    for (ScoreboardElement& element : elements) {
+        std::string key = KeyOf(element);
+        if (fullRedraw || !element.drawn || key != element.key) {
+            element.key = key;
+            element.drawn = true;
+            Prepare(element);
+            CanvasRect area = element.rect.Intersect(bounds);
+            if (!fullRedraw && !area.Empty()) {
+                AddDirty(dirty, area);
+            }
+        }
+    }
+    if (fullRedraw) {
+        dirty.assign(1, bounds);
+        stats.fullRedraws++;
+        fullRedraw = false;
+    }
+    if (dirty.empty()) {
+        stats.skipped++;
+        return CanvasRect();
+    }
+
+    CanvasRect drawn;
+    for (const CanvasRect& area : dirty) {
+        canvas.Fill(area, background);
+        for (ScoreboardElement& element : elements) {
+            Draw(element, area);
+        }
+        stats.pixelsDrawn += area.Area();
+        drawn = drawn.Union(area);
+    }
+    stats.renders++;
+    return drawn;
+}
+
+std::string ScoreboardRenderer::DefaultTemplate() {
+    return R"({
+  "width": 400,
+  "height": 120,
+  "background": "#00000000",
+  "encoding": "fast",
+  "fonts": ["C:/Windows/Fonts/arialbd.ttf", "C:/Windows/Fonts/msgothic.ttc"],
+  "elements": [
+    { "type": "rect", "x": 0, "y": 0, "w": 400, "h": 120, "color": "#D0141A24" },
+    { "type": "rect", "x": 160, "y": 24, "w": 80, "h": 68, "color": "#FF222C3C" },
+    { "type": "image", "source": "p1.portrait", "x": 4, "y": 4, "w": 72, "h": 112 },
+    { "type": "image", "source": "p2.portrait", "x": 324, "y": 4, "w": 72, "h": 112 },
+    { "type": "text", "text": "{p1.nickname}", "x": 80, "y": 4, "w": 150, "h": 20, "size": 18, "align": "left" },
+    { "type": "text", "text": "{p2.nickname}", "x": 170, "y": 4, "w": 150, "h": 20, "size": 18, "align": "right" },
+    { "type": "text", "text": "{p1.character}", "x": 80, "y": 96, "w": 76, "h": 20, "size": 14, "color": "#FFB0B8C8" },
+    { "type": "text", "text": "{p2.character}", "x": 244, "y": 96, "w": 76, "h": 20, "size": 14, "color": "#FFB0B8C8", "align": "right" },
+    { "type": "text", "text": "{p1.wins}", "x": 160, "y": 24, "w": 36, "h": 68, "size": 48, "align": "center" },
+    { "type": "text", "text": "-", "x": 194, "y": 24, "w": 12, "h": 68, "size": 36, "color": "#FF8090A0", "align": "center" },
+    { "type": "text", "text": "{p2.wins}", "x": 204, "y": 24, "w": 36, "h": 68, "size": 48, "align": "center" },
+    { "type": "text", "text": "{p1.rating}", "x": 80, "y": 40, "w": 76, "h": 20, "size": 14, "color": "#FFFFD070" },
+    { "type": "text", "text": "{p2.rating}", "x": 244, "y": 40, "w": 76, "h": 20, "size": 14, "color": "#FFFFD070", "align": "right" },
+    { "type": "text", "text": "{p1.record}", "x": 80, "y": 62, "w": 76, "h": 18, "size": 12, "color": "#FFB0B8C8" },
+    { "type": "text", "text": "{p2.record}", "x": 244, "y": 62, "w": 76, "h": 18, "size": 12, "color": "#FFB0B8C8", "align": "right" },
+    { "type": "text", "text": "{h2h}", "x": 160, "y": 96, "w": 80, "h": 20, "size": 13, "color": "#FFB0B8C8", "align": "center" }
+  ]
+}
+)";
+}
+
+bool ScoreboardRenderer::RunSelfTest(std::string& failure) {
+    failure.clear();
+    ScoreboardRenderer renderer;
+    std::string error;
+
+    const char* broken[] = {
+        "[]",
+        R"({"width": 0, "height": 10, "elements": []})",
+        R"({"width": 10, "height": 10, "elements": [{"type": "circle", "x": 0, "y": 0, "w": 1, "h": 1}]})",
+        R"({"width": 10, "height": 10, "elements": [{"type": "rect", "x": 0, "y": 0, "w": 1, "h": 1, "color": "red"}]})",
+        R"({"width": 10, "height": 10, "elements": [{"type": "text", "x": 0, "w": 1, "h": 1}]})",
+    };
+    for (const char* text : broken) {
+        if (renderer.LoadTemplate(text, error)) {
+            failure = std::string("accepted a broken template: ") + text;
+            return false;
+        }
+    }
+    if (!renderer.LoadTemplate(DefaultTemplate(), error)) {
+        failure = "default template: " + error;
+        return false;
+    }
+
+    // Panel, one portrait slot and one text slot (no fonts: text only drives dirty areas)
+    const char* layout = R"({"width": 64, "height": 32, "background": "#00000000", "elements": [
+        {"type": "rect", "x": 0, "y": 0, "w": 64, "h": 32, "color": "#80000000"},
+        {"type": "image", "source": "p1.portrait", "x": 2, "y": 2, "w": 20, "h": 28},
+        {"type": "text", "text": "{p1.wins}", "x": 40, "y": 4, "w": 20, "h": 24}]})";
+    if (!renderer.LoadTemplate(layout, error)) {
+        failure = "test template: " + error;
+        return false;
+    }
+    CanvasRect all = renderer.Render();
+    if (!(all == CanvasRect::Make(0, 0, 64, 32)) || !renderer.Render().Empty()) {
+        failure = "first render was not full, or a second one was not empty";
+        return false;
+    }
+
+    renderer.SetField("p1.wins", "2");
+    if (!(renderer.Render() == CanvasRect::Make(40, 4, 20, 24))) {
+        failure = "a changed field did not dirty exactly its text rect";
+        return false;
+    }
+    renderer.SetField("p1.wins", "2");
+    renderer.SetField("unused", "x");
+    if (!renderer.Render().Empty()) {
+        failure = "an unchanged or unused field caused a redraw";
+        return false;
+    }
+
+    // A 10x20 portrait fits 20x28 as 14x28, centred
+    Canvas portrait(10, 20);
+    portrait.Fill(portrait.GetBounds(), 0xFF0000FF);
+    renderer.SetImage("p1.portrait", &portrait, 7);
+    CanvasRect imageArea = renderer.Render();
+    const Canvas& canvas = renderer.GetCanvas();
+    if (!(imageArea == CanvasRect::Make(2, 2, 20, 28)) || canvas.Row(10)[5] != 0xFF0000FF ||
+        canvas.Row(10)[3] != 0x80000000 || canvas.Row(10)[30] != 0x80000000) {
+        failure = "portrait: wrong dirty area or pixels";
+        return false;
+    }
+
+    // Incremental result equals a full redraw of the same state
+    ScoreboardRenderer fresh;
+    fresh.LoadTemplate(layout, error);
+    fresh.SetField("p1.wins", "2");
+    fresh.SetImage("p1.portrait", &portrait, 7);
+    fresh.Render();
+    for (int y = 0; y < 32; y++) {
+        for (int x = 0; x < 64; x++) {
+            if (fresh.GetCanvas().Row(y)[x] != canvas.Row(y)[x]) {
+                failure = "incremental render differs from a full one at " + std::to_string(x) + "," +
+                          std::to_string(y);
+                return false;
+            }
+        }
+    }
+
+    renderer.SetImage("p1.portrait", nullptr, 0);
+    renderer.Render();
+    if (canvas.Row(10)[5] != 0x80000000) {
+        failure = "removed portrait still drawn";
+        return false;
+    }
+    Stats counters = renderer.GetStats();
+    if (counters.renders != 4 || counters.fullRedraws != 1 || counters.skipped != 2) {
+        failure = "stats: " + std::to_string(counters.renders) + " renders, " + std::to_string(counters.skipped) +
+                  " skipped";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,527 @@
+#include "../include/signature_scanner.h"
+#include <chrono>
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#include <immintrin.h>
+#define EFZ_SCANNER_SSE2 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define EFZ_TARGET_AVX2
+#else
+#define EFZ_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+enum SimdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE2,
+    SIMD_AVX2
+};
+
+// AVX2 needs both the CPU flag and the OS saving YMM state
+SimdLevel DetectSimdLevel() {
+#ifdef EFZ_SCANNER_SSE2
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (osxsave && avx && (_xgetbv(0) & 6) == 6) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5)) {
+                return SIMD_AVX2;
+            }
+        }
+    }
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+#endif
+    return SIMD_SSE2;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+SimdLevel GetLevel() {
+    static const SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+inline unsigned LowestBit(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+inline bool MatchAt(const uint8_t* data, const BytePattern& pattern) {
+    const uint8_t* bytes = pattern.bytes.data();
+    const uint8_t* mask = pattern.mask.data();
+    size_t length = pattern.bytes.size();
+    for (size_t i = 0; i < length; i++) {
+        if ((data[i] ^ bytes[i]) & mask[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef EFZ_SCANNER_SSE2
+// Each bit of the filter mask is a start position whose first and last
+// fixed bytes both match; only those are verified in full
+size_t FindSse2(const uint8_t* data, size_t size, const BytePattern& pattern, size_t pos) {
+    size_t lastStart = size - pattern.bytes.size();
+    const __m128i first = _mm_set1_epi8((char)pattern.bytes[pattern.first]);
+    const __m128i last = _mm_set1_epi8((char)pattern.bytes[pattern.last]);
+    for (; pos + 16 <= lastStart + 1; pos += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + pattern.first));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + pattern.last));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            size_t candidate = pos + LowestBit(mask);
+            if (MatchAt(data + candidate, pattern)) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return pos;     // Tail is left to the scalar loop
+}
+
+EFZ_TARGET_AVX2
+size_t FindAvx2(const uint8_t* data, size_t size, const BytePattern& pattern, size_t pos) {
+    size_t lastStart = size - pattern.bytes.size();
+    const __m256i first = _mm256_set1_epi8((char)pattern.bytes[pattern.first]);
+    const __m256i last = _mm256_set1_epi8((char)pattern.bytes[pattern.last]);
+    for (; pos + 32 <= lastStart + 1; pos += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos + pattern.first));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos + pattern.last));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        while (mask) {
+            size_t candidate = pos + LowestBit(mask);
+            if (MatchAt(data + candidate, pattern)) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return pos;
+}
+#endif
+
+int HexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+uint32_t Load32(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint16_t Load16(const uint8_t* data) {
+    uint16_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// PE layout constants (winnt.h), spelled out so the scanner builds anywhere
+const uint32_t PE_SIGNATURE = 0x00004550;   // "PE\0\0"
+const uint32_t SECTION_HEADER_SIZE = 40;
+const uint32_t SCN_CNT_CODE = 0x00000020;
+const uint32_t SCN_CNT_INITIALIZED_DATA = 0x00000040;
+const uint32_t SCN_CNT_UNINITIALIZED_DATA = 0x00000080;
+const uint32_t SCN_MEM_EXECUTE = 0x20000000;
+
+}
+
+bool BytePattern::Parse(const std::string& text, BytePattern& pattern, std::string& error) {
+    BytePattern parsed;
+    size_t i = 0;
+    while (i < text.size()) {
+        if (text[i] == ' ') {
+            i++;
+            continue;
+        }
+        if (text[i] == '?') {
+            parsed.bytes.push_back(0);
+            parsed.mask.push_back(0);
+            i += (i + 1 < text.size() && text[i + 1] == '?') ? 2 : 1;
+            continue;
+        }
+        int high = HexDigit(text[i]);
+        int low = (i + 1 < text.size()) ? HexDigit(text[i + 1]) : -1;
+        if (high < 0 || low < 0) {
+            error = "bad byte at position " + std::to_string(i) + " in \"" + text + "\"";
+            return false;
+        }
+        parsed.bytes.push_back((uint8_t)(high * 16 + low));
+        parsed.mask.push_back(0xFF);
+        i += 2;
+    }
+
+    parsed.first = parsed.bytes.size();
+    for (size_t k = 0; k < parsed.bytes.size(); k++) {
+        if (parsed.mask[k]) {
+            if (parsed.first == parsed.bytes.size()) {
+                parsed.first = k;
+            }
+            parsed.last = k;
+        }
+    }
+    if (parsed.first == parsed.bytes.size()) {
+        error = "pattern \"" + text + "\" has no fixed bytes";
+        return false;
+    }
+    pattern = parsed;
+    return true;
+}
+
+const char* SignatureScanner::GetSimdLevel() {
+    switch (GetLevel()) {
+        case SIMD_AVX2: return "AVX2";
+        case SIMD_SSE2: return "SSE2";
+        default: return "scalar";
+    }
+}
+
+size_t SignatureScanner::FindScalar(const uint8_t* data, size_t size, const BytePattern& pattern, size_t start) {
+    size_t length = pattern.bytes.size();
+    if (length == 0 || size < length) {
+        return NOT_FOUND;
+    }
+    for (size_t pos = start; pos + length <= size; pos++) {
+        if (MatchAt(data + pos, pattern)) {
+            return pos;
+        }
+    }
+    return NOT_FOUND;
+}
+
+size_t SignatureScanner::Find(const uint8_t* data, size_t size, const BytePattern& pattern, size_t start) {
+    size_t length = pattern.bytes.size();
+    if (length == 0 || size < length || start > size - length) {
+        return NOT_FOUND;
+    }
+    size_t pos = start;
+#ifdef EFZ_SCANNER_SSE2
+    SimdLevel level = GetLevel();
+    if (level == SIMD_AVX2) {
+        pos = FindAvx2(data, size, pattern, pos);
+    } else if (level == SIMD_SSE2) {
+        pos = FindSse2(data, size, pattern, pos);
+    }
+    // A SIMD hit returns its position, which the scalar loop confirms at
+    // once; otherwise pos is where the unfiltered tail starts
+#endif
+    return FindScalar(data, size, pattern, pos);
+}
+
+bool SignatureScanner::GetSections(const uint8_t* image, size_t size, bool code, std::vector<ImageRange>& sections) {
+    sections.clear();
+    if (size < 0x40) {
+        return false;
+    }
+    uint32_t ntOffset = Load32(image + 0x3C);
+    if ((uint64_t)ntOffset + 24 > size || Load32(image + ntOffset) != PE_SIGNATURE) {
+        return false;
+    }
+    uint32_t sectionCount = Load16(image + ntOffset + 4 + 2);
+    uint32_t optionalHeaderSize = Load16(image + ntOffset + 4 + 16);
+    uint64_t table = (uint64_t)ntOffset + 4 + 20 + optionalHeaderSize;
+    if (table + (uint64_t)sectionCount * SECTION_HEADER_SIZE > size) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < sectionCount; i++) {
+        const uint8_t* header = image + table + i * SECTION_HEADER_SIZE;
+        uint32_t virtualSize = Load32(header + 8);
+        uint32_t virtualAddress = Load32(header + 12);
+        uint32_t rawSize = Load32(header + 16);
+        uint32_t characteristics = Load32(header + 36);
+
+        bool isCode = (characteristics & (SCN_CNT_CODE | SCN_MEM_EXECUTE)) != 0;
+        bool isData = !isCode && (characteristics & (SCN_CNT_INITIALIZED_DATA | SCN_CNT_UNINITIALIZED_DATA)) != 0;
+        if ((code && !isCode) || (!code && !isData)) {
+            continue;
+        }
+        uint32_t extent = virtualSize ? virtualSize : rawSize;
+        if (virtualAddress >= size) {
+            continue;
+        }
+        if (extent > size - virtualAddress) {
+            extent = (uint32_t)(size - virtualAddress);
+        }
+        sections.push_back({ virtualAddress, extent });
+    }
+    return true;
+}
+
+bool SignatureScanner::Resolve(const uint8_t* image, size_t imageSize, uint32_t imageBase, const SignatureSpec& spec,
+                               uint32_t& rva, std::string& error) {
+    BytePattern pattern;
+    if (!BytePattern::Parse(spec.pattern, pattern, error)) {
+        return false;
+    }
+    if ((size_t)spec.operand + 4 > pattern.bytes.size()) {
+        error = "operand at +" + std::to_string(spec.operand) + " is past the end of the pattern";
+        return false;
+    }
+
+    std::vector<ImageRange> code;
+    if (!GetSections(image, imageSize, true, code) || code.empty()) {
+        error = "no code sections in the image";
+        return false;
+    }
+
+    bool found = false;
+    uint32_t target = 0;
+    size_t scanned = 0;
+    for (const ImageRange& section : code) {
+        const uint8_t* data = image + section.offset;
+        scanned += section.size;
+        for (size_t pos = Find(data, section.size, pattern); pos != NOT_FOUND; pos = Find(data, section.size, pattern, pos + 1)) {
+            uint32_t matchRva = section.offset + (uint32_t)pos;
+            uint32_t value = Load32(data + pos + spec.operand);
+            uint32_t candidate = (spec.kind == OPERAND_ABSOLUTE)
+                ? value - imageBase
+                : matchRva + spec.operand + 4 + value;
+            if (found && candidate != target) {
+                error = "pattern is ambiguous (refers to both +" + std::to_string(target) + " and +" +
+                        std::to_string(candidate) + ")";
+                return false;
+            }
+            found = true;
+            target = candidate;
+        }
+    }
+    if (!found) {
+        error = "pattern not found in " + std::to_string(scanned) + " bytes of code";
+        return false;
+    }
+    if (target >= imageSize) {
+        error = "operand refers outside the image";
+        return false;
+    }
+
+    // A global lives in .data/.bss; anything else means the pattern matched the wrong code
+    if (spec.kind == OPERAND_ABSOLUTE) {
+        std::vector<ImageRange> dataSections;
+        GetSections(image, imageSize, false, dataSections);
+        bool inData = false;
+        for (const ImageRange& section : dataSections) {
+            if (target >= section.offset && target - section.offset < section.size) {
+                inData = true;
+            }
+        }
+        if (!inData) {
+            error = "operand does not refer to a data section";
+            return false;
+        }
+    }
+    rva = target;
+    return true;
+}
+
+namespace {
+
+uint32_t NextRandom(uint32_t& seed) {
+    seed = seed * 1664525u + 1013904223u;
+    return seed;
+}
+
+void FillRandom(std::vector<uint8_t>& buffer, uint32_t seed) {
+    for (uint8_t& byte : buffer) {
+        byte = (uint8_t)(NextRandom(seed) >> 24);
+    }
+}
+
+void Store32(uint8_t* data, uint32_t value) {
+    memcpy(data, &value, sizeof(value));
+}
+
+void Store16(uint8_t* data, uint16_t value) {
+    memcpy(data, &value, sizeof(value));
+}
+
+void Plant(std::vector<uint8_t>& buffer, size_t pos, const BytePattern& pattern, uint32_t seed) {
+    for (size_t i = 0; i < pattern.bytes.size(); i++) {
+        buffer[pos + i] = pattern.mask[i] ? pattern.bytes[i] : (uint8_t)(NextRandom(seed) >> 24);
+    }
+}
+
+std::vector<size_t> FindAll(const std::vector<uint8_t>& buffer, const BytePattern& pattern, bool scalar) {
+    std::vector<size_t> matches;
+    size_t pos = 0;
+    while (true) {
+        pos = scalar ? SignatureScanner::FindScalar(buffer.data(), buffer.size(), pattern, pos)
+                     : SignatureScanner::Find(buffer.data(), buffer.size(), pattern, pos);
+        if (pos == SignatureScanner::NOT_FOUND) {
+            break;
+        }
+        matches.push_back(pos++);
+    }
+    return matches;
+}
+
+// Minimal mapped PE: headers, one code section and one data section
+const uint32_t TEST_IMAGE_BASE = 0x10000000;
+const uint32_t TEST_TEXT_RVA = 0x1000;
+const uint32_t TEST_TEXT_SIZE = 0x40000;
+const uint32_t TEST_DATA_RVA = 0x41000;
+const uint32_t TEST_DATA_SIZE = 0x10000;
+
+std::vector<uint8_t> MakeTestImage(uint32_t seed) {
+    std::vector<uint8_t> image(TEST_DATA_RVA + TEST_DATA_SIZE);
+    FillRandom(image, seed);
+    memset(image.data(), 0, TEST_TEXT_RVA);
+    uint32_t ntOffset = 0x80;
+    Store32(&image[0x3C], ntOffset);
+    Store32(&image[ntOffset], PE_SIGNATURE);
+    Store16(&image[ntOffset + 4 + 2], 2);           // NumberOfSections
+    Store16(&image[ntOffset + 4 + 16], 0xE0);       // SizeOfOptionalHeader
+    uint8_t* table = &image[ntOffset + 4 + 20 + 0xE0];
+    memcpy(table, ".text", 5);
+    Store32(table + 8, TEST_TEXT_SIZE);
+    Store32(table + 12, TEST_TEXT_RVA);
+    Store32(table + 36, SCN_CNT_CODE | SCN_MEM_EXECUTE);
+    memcpy(table + 40, ".data", 5);
+    Store32(table + 40 + 8, TEST_DATA_SIZE);
+    Store32(table + 40 + 12, TEST_DATA_RVA);
+    Store32(table + 40 + 36, SCN_CNT_INITIALIZED_DATA);
+    return image;
+}
+
+}
+
+bool SignatureScanner::RunSelfTest(std::string& failure) {
+    failure.clear();
+    std::string error;
+    BytePattern pattern;
+    if (!BytePattern::Parse("8B 0D ?? ?? ?? ?? 8B 81 C8 04 00 00", pattern, error) ||
+        pattern.bytes.size() != 12 || pattern.first != 0 || pattern.last != 11 || pattern.mask[2] != 0) {
+        failure = "parse: " + error;
+        return false;
+    }
+    BytePattern rejected;
+    if (BytePattern::Parse("?? ? ??", rejected, error) || BytePattern::Parse("8B 0G", rejected, error)) {
+        failure = "parse accepted a pattern without fixed bytes or with a bad digit";
+        return false;
+    }
+
+    // Planted matches (start, SIMD block edges, the very end) and decoys that
+    // pass the first/last byte filter but not the full compare
+    std::vector<uint8_t> buffer((1 << 20) + 37);
+    FillRandom(buffer, 12345);
+    std::vector<size_t> planted = { 0, 17, 1000, 4093, 65535 - 6, 500000, buffer.size() - pattern.bytes.size() };
+    for (size_t pos : planted) {
+        Plant(buffer, pos, pattern, (uint32_t)pos);
+    }
+    for (size_t pos = 2000; pos < 400000; pos += 7919) {
+        Plant(buffer, pos, pattern, (uint32_t)pos);
+        buffer[pos + 7] ^= 0x40;
+    }
+    std::vector<size_t> fast = FindAll(buffer, pattern, false);
+    std::vector<size_t> scalar = FindAll(buffer, pattern, true);
+    if (fast != planted || scalar != planted) {
+        failure = "planted signatures: found " + std::to_string(fast.size()) + " (" + GetSimdLevel() + "), " +
+                  std::to_string(scalar.size()) + " (scalar), planted " + std::to_string(planted.size());
+        return false;
+    }
+
+    // One fixed byte among wildcards: many hits, SIMD and scalar must agree
+    BytePattern sparse;
+    BytePattern::Parse("?? E8 ?? ??", sparse, error);
+    if (FindAll(buffer, sparse, false) != FindAll(buffer, sparse, true)) {
+        failure = "single fixed byte pattern: SIMD and scalar disagree";
+        return false;
+    }
+
+    // Resolution through code sections of a synthetic PE image
+    SignatureSpec spec = { "8B 0D ?? ?? ?? ?? 8B 81 C8 04 00 00", 2, OPERAND_ABSOLUTE };
+    const uint32_t global = TEST_DATA_RVA + 0x2CC;
+    std::vector<uint8_t> image = MakeTestImage(777);
+    uint8_t instruction[12] = { 0x8B, 0x0D, 0, 0, 0, 0, 0x8B, 0x81, 0xC8, 0x04, 0x00, 0x00 };
+    Store32(instruction + 2, TEST_IMAGE_BASE + global);
+    memcpy(&image[TEST_TEXT_RVA + 0x1234], instruction, sizeof(instruction));
+    memcpy(&image[TEST_TEXT_RVA + 0x3FF00], instruction, sizeof(instruction));     // Same global twice is fine
+    Store32(instruction + 2, TEST_IMAGE_BASE + global + 0x100);
+    memcpy(&image[TEST_DATA_RVA + 0x40], instruction, sizeof(instruction));        // Data is never scanned
+
+    uint32_t rva = 0;
+    if (!Resolve(image.data(), image.size(), TEST_IMAGE_BASE, spec, rva, error) || rva != global) {
+        failure = "resolve absolute: " + (error.empty() ? "rva " + std::to_string(rva) : error);
+        return false;
+    }
+
+    uint8_t call[8] = { 0xE8, 0, 0, 0, 0, 0x85, 0xC0, 0x74 };
+    const uint32_t callRva = TEST_TEXT_RVA + 0x2000;
+    const uint32_t function = TEST_TEXT_RVA + 0x100;
+    Store32(call + 1, function - (callRva + 5));
+    memcpy(&image[callRva], call, sizeof(call));
+    SignatureSpec relative = { "E8 ?? ?? ?? ?? 85 C0 74", 1, OPERAND_RELATIVE };
+    if (!Resolve(image.data(), image.size(), TEST_IMAGE_BASE, relative, rva, error) || rva != function) {
+        failure = "resolve relative: " + (error.empty() ? "rva " + std::to_string(rva) : error);
+        return false;
+    }
+
+    // A second site referring elsewhere makes the signature useless
+    memcpy(&image[TEST_TEXT_RVA + 0x20000], instruction, sizeof(instruction));
+    if (Resolve(image.data(), image.size(), TEST_IMAGE_BASE, spec, rva, error)) {
+        failure = "ambiguous signature was accepted";
+        return false;
+    }
+    // An absolute operand into code is not a global
+    image = MakeTestImage(778);
+    Store32(instruction + 2, TEST_IMAGE_BASE + TEST_TEXT_RVA + 0x10);
+    memcpy(&image[TEST_TEXT_RVA + 0x500], instruction, sizeof(instruction));
+    if (Resolve(image.data(), image.size(), TEST_IMAGE_BASE, spec, rva, error)) {
+        failure = "operand into the code section was accepted";
+        return false;
+    }
+
+    return true;
+}
+
+SignatureScanner::BenchmarkResult SignatureScanner::RunBenchmark(size_t imageSize) {
+    std::vector<uint8_t> image(imageSize);
+    FillRandom(image, 4242);
+    BytePattern pattern;
+    std::string error;
+    // Common opcode bytes so the filter sees realistic candidate rates; never completes
+    BytePattern::Parse("8B 0D ?? ?? ?? ?? 8B 81 C8 04 00 00 CC CC", pattern, error);
+
+    BenchmarkResult result = {};
+    result.megabytes = (double)imageSize / (1024.0 * 1024.0);
+    result.level = GetSimdLevel();
+    result.fastMs = 1e30;
+    result.scalarMs = 1e30;
+    volatile size_t sink = 0;
+    for (int round = 0; round < 5; round++) {
+        auto start = std::chrono::steady_clock::now();
+        sink = sink + Find(image.data(), image.size(), pattern);
+        auto middle = std::chrono::steady_clock::now();
+        sink = sink + FindScalar(image.data(), image.size(), pattern);
+        auto end = std::chrono::steady_clock::now();
+        double fastMs = std::chrono::duration<double, std::milli>(middle - start).count();
+        double scalarMs = std::chrono::duration<double, std::milli>(end - middle).count();
+        result.fastMs = fastMs < result.fastMs ? fastMs : result.fastMs;
+        result.scalarMs = scalarMs < result.scalarMs ? scalarMs : result.scalarMs;
+    }
+    return result;
+}
@@ -0,0 +1,320 @@
+#include "../include/utf_transcoder.h"
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define EFZ_UTF_SSE2 1
+#endif
+
+size_t Utf16Transcoder::EncodeOne(const char16_t* input, size_t length, size_t& index, char* output, size_t remaining) {
+    uint32_t c = input[index];
+    size_t consumed = 1;
+
+    if (c >= 0xD800 && c <= 0xDFFF) {
+        if (c <= 0xDBFF && index + 1 < length && input[index + 1] >= 0xDC00 && input[index + 1] <= 0xDFFF) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (input[index + 1] - 0xDC00);
+            consumed = 2;
+        } else {
+            c = 0xFFFD; // Unpaired surrogate
+        }
+    }
+
+    if (c < 0x80) {
+        if (remaining < 1) return 0;
+        output[0] = (char)c;
+        index += consumed;
+        return 1;
+    }
+    if (c < 0x800) {
+        if (remaining < 2) return 0;
+        output[0] = (char)(0xC0 | (c >> 6));
+        output[1] = (char)(0x80 | (c & 0x3F));
+        index += consumed;
+        return 2;
+    }
+    if (c < 0x10000) {
+        if (remaining < 3) return 0;
+        output[0] = (char)(0xE0 | (c >> 12));
+        output[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+        output[2] = (char)(0x80 | (c & 0x3F));
+        index += consumed;
+        return 3;
+    }
+    if (remaining < 4) return 0;
+    output[0] = (char)(0xF0 | (c >> 18));
+    output[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+    output[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+    output[3] = (char)(0x80 | (c & 0x3F));
+    index += consumed;
+    return 4;
+}
+
+size_t Utf16Transcoder::ToUtf8Scalar(const char16_t* input, size_t length, char* output, size_t capacity) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < length) {
+        size_t written = EncodeOne(input, length, in, output + out, capacity - out);
+        if (written == 0) break;
+        out += written;
+    }
+    return out;
+}
+
+size_t Utf16Transcoder::ToUtf8(const char16_t* input, size_t length, char* output, size_t capacity) {
+    size_t in = 0;
+    size_t out = 0;
+
+#ifdef EFZ_UTF_SSE2
+    const __m128i nonAsciiMask = _mm_set1_epi16((short)0xFF80);
+    const __m128i zero = _mm_setzero_si128();
+    while (in + 16 <= length && out + 16 <= capacity) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + in));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + in + 8));
+        // One bit per unit, set when the unit is ASCII
+        __m128i asciiA = _mm_cmpeq_epi16(_mm_and_si128(a, nonAsciiMask), zero);
+        __m128i asciiB = _mm_cmpeq_epi16(_mm_and_si128(b, nonAsciiMask), zero);
+        unsigned int asciiBits = (unsigned int)_mm_movemask_epi8(_mm_packs_epi16(asciiA, asciiB));
+
+        // Narrow all 16 units in one store; only the ASCII prefix is kept
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + out), _mm_packus_epi16(a, b));
+        if (asciiBits == 0xFFFF) {
+            in += 16;
+            out += 16;
+            continue;
+        }
+        size_t prefix = 0;
+        while (asciiBits & (1u << prefix)) {
+            prefix++;
+        }
+        in += prefix;
+        out += prefix;
+
+        // Finish this block unit by unit, then retry the wide path
+        size_t blockEnd = in - prefix + 16;
+        while (in < blockEnd) {
+            size_t written = EncodeOne(input, length, in, output + out, capacity - out);
+            if (written == 0) return out;
+            out += written;
+        }
+    }
+#endif
+
+    while (in < length) {
+        size_t written = EncodeOne(input, length, in, output + out, capacity - out);
+        if (written == 0) break;
+        out += written;
+    }
+    return out;
+}
+
+std::string Utf16Transcoder::ToUtf8(const char16_t* input, size_t length) {
+    std::string result(length * MAX_UTF8_PER_UNIT, '\0');
+    if (length > 0) {
+        result.resize(ToUtf8(input, length, &result[0], result.size()));
+    }
+    return result;
+}
+
+std::string Utf16Transcoder::ToUtf8(const std::u16string& input) {
+    return ToUtf8(input.data(), input.size());
+}
+
+// Random input biased towards the cases that matter: ASCII runs long enough to
+// hit the SIMD path, every UTF-8 length class, valid pairs and lone surrogates
+static void GenerateFuzzInput(uint32_t& seed, std::u16string& text) {
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+
+    text.clear();
+    size_t target = (next() % 8 == 0) ? next() % 300 : next() % 48;
+    while (text.size() < target) {
+        switch (next() % 20) {
+        case 0: case 1: case 2: case 3: case 4: case 5: case 6: case 7: {
+            size_t run = 1 + next() % 40;
+            for (size_t i = 0; i < run; i++) text += (char16_t)(next() % 0x80);
+            break;
+        }
+        case 8: case 9: case 10:
+            text += (char16_t)(0x80 + next() % (0x800 - 0x80));
+            break;
+        case 11: case 12: case 13: {
+            char16_t c = (char16_t)(0x800 + next() % (0x10000 - 0x800));
+            text += (c >= 0xD800 && c <= 0xDFFF) ? (char16_t)0x3042 : c;
+            break;
+        }
+        case 14: case 15: case 16:
+            text += (char16_t)(0xD800 + next() % 0x400);
+            text += (char16_t)(0xDC00 + next() % 0x400);
+            break;
+        case 17: case 18:
+            text += (char16_t)(0xD800 + next() % 0x400); // Lone high (unless a low follows by chance)
+            break;
+        default:
+            text += (char16_t)(0xDC00 + next() % 0x400); // Lone low
+            break;
+        }
+    }
+}
+
+static std::string DescribeInput(const std::u16string& text) {
+    static const char hex[] = "0123456789ABCDEF";
+    std::string description;
+    for (size_t i = 0; i < text.size() && i < 24; i++) {
+        char16_t c = text[i];
+        description += hex[(c >> 12) & 0xF];
+        description += hex[(c >> 8) & 0xF];
+        description += hex[(c >> 4) & 0xF];
+        description += hex[c & 0xF];
+        description += ' ';
+    }
+    if (text.size() > 24) description += "...";
+    return description;
+}
+
+#ifdef _WIN32
+// The OS converter as a third opinion; elsewhere the fixed vectors and the
+// scalar path are the reference
+static std::string SystemToUtf8(const std::u16string& text) {
+    static_assert(sizeof(wchar_t) == sizeof(char16_t), "WideCharToMultiByte expects UTF-16 wchar_t");
+    if (text.empty()) return std::string();
+    const wchar_t* wide = reinterpret_cast<const wchar_t*>(text.data());
+    int size = WideCharToMultiByte(CP_UTF8, 0, wide, (int)text.size(), nullptr, 0, nullptr, nullptr);
+    std::string result(size, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, wide, (int)text.size(), &result[0], size, nullptr, nullptr);
+    return result;
+}
+#endif
+
+bool Utf16Transcoder::RunFuzzTest(size_t iterations, std::string& failure) {
+    struct Vector {
+        std::u16string input;
+        const char* expected;
+    };
+    const Vector vectors[] = {
+        { u"", "" },
+        { u"Player 1", "Player 1" },
+        { std::u16string(1, (char16_t)0x7F), "\x7F" },
+        { std::u16string(1, (char16_t)0x80), "\xC2\x80" },
+        { std::u16string(1, (char16_t)0x7FF), "\xDF\xBF" },
+        { std::u16string(1, (char16_t)0x800), "\xE0\xA0\x80" },
+        { std::u16string(1, (char16_t)0xFFFF), "\xEF\xBF\xBF" },
+        { u"\xD83D\xDE00", "\xF0\x9F\x98\x80" },             // Valid pair
+        { std::u16string(1, (char16_t)0xD83D), "\xEF\xBF\xBD" }, // Lone high at end
+        { std::u16string(1, (char16_t)0xDE00), "\xEF\xBF\xBD" }, // Lone low
+        { std::u16string({ (char16_t)0xDE00, (char16_t)0xD83D }), "\xEF\xBF\xBD\xEF\xBF\xBD" }, // Reversed pair
+        { std::u16string(15, u'a') + u"\xD83D\xDE00", "aaaaaaaaaaaaaaa\xF0\x9F\x98\x80" }, // Pair straddling a block
+    };
+    for (const Vector& vector : vectors) {
+        bool matches = ToUtf8(vector.input) == vector.expected;
+#ifdef _WIN32
+        matches = matches && SystemToUtf8(vector.input) == vector.expected;
+#endif
+        if (!matches) {
+            failure = "Fixed vector mismatch for input [" + DescribeInput(vector.input) + "]";
+            return false;
+        }
+    }
+
+    uint32_t seed = 0xC0FFEE11;
+    std::u16string text;
+    std::vector<char> fast, scalar;
+    for (size_t iteration = 0; iteration < iterations; iteration++) {
+        GenerateFuzzInput(seed, text);
+        size_t capacity = text.size() * MAX_UTF8_PER_UNIT;
+        fast.assign(capacity + 1, '\0');
+        scalar.assign(capacity + 1, '\0');
+
+        size_t fastLength = ToUtf8(text.data(), text.size(), fast.data(), capacity);
+        size_t scalarLength = ToUtf8Scalar(text.data(), text.size(), scalar.data(), capacity);
+#ifdef _WIN32
+        std::string expected = SystemToUtf8(text);
+#else
+        std::string expected(scalar.data(), scalarLength);
+#endif
+        if (fastLength != scalarLength || memcmp(fast.data(), scalar.data(), fastLength) != 0 ||
+            expected.size() != fastLength || memcmp(expected.data(), fast.data(), fastLength) != 0) {
+            failure = "Iteration " + std::to_string(iteration) + ": fast " + std::to_string(fastLength) +
+                      " bytes, scalar " + std::to_string(scalarLength) + " bytes, reference " +
+                      std::to_string(expected.size()) + " bytes for [" + DescribeInput(text) + "]";
+            return false;
+        }
+
+        // Truncated output must be the longest whole-code-point prefix that fits
+        seed = seed * 1664525u + 1013904223u;
+        size_t limit = fastLength ? (seed >> 8) % (fastLength + 1) : 0;
+        size_t truncatedLength = ToUtf8(text.data(), text.size(), fast.data(), limit);
+        size_t boundary = limit;
+        while (boundary > 0 && boundary < expected.size() && (expected[boundary] & 0xC0) == 0x80) {
+            boundary--;
+        }
+        if (truncatedLength != boundary || memcmp(fast.data(), expected.data(), truncatedLength) != 0) {
+            failure = "Iteration " + std::to_string(iteration) + ": capacity " + std::to_string(limit) +
+                      " produced " + std::to_string(truncatedLength) + " bytes, expected " +
+                      std::to_string(boundary) + " for [" + DescribeInput(text) + "]";
+            return false;
+        }
+    }
+    return true;
+}
+
+Utf16Transcoder::BenchmarkResult Utf16Transcoder::RunBenchmark(size_t units, bool asciiOnly) {
+    std::u16string text(units, u' ');
+    uint32_t seed = 0x2468ACE0;
+    for (size_t i = 0; i < units; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t r = seed >> 8;
+        if (asciiOnly || r % 10 < 7) {
+            text[i] = (char16_t)(0x20 + r % 0x5F);
+        } else if (r % 10 < 9) {
+            text[i] = (char16_t)(0x4E00 + r % 0x5000); // CJK
+        } else {
+            text[i] = (char16_t)(0x0410 + r % 0x40);   // Cyrillic
+        }
+    }
+
+    std::vector<char> output(units * MAX_UTF8_PER_UNIT);
+    const int passes = 20;
+    std::chrono::steady_clock::time_point start, end;
+    double megabytes = (double)units * sizeof(char16_t) * passes / 1000000.0;
+    auto throughput = [&]() {
+        double seconds = std::chrono::duration<double>(end - start).count();
+        return seconds > 0 ? megabytes / seconds : 0.0;
+    };
+
+    BenchmarkResult result = {};
+    volatile size_t sink = 0;
+
+    start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; pass++) {
+        sink = sink + ToUtf8(text.data(), units, output.data(), output.size());
+    }
+    end = std::chrono::steady_clock::now();
+    result.fastMBps = throughput();
+
+    start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; pass++) {
+        sink = sink + ToUtf8Scalar(text.data(), units, output.data(), output.size());
+    }
+    end = std::chrono::steady_clock::now();
+    result.scalarMBps = throughput();
+
+#ifdef _WIN32
+    const wchar_t* wide = reinterpret_cast<const wchar_t*>(text.data());
+    start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; pass++) {
+        sink = sink + WideCharToMultiByte(CP_UTF8, 0, wide, (int)units, output.data(), (int)output.size(), nullptr, nullptr);
+    }
+    end = std::chrono::steady_clock::now();
+    result.systemMBps = throughput();
+#endif
+
+    return result;
+}
@@ -0,0 +1,355 @@
+#include "../include/widget_image.h"
+#include "../include/game_data.h"
+#include "../include/combo_tracker.h"
+#include "../include/highlight_log.h"
+#include "../include/match_history.h"
+#include "../include/scheduling_policy.h"
+#include "../include/logger.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+OverlayWidgets::Config WidgetImage::config;
+OverlayWidgets* WidgetImage::widgets = nullptr;
+bool WidgetImage::enabled = true;
+int WidgetImage::frameRate = 30;
+PngWriter::Mode WidgetImage::mode = PngWriter::FAST;
+bool WidgetImage::writeFile = false;
+std::string WidgetImage::imagePath;
+std::string WidgetImage::headToHead;
+HANDLE WidgetImage::frameMapping = nullptr;
+void* WidgetImage::frameView = nullptr;
+FrameShareWriter* WidgetImage::frameWriter = nullptr;
+HANDLE WidgetImage::wakeEvent = nullptr;
+HANDLE WidgetImage::renderThread = nullptr;
+std::atomic<bool> WidgetImage::stopping(false);
+std::mutex WidgetImage::lock;
+WidgetState WidgetImage::state = {};
+int64_t WidgetImage::stateUs = 0;
+WidgetImage::Stats WidgetImage::stats = {};
+
+// Longer than any frame; a render thread still busy after it is left running
+static const DWORD RENDER_STOP_TIMEOUT_MS = 1000;
+
+static int64_t QpcMicros() {
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (int64_t)(counter.QuadPart / frequency.QuadPart * 1000000 +
+                     counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
+
+static bool ReadFileBytes(const std::string& path, std::vector<uint8_t>& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !data.empty();
+}
+
+void WidgetImage::LoadConfig(const std::string& path) {
+    const char* section = "Widgets";
+    const char* file = path.c_str();
+
+    if (!std::filesystem::exists(path)) {
+        WritePrivateProfileStringA(section, "Enabled", "1", file);
+        WritePrivateProfileStringA(section, "Width", "640", file);
+        WritePrivateProfileStringA(section, "Height", "150", file);
+        WritePrivateProfileStringA(section, "Font", "", file);
+        WritePrivateProfileStringA(section, "FontSize", "18", file);
+        WritePrivateProfileStringA(section, "FrameRate", "30", file);
+        WritePrivateProfileStringA(section, "MaxHp", "10000", file);
+        WritePrivateProfileStringA(section, "TickerSpeed", "60", file);
+        // The ticker moves every frame, so a file would be rewritten at FrameRate
+        WritePrivateProfileStringA(section, "Encoding", "none", file);
+    }
+
+    enabled = GetPrivateProfileIntA(section, "Enabled", 1, file) != 0;
+    config.width = std::clamp((int)GetPrivateProfileIntA(section, "Width", 640, file), 16, 4096);
+    config.height = std::clamp((int)GetPrivateProfileIntA(section, "Height", 150, file), 16, 4096);
+    config.fontSize = (float)std::clamp((int)GetPrivateProfileIntA(section, "FontSize", 18, file), 6, 96);
+    frameRate = std::clamp((int)GetPrivateProfileIntA(section, "FrameRate", 30, file), 1, 120);
+    config.maxHp = (int32_t)GetPrivateProfileIntA(section, "MaxHp", config.maxHp, file);
+    config.tickerSpeed = (float)GetPrivateProfileIntA(section, "TickerSpeed", 60, file);
+
+    // Relative to the overlay directory; empty keeps ImGui's built-in font
+    char font[MAX_PATH] = {};
+    GetPrivateProfileStringA(section, "Font", "", font, sizeof(font), file);
+    config.font.clear();
+    if (font[0] != '\0') {
+        std::filesystem::path fontPath = font;
+        if (fontPath.is_relative()) {
+            fontPath = std::filesystem::path(path).parent_path() / fontPath;
+        }
+        if (!ReadFileBytes(fontPath.string(), config.font)) {
+            Logger::Warning("Widget font not found: " + fontPath.string() + "; using the built-in font");
+        }
+    }
+
+    char encoding[32] = {};
+    GetPrivateProfileStringA(section, "Encoding", "none", encoding, sizeof(encoding), file);
+    mode = PngWriter::FAST;
+    writeFile = std::string(encoding) != "none";
+    if (writeFile && !PngWriter::ParseMode(encoding, mode)) {
+        Logger::Warning(std::string("Widget encoding '") + encoding + "' unknown (stored, rle, fast, none); using fast");
+    }
+}
+
+bool WidgetImage::Initialize(const std::string& directory) {
+    LoadConfig((std::filesystem::path(directory) / "widgets.ini").string());
+    if (!enabled) {
+        Logger::Info("Overlay widgets disabled");
+        return false;
+    }
+    imagePath = (std::filesystem::path(directory) / "widgets.png").string();
+
+    std::string error;
+    widgets = new OverlayWidgets();
+    if (!widgets->Initialize(config, error)) {
+        Logger::Error("Overlay widgets unavailable: " + error);
+        delete widgets;
+        widgets = nullptr;
+        return false;
+    }
+    state.hp[0] = state.hp[1] = -1;
+    state.rating[0] = state.rating[1] = -1;
+    state.pingMs = -1;
+    stateUs = QpcMicros();
+    OpenFrameShare();
+
+    wakeEvent = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+    renderThread = CreateThread(nullptr, 0, RenderThreadProc, nullptr, 0, nullptr);
+    if (!wakeEvent || !renderThread) {
+        LOG_WIN32_ERROR("Overlay widget render thread unavailable");
+        return false;
+    }
+    stats.ready = true;
+    Logger::Info("Overlay widgets: " + std::to_string(config.width) + "x" + std::to_string(config.height) + " at " +
+                 std::to_string(frameRate) + " fps, " +
+                 (writeFile ? std::string(PngWriter::GetModeName(mode)) + " PNG" : std::string("no PNG")) +
+                 ", rasterizer " + DrawListRasterizer::GetSimdLevel());
+    return true;
+}
+
+void WidgetImage::OpenFrameShare() {
+    uint32_t capacity = (uint32_t)config.width * (uint32_t)config.height * 4;
+    if (capacity < FRAME_SHARE_MIN_CAPACITY) {
+        capacity = FRAME_SHARE_MIN_CAPACITY;
+    }
+    size_t size = FrameShare::MappingSize(capacity);
+    frameMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)size,
+                                      FRAME_SHARE_WIDGETS_NAME);
+    if (!frameMapping) {
+        LOG_WIN32_ERROR("Widget frame mapping unavailable");
+        return;
+    }
+    frameView = MapViewOfFile(frameMapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!frameView) {
+        LOG_WIN32_ERROR("MapViewOfFile failed for widget frames");
+        CloseHandle(frameMapping);
+        frameMapping = nullptr;
+        return;
+    }
+    frameWriter = new FrameShareWriter(frameView, capacity);
+    Logger::Info(std::string("Widget frames shared as ") + FRAME_SHARE_WIDGETS_NAME + " (" + std::to_string(size) +
+                 " bytes)");
+}
+
+void WidgetImage::Shutdown() {
+    if (!stats.ready) {
+        return;
+    }
+    stats.ready = false;
+    stopping = true;
+    SetEvent(wakeEvent);
+    if (WaitForSingleObject(renderThread, RENDER_STOP_TIMEOUT_MS) != WAIT_OBJECT_0) {
+        // Still using the canvas and the mapping: leave both to the process teardown
+        Logger::Warning("Widget render thread did not stop; widget output left open");
+        return;
+    }
+    CloseHandle(renderThread);
+    renderThread = nullptr;
+
+    std::error_code ignored;
+    std::filesystem::remove(imagePath, ignored);
+    std::filesystem::remove(imagePath + ".tmp", ignored);
+    if (frameWriter) {
+        frameWriter->Close();
+        delete frameWriter;
+        frameWriter = nullptr;
+        UnmapViewOfFile(frameView);
+        CloseHandle(frameMapping);
+        frameView = nullptr;
+        frameMapping = nullptr;
+    }
+    delete widgets;
+    widgets = nullptr;
+    CloseHandle(wakeEvent);
+    wakeEvent = nullptr;
+}
+
+void WidgetImage::Abandon() {
+    // The render thread was terminated wherever it stood, maybe holding the
+    // state lock, the ImGui lock or the heap's: touch none of them
+    if (frameWriter) {
+        frameWriter->Close();
+        UnmapViewOfFile(frameView);
+        CloseHandle(frameMapping);
+        frameWriter = nullptr;
+    }
+}
+
+DWORD WINAPI WidgetImage::RenderThreadProc(LPVOID) {
+    // Same priority and cores as the loop thread, off the game's core
+    int appliedCore = SchedulingPolicy::GetGameCore();
+    SchedulingPolicy::ApplyToCurrentThread();
+    PngWriter writer;
+    const int64_t periodUs = 1000000 / frameRate;
+    int64_t next = QpcMicros();
+    while (!stopping) {
+        // The loop's recheck moved the game's core: move off it too
+        int core = SchedulingPolicy::GetGameCore();
+        if (core != appliedCore) {
+            appliedCore = core;
+            SchedulingPolicy::ApplyToCurrentThread();
+        }
+        RenderFrame(writer);
+        // Fixed cadence; a frame that overran starts the next one at once
+        next += periodUs;
+        int64_t now = QpcMicros();
+        if (next < now) {
+            next = now;
+        }
+        WaitForSingleObject(wakeEvent, (DWORD)((next - now) / 1000));
+    }
+    return 0;
+}
+
+void WidgetImage::RenderFrame(PngWriter& writer) {
+    WidgetState frame;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        frame = state;
+        frame.clockSeconds += (QpcMicros() - stateUs) / 1e6;
+    }
+    CanvasRect dirty = widgets->Render(frame, QpcMicros() / 1e6);
+
+    Stats rendered = {};
+    rendered.lastDirty = dirty;
+    if (!dirty.Empty()) {
+        if (frameWriter) {
+            frameWriter->Publish(widgets->GetCanvas(), dirty);
+        }
+        if (writeFile) {
+            int64_t start = QpcMicros();
+            const std::vector<uint8_t>& png = writer.Encode(widgets->GetCanvas(), mode);
+            int64_t encoded = QpcMicros();
+            rendered.images = WriteImage(png) ? 1 : 0;
+            rendered.lastEncodeUs = (double)(encoded - start);
+            rendered.lastWriteUs = (double)(QpcMicros() - encoded);
+            rendered.lastBytes = png.size();
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    stats.widgets = widgets->GetStats();
+    stats.frames = frameWriter ? frameWriter->GetStats() : FrameShareWriter::Stats{};
+    if (!dirty.Empty()) {
+        stats.lastDirty = rendered.lastDirty;
+    }
+    if (rendered.lastBytes) {
+        stats.images += rendered.images;
+        stats.lastEncodeUs = rendered.lastEncodeUs;
+        stats.lastWriteUs = rendered.lastWriteUs;
+        stats.lastBytes = rendered.lastBytes;
+    }
+}
+
+// Written beside the old file and moved over it so OBS never reads a
+// partial image
+bool WidgetImage::WriteImage(const std::vector<uint8_t>& png) {
+    std::string temporary = imagePath + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write((const char*)png.data(), (std::streamsize)png.size());
+        if (!file) {
+            Logger::Warning("Could not write " + temporary);
+            return false;
+        }
+    }
+    if (!MoveFileExA(temporary.c_str(), imagePath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        LOG_WIN32_ERROR("Could not replace widget image");
+        return false;
+    }
+    return true;
+}
+
+void WidgetImage::Update(const GameData& data, uint32_t fields) {
+    if (!stats.ready) {
+        return;
+    }
+    // Once per pairing, not per hit
+    if (fields & (FIELD_P1_NICKNAME | FIELD_P2_NICKNAME | FIELD_P1_STATS | FIELD_P2_STATS)) {
+        HeadToHeadRecord h2h = MatchHistory::GetHeadToHead(data.player1.nickname.str(), data.player2.nickname.str());
+        headToHead = h2h.sets > 0 ? "  Head-to-head " + std::to_string(h2h.firstWins) + " - " +
+                                        std::to_string(h2h.secondWins)
+                                  : "";
+    }
+
+    const ComboStats& combo = data.combo;
+    std::string ticker;
+    if (!data.player1.nickname.empty() && !data.player2.nickname.empty()) {
+        ticker = std::string(data.player1.nickname.c_str()) + " vs " + data.player2.nickname.c_str() + headToHead;
+        uint32_t best = std::max(combo.side[0].maxHits, combo.side[1].maxHits);
+        if (best > 0) {
+            ticker += "  Best combo " + std::to_string(best) + " hits";
+        }
+        if (data.netplay.pingMs >= 0) {
+            ticker += "  Ping " + std::to_string(data.netplay.pingMs) + " ms";
+        }
+        ticker += "  First to " + std::to_string(HighlightLog::GetConfig().firstTo);
+    }
+    double clock = HighlightLog::GetStats().streamSeconds;
+
+    std::lock_guard<std::mutex> guard(lock);
+    const PlayerData* players[2] = {&data.player1, &data.player2};
+    for (int side = 0; side < 2; side++) {
+        state.nickname[side] = players[side]->nickname;
+        state.wins[side] = players[side]->winCount;
+        state.rating[side] = players[side]->rating.rating;
+        state.comboHits[side] = combo.side[side].hits;
+        state.comboDamage[side] = combo.side[side].damage;
+        state.bestHits[side] = combo.side[side].maxHits;
+        state.roundDamage[side] = combo.side[side].roundDamage;
+    }
+    state.round = combo.round;
+    state.pingMs = data.netplay.pingMs;
+    state.clockSeconds = clock;
+    stateUs = QpcMicros();
+    state.ticker = ticker;
+    SetEvent(wakeEvent);
+}
+
+void WidgetImage::OnFrame(const ComboSample& sample) {
+    if (!stats.ready) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    state.hp[0] = sample.hp[0];
+    state.hp[1] = sample.hp[1];
+}
+
+WidgetImage::Stats WidgetImage::GetStats() {
+    std::lock_guard<std::mutex> guard(lock);
+    Stats result = stats;
+    result.encoding = writeFile ? PngWriter::GetModeName(mode) : "none";
+    result.frameRate = frameRate;
+    result.shared = frameWriter != nullptr;
+    return result;
+}
+
+OverlayWidgets::BenchmarkResult WidgetImage::RunBenchmark(int rounds) {
+    return OverlayWidgets::RunBenchmark(config, rounds);
+}
@@ -0,0 +1,117 @@
+// Reference reader and validator for the shared frame output (layout and
+// protocol in include/frame_share.h).
+//
+//   efz_frame_reader [seconds] [mapping name]
+//       Windows: follows the live mapping (default the scoreboard) and
+//       checks every frame it copies against its checksum
+//   efz_frame_reader --stress [frames] [readers]
+//       Any platform: a writer thread against reader threads in this process
+//
+// Exits nonzero if a copy was torn, out of order or invalid.
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "../include/frame_share.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int RunStress(uint32_t frames, int readers) {
+    std::string failure;
+    if (!FrameShare::RunSelfTest(failure)) {
+        printf("Self-test FAILED: %s\n", failure.c_str());
+        return 1;
+    }
+    FrameShare::StressResult result = FrameShare::RunStressTest(frames, readers);
+    printf("%llu frames published in %.2f s to %d readers: %llu copies verified, %llu unchanged polls, "
+           "%llu lapped\n",
+           (unsigned long long)result.published, result.seconds, readers, (unsigned long long)result.reads,
+           (unsigned long long)result.unchanged, (unsigned long long)result.lapped);
+    if (result.torn || result.outOfOrder) {
+        printf("FAILED: %llu torn, %llu out of order\n", (unsigned long long)result.torn,
+               (unsigned long long)result.outOfOrder);
+        return 1;
+    }
+    printf("No torn or out-of-order frames\n");
+    return 0;
+}
+
+#ifdef _WIN32
+static int FollowMapping(const char* name, double seconds) {
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    if (!mapping) {
+        printf("Cannot open %s (error %lu) - is the game running with the overlay?\n", name, GetLastError());
+        return 1;
+    }
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION region = {};
+    if (!view || !VirtualQuery(view, &region, sizeof(region))) {
+        printf("Cannot map %s (error %lu)\n", name, GetLastError());
+        CloseHandle(mapping);
+        return 1;
+    }
+
+    uint64_t frames = 0, skipped = 0, lapped = 0, torn = 0, outOfOrder = 0, invalid = 0, badDirty = 0;
+    uint64_t last = 0;
+    FrameShare::FrameInfo info;
+    std::vector<uint32_t> pixels;
+    LARGE_INTEGER frequency, start, now;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    do {
+        FrameShare::ReadStatus status = FrameShare::Read(view, region.RegionSize, last, info, pixels);
+        if (status == FrameShare::READ_FRAME) {
+            frames++;
+            skipped += last && info.frame > last + 1 ? info.frame - last - 1 : 0;
+            torn += FrameShare::Checksum(pixels.data(), pixels.size()) != info.checksum;
+            outOfOrder += info.frame < last;
+            CanvasRect bounds = {0, 0, (int)info.width, (int)info.height};
+            badDirty += !(info.dirty.Intersect(bounds) == info.dirty) && !info.dirty.Empty();
+            last = info.frame;
+        } else if (status == FrameShare::READ_LAPPED) {
+            lapped++;
+        } else if (status == FrameShare::READ_INVALID) {
+            invalid++;
+        }
+        if (FrameShare::IsClosed(view)) {
+            printf("Writer closed the mapping\n");
+            break;
+        }
+        Sleep(1);
+        QueryPerformanceCounter(&now);
+    } while ((double)(now.QuadPart - start.QuadPart) / (double)frequency.QuadPart < seconds);
+
+    printf("%s: %llu frames copied (last %llu, %ux%u), %llu skipped between polls, %llu lapped\n", name,
+           (unsigned long long)frames, (unsigned long long)last, info.width, info.height,
+           (unsigned long long)skipped, (unsigned long long)lapped);
+    UnmapViewOfFile(view);
+    CloseHandle(mapping);
+    if (torn || outOfOrder || invalid || badDirty) {
+        printf("FAILED: %llu torn, %llu out of order, %llu invalid, %llu dirty rectangles out of bounds\n",
+               (unsigned long long)torn, (unsigned long long)outOfOrder, (unsigned long long)invalid,
+               (unsigned long long)badDirty);
+        return 1;
+    }
+    printf("Every frame matched its checksum\n");
+    return 0;
+}
+#endif
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--stress") == 0) {
+        uint32_t frames = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 10) : 200000;
+        unsigned cores = std::thread::hardware_concurrency();
+        int readers = argc > 3 ? atoi(argv[3]) : (cores > 2 ? (int)cores - 1 : 2);
+        return RunStress(frames, readers);
+    }
+#ifdef _WIN32
+    double seconds = argc > 1 ? atof(argv[1]) : 10.0;
+    return FollowMapping(argc > 2 ? argv[2] : FRAME_SHARE_SCOREBOARD_NAME, seconds);
+#else
+    printf("Only --stress is available on this platform\n");
+    return 2;
+#endif
+}
@@ -0,0 +1,81 @@
+// Runs the self-tests of the portable components outside the game, so the
+// checks behind the "test ..." console commands also run in CI (ctest).
+// Components that need the game or Win32 (the nickname pool's allocation
+// count, the match history's file mapping) stay console-only.
+//
+//   efz_self_test [name]
+//       Every test, or only the named one
+//
+// Exits nonzero if a test failed.
+#include "../include/canvas.h"
+#include "../include/combo_tracker.h"
+#include "../include/draw_list_rasterizer.h"
+#include "../include/frame_sampler.h"
+#include "../include/frame_share.h"
+#include "../include/highlight_detector.h"
+#include "../include/input_recorder.h"
+#include "../include/layout_classifier.h"
+#include "../include/netplay_telemetry.h"
+#include "../include/nickname_sanitizer.h"
+#include "../include/offset_schema.h"
+#include "../include/overlay_widgets.h"
+#include "../include/png_writer.h"
+#include "../include/scoreboard_renderer.h"
+#include "../include/signature_scanner.h"
+#include "../include/utf_transcoder.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+struct SelfTest {
+    const char* name;
+    bool (*run)(std::string& failure);
+};
+
+// Same iteration count as "test utf"
+static bool RunTranscoderFuzz(std::string& failure) {
+    return Utf16Transcoder::RunFuzzTest(100000, failure);
+}
+
+static const SelfTest TESTS[] = {
+    { "utf", RunTranscoderFuzz },
+    { "sanitizer", NicknameSanitizer::RunSelfTest },
+    { "schema", OffsetSchema::RunSelfTest },
+    { "layout", LayoutClassifier::RunSelfTest },
+    { "netplay", NetplayTelemetry::RunSelfTest },
+    { "combo", ComboTracker::RunSelfTest },
+    { "highlights", HighlightDetector::RunSelfTest },
+    { "inputs", InputRecorder::RunSelfTest },
+    { "canvas", Canvas::RunSelfTest },
+    { "png", PngWriter::RunSelfTest },
+    { "scoreboard", ScoreboardRenderer::RunSelfTest },
+    { "rasterizer", DrawListRasterizer::RunSelfTest },
+    { "widgets", OverlayWidgets::RunSelfTest },
+    { "frameshare", FrameShare::RunSelfTest },
+    { "scanner", SignatureScanner::RunSelfTest },
+    { "sampler", FrameSampler::RunSelfTest },   // Simulated clock
+};
+
+int main(int argc, char** argv) {
+    const char* only = argc > 1 ? argv[1] : nullptr;
+    int failed = 0;
+    int ran = 0;
+    for (const SelfTest& test : TESTS) {
+        if (only && strcmp(only, test.name) != 0) {
+            continue;
+        }
+        std::string failure;
+        ran++;
+        if (test.run(failure)) {
+            printf("%-12s passed\n", test.name);
+        } else {
+            printf("%-12s FAILED: %s\n", test.name, failure.c_str());
+            failed++;
+        }
+    }
+    if (ran == 0) {
+        printf("Unknown test '%s'\n", only);
+        return 2;
+    }
+    return failed ? 1 : 0;
+}